@@ -0,0 +1,239 @@
+// Battery replay check and benchmark. Writes the same trace (a battery
+// draining on battery, then charging on AC, at 1 Hz from an hour boundary)
+// as a CSV file, with a header, a comment and two lines swapped, and as a
+// TLM1 telemetry file, and checks that both load to the same samples in
+// time order. Replays at speed 0 and checks that every sample comes out once
+// and that the replay then ends; replays with loop and checks that each pass
+// is the previous one shifted by the loop length (the span plus one mean
+// interval). Feeds a replay into BatteryHistory and a TelemetryWriter and
+// checks the raw, minute and hour tier counts, the AC transition, the file's
+// sample and block counts, and that a sample from a clock that stepped back
+// is kept. Times the replay through both.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_battery_replay.cpp labs/battery_replay.cpp labs/battery_source.cpp labs/battery_history.cpp labs/telemetry_file.cpp labs/mapped_file.cpp labs/power_supply_linux.cpp -o bench_battery_replay -pthread
+//   ./bench_battery_replay [hours=3] [directory=/tmp]
+#include "battery_replay.hpp"
+#include "battery_history.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// 2023-11-14 22:00 UTC, on an hour boundary so the tiers split evenly
+static const uint64_t kStartMs = 1700000000000ull - 1700000000000ull % BatteryHistory::kHourMs;
+static const size_t kSamplesPerBlock = 256;
+// long enough that only kSamplesPerBlock ends a block
+static const uint64_t kMaxBlockAgeMs = 24 * BatteryHistory::kHourMs;
+
+// on battery for the first two thirds, then plugged in
+static std::vector<TelemetrySample> makeTrace(size_t samples) {
+    std::vector<TelemetrySample> trace(samples);
+    size_t plugged = samples * 2 / 3;
+    for (size_t i = 0; i < samples; i++) {
+        TelemetrySample& sample = trace[i];
+        sample.timestampMs = kStartMs + i * 1000;
+        bool onAc = i >= plugged;
+        int64_t charge = onAc ? 20 + (int64_t)((i - plugged) * 80 / samples) : 100 - (int64_t)(i * 80 / plugged);
+        sample.values[0] = charge;
+        sample.values[1] = onAc ? -1 : (int64_t)(plugged - i);
+        sample.values[2] = onAc ? (int64_t)AcLineStatus::Online : (int64_t)AcLineStatus::Offline;
+        sample.values[3] = onAc ? BatteryFlagCharging : 0;
+        sample.values[4] = 0;
+    }
+    return trace;
+}
+
+static void writeCsv(const fs::path& path, const std::vector<TelemetrySample>& trace) {
+    std::ofstream file(path, std::ios::trunc);
+    file << "timestampMs,charge,timeLeft,acLineStatus,batteryFlag,eco\n";
+    file << "# recorded by bench_battery_replay\n";
+    for (size_t i = 0; i < trace.size(); i++) {
+        // the second and third lines swapped: the loader sorts them back
+        size_t index = i == 1 ? 2 : i == 2 ? 1 : i;
+        const TelemetrySample& sample = trace[index];
+        file << sample.timestampMs;
+        for (size_t field = 0; field < kBatteryTelemetryFields; field++) file << "," << sample.values[field];
+        file << "\n";
+    }
+}
+
+static bool writeTelemetry(const fs::path& path, const std::vector<TelemetrySample>& trace) {
+    fs::remove(path);
+    TelemetryWriter writer(kSamplesPerBlock, kMaxBlockAgeMs);
+    if (!writer.open(path.string(), kBatteryTelemetryFields)) return false;
+    for (const TelemetrySample& sample : trace) writer.append(sample);
+    writer.close();
+    return true;
+}
+
+static bool sameSample(const BatterySnapshot& snapshot, const TelemetrySample& expected) {
+    TelemetrySample sample = batterySnapshotToTelemetry(snapshot);
+    if (sample.timestampMs != expected.timestampMs) return false;
+    for (size_t field = 0; field < kBatteryTelemetryFields; field++) {
+        if (sample.values[field] != expected.values[field]) return false;
+    }
+    return true;
+}
+
+// plays the whole trace at speed 0 and compares it sample by sample
+static void checkLoad(const fs::path& path, const char* what, const std::vector<TelemetrySample>& trace) {
+    ReplayBatterySource source(0);
+    check(source.load(path.string()), std::string(what) + " loads: " + source.error());
+    check(source.traceLength() == trace.size(), std::string(what) + " trace length: " + std::to_string(source.traceLength()));
+    size_t played = 0;
+    size_t mismatched = 0;
+    BatterySnapshot snapshot;
+    while (source.sample(snapshot)) {
+        if (played >= trace.size() || !sameSample(snapshot, trace[played])) mismatched++;
+        played++;
+        source.waitNext(std::chrono::milliseconds(1000));
+    }
+    check(played == trace.size() && source.samplesReplayed() == trace.size(),
+          std::string(what) + " speed 0 plays every sample once: " + std::to_string(played));
+    check(mismatched == 0, std::string(what) + " samples as recorded, in time order: " + std::to_string(mismatched) + " differ");
+    check(source.finished() && !source.sample(snapshot), std::string(what) + " ends after the last sample");
+}
+
+static void checkLoop(const fs::path& path, const std::vector<TelemetrySample>& trace) {
+    ReplayBatterySource source(0, true);
+    check(source.load(path.string()), "loop trace loads");
+    uint64_t span = trace.back().timestampMs - trace.front().timestampMs;
+    uint64_t loopLengthMs = span + std::max<uint64_t>(1, span / (trace.size() - 1));
+
+    const int passes = 3;
+    size_t shifted = 0;
+    size_t backwards = 0;
+    uint64_t last = 0;
+    BatterySnapshot snapshot;
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < trace.size(); i++) {
+            if (!source.sample(snapshot)) break;
+            TelemetrySample expected = trace[i];
+            expected.timestampMs += pass * loopLengthMs;
+            if (!sameSample(snapshot, expected)) shifted++;
+            if (snapshot.sampledAtMs <= last) backwards++;
+            last = snapshot.sampledAtMs;
+        }
+    }
+    check(source.samplesReplayed() == passes * trace.size() && !source.finished(),
+          "loop keeps playing: " + std::to_string(source.samplesReplayed()));
+    check(shifted == 0, "every pass shifted by the loop length: " + std::to_string(shifted) + " differ");
+    check(backwards == 0, "time keeps going forward across passes");
+}
+
+// a short trace at speed 10: the deadlines follow the trace's spacing
+static void checkSpeed(const fs::path& path) {
+    std::vector<TelemetrySample> trace = makeTrace(6);
+    for (size_t i = 0; i < trace.size(); i++) trace[i].timestampMs = kStartMs + i * 100;
+    writeCsv(path, trace);
+    ReplayBatterySource source(10);
+    check(source.load(path.string()), "speed trace loads");
+    BatterySnapshot snapshot;
+    auto started = Clock::now();
+    while (source.sample(snapshot)) source.waitNext(std::chrono::milliseconds(1000));
+    double elapsedMs = msSince(started);
+    // 500 ms of trace at 10x
+    check(elapsedMs >= 49 && elapsedMs < 1000, "speed 10 takes a tenth of the trace: " + std::to_string(elapsedMs) + " ms");
+}
+
+static void checkHistoryAndFile(const fs::path& tracePath, const fs::path& outPath, size_t samples, double& replayMs) {
+    ReplayBatterySource source(0);
+    check(source.load(tracePath.string()), "history trace loads");
+    BatteryHistory history;
+    fs::remove(outPath);
+    TelemetryWriter writer(kSamplesPerBlock, kMaxBlockAgeMs);
+    check(writer.open(outPath.string(), kBatteryTelemetryFields), "telemetry output opens");
+
+    // what the sampler thread does with every sample in main.cpp
+    auto started = Clock::now();
+    BatterySnapshot snapshot;
+    while (source.sample(snapshot)) {
+        history.add(snapshot);
+        writer.append(batterySnapshotToTelemetry(snapshot));
+        source.waitNext(std::chrono::milliseconds(1000));
+    }
+    replayMs = msSince(started);
+    writer.close();
+
+    uint64_t endMs = kStartMs + samples * 1000;
+    size_t minutes = (samples + 59) / 60;
+    size_t hours = (samples + 3599) / 3600;
+    BatteryHistoryQuery raw = history.query(kStartMs, endMs, 1);
+    check(raw.tier == "raw" && raw.points.size() == samples, "raw tier: " + std::to_string(raw.points.size()));
+    BatteryHistoryQuery minute = history.query(kStartMs, endMs, BatteryHistory::kMinuteMs);
+    check(minute.tier == "minute" && minute.points.size() == minutes, "minute tier: " + std::to_string(minute.points.size()));
+    BatteryHistoryQuery hour = history.query(kStartMs, endMs, BatteryHistory::kHourMs);
+    check(hour.tier == "hour" && hour.points.size() == hours, "hour tier: " + std::to_string(hour.points.size()));
+    uint64_t counted = 0;
+    uint32_t transitions = 0;
+    for (const auto& bucket : hour.points) {
+        counted += bucket.samples;
+        transitions += bucket.acTransitions;
+    }
+    check(counted == samples, "hour buckets hold every sample: " + std::to_string(counted));
+    check(transitions == 1, "one AC transition: " + std::to_string(transitions));
+
+    // the clock stepped back an hour: stamped with the last time, not dropped
+    snapshot.sampledAtMs -= BatteryHistory::kHourMs;
+    history.add(snapshot);
+    raw = history.query(kStartMs, endMs, 1);
+    // the query merges it with the last sample, they have the same time
+    check(raw.points.size() == samples && raw.points.back().startMs == endMs - 1000 && raw.points.back().samples == 2,
+          "a sample from before a clock step is kept at the last time");
+
+    TelemetryReader reader;
+    check(reader.open(outPath.string()), "telemetry output reads back");
+    check(reader.sampleCount() == samples, "telemetry samples: " + std::to_string(reader.sampleCount()));
+    check(reader.blockCount() == (samples + kSamplesPerBlock - 1) / kSamplesPerBlock,
+          "telemetry blocks: " + std::to_string(reader.blockCount()));
+    check(reader.lastMs() == endMs - 1000, "telemetry ends with the trace");
+}
+
+int main(int argc, char** argv) {
+    int hours = argc > 1 ? atoi(argv[1]) : 3;
+    // the raw tier keeps 6 hours, and the clock step check adds a sample
+    size_t samples = (size_t)std::max(1, std::min(hours, 5)) * 3600;
+    fs::path directory = argc > 2 ? argv[2] : fs::temp_directory_path();
+    std::string prefix = "battery-replay-" + std::to_string(getpid());
+    fs::path csvPath = directory / (prefix + ".csv");
+    fs::path tlmPath = directory / (prefix + ".tlm");
+    fs::path outPath = directory / (prefix + "-out.tlm");
+    fs::path speedPath = directory / (prefix + "-speed.csv");
+
+    std::vector<TelemetrySample> trace = makeTrace(samples);
+    writeCsv(csvPath, trace);
+    check(writeTelemetry(tlmPath, trace), "telemetry trace written");
+
+    checkLoad(csvPath, "CSV", trace);
+    checkLoad(tlmPath, "TLM1", trace);
+    checkLoop(tlmPath, trace);
+    checkSpeed(speedPath);
+    double replayMs = 0;
+    checkHistoryAndFile(csvPath, outPath, samples, replayMs);
+
+    printf("%zu samples replayed into the history and a telemetry file: %.1f ms, %.2f us per sample\n",
+           samples, replayMs, replayMs * 1000 / samples);
+    for (const fs::path& path : {csvPath, tlmPath, outPath, speedPath}) fs::remove(path);
+    printf("checks: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,258 @@
+// Block device inventory check and benchmark. Builds a fake /sys and /proc
+// with N SCSI LUNs (two partitions each, some mounted), a few NVMe
+// namespaces, loop devices and an empty CD drive, checks the records, checks
+// that only block uevents make the inventory enumerate again, and times
+// full enumerations.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_block_devices.cpp labs/block_devices.cpp labs/power_supply_linux.cpp labs/worker_pool.cpp -o bench_block_devices -pthread
+//   ./bench_block_devices [LUNs=512] [workers=0]
+//   ./bench_block_devices --root / [workers=0]     (the real /sys and /proc)
+#include "block_devices.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        if (failures < 20) printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+}
+
+// sda .. sdz, sdaa .. sdzz, as the kernel names them
+static std::string scsiName(int index) {
+    std::string letters;
+    index++;
+    while (index > 0) {
+        index--;
+        letters.insert(letters.begin(), (char)('a' + index % 26));
+        index /= 26;
+    }
+    return "sd" + letters;
+}
+
+struct FakeDisk {
+    std::string name;
+    int major, minor;
+    uint64_t sectors;
+    int partitions;
+    bool nvme;
+};
+
+static void addDisk(const fs::path& sys, std::string& partitionsText, const FakeDisk& disk) {
+    fs::path dir = sys / "block" / disk.name;
+    fs::create_directories(dir / "queue");
+    writeFile(dir / "dev", std::to_string(disk.major) + ":" + std::to_string(disk.minor) + "\n");
+    writeFile(dir / "size", std::to_string(disk.sectors) + "\n");
+    writeFile(dir / "removable", "0\n");
+    writeFile(dir / "ro", "0\n");
+    writeFile(dir / "queue/rotational", disk.nvme ? "0\n" : "1\n");
+    writeFile(dir / "queue/logical_block_size", "512\n");
+    writeFile(dir / "queue/physical_block_size", "4096\n");
+    writeFile(dir / "queue/nr_requests", disk.nvme ? "1023\n" : "256\n");
+    writeFile(dir / "queue/scheduler", disk.nvme ? "[none] mq-deadline kyber bfq\n" : "mq-deadline kyber [bfq] none\n");
+    fs::create_directories(dir / "device");
+    if (disk.nvme) {
+        writeFile(dir / "device/model", "Samsung SSD 980 PRO 1TB                 \n");
+    } else {
+        writeFile(dir / "device/vendor", "LIO-ORG \n");
+        writeFile(dir / "device/model", "block_lun       \n");
+        writeFile(dir / "device/queue_depth", "64\n");
+    }
+    partitionsText += " " + std::to_string(disk.major) + " " + std::to_string(disk.minor) + " " +
+                      std::to_string(disk.sectors / 2) + " " + disk.name + "\n";
+    uint64_t start = 2048;
+    for (int part = 1; part <= disk.partitions; part++) {
+        std::string name = disk.name + (disk.nvme ? "p" : "") + std::to_string(part);
+        uint64_t sectors = disk.sectors / 4;
+        fs::create_directories(dir / name);
+        writeFile(dir / name / "partition", std::to_string(part) + "\n");
+        writeFile(dir / name / "start", std::to_string(start) + "\n");
+        writeFile(dir / name / "size", std::to_string(sectors) + "\n");
+        partitionsText += " " + std::to_string(disk.major) + " " + std::to_string(disk.minor + part) + " " +
+                          std::to_string(sectors / 2) + " " + name + "\n";
+        start += sectors;
+    }
+}
+
+static fs::path buildTree(int luns) {
+    fs::path root = fs::temp_directory_path() / ("fake_block_" + std::to_string(getpid()));
+    fs::path sys = root / "sys";
+    fs::path proc = root / "proc";
+    fs::create_directories(sys / "block");
+    fs::create_directories(proc / "self");
+    std::string partitions = "major minor  #blocks  name\n\n";
+    std::string mountinfo = "21 1 0:20 / /proc rw,nosuid,nodev,noexec,relatime shared:12 - proc proc rw\n";
+
+    for (int n = 0; n < 4; n++) {
+        FakeDisk disk{ "nvme0n" + std::to_string(n + 1), 259, n * 8, 1953525168ull, 3, true };
+        addDisk(sys, partitions, disk);
+    }
+    mountinfo += "25 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n";
+    mountinfo += "26 25 259:1 / /boot/efi rw,relatime shared:2 - vfat /dev/nvme0n1p1 rw,fmask=0077\n";
+    for (int i = 0; i < luns; i++) {
+        // sd majors are 8, then 65 to 71, 16 disks of 16 minors each
+        FakeDisk disk{ scsiName(i), i / 16 ? 64 + i / 16 : 8, (i % 16) * 16, 209715200ull, 2, false };
+        addDisk(sys, partitions, disk);
+        if (i % 4 == 0) {
+            mountinfo += std::to_string(100 + i) + " 25 " + std::to_string(disk.major) + ":" + std::to_string(disk.minor + 1) +
+                         " / /srv/lun" + std::to_string(i) + " rw,noatime shared:" + std::to_string(100 + i) +
+                         " master:3 - xfs /dev/" + disk.name + "1 rw,attr2\n";
+        }
+    }
+    // a mount point with a space, read only
+    mountinfo += "90 25 8:2 / /mnt/backup\\040disk ro,relatime - ext4 /dev/sda2 ro\n";
+    // unused loop devices are left out, a used one is kept
+    for (int n = 0; n < 8; n++) {
+        fs::path dir = sys / "block" / ("loop" + std::to_string(n));
+        fs::create_directories(dir / "queue");
+        writeFile(dir / "dev", "7:" + std::to_string(n) + "\n");
+        writeFile(dir / "size", n == 3 ? "131072\n" : "0\n");
+        writeFile(dir / "removable", "0\n");
+    }
+    partitions += "   7        3      65536 loop3\n";
+    mountinfo += "40 25 7:3 / /snap/core/1 ro,nodev,relatime shared:20 - squashfs /dev/loop3 ro\n";
+    // a CD drive without a disc
+    fs::create_directories(sys / "block/sr0/queue");
+    writeFile(sys / "block/sr0/dev", "11:0\n");
+    writeFile(sys / "block/sr0/size", "0\n");
+    writeFile(sys / "block/sr0/removable", "1\n");
+    // in /proc/partitions but not a partition of sda in sysfs
+    partitions += "   8       15       1024 sda15\n";
+    writeFile(proc / "partitions", partitions);
+    writeFile(proc / "self/mountinfo", mountinfo);
+    return root;
+}
+
+// a uevent with its NUL separators, as it comes off the socket
+template <size_t N>
+static std::string uevent(const char (&text)[N]) {
+    return std::string(text, N - 1);
+}
+
+static const BlockDevice* findDevice(const std::vector<BlockDevice>& devices, const std::string& name) {
+    for (const auto& device : devices) {
+        if (device.name == name) return &device;
+    }
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    int luns = 512;
+    unsigned workers = 0;
+    std::string sysRoot, procRoot;
+    bool fake = true;
+    if (argc > 2 && strcmp(argv[1], "--root") == 0) {
+        sysRoot = std::string(argv[2]) + "/sys";
+        procRoot = std::string(argv[2]) + "/proc";
+        fake = false;
+        if (argc > 3) workers = (unsigned)atoi(argv[3]);
+    } else {
+        if (argc > 1) luns = atoi(argv[1]);
+        if (argc > 2) workers = (unsigned)atoi(argv[2]);
+        if (luns < 1) luns = 1;
+        fs::path root = buildTree(luns);
+        sysRoot = (root / "sys").string();
+        procRoot = (root / "proc").string();
+    }
+
+    BlockDeviceEnumerator enumerator(sysRoot, procRoot, workers);
+    std::vector<BlockDevice> devices = enumerator.enumerate();
+
+    if (fake) {
+        // 4 NVMe namespaces, the LUNs, loop3 and sr0
+        expect(devices.size() == (size_t)luns + 6, "device count " + std::to_string(devices.size()));
+        bool ordered = true;
+        for (size_t i = 1; i < devices.size(); i++) {
+            ordered = ordered && BlockDeviceEnumerator::nameLess(devices[i - 1].name, devices[i].name);
+        }
+        expect(ordered, "name order");
+        expect(BlockDeviceEnumerator::nameLess("sdz", "sdaa") && BlockDeviceEnumerator::nameLess("nvme0n2", "nvme0n10") &&
+               !BlockDeviceEnumerator::nameLess("sdaa", "sdz"), "natural order");
+
+        const BlockDevice* nvme = findDevice(devices, "nvme0n1");
+        expect(nvme && nvme->model == "Samsung SSD 980 PRO 1TB" && nvme->sizeBytes == 1953525168ull * 512 &&
+               !nvme->rotational && nvme->queueDepth == -1 && nvme->scheduler == "none" && nvme->schedulers.size() == 4,
+               "nvme0n1 attributes");
+        expect(nvme && nvme->partitions.size() == 3 && nvme->partitions[1].name == "nvme0n1p2" &&
+               nvme->partitions[1].number == 2 && nvme->partitions[1].mounts.size() == 1 &&
+               nvme->partitions[1].mounts[0].mountPoint == "/" && nvme->partitions[1].mounts[0].fsType == "ext4",
+               "nvme0n1 partitions and root mount");
+        expect(nvme && nvme->partitions.size() == 3 && nvme->partitions[0].startSector == 2048 &&
+               nvme->partitions[0].sizeBytes == 1953525168ull / 4 / 2 * 1024 && nvme->partitions[0].mounts[0].source == "/dev/nvme0n1p1",
+               "nvme0n1p1 start, size and source");
+
+        const BlockDevice* sda = findDevice(devices, "sda");
+        expect(sda && sda->vendor == "LIO-ORG" && sda->model == "block_lun" && sda->queueDepth == 64 && sda->rotational &&
+               sda->scheduler == "bfq" && sda->requests == 256 && sda->physicalBlockSize == 4096,
+               "sda attributes");
+        expect(sda && sda->partitions.size() == 2, "sda15 is not a partition of sda");
+        expect(sda && sda->partitions.size() == 2 && sda->partitions[0].mounts.size() == 1 &&
+               sda->partitions[0].mounts[0].mountPoint == "/srv/lun0" && sda->partitions[1].mounts.size() == 1 &&
+               sda->partitions[1].mounts[0].mountPoint == "/mnt/backup disk" && sda->partitions[1].mounts[0].readOnly,
+               "sda mounts, escaped mount point");
+        expect(!findDevice(devices, "loop0"), "unused loop device left out");
+        const BlockDevice* loop = findDevice(devices, "loop3");
+        expect(loop && loop->mounts.size() == 1 && loop->mounts[0].fsType == "squashfs" && loop->mounts[0].readOnly,
+               "loop3 mounted on the whole device");
+        const BlockDevice* cd = findDevice(devices, "sr0");
+        expect(cd && cd->removable && cd->sizeBytes == 0, "empty CD drive kept");
+        if (luns > 17) {
+            const BlockDevice* lun = findDevice(devices, scsiName(17));
+            expect(lun && lun->major == 65 && lun->minor == 16 && lun->partitions.size() == 2 &&
+                   lun->partitions[0].minor == 17, "LUN 17 numbers");
+        }
+
+        // only block uevents make the inventory enumerate again
+        auto pipe = std::make_unique<PipeUeventSource>();
+        PipeUeventSource* events = pipe.get();
+        BlockInventory inventory(sysRoot, procRoot, std::move(pipe));
+        auto first = inventory.current();
+        auto again = inventory.current();
+        expect(inventory.enumerations() == 1 && first == again, "cached between events");
+        events->inject(uevent("add@/devices/pci0000:00/0000:00:14.0/usb1/1-1\0SUBSYSTEM=usb\0DEVTYPE=usb_device"));
+        inventory.current();
+        expect(inventory.enumerations() == 1, "usb uevent ignored");
+        events->inject(uevent("change@/devices/virtual/block/loop3\0ACTION=change\0SUBSYSTEM=block"));
+        auto same = inventory.current();
+        expect(inventory.enumerations() == 2 && same->generation == first->generation, "block uevent, nothing changed");
+        writeFile(fs::path(sysRoot) / "block/sda/queue/scheduler", "[mq-deadline] kyber bfq none\n");
+        events->inject(uevent("change@/devices/platform/host0/target0:0:0/0:0:0:0/block/sda\0SUBSYSTEM=block"));
+        auto changed = inventory.current();
+        expect(inventory.enumerations() == 3 && changed->generation == first->generation + 1 &&
+               findDevice(changed->devices, "sda")->scheduler == "mq-deadline", "block uevent, scheduler changed");
+        inventory.invalidate();
+        inventory.current();
+        expect(inventory.enumerations() == 4, "invalidate");
+        printf("checks: %d failures\n", failures);
+    }
+
+    size_t partitionCount = 0;
+    for (const auto& device : devices) partitionCount += device.partitions.size();
+    int runs = 20;
+    auto started = Clock::now();
+    for (int run = 0; run < runs; run++) {
+        devices = enumerator.enumerate();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count() / runs;
+    printf("%zu disks, %zu partitions, %u threads: %.2f ms per enumeration\n",
+           devices.size(), partitionCount, enumerator.threadCount(), ms);
+
+    if (fake) fs::remove_all(fs::path(sysRoot).parent_path());
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+// /proc/diskstats sampler check and benchmark. Writes a fake diskstats with
+// known counter deltas and checks the rates, latencies, queue depth,
+// utilization and window averages worked out from them, devices coming and
+// going and counters going backwards. Then times ticks over N disks with two
+// partitions each, and counts heap allocations per tick.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_disk_stats.cpp labs/disk_stats.cpp -o bench_disk_stats -pthread
+//   ./bench_disk_stats [disks=500]
+//   ./bench_disk_stats --root /        (the real /proc/diskstats)
+#include "disk_stats.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        if (failures < 20) printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static bool near(double a, double b) {
+    return std::fabs(a - b) <= 1e-3 * std::max(1.0, std::fabs(b));
+}
+
+struct Counters {
+    uint64_t reads, readSectors, readMs, writes, writeSectors, writeMs, inFlight, ioMs, weightedMs;
+};
+
+static std::string line(int major, int minor, const std::string& name, const Counters& c) {
+    char text[256];
+    // the kernel prints 17 or 20 fields now; the sampler reads the first 14
+    snprintf(text, sizeof(text), "%4d %7d %s %llu 0 %llu %llu %llu 0 %llu %llu %llu %llu %llu 0 0 0 0 0 0\n",
+             major, minor, name.c_str(), (unsigned long long)c.reads, (unsigned long long)c.readSectors,
+             (unsigned long long)c.readMs, (unsigned long long)c.writes, (unsigned long long)c.writeSectors,
+             (unsigned long long)c.writeMs, (unsigned long long)c.inFlight, (unsigned long long)c.ioMs,
+             (unsigned long long)c.weightedMs);
+    return text;
+}
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+}
+
+static const DiskIoStats* find(const std::vector<DiskIoStats>& stats, const std::string& name) {
+    for (const auto& item : stats) {
+        if (item.name == name) return &item;
+    }
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    int disks = 500;
+    std::string procRoot, sysRoot;
+    bool fake = true;
+    if (argc > 2 && strcmp(argv[1], "--root") == 0) {
+        procRoot = std::string(argv[2]) + "/proc";
+        sysRoot = std::string(argv[2]) + "/sys";
+        fake = false;
+    } else if (argc > 1) {
+        disks = std::max(1, atoi(argv[1]));
+    }
+    fs::path root = fs::temp_directory_path() / ("fake_diskstats_" + std::to_string(getpid()));
+
+    if (fake) {
+        procRoot = (root / "proc").string();
+        sysRoot = (root / "sys").string();
+        fs::create_directories(root / "proc");
+        fs::create_directories(root / "sys/block/sda");
+        fs::create_directories(root / "sys/block/sdb");
+        fs::path path = root / "proc/diskstats";
+
+        DiskStatsMonitor monitor(procRoot, sysRoot, 16);
+        int listened = 0;
+        monitor.addListener([&listened](uint64_t) { listened++; });
+        Counters sda{ 1000, 80000, 3000, 500, 40000, 2500, 0, 10000, 20000 };
+        Counters sda1 = sda;
+        Counters sdb{ 10, 100, 10, 0, 0, 0, 0, 20, 30 };
+        writeFile(path, line(8, 0, "sda", sda) + line(8, 1, "sda1", sda1) + line(8, 16, "sdb", sdb));
+        expect(monitor.sampleOnce(1000000), "first tick");
+        expect(monitor.deviceCount() == 3 && listened == 1, "three devices, listener called");
+        auto stats = monitor.stats(0, 1000000);
+        expect(find(stats, "sda") && find(stats, "sda")->last.timestampMs == 0, "first tick is the baseline");
+        expect(find(stats, "sda1") && find(stats, "sda1")->partition && !find(stats, "sda")->partition, "partition flag");
+
+        // one second: 100 reads of 1 MiB in total taking 5 ms each, 50 writes
+        // of 2 MiB taking 8 ms each, busy 950 ms with 1.5 requests in flight
+        sda.reads += 100; sda.readSectors += 2048; sda.readMs += 500;
+        sda.writes += 50; sda.writeSectors += 4096; sda.writeMs += 400;
+        sda.ioMs += 950; sda.weightedMs += 1500; sda.inFlight = 3;
+        writeFile(path, line(8, 0, "sda", sda) + line(8, 1, "sda1", sda1) + line(8, 16, "sdb", sdb));
+        monitor.sampleOnce(1001000);
+        stats = monitor.stats(0, 1001000);
+        const DiskIoStats* a = find(stats, "sda");
+        expect(a && near(a->last.readIops, 100) && near(a->last.writeIops, 50), "IOPS");
+        expect(a && near(a->last.readBytesPerSecond, 1048576) && near(a->last.writeBytesPerSecond, 2097152), "throughput");
+        expect(a && near(a->last.readLatencyMs, 5) && near(a->last.writeLatencyMs, 8), "latency");
+        expect(a && near(a->last.queueDepth, 1.5) && near(a->last.utilization, 0.95) && a->last.inFlight == 3,
+               "queue depth, utilization, in flight");
+        expect(a && a->saturated && a->reads == sda.reads && a->bytesWritten == sda.writeSectors * 512, "saturated, totals");
+        expect(find(stats, "sdb") && !find(stats, "sdb")->saturated && find(stats, "sdb")->last.readIops == 0, "idle sdb");
+
+        // three seconds idle: the 4 second window averages to a quarter
+        writeFile(path, line(8, 0, "sda", sda) + line(8, 1, "sda1", sda1) + line(8, 16, "sdb", sdb));
+        monitor.sampleOnce(1004000);
+        stats = monitor.stats(4000, 1004000);
+        a = find(stats, "sda");
+        expect(a && near(a->readIops, 25) && near(a->utilization, 0.2375) && !a->saturated &&
+               near(a->peakUtilization, 0.95) && near(a->readLatencyMs, 5), "window weighted by tick length");
+
+        // sdb pulled, sdc plugged in, sda's counters reset
+        Counters sdc{ 5, 40, 1, 0, 0, 0, 0, 1, 1 };
+        sda = Counters{ 10, 80, 20, 0, 0, 0, 0, 100, 100 };
+        writeFile(path, line(8, 0, "sda", sda) + line(8, 1, "sda1", sda1) + line(8, 32, "sdc", sdc));
+        monitor.sampleOnce(1005000);
+        stats = monitor.stats(0, 1005000);
+        std::vector<DiskIoSample> samples;
+        expect(!find(stats, "sdb") && !monitor.history("sdb", samples), "sdb gone");
+        expect(find(stats, "sdc") && find(stats, "sdc")->last.timestampMs == 0 && find(stats, "sdc")->partition,
+               "sdc new, not in the fake /sys/block");
+        a = find(stats, "sda");
+        expect(a && near(a->last.readIops, 10) && near(a->last.utilization, 0.1), "reset counts from zero");
+        expect(monitor.history("sda", samples) && samples.size() == 3 && samples[0].timestampMs == 1001000, "history");
+        expect(stats.size() == 3 && stats[2].name == "sdc", "file order");
+        printf("checks: %d failures\n", failures);
+    }
+
+    // --- benchmark ---
+    if (fake) {
+        fs::path path = root / "proc/diskstats";
+        std::string text;
+        for (int i = 0; i < disks; i++) {
+            Counters c{ (uint64_t)i * 1000, (uint64_t)i * 80000, 3000, 500, 40000, 2500, 1, 10000, 20000 };
+            std::string name = "sd" + std::to_string(i);
+            text += line(8 + i / 16, (i % 16) * 16, name, c);
+            text += line(8 + i / 16, (i % 16) * 16 + 1, name + "p1", c);
+            text += line(8 + i / 16, (i % 16) * 16 + 2, name + "p2", c);
+        }
+        writeFile(path, text);
+    }
+    DiskStatsMonitor monitor(procRoot, sysRoot);
+    uint64_t nowMs = 2000000;
+    monitor.sampleOnce(nowMs);
+    monitor.sampleOnce(nowMs += 1000);
+    int ticks = 1000;
+    uint64_t before = allocations;
+    auto started = Clock::now();
+    for (int i = 0; i < ticks; i++) monitor.sampleOnce(nowMs += 1000);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - started).count() / ticks;
+    double perTick = (double)(allocations - before) / ticks;
+    started = Clock::now();
+    auto stats = monitor.stats(60000, nowMs);
+    double statsUs = std::chrono::duration<double, std::micro>(Clock::now() - started).count();
+    printf("%zu devices: %.1f us per tick (%.2f us per device), %.2f allocations per tick; 60 s stats %.0f us\n",
+           monitor.deviceCount(), us, us / std::max<size_t>(1, monitor.deviceCount()), perTick, statsUs);
+    if (fake) expect(perTick == 0, "no allocations in steady state");
+
+    if (fake) fs::remove_all(root);
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
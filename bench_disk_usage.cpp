@@ -0,0 +1,240 @@
+// Directory usage scanner check and benchmark. Generates a tree of N sparse
+// files (100 per directory, four levels of ten directories, backdated a
+// day) and checks the scanner's totals and largest files against what was
+// generated. Then times a full scan against a plain std::filesystem walk
+// and a rescan of the unchanged tree, and checks that added, removed and
+// growing files are picked up by rescans that read only what changed.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_disk_usage.cpp labs/disk_usage.cpp labs/worker_pool.cpp -o bench_disk_usage -pthread
+//   ./bench_disk_usage [files=1000000] [workers=0] [directory=/tmp/disk-usage-tree]
+//
+// The tree is kept between runs and generated again only if the file count
+// differs; delete the directory to get rid of it.
+#include "disk_usage.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static const int kFilesPerDirectory = 100;
+
+static uint64_t fileSize(uint64_t index) {
+    return (index * 2654435761ull) % (64ull << 20);
+}
+
+// directory of the leaf a file goes in: "3/1/4/1" for leaf 3141
+static std::string leafPath(uint64_t leaf) {
+    char text[64];
+    snprintf(text, sizeof(text), "%llu/%llu/%llu/%llu", (unsigned long long)(leaf / 1000 % 10),
+             (unsigned long long)(leaf / 100 % 10), (unsigned long long)(leaf / 10 % 10), (unsigned long long)(leaf % 10));
+    return text;
+}
+
+static void generate(const fs::path& root, uint64_t files) {
+    std::ifstream manifest(root / "manifest");
+    uint64_t existing = 0;
+    if (manifest >> existing && existing == files) return;
+    printf("generating %llu files in %s...\n", (unsigned long long)files, root.c_str());
+    auto started = Clock::now();
+    fs::remove_all(root);
+    fs::create_directories(root);
+    const timespec old[2] = {{time(nullptr) - 86400, 0}, {time(nullptr) - 86400, 0}};
+    uint64_t leaves = (files + kFilesPerDirectory - 1) / kFilesPerDirectory;
+    for (uint64_t leaf = 0; leaf < leaves; leaf++) {
+        fs::path directory = root / leafPath(leaf);
+        fs::create_directories(directory);
+        int dirFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        for (uint64_t index = leaf * kFilesPerDirectory; index < std::min(files, (leaf + 1) * kFilesPerDirectory); index++) {
+            std::string name = "f" + std::to_string(index) + ".bin";
+            int fd = openat(dirFd, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0 || ftruncate(fd, (off_t)fileSize(index)) != 0 || futimens(fd, old) != 0) {
+                perror(name.c_str());
+                exit(1);
+            }
+            close(fd);
+        }
+        close(dirFd);
+    }
+    // directories last, creating their contents moved their mtimes
+    std::vector<fs::path> directories;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_directory()) directories.push_back(entry.path());
+    }
+    directories.push_back(root);
+    std::ofstream(root / "manifest") << files;
+    for (const auto& directory : directories) utimensat(AT_FDCWD, directory.c_str(), old, 0);
+    printf("generated in %.1f s\n", msSince(started) / 1000);
+}
+
+static DiskUsageReport scan(DiskUsageScanner& scanner, const std::string& root, DiskUsageOptions options = {}) {
+    DiskUsageReport report;
+    std::string error;
+    check(scanner.scan(root, options, report, error), "scan " + root + ": " + error);
+    return report;
+}
+
+// a small tree where every number is known
+static void checkSmallTree(const fs::path& root) {
+    fs::remove_all(root);
+    fs::create_directories(root / "a" / "deep" / "er");
+    fs::create_directories(root / "b");
+    fs::create_directories(root / "empty");
+    auto write = [&](const std::string& path, size_t size) { std::ofstream(root / path) << std::string(size, 'x'); };
+    write("top.txt", 10);
+    write("a/one", 1000);
+    write("a/deep/two", 2000);
+    write("a/deep/er/three", 3000);
+    write("b/four", 4000);
+    write("b/five", 5);
+    fs::create_symlink("a/one", root / "link");
+    fs::create_directory_symlink("a", root / "dirlink");
+
+    DiskUsageScanner scanner(2);
+    DiskUsageOptions options;
+    options.top = 3;
+    options.depth = 1;
+    DiskUsageReport report = scan(scanner, root.string(), options);
+    uint64_t links = fs::read_symlink(root / "link").string().size() + fs::read_symlink(root / "dirlink").string().size();
+    check(report.total.bytes == 10 + 1000 + 2000 + 3000 + 4000 + 5 + links, "small tree bytes " + std::to_string(report.total.bytes));
+    check(report.total.files == 8, "symlinks count as files, not followed");
+    check(report.total.directories == 5, "small tree directories " + std::to_string(report.total.directories));
+    check(report.largest.size() == 3 && report.largest[0].path == "b/four" && report.largest[1].path == "a/deep/er/three" &&
+          report.largest[2].path == "a/deep/two", "largest files");
+    std::vector<std::string> paths;
+    for (const auto& directory : report.directories) paths.push_back(directory.path);
+    check(paths == std::vector<std::string>{"", "a", "b", "empty"}, "directories to depth 1, by name");
+    check(report.directories[1].bytes == 6000 && report.directories[1].files == 3 && report.directories[1].directories == 2,
+          "totals of a");
+
+    // the tree was read right after it was made, so nothing could be
+    // trusted; read a second later it can
+    check(report.listedDirectories == 6, "a fresh tree is read in full");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    report = scan(scanner, root.string(), options);
+    check(report.listedDirectories == 6, "directories changed within a second of the last scan are read again");
+    report = scan(scanner, root.string(), options);
+    check(report.listedDirectories == 0 && report.reusedDirectories == 6, "unchanged small tree: " +
+          std::to_string(report.listedDirectories) + " listed");
+    // a file added deep down: only its directory is read again
+    write("a/deep/er/new", 7000);
+    report = scan(scanner, root.string(), options);
+    check(report.listedDirectories == 1, "one directory changed: " + std::to_string(report.listedDirectories) + " listed");
+    check(report.largest[0].path == "a/deep/er/new" && report.directories[1].bytes == 13000, "the added file counts");
+
+    // a growing file in an unchanged directory: statted because it is hot
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    report = scan(scanner, root.string(), options);
+    { std::ofstream(root / "a/deep/er/new", std::ios::app) << std::string(3000, 'y'); }
+    report = scan(scanner, root.string(), options);
+    check(report.listedDirectories == 0, "a growing file needs no listing");
+    check(report.largest[0].bytes == 10000 && report.directories[1].bytes == 16000, "the grown file counts");
+
+    fs::remove(root / "b" / "four");
+    report = scan(scanner, root.string(), options);
+    check(report.directories[2].bytes == 5 && report.largest[0].path == "a/deep/er/new", "removed file");
+    fs::remove_all(root / "a" / "deep");
+    report = scan(scanner, root.string(), options);
+    check(report.directories[1].bytes == 1000 && report.directories[1].directories == 0, "removed subtree");
+
+    DiskUsageOptions full = options;
+    full.full = true;
+    DiskUsageReport fresh = scan(scanner, root.string(), full);
+    check(fresh.total.bytes == report.total.bytes && fresh.listedDirectories == 4, "a full rescan agrees");
+    std::string error;
+    check(!scanner.scan((root / "missing").string(), options, report, error) && !error.empty(), "missing root");
+    fs::remove_all(root);
+}
+
+int main(int argc, char** argv) {
+    uint64_t files = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned workers = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    fs::path root = argc > 3 ? argv[3] : "/tmp/disk-usage-tree";
+
+    checkSmallTree(root.string() + "-small");
+
+    generate(root, files);
+    uint64_t expectedBytes = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> sizes;   // size, index
+    for (uint64_t i = 0; i < files; i++) {
+        expectedBytes += fileSize(i);
+        sizes.push_back({fileSize(i), i});
+    }
+    std::partial_sort(sizes.begin(), sizes.begin() + std::min<size_t>(20, sizes.size()), sizes.end(),
+                      [](const auto& a, const auto& b) { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+    uint64_t leaves = (files + kFilesPerDirectory - 1) / kFilesPerDirectory;
+
+    // the old way: one thread, a path per entry
+    auto started = Clock::now();
+    uint64_t walkedBytes = 0, walkedFiles = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_regular_file()) {
+            walkedBytes += entry.file_size();
+            walkedFiles++;
+        }
+    }
+    double walkMs = msSince(started);
+
+    DiskUsageScanner scanner(workers);
+    DiskUsageOptions options;
+    options.full = true;
+    DiskUsageReport report = scan(scanner, root.string(), options);
+    double fullMs = report.scanUs / 1000.0;
+    uint64_t manifestBytes = fs::file_size(root / "manifest");
+    check(report.total.files == files + 1 && walkedFiles == files + 1, "file count " + std::to_string(report.total.files));
+    check(report.total.bytes == expectedBytes + manifestBytes && walkedBytes == report.total.bytes, "total bytes");
+    check(report.errors == 0, "no errors");
+    bool topMatches = report.largest.size() == std::min<size_t>(20, files);
+    for (size_t i = 0; topMatches && i < report.largest.size(); i++) {
+        topMatches = report.largest[i].bytes == sizes[i].first;
+    }
+    check(topMatches, "the 20 largest files");
+
+    options.full = false;
+    report = scan(scanner, root.string(), options);
+    double rescanMs = report.scanUs / 1000.0;
+    uint64_t directories = report.total.directories + 1;
+    check(report.listedDirectories == 0 && report.reusedDirectories == directories, "unchanged tree: " +
+          std::to_string(report.listedDirectories) + " directories listed");
+    check(report.total.bytes == expectedBytes + manifestBytes, "rescan total bytes");
+
+    // one leaf gets a new file
+    std::string added = (root / leafPath(leaves / 2) / "added.bin").string();
+    { std::ofstream(added) << std::string(12345, 'z'); }
+    report = scan(scanner, root.string(), options);
+    double changedMs = report.scanUs / 1000.0;
+    check(report.listedDirectories == 1 && report.total.bytes == expectedBytes + manifestBytes + 12345, "one leaf changed");
+    fs::remove(added);
+
+    printf("%llu files in %llu directories, %u worker(s):\n", (unsigned long long)files, (unsigned long long)directories,
+           scanner.threadCount());
+    printf("  std::filesystem walk  %8.1f ms\n", walkMs);
+    printf("  full scan             %8.1f ms (%.2f us per entry)\n", fullMs, fullMs * 1000 / (files + directories));
+    printf("  unchanged rescan      %8.1f ms (%llu statx)\n", rescanMs, (unsigned long long)directories);
+    printf("  one leaf changed      %8.1f ms\n", changedMs);
+    printf("checks: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+// File follower check and benchmark. Checks that appends, truncation, a
+// report saved again over itself, and rotation (moved away, created again)
+// come out of the follower as an offset stream a client can keep passing
+// back; that UTF-8 and UTF-16 text is never cut inside a character; and that
+// polling a file nobody writes to stats nothing. Then grows a log line by
+// line and times following it against reading the whole file on every poll,
+// which is what showing the log used to cost.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_file_follow.cpp labs/file_follow.cpp labs/utf16.cpp -o bench_file_follow
+//   ./bench_file_follow [log MiB=16] [directory=/tmp]
+#include "file_follow.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void append(const fs::path& path, const std::string& data) {
+    std::ofstream(path, std::ios::binary | std::ios::app) << data;
+}
+
+static void rewrite(const fs::path& path, const std::string& data) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+static FollowChunk follow(FileFollower& follower, uint64_t since, size_t maxBytes = 1 << 20) {
+    FollowChunk chunk;
+    check(follower.read(since, maxBytes, chunk), "read " + follower.path() + ": " + follower.error());
+    return chunk;
+}
+
+// everything after `since`, as a client asking until `more` is false would see it
+static std::string followAll(FileFollower& follower, uint64_t& since, size_t maxBytes, bool* reset = nullptr) {
+    std::string text;
+    FollowChunk chunk;
+    do {
+        chunk = follow(follower, since, maxBytes);
+        if (chunk.reset) {
+            text.clear();
+            if (reset) *reset = true;
+        }
+        text += chunk.text;
+        since = chunk.next;
+    } while (chunk.more && chunk.next > chunk.start);
+    return text;
+}
+
+static void checkLog(const fs::path& directory) {
+    fs::path path = directory / "follow-check.log";
+    fs::remove(path);
+    FileFollower follower(path.string());
+    FollowChunk chunk;
+    check(!follower.read(0, 4096, chunk) && !follower.error().empty(), "a missing file is an error");
+
+    rewrite(path, "one\ntwo\n");
+    uint64_t next = 0;
+    check(followAll(follower, next, 4096) == "one\ntwo\n" && next == 8, "created after the follower");
+    chunk = follow(follower, next);
+    check(chunk.text.empty() && chunk.next == 8 && !chunk.more && !chunk.reset, "nothing new");
+
+    append(path, "three\nfour");
+    chunk = follow(follower, next);
+    check(chunk.text == "three\nfour" && chunk.start == 8 && chunk.next == 18, "appended bytes only");
+    next = chunk.next;
+
+    // limited reads stop after a line
+    append(path, "\nfive\nsix\n");
+    chunk = follow(follower, 8, 18);
+    check(chunk.text == "three\nfour\nfive\n" && chunk.next == 24 && chunk.more, "a limited read ends at a line: " + chunk.text);
+    uint64_t since = 8;
+    check(followAll(follower, since, 16) == "three\nfour\nfive\nsix\n", "limited reads add up");
+
+    // the same offset asked twice gives the same text
+    check(follow(follower, 14).text == follow(follower, 14).text, "reads are repeatable");
+
+    // truncated: offsets keep going up, the old offset is a reset
+    uint64_t before = follower.end();
+    rewrite(path, "new\n");
+    chunk = follow(follower, before);
+    check(chunk.reset && chunk.text == "new\n" && chunk.start == before && chunk.rotations == 1, "truncation is a reset");
+    next = chunk.next;
+    append(path, "more\n");
+    chunk = follow(follower, next);
+    check(!chunk.reset && chunk.text == "more\n", "after truncation");
+    next = chunk.next;
+
+    // saved again, longer than before: not an append
+    rewrite(path, "another report, longer than the last one\n");
+    chunk = follow(follower, next);
+    check(chunk.reset && chunk.text == "another report, longer than the last one\n" && chunk.rotations == 2,
+          "a file written over is a reset, not an append: " + chunk.text);
+    next = chunk.next;
+
+    // rotated: the rest of the old file, then the new one
+    append(path, "last of the old\n");
+    fs::rename(path, directory / "follow-check.log.1");
+    rewrite(path, "first of the new\n");
+    bool reset = false;
+    std::string text = followAll(follower, next, 4096, &reset);
+    check(!reset && text == "last of the old\nfirst of the new\n", "rotation reads the old file to its end: " + text);
+    append(path, "x\n");
+    check(follow(follower, next).text == "x\n", "the new file is followed");
+    fs::remove(directory / "follow-check.log.1");
+
+    // an offset from before a restart is past the end
+    chunk = follow(follower, next + 1000);
+    check(chunk.reset && chunk.text == "first of the new\nx\n", "offset past the end");
+
+    // tail starts at a line
+    rewrite(path, "");
+    for (int i = 0; i < 100; i++) append(path, "line " + std::to_string(i) + "\n");
+    check(follower.tail(30, 4096, chunk), "tail");
+    check(chunk.text == "line 97\nline 98\nline 99\n", "tail starts at a line: " + chunk.text);
+
+    // UTF-8 is not cut inside a character
+    rewrite(path, "x\xD0\x9F\xD1\x80\xD0\xB8\xD0\x9F\xD1\x80\xD0\xB8\xD0\x9F\xD1\x80\xD0\xB8");    // "xПриПриПри"
+    next = follower.end() - 19;
+    chunk = follow(follower, next, 16);
+    check(chunk.text.size() == 15 && chunk.next - chunk.start == 15 && chunk.more, "whole UTF-8 characters only");
+
+#ifdef __linux__
+    if (follower.watching()) {
+        follow(follower, next);
+        uint64_t checks = follower.checks();
+        for (int i = 0; i < 1000; i++) follow(follower, next);
+        check(follower.checks() == checks, "a quiet file is not statted");
+        append(path, "\n");
+        follow(follower, next);
+        check(follower.checks() == checks + 1, "a write is noticed");
+    } else {
+        printf("inotify unavailable, polling\n");
+    }
+#endif
+    fs::remove(path);
+}
+
+// the storage report is UTF-16 with a BOM; pieces of it are transcoded as it grows
+static void checkUtf16(const fs::path& directory) {
+    fs::path path = directory / "follow-check-report.txt";
+    std::u16string source = u"Диск C: 100 ГБ\r\n\U0001F4BE USB\r\n";
+    std::string bytes = "\xFF\xFE";
+    for (char16_t unit : source) {
+        bytes += (char)(unit & 0xFF);
+        bytes += (char)(unit >> 8);
+    }
+    std::string expected = "Диск C: 100 ГБ\r\n\U0001F4BE USB\r\n";
+
+    rewrite(path, "");
+    FileFollower follower(path.string());
+    uint64_t next = 0;
+    std::string text;
+    // written a byte at a time: halves of units and of the surrogate pair
+    for (char byte : bytes) {
+        append(path, std::string(1, byte));
+        text += followAll(follower, next, 4096);
+    }
+    check(text == expected, "UTF-16 written a byte at a time: " + text);
+    next = 0;
+    check(followAll(follower, next, 5) == expected, "UTF-16 in small pieces");
+    fs::remove(path);
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    fs::path directory = argc > 2 ? argv[2] : "/tmp";
+
+    checkLog(directory);
+    checkUtf16(directory);
+
+    // a log of `megabytes`, then 1000 lines appended with a poll after each
+    fs::path path = directory / "follow-bench.log";
+    {
+        std::ofstream log(path, std::ios::binary | std::ios::trunc);
+        std::string line = "2026-01-01 12:00:00 USB device arrived: VID_0781&PID_5583 SanDisk Ultra Fit\n";
+        for (size_t written = 0; written < (megabytes << 20); written += line.size()) log << line;
+    }
+    const int polls = 1000;
+    std::string added = "2026-01-01 12:00:01 Drive E: ejected\n";
+
+    FileFollower follower(path.string());
+    FollowChunk chunk;
+    follower.tail(64 * 1024, 64 * 1024, chunk);
+    uint64_t next = chunk.next;
+    auto started = Clock::now();
+    size_t followed = 0;
+    for (int i = 0; i < polls; i++) {
+        append(path, added);
+        followed += followAll(follower, next, 256 * 1024).size();
+    }
+    double followMs = msSince(started);
+    check(followed == added.size() * polls, "every appended line is followed once");
+
+    started = Clock::now();
+    size_t reread = 0;
+    for (int i = 0; i < polls / 10; i++) {
+        append(path, added);
+        std::ifstream log(path, std::ios::binary);
+        std::stringstream all;
+        all << log.rdbuf();
+        reread += all.str().size();
+    }
+    double rereadMs = msSince(started) * 10;
+
+    started = Clock::now();
+    for (int i = 0; i < polls; i++) follow(follower, follower.end());
+    double quietMs = msSince(started);
+    fs::remove(path);
+
+    printf("%zu MiB log, %d polls after one appended line each:\n", megabytes, polls);
+    printf("  follow         %8.1f ms (%.1f us per poll)\n", followMs, followMs * 1000 / polls);
+    printf("  read it all    %8.1f ms (%.1f us per poll, estimated from %d)\n", rereadMs, rereadMs * 1000 / polls,
+           polls / 10);
+    printf("  quiet polls    %8.1f ms (%.2f us per poll, %s)\n", quietMs, quietMs * 1000 / polls,
+           follower.watching() ? "inotify" : "stat");
+    printf("checks: %d failures\n", failures);
+    (void)reread;
+    return failures ? 1 : 0;
+}
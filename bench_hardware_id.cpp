@@ -0,0 +1,348 @@
+// Hardware-ID parser check, fuzz run and benchmark.
+//  - checks: real PCI, USB, HID and interface-path IDs, REG_MULTI_SZ lists and
+//    malformed fields;
+//  - fuzz: mutates those IDs (replaced, inserted and dropped characters, cut
+//    ends) and compares every parse with a plain std::string reference parser.
+//    The views must stay inside the input; build with the sanitizers for this
+//    part;
+//  - fuzz: also checks that the VID/PID fast path (parseUsbHardwareId)
+//    agrees with the full parser;
+//  - benchmark: the parsers against the find/substr code they replaced in
+//    lab_02 (ExtractVidDid) and lab_05 (listInputDevices), with heap
+//    allocations counted for each.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_hardware_id.cpp -o bench_hardware_id
+//   g++ -std=c++20 -O1 -g -fsanitize=address,undefined -I./labs bench_hardware_id.cpp -o bench_hardware_id_asan
+//   ./bench_hardware_id [fuzz iterations=200000]
+#include "hardware_id.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string& id, const char* what) {
+    if (!condition) {
+        if (failures < 20) printf("FAIL %s: %s\n", id.c_str(), what);
+        failures++;
+    }
+}
+
+static const char* kCorpus[] = {
+    "PCI\\VEN_8086&DEV_A370&SUBSYS_00748086&REV_10\\3&11583659&0&A3",
+    "PCI\\VEN_10DE&DEV_1F08&SUBSYS_13AD1043&REV_A1",
+    "PCI\\VEN_8086&CC_0C0330",
+    "PCI\\CC_0C03",
+    "USB\\VID_046D&PID_C077&REV_7200",
+    "USB\\VID_046D&PID_C077&MI_01\\7&2A5C0F4&0&0001",
+    "USB\\ROOT_HUB30\\4&1C5D1A1B&0&0",
+    "USBSTOR\\DISK&VEN_SANDISK&PROD_CRUZER_BLADE&REV_1.00\\4C530001230805112183&0",
+    "HID\\VID_046D&PID_C077\\7&1234ABCD&0&0000",
+    "HID\\ConvertedDevice&Col01\\5&2b9a2f0&0&0000",
+    "\\\\?\\hid#vid_046d&pid_c077&mi_00#7&1234abcd&0&0000#{4d1e55b2-f16f-11cf-88cb-001111000030}",
+    "\\\\?\\USB#VID_0781&PID_5567#4C530001230805112183#{a5dcbf10-6530-11d2-901f-00c04fb951ed}",
+    "SWD\\MMDEVAPI\\{0.0.0.00000000}",
+    "ACPI\\PNP0303\\4&2f94427b&0",
+};
+
+// The same fields the slow way, for the fuzz comparison
+struct Reference {
+    std::string enumerator, device, instance;
+    uint16_t fields = 0;
+    uint32_t values[8] = {};
+};
+
+static bool isHex(const std::string& text) {
+    if (text.empty()) return false;
+    for (char c : text) {
+        if (!isxdigit((unsigned char)c)) return false;
+    }
+    return true;
+}
+
+static std::string upper(std::string text) {
+    for (char& c : text) {
+        if (c >= 'a' && c <= 'z') c = (char)(c - 32);
+    }
+    return text;
+}
+
+static Reference referenceParse(std::string text) {
+    Reference ref;
+    if (text.size() >= 4 && text[0] == '\\' && (text[1] == '\\' || text[1] == '?') &&
+        (text[2] == '?' || text[2] == '.') && text[3] == '\\') {
+        text = text.substr(4);
+    }
+    std::vector<std::string> segments(1);
+    for (char c : text) {
+        if (c == '\\' || c == '#') {
+            segments.emplace_back();
+        } else {
+            segments.back() += c;
+        }
+    }
+    ref.enumerator = segments[0];
+    if (segments.size() < 2) return ref;
+    ref.device = segments[1];
+    if (segments.size() > 2) ref.instance = segments[2];
+    std::vector<std::string> tokens(1);
+    for (char c : ref.device) {
+        if (c == '&') {
+            tokens.emplace_back();
+        } else {
+            tokens.back() += c;
+        }
+    }
+    for (const std::string& token : tokens) {
+        size_t underscore = token.find('_');
+        if (underscore == std::string::npos) continue;
+        std::string key = upper(token.substr(0, underscore));
+        std::string value = token.substr(underscore + 1);
+        if (!isHex(value)) continue;
+        uint32_t number = (uint32_t)strtoul(value.c_str(), nullptr, 16);
+        size_t digits = value.size();
+        struct { const char* key; size_t minDigits, maxDigits; HardwareIdField field; int slot; } keys[] = {
+            { "VEN", 4, 4, HardwareIdField::Vendor, 0 },
+            { "DEV", 4, 4, HardwareIdField::Device, 1 },
+            { "SUBSYS", 8, 8, HardwareIdField::Subsystem, 2 },
+            { "REV", 2, 4, HardwareIdField::Revision, 3 },
+            { "CC", 2, 6, HardwareIdField::ClassCode, 4 },
+            { "VID", 4, 4, HardwareIdField::UsbVendor, 5 },
+            { "PID", 4, 4, HardwareIdField::UsbProduct, 6 },
+            { "MI", 2, 2, HardwareIdField::Interface, 7 },
+        };
+        for (const auto& k : keys) {
+            if (key != k.key || digits < k.minDigits || digits > k.maxDigits) continue;
+            if (k.field == HardwareIdField::ClassCode) {
+                if (digits % 2) continue;
+                number <<= 4 * (6 - digits);
+            }
+            ref.fields |= (uint16_t)k.field;
+            ref.values[k.slot] = number;
+        }
+    }
+    return ref;
+}
+
+static void compareWithReference(const std::string& text) {
+    HardwareId id;
+    parseHardwareId(std::string_view(text), id);
+    Reference ref = referenceParse(text);
+    // views inside the input
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    for (std::string_view view : { id.enumerator, id.device, id.instance }) {
+        expect(view.empty() || (view.data() >= begin && view.data() + view.size() <= end), text, "view outside the input");
+    }
+    expect(id.enumerator == ref.enumerator, text, "enumerator");
+    expect(id.device == ref.device, text, "device part");
+    expect(id.instance == ref.instance, text, "instance");
+    expect(id.fields == ref.fields, text, "field set");
+    uint32_t values[8] = {
+        id.vendorId, id.deviceId, (uint32_t)id.subsystemDeviceId << 16 | id.subsystemVendorId, id.revision,
+        id.classCode, id.usbVendorId, id.usbProductId, id.interfaceNumber,
+    };
+    for (int i = 0; i < 8; i++) {
+        if (ref.fields & (1 << i)) expect(values[i] == ref.values[i], text, "field value");
+    }
+
+    // the USB fast path agrees on what it parses
+    HardwareId usb;
+    const uint16_t usbFields = (uint16_t)HardwareIdField::UsbVendor | (uint16_t)HardwareIdField::UsbProduct;
+    bool found = parseUsbHardwareId(std::string_view(text), usb);
+    expect(found == ((ref.fields & usbFields) != 0) && usb.fields == (ref.fields & usbFields), text, "USB field set");
+    expect(usb.enumerator == ref.enumerator && usb.device == ref.device && usb.instance.empty(), text, "USB parts");
+    expect(usb.usbVendorId == id.usbVendorId && usb.usbProductId == id.usbProductId, text, "USB values");
+}
+
+// --- the replaced code, for the benchmark ---
+
+static bool OldExtractHexField(const std::string& id, const char* key, int digits, unsigned long& value) {
+    size_t pos = id.find(key);
+    if (pos == std::string::npos) return false;
+    std::string digitsText = id.substr(pos + strlen(key), digits);
+    char* end;
+    value = strtoul(digitsText.c_str(), &end, 16);
+    return end != digitsText.c_str();
+}
+
+static uint32_t OldExtractVidDid(const std::wstring& hardwareId) {
+    std::string id(hardwareId.begin(), hardwareId.end());
+    unsigned long value, sum = 0;
+    if (OldExtractHexField(id, "VEN_", 4, value)) sum += value;
+    if (OldExtractHexField(id, "DEV_", 4, value)) sum += value;
+    if (OldExtractHexField(id, "SUBSYS_", 8, value)) sum += value;
+    if (OldExtractHexField(id, "REV_", 2, value)) sum += value;
+    return (uint32_t)sum;
+}
+
+static size_t OldVidPid(const std::string& hwId) {
+    std::string vid = "Unknown";
+    std::string pid = "Unknown";
+    size_t vidPos = hwId.find("VID_");
+    if (vidPos != std::string::npos) vid = hwId.substr(vidPos + 4, 4);
+    size_t pidPos = hwId.find("PID_");
+    if (pidPos != std::string::npos) pid = hwId.substr(pidPos + 4, 4);
+    return vid.size() + pid.size();
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+
+    // --- checks ---
+    HardwareId id;
+    parseHardwareId(kCorpus[0], id);
+    expect(id.enumeratorIs("PCI") && id.vendorId == 0x8086 && id.deviceId == 0xA370 &&
+           id.subsystemVendorId == 0x8086 && id.subsystemDeviceId == 0x0074 && id.revision == 0x10 &&
+           id.instance == "3&11583659&0&A3", kCorpus[0], "PCI instance ID");
+    parseHardwareId(kCorpus[3], id);
+    expect(id.classCode == 0x0C0300 && id.classDigits == 4, kCorpus[3], "short class code");
+    parseHardwareId(kCorpus[5], id);
+    expect(id.enumeratorIs("USB") && id.usbVendorId == 0x046D && id.usbProductId == 0xC077 &&
+           id.has(HardwareIdField::Interface) && id.interfaceNumber == 1, kCorpus[5], "USB interface");
+    parseHardwareId(kCorpus[6], id);
+    expect(!parseHardwareId(kCorpus[6], id) && id.enumeratorIs("USB") && id.deviceContains("HUB"), kCorpus[6], "root hub");
+    parseHardwareId(kCorpus[7], id);
+    expect(id.enumeratorIs("USBSTOR") && id.enumeratorStartsWith("USB") && !id.enumeratorIs("USB") &&
+           !id.has(HardwareIdField::Vendor) && !id.has(HardwareIdField::Revision), kCorpus[7], "USBSTOR text fields ignored");
+    parseHardwareId(kCorpus[10], id);
+    expect(id.enumeratorIs("HID") && id.usbVendorId == 0x046D && id.interfaceNumber == 0 &&
+           id.instance == "7&1234abcd&0&0000", kCorpus[10], "lower-case interface path");
+    parseHardwareId("PCI\\VEN_80G6&DEV_12345&REV_1", id);
+    expect(id.fields == 0, "malformed", "bad digits and lengths rejected");
+
+    const wchar_t compatible[] = L"PCI\\VEN_8086&DEV_A370&REV_10\0PCI\\VEN_8086&DEV_A370\0PCI\\VEN_8086&CC_0C0330\0PCI\\VEN_8086&CC_0C03\0PCI\\CC_0C\0\0";
+    WideHardwareId wide;
+    parseHardwareIdList(compatible, sizeof(compatible) / sizeof(wchar_t), wide);
+    expect(wide.enumeratorIs("PCI") && wide.deviceId == 0xA370 && wide.revision == 0x10 &&
+           wide.classCode == 0x0C0330 && wide.classDigits == 6, "compatible list", "fields merged, longest class code");
+    const char usbList[] = "USB\\VID_046D&REV_7200\0USB\\VID_046D&PID_C077\0\0";
+    parseUsbHardwareIdList(usbList, sizeof(usbList), id);
+    expect(id.enumeratorIs("USB") && id.usbVendorId == 0x046D && id.usbProductId == 0xC077 &&
+           id.device == "VID_046D&REV_7200", "USB list", "VID/PID merged, views from the first ID");
+
+    for (const char* text : kCorpus) compareWithReference(text);
+    printf("checks: %d failures\n", failures);
+
+    // --- fuzz ---
+    const char alphabet[] = "\\#&_?.{}-0123456789abcdefABCDEFGVENDPIMSUBYRC";
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    const size_t corpusSize = sizeof(kCorpus) / sizeof(kCorpus[0]);
+    int before = failures;
+    for (long i = 0; i < iterations; i++) {
+        std::string text = kCorpus[next() % corpusSize];
+        int edits = 1 + (int)(next() % 4);
+        for (int e = 0; e < edits && !text.empty(); e++) {
+            size_t at = next() % text.size();
+            char c = alphabet[next() % (sizeof(alphabet) - 1)];
+            switch (next() % 4) {
+            case 0: text[at] = c; break;
+            case 1: text.insert(text.begin() + at, c); break;
+            case 2: text.erase(at, 1); break;
+            case 3: text.resize(at); break;
+            }
+        }
+        // exactly sized heap copy, so a read past the end is caught by ASan
+        std::unique_ptr<char[]> exact(new char[text.size() ? text.size() : 1]);
+        memcpy(exact.get(), text.data(), text.size());
+        HardwareId fuzzed;
+        parseHardwareId(std::string_view(exact.get(), text.size()), fuzzed);
+        compareWithReference(text);
+    }
+    printf("fuzz: %ld inputs, %d mismatches\n", iterations, failures - before);
+
+    // --- benchmark ---
+    std::vector<std::string> ids;
+    std::vector<std::wstring> wideIds;
+    for (int i = 0; i < 1000; i++) {
+        ids.push_back(kCorpus[i % corpusSize]);
+        wideIds.emplace_back(ids.back().begin(), ids.back().end());
+    }
+    const int rounds = 200;
+    volatile uint64_t sink = 0;
+
+    size_t allocationsBefore = allocations;
+    auto started = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& text : wideIds) sink = sink + OldExtractVidDid(text);
+    }
+    double oldPci = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / (rounds * ids.size());
+    size_t oldPciAllocations = allocations - allocationsBefore;
+
+    allocationsBefore = allocations;
+    started = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& text : wideIds) {
+            WideHardwareId parsed;
+            parseHardwareId(std::wstring_view(text), parsed);
+            sink = sink + parsed.vendorId + parsed.deviceId + parsed.revision + parsed.subsystemVendorId;
+        }
+    }
+    double newPci = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / (rounds * ids.size());
+    size_t newPciAllocations = allocations - allocationsBefore;
+
+    allocationsBefore = allocations;
+    started = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& text : ids) sink = sink + OldVidPid(text);
+    }
+    double oldUsb = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / (rounds * ids.size());
+    size_t oldUsbAllocations = allocations - allocationsBefore;
+
+    allocationsBefore = allocations;
+    started = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& text : ids) {
+            HardwareId parsed;
+            parseHardwareId(std::string_view(text), parsed);
+            sink = sink + parsed.usbVendorId + parsed.usbProductId;
+        }
+    }
+    double newUsb = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / (rounds * ids.size());
+    size_t newUsbAllocations = allocations - allocationsBefore;
+
+    allocationsBefore = allocations;
+    started = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& text : ids) {
+            HardwareId parsed;
+            parseUsbHardwareId(std::string_view(text), parsed);
+            sink = sink + parsed.usbVendorId + parsed.usbProductId;
+        }
+    }
+    double fastUsb = std::chrono::duration<double, std::nano>(Clock::now() - started).count() / (rounds * ids.size());
+    size_t fastUsbAllocations = allocations - allocationsBefore;
+
+    double perId = (double)(rounds * ids.size());
+    printf("lab_02 ExtractVidDid: %6.1f ns/id, %.2f allocations/id\n", oldPci, oldPciAllocations / perId);
+    printf("parseHardwareId (wide): %6.1f ns/id, %.2f allocations/id\n", newPci, newPciAllocations / perId);
+    printf("lab_05 VID/PID substr: %6.1f ns/id, %.2f allocations/id\n", oldUsb, oldUsbAllocations / perId);
+    printf("parseHardwareId: %6.1f ns/id, %.2f allocations/id\n", newUsb, newUsbAllocations / perId);
+    printf("parseUsbHardwareId: %6.1f ns/id, %.2f allocations/id\n", fastUsb, fastUsbAllocations / perId);
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// pci.ids loader benchmark: open cost, first (indexing) and repeated lookups,
+// and index memory against the size of the text.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pci_ids.cpp labs/pci_ids.cpp labs/mapped_file.cpp -o bench_pci_ids
+//   ./bench_pci_ids [/usr/share/hwdata/pci.ids]     (default: fixtures/pci.ids)
+#include "pci_ids.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double usSince(Clock::time_point started) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - started).count();
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "fixtures/pci.ids";
+
+    // the vendor/device pairs to look up, read the slow way
+    std::vector<std::pair<uint16_t, uint16_t>> pairs;
+    {
+        std::ifstream text(path);
+        std::string line;
+        unsigned long vendor = 0x10000;
+        while (std::getline(text, line)) {
+            if (line.size() > 1 && line[0] == 'C' && line[1] == ' ') {
+                break;
+            } else if (line.size() > 6 && isxdigit((unsigned char)line[0]) && line[4] == ' ') {
+                vendor = strtoul(line.substr(0, 4).c_str(), nullptr, 16);
+            } else if (line.size() > 6 && line[0] == '\t' && line[1] != '\t' && vendor <= 0xFFFF) {
+                pairs.push_back({ (uint16_t)vendor, (uint16_t)strtoul(line.substr(1, 4).c_str(), nullptr, 16) });
+            }
+        }
+    }
+    if (pairs.empty()) {
+        printf("No devices in %s\n", path.c_str());
+        return 1;
+    }
+
+    PciIdsDatabase database;
+    auto started = Clock::now();
+    if (!database.open(path)) {
+        printf("Failed to open %s\n", path.c_str());
+        return 1;
+    }
+    printf("open:              %10.1f us (%zu bytes)\n", usSince(started), database.fileBytes());
+
+    started = Clock::now();
+    size_t named = 0;
+    for (const auto& [vendor, device] : pairs) {
+        named += !database.deviceName(vendor, device).empty();
+    }
+    double cold = usSince(started);
+    printf("first pass:        %10.1f us for %zu devices, %zu named (indexes every vendor)\n",
+           cold, pairs.size(), named);
+
+    std::mt19937 random(42);
+    const int lookups = 2000000;
+    started = Clock::now();
+    size_t length = 0;
+    for (int i = 0; i < lookups; i++) {
+        const auto& [vendor, device] = pairs[random() % pairs.size()];
+        length += database.deviceName(vendor, device).size();
+    }
+    double warm = usSince(started);
+    printf("indexed lookups:   %10.1f ns/lookup (%.1f M/s)\n", warm * 1000 / lookups, lookups / warm);
+
+    started = Clock::now();
+    for (int i = 0; i < lookups; i++) {
+        length += database.className((uint8_t)(random() % 0x14)).size();
+    }
+    printf("class lookups:     %10.1f ns/lookup\n", usSince(started) * 1000 / lookups);
+
+    printf("index memory:      %10zu bytes for %zu vendors (%.1f%% of the text)\n",
+           database.memoryBytes(), database.indexedVendors(),
+           100.0 * database.memoryBytes() / database.fileBytes());
+    return length == 0 ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// PCI list filter check and benchmark. Builds an SR-IOV host: NICs with
+// virtual functions, NVMe drives, GPUs and the usual chipset functions, and
+// compares the indexed filters with a scan that lower-cases and matches every
+// record per request, which is what the API would do without the index.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pci_index.cpp labs/pci_index.cpp labs/pci_topology.cpp labs/lab_02.cpp labs/pci_sysfs.cpp labs/pci_ids.cpp labs/mapped_file.cpp labs/worker_pool.cpp -o bench_pci_index -pthread
+//   ./bench_pci_index [virtual functions per NIC=250]
+#include "pci_index.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static PciDeviceRecord makeRecord(int bus, int slot, int function, uint16_t vendorId, uint16_t deviceId, uint32_t classCode,
+                                  const char* vendorName, const char* deviceName) {
+    char address[32];
+    snprintf(address, sizeof(address), "0000:%02x:%02x.%x", bus & 0xFF, slot & 0x1F, function & 0x7);
+    PciDeviceRecord record;
+    record.address = address;
+    record.vendorId = vendorId;
+    record.deviceId = deviceId;
+    record.classCode = classCode;
+    record.vendorName = vendorName;
+    record.deviceName = deviceName;
+    return record;
+}
+
+static std::vector<PciDeviceRecord> buildHost(int virtualFunctions) {
+    std::vector<PciDeviceRecord> records;
+    records.push_back(makeRecord(0, 0, 0, 0x8086, 0x09A2, 0x060000, "Intel Corporation", "Ice Lake Memory Map/VT-d"));
+    records.push_back(makeRecord(0, 0x1F, 0, 0x8086, 0xA1C1, 0x060100, "Intel Corporation", "C621 Series Chipset LPC/eSPI Controller"));
+    records.push_back(makeRecord(0, 0x14, 0, 0x8086, 0xA1AF, 0x0C0330, "Intel Corporation", "C620 Series Chipset USB 3.0 xHCI Controller"));
+    for (int nic = 0; nic < 4; nic++) {
+        int bus = 0x10 + nic * 0x10;
+        records.push_back(makeRecord(bus, 0, 0, 0x15B3, 0x101B, 0x020000, "Mellanox Technologies", "MT28908 Family [ConnectX-6]"));
+        for (int vf = 0; vf < virtualFunctions; vf++) {
+            int index = vf + 1;
+            records.push_back(makeRecord(bus + index / 256, (index / 8) % 32, index % 8, 0x15B3, 0x101C, 0x020000,
+                                         "Mellanox Technologies", "MT28908 Family [ConnectX-6 Virtual Function]"));
+        }
+    }
+    for (int drive = 0; drive < 16; drive++) {
+        records.push_back(makeRecord(0x60 + drive, 0, 0, 0x144D, 0xA824, 0x010802, "Samsung Electronics Co Ltd", "NVMe SSD Controller PM173X"));
+    }
+    records.push_back(makeRecord(0x80, 0, 0, 0x1000, 0x00E6, 0x010700, "Broadcom / LSI", "Fusion-MPT 12GSAS/PCIe Secure SAS38xx"));
+    for (int gpu = 0; gpu < 8; gpu++) {
+        records.push_back(makeRecord(0x90 + gpu, 0, 0, 0x10DE, 0x20B0, 0x030200, "NVIDIA Corporation", "GA100 [A100 SXM4 40GB]"));
+    }
+    return records;
+}
+
+// what the route would do without the index
+static std::string lowered(std::string text) {
+    for (char& c : text) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c + 32);
+    }
+    return text;
+}
+
+static std::vector<uint32_t> scan(const std::vector<PciTopologyNode>& nodes, int baseClass, const std::string& name) {
+    std::vector<uint32_t> positions;
+    std::string needle = lowered(name);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        const PciDeviceRecord& device = nodes[i].device;
+        if (baseClass >= 0 && (int)(device.classCode >> 16) != baseClass) continue;
+        if (!name.empty() && lowered(device.vendorName + " " + device.deviceName).find(needle) == std::string::npos) continue;
+        positions.push_back(i);
+    }
+    return positions;
+}
+
+int main(int argc, char* argv[]) {
+    int virtualFunctions = argc > 1 ? atoi(argv[1]) : 250;
+    std::vector<PciDeviceRecord> records = buildHost(virtualFunctions);
+    PciTopology topology([&records]() { return records; });
+    PciInventory inventory(topology);
+
+    auto started = Clock::now();
+    std::shared_ptr<const PciInventoryIndex> index = inventory.current();
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    printf("%zu functions, index built in %.2f ms\n", index->nodes().size(), buildMs);
+    expect(inventory.current() == index, "same generation, same index");
+
+    std::vector<uint32_t> positions;
+    std::string error;
+    PciFilter storage{ "storage", "", "" };
+    expect(index->filter(storage, positions, error) && positions.size() == 17, "17 storage controllers");
+    PciFilter nvme{ "0108", "", "" };
+    expect(index->filter(nvme, positions, error) && positions.size() == 16, "16 NVMe by class prefix");
+    PciFilter storageAndNetwork{ "storage, network", "", "" };
+    expect(index->filter(storageAndNetwork, positions, error) && positions.size() == 17 + 4 * (size_t)(virtualFunctions + 1),
+           "class list is ORed");
+    PciFilter intelUsb{ "0c03", "intel", "" };
+    expect(index->filter(intelUsb, positions, error) && positions.size() == 1, "class and vendor name are ANDed");
+    PciFilter byId{ "", "15b3", "Virtual Function" };
+    expect(index->filter(byId, positions, error) && positions.size() == 4 * (size_t)virtualFunctions, "vendor ID and name");
+    PciFilter bad{ "storag3", "", "" };
+    expect(!index->filter(bad, positions, error) && !error.empty(), "unknown class rejected");
+
+    // the same answers as the scan
+    expect(index->filter(PciFilter{ "network", "", "connectx" }, positions, error) &&
+           positions == scan(index->nodes(), 0x02, "connectx"), "matches the scan");
+    expect(index->filter(PciFilter{ "", "", "a100" }, positions, error) &&
+           positions == scan(index->nodes(), -1, "a100"), "name matches the scan");
+
+    const int rounds = 200;
+    struct Query {
+        const char* text;
+        PciFilter filter;
+        int baseClass;
+        const char* name;
+    } queries[] = {
+        { "class=storage&name~=nvme", { "storage", "", "nvme" }, 0x01, "nvme" },
+        { "name~=nvme", { "", "", "nvme" }, -1, "nvme" },
+    };
+    for (const auto& query : queries) {
+        started = Clock::now();
+        size_t indexedFound = 0, scanFound = 0;
+        for (int i = 0; i < rounds; i++) {
+            index->filter(query.filter, positions, error);
+            indexedFound += positions.size();
+        }
+        double indexedUs = std::chrono::duration<double, std::micro>(Clock::now() - started).count() / rounds;
+        started = Clock::now();
+        for (int i = 0; i < rounds; i++) scanFound += scan(index->nodes(), query.baseClass, query.name).size();
+        double scanUs = std::chrono::duration<double, std::micro>(Clock::now() - started).count() / rounds;
+        expect(indexedFound == 16 * (size_t)rounds && scanFound == indexedFound, "both find the drives");
+        printf("%s: indexed %.1f us, scan %.1f us\n", query.text, indexedUs, scanUs);
+    }
+
+    // a hot-plugged drive moves the generation and the next request rebuilds
+    records.push_back(makeRecord(0x70, 0, 0, 0x144D, 0xA824, 0x010802, "Samsung Electronics Co Ltd", "NVMe SSD Controller PM173X"));
+    topology.refresh(std::chrono::milliseconds(0));
+    std::shared_ptr<const PciInventoryIndex> next = inventory.current();
+    expect(next != index && next->filter(nvme, positions, error) && positions.size() == 17, "rebuilt for the new generation");
+
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
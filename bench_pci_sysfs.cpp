@@ -0,0 +1,113 @@
+// sysfs PCI enumerator benchmark. Builds a fake /sys with N devices (half of
+// them PCIe, every tenth without a config file) and times full enumerations,
+// or times the tree given on the command line. Every device costs 10-16
+// syscalls (open, read, close per attribute file, two readlinkat), so the time
+// follows the machine's syscall cost, which is printed to compare runs by.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pci_sysfs.cpp labs/pci_sysfs.cpp labs/worker_pool.cpp -o bench_pci_sysfs -pthread
+//   ./bench_pci_sysfs [devices=200] [workers=0]
+//   ./bench_pci_sysfs --root /sys [workers=0]
+#include "pci_sysfs.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+static fs::path buildTree(int count) {
+    fs::path root = fs::temp_directory_path() / ("fake_sysfs_" + std::to_string(getpid()));
+    fs::path devices = root / "bus/pci/devices";
+    fs::path real = root / "devices/pci0000:00";
+    fs::create_directories(devices);
+    fs::create_directories(real);
+    char text[128];
+    for (int i = 0; i < count; i++) {
+        char address[32];
+        snprintf(address, sizeof(address), "0000:%02x:%02x.%x", i / 32, i % 32, 0);
+        fs::path dir = real / address;
+        fs::create_directories(dir);
+        uint16_t device = (uint16_t)(0x1000 + i);
+        snprintf(text, sizeof(text), "0x8086\n"); writeFile(dir / "vendor", text);
+        snprintf(text, sizeof(text), "0x%04x\n", device); writeFile(dir / "device", text);
+        writeFile(dir / "class", "0x020000\n");
+        writeFile(dir / "revision", "0x01\n");
+        writeFile(dir / "subsystem_vendor", "0x8086\n");
+        writeFile(dir / "subsystem_device", "0x0001\n");
+        if (i % 10 != 0) {
+            std::string config(256, '\0');
+            config[0] = (char)0x86; config[1] = (char)0x80;
+            config[2] = (char)(device & 0xFF); config[3] = (char)(device >> 8);
+            config[8] = 0x01; config[0x0B] = 0x02;
+            config[0x2C] = (char)0x86; config[0x2D] = (char)0x80; config[0x2E] = 0x01;
+            writeFile(dir / "config", config);
+        }
+        if (i % 2) {
+            writeFile(dir / "current_link_speed", "8.0 GT/s PCIe\n");
+            writeFile(dir / "current_link_width", "4\n");
+            writeFile(dir / "max_link_speed", "16.0 GT/s PCIe\n");
+            writeFile(dir / "max_link_width", "16\n");
+        }
+        std::string resource = "0x00000000f7f00000 0x00000000f7f0ffff 0x0000000000140204\n";
+        for (int bar = 1; bar < 13; bar++) resource += "0x0000000000000000 0x0000000000000000 0x0000000000000000\n";
+        writeFile(dir / "resource", resource);
+        fs::create_directory_symlink(fs::path("../../../devices/pci0000:00") / address, devices / address);
+    }
+    return root;
+}
+
+int main(int argc, char* argv[]) {
+    std::string root;
+    int count = 200;
+    unsigned workers = 0;
+    bool fake = true;
+    if (argc > 2 && strcmp(argv[1], "--root") == 0) {
+        root = argv[2];
+        fake = false;
+        if (argc > 3) workers = (unsigned)atoi(argv[3]);
+    } else {
+        if (argc > 1) count = atoi(argv[1]);
+        if (argc > 2) workers = (unsigned)atoi(argv[2]);
+        root = buildTree(count).string();
+    }
+
+    SysfsPciEnumerator enumerator(root, workers);
+    std::vector<PciDeviceRecord> first = enumerator.enumerate(); // warms the dentry cache
+    size_t found = first.size();
+    const int rounds = 50;
+    double best = 1e9, total = 0;
+    for (int i = 0; i < rounds; i++) {
+        auto started = Clock::now();
+        found = enumerator.enumerate().size();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        best = ms < best ? ms : best;
+        total += ms;
+    }
+    printf("%zu devices, %u threads: %.3f ms mean, %.3f ms best\n",
+           found, enumerator.threadCount(), total / rounds, best);
+    // what one open/read/close of an attribute costs here
+    std::string probe = root + "/bus/pci/devices/" + (found ? first[0].address : "") + "/vendor";
+    auto started = Clock::now();
+    const int probes = 2000;
+    for (int i = 0; i < probes; i++) {
+        int fd = open(probe.c_str(), O_RDONLY | O_CLOEXEC);
+        char text[16];
+        if (fd >= 0 && read(fd, text, sizeof(text)) < 0) break;
+        close(fd);
+    }
+    double syscallUs = std::chrono::duration<double, std::micro>(Clock::now() - started).count() / probes / 3;
+    printf("%.2f us per syscall on this machine, %.1f us per device\n", syscallUs, total / rounds * 1000 / found);
+
+    if (fake) fs::remove_all(root);
+    return found == 0 ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+// PCI topology change log check and benchmark. Drives a PciTopology with a
+// fake enumerator and checks what changesSince() reports: a device added and
+// removed again after the client's generation is not reported at all, one
+// removed and added again is reported as changed, a generation older than
+// the trimmed log (or from another run) asks for a reset with every node,
+// and the current generation gets nothing. Then times an unchanged
+// enumeration and changesSince() over a long log on N devices.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pci_topology.cpp labs/pci_topology.cpp labs/lab_02.cpp labs/pci_sysfs.cpp labs/pci_ids.cpp labs/mapped_file.cpp labs/worker_pool.cpp -o bench_pci_topology -pthread
+//   ./bench_pci_topology [devices=1000]
+#include "pci_topology.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double usSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static PciDeviceRecord device(unsigned bus, unsigned slot, const std::string& parent = "") {
+    char address[16];
+    snprintf(address, sizeof(address), "0000:%02x:%02x.0", bus & 0xff, slot & 0x1f);
+    PciDeviceRecord record;
+    record.address = address;
+    record.parent = parent;
+    record.vendorId = 0x8086;
+    record.deviceId = (uint16_t)(0x1000 + bus * 32 + slot);
+    record.classCode = parent.empty() ? 0x060400 : 0x020000;
+    record.driver = "fake";
+    return record;
+}
+
+// the enumerator returns whatever the check put on the "bus" last
+struct FakeBus {
+    std::vector<PciDeviceRecord> devices;
+
+    PciTopology::Enumerate enumerator() {
+        return [this]() { return devices; };
+    }
+    void remove(const std::string& address) {
+        devices.erase(std::remove_if(devices.begin(), devices.end(),
+                                     [&](const PciDeviceRecord& record) { return record.address == address; }),
+                      devices.end());
+    }
+};
+
+static bool has(const std::vector<PciTopologyNode>& nodes, const std::string& address) {
+    return std::any_of(nodes.begin(), nodes.end(), [&](const PciTopologyNode& node) { return node.device.address == address; });
+}
+
+static bool empty(const PciChanges& changes) {
+    return changes.added.empty() && changes.changed.empty() && changes.removed.empty();
+}
+
+static void checkChanges() {
+    FakeBus bus;
+    PciDeviceRecord bridge = device(0, 1);
+    PciDeviceRecord nic = device(1, 0, bridge.address);
+    PciDeviceRecord gpu = device(2, 0);
+    bus.devices = { bridge, nic, gpu };
+    PciTopology topology(bus.enumerator());
+    uint64_t start = topology.refresh(std::chrono::milliseconds(0));
+
+    // since == current: nothing to send
+    PciChanges changes = topology.changesSince(start);
+    check(!changes.reset && empty(changes) && changes.generation == start, "current generation: no changes");
+    check(topology.refresh(std::chrono::milliseconds(0)) == start, "an unchanged enumeration keeps the generation");
+
+    // added and removed again after since: the client never needs to know
+    PciDeviceRecord hotplug = device(3, 0);
+    bus.devices.push_back(hotplug);
+    uint64_t added = topology.refresh(std::chrono::milliseconds(0));
+    bus.remove(hotplug.address);
+    uint64_t removed = topology.refresh(std::chrono::milliseconds(0));
+    check(added == start + 1 && removed == start + 2, "one generation per differing enumeration");
+    changes = topology.changesSince(start);
+    check(!changes.reset && empty(changes) && changes.generation == removed,
+          "added then removed in the window: not reported (" + std::to_string(changes.added.size()) + " added, " +
+          std::to_string(changes.removed.size()) + " removed)");
+    changes = topology.changesSince(added);
+    check(changes.removed.size() == 1 && changes.removed[0] == hotplug.address && changes.added.empty(),
+          "since the add: reported removed");
+
+    // removed and back again (reset, rebound): the client's node may be stale
+    bus.remove(nic.address);
+    topology.refresh(std::chrono::milliseconds(0));
+    nic.driver = "fake-rebound";
+    bus.devices.push_back(nic);
+    uint64_t back = topology.refresh(std::chrono::milliseconds(0));
+    changes = topology.changesSince(removed);
+    check(changes.changed.size() == 1 && changes.changed[0].device.address == nic.address &&
+          changes.changed[0].device.driver == "fake-rebound" && changes.added.empty() && changes.removed.empty(),
+          "removed then added again: reported changed");
+    changes = topology.changesSince(back - 1);
+    check(changes.added.size() == 1 && has(changes.added, nic.address) && changes.changed.empty(),
+          "since the removal: reported added");
+
+    // a generation from another run, past the current one
+    changes = topology.changesSince(back + 1000);
+    check(changes.reset && changes.added.size() == 3, "a generation from another run: reset");
+}
+
+static void checkTrimmedLog() {
+    FakeBus bus;
+    bus.devices = { device(0, 1), device(0, 2) };
+    // room for two generations of one entry each
+    PciTopology topology(bus.enumerator(), 2);
+    uint64_t start = topology.refresh(std::chrono::milliseconds(0));
+    uint64_t generation = start;
+    for (unsigned slot = 3; slot < 8; slot++) {
+        bus.devices.push_back(device(0, slot));
+        generation = topology.refresh(std::chrono::milliseconds(0));
+    }
+    PciChanges changes = topology.changesSince(start);
+    check(changes.reset && changes.added.size() == bus.devices.size() && changes.generation == generation,
+          "since older than the trimmed log: reset with every node (" + std::to_string(changes.added.size()) + ")");
+    // the log still holds the last two generations
+    changes = topology.changesSince(generation - 2);
+    check(!changes.reset && changes.added.size() == 2, "since within the log: only its changes");
+    changes = topology.changesSince(generation - 3);
+    check(changes.reset, "since the generation whose entry was trimmed: reset");
+    changes = topology.changesSince(generation);
+    check(!changes.reset && empty(changes), "current generation after trimming: no changes");
+}
+
+static void timeChanges(size_t count) {
+    FakeBus bus;
+    for (size_t i = 0; i < count; i++) bus.devices.push_back(device((unsigned)(i / 32) + 1, (unsigned)(i % 32)));
+    PciTopology topology(bus.enumerator());
+    uint64_t start = topology.refresh(std::chrono::milliseconds(0));
+
+    const int rounds = 100;
+    auto started = Clock::now();
+    for (int i = 0; i < rounds; i++) topology.refresh(std::chrono::milliseconds(0));
+    double unchangedUs = usSince(started) / rounds;
+
+    // a flapping device: a long log that folds into one change
+    PciDeviceRecord flapping = bus.devices.back();
+    for (int i = 0; i < 1000; i++) {
+        bus.devices.back().revision = (uint8_t)(i + 1);
+        topology.refresh(std::chrono::milliseconds(0));
+    }
+    started = Clock::now();
+    PciChanges changes;
+    for (int i = 0; i < rounds; i++) changes = topology.changesSince(start);
+    double changesUs = usSince(started) / rounds;
+    check(!changes.reset && changes.changed.size() == 1 && changes.changed[0].device.address == flapping.address,
+          "a thousand changes of one device fold into one");
+    started = Clock::now();
+    for (int i = 0; i < rounds; i++) changes = topology.changesSince(changes.generation);
+    double currentUs = usSince(started) / rounds;
+
+    printf("%zu devices: unchanged enumeration %.1f us, changesSince over 1000 generations %.1f us, up to date %.2f us\n",
+           count, unchangedUs, changesUs, currentUs);
+}
+
+int main(int argc, char** argv) {
+    int devices = argc > 1 ? atoi(argv[1]) : 1000;
+    checkChanges();
+    checkTrimmedLog();
+    // the fake addresses have 255 buses of 32 slots
+    timeChanges((size_t)std::max(1, std::min(devices, 254 * 32)));
+    printf("checks: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
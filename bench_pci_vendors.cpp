@@ -0,0 +1,60 @@
+// PCI vendor lookup microbenchmark: the old linear scan over PciVenTable
+// against the compile-time index in labs/pci_vendors.hpp.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pci_vendors.cpp -o bench_pci_vendors
+#include "pci_vendors.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static const PCI_VENTABLE* linear_find(unsigned short id) {
+    for (size_t i = 0; i < PCI_VENTABLE_LEN; i++) {
+        if (PciVenTable[i].VenId == id) {
+            return &PciVenTable[i];
+        }
+    }
+    return nullptr;
+}
+
+// results go here, so the compiler can neither drop the lookups nor move
+// them past the clock reads
+static volatile uintptr_t sink;
+
+template <typename Find>
+static double nsPerLookup(const std::vector<uint16_t>& ids, int rounds, Find find) {
+    auto started = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        uintptr_t sum = 0;
+        for (uint16_t id : ids) {
+            sum += (uintptr_t)find(id);
+        }
+        sink = sink + sum;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - started;
+    return elapsed.count() / ((double)ids.size() * rounds);
+}
+
+int main() {
+    // both must agree on every possible ID
+    for (uint32_t id = 0; id <= 0xFFFF; id++) {
+        if (linear_find((uint16_t)id) != PciVendors.find((uint16_t)id)) {
+            printf("Mismatch for %04X\n", id);
+            return 1;
+        }
+    }
+
+    // a realistic mix: mostly known vendors (devices present in a machine), some unknown
+    std::mt19937 random(42);
+    std::vector<uint16_t> ids(1 << 16);
+    for (uint16_t& id : ids) {
+        id = random() % 8 ? PciVenTable[random() % PCI_VENTABLE_LEN].VenId : (uint16_t)random();
+    }
+
+    double linear = nsPerLookup(ids, 5, linear_find);
+    double indexed = nsPerLookup(ids, 200, [](uint16_t id) { return PciVendors.find(id); });
+    printf("%zu vendors, index %zu bytes\n", (size_t)PCI_VENTABLE_LEN, sizeof(PciVendors));
+    printf("linear scan: %8.2f ns/lookup\n", linear);
+    printf("index:       %8.2f ns/lookup (%.0fx)\n", indexed, linear / indexed);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// PCIe link sampler check and benchmark. Builds a fake sysfs tree of PCIe
+// devices with link and AER files, times ticks where nothing changed, then
+// edits the files the way a failing link would (fewer lanes, AER counts going
+// up) and checks what the monitor reports.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_pcie_links.cpp labs/pcie_links.cpp -o bench_pcie_links -pthread
+//   ./bench_pcie_links [devices=200]
+#include "pcie_links.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+}
+
+static std::string aerText(const char* total, unsigned count) {
+    return "RxErr 0\nBadTLP " + std::to_string(count) + "\nBadDLLP 0\nRollover 0\nTimeout 0\n" +
+           total + " " + std::to_string(count) + "\n";
+}
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : 200;
+    fs::path root = fs::temp_directory_path() / ("fake_pcie_" + std::to_string(getpid()));
+    fs::path devicesDir = root / "bus/pci/devices";
+    fs::create_directories(devicesDir);
+
+    std::vector<PciDeviceRecord> records;
+    for (int i = 0; i < count; i++) {
+        char address[32];
+        snprintf(address, sizeof(address), "0000:%02x:00.0", i + 1);
+        fs::path dir = devicesDir / address;
+        fs::create_directories(dir);
+        writeFile(dir / "current_link_speed", "16.0 GT/s PCIe\n");
+        writeFile(dir / "current_link_width", "4\n");
+        writeFile(dir / "aer_dev_correctable", aerText("TOTAL_ERR_COR", 0));
+        writeFile(dir / "aer_dev_nonfatal", aerText("TOTAL_ERR_NONFATAL", 0));
+        writeFile(dir / "aer_dev_fatal", aerText("TOTAL_ERR_FATAL", 0));
+        PciDeviceRecord record;
+        record.address = address;
+        record.maxLinkSpeed = 16;
+        record.maxLinkWidth = 4;
+        records.push_back(record);
+    }
+    // a conventional PCI device is not sampled
+    PciDeviceRecord legacy;
+    legacy.address = "0000:00:1e.0";
+    records.push_back(legacy);
+
+    PcieLinkMonitor monitor(root.string());
+    monitor.setDevices(records);
+    expect(monitor.deviceCount() == (size_t)count, "only PCIe devices are sampled");
+    printf("%zu devices, %zu files open\n", monitor.deviceCount(), monitor.openFiles());
+
+    uint64_t now = 1000000;
+    expect(monitor.sampleOnce(now) == (size_t)count, "first tick reads every device");
+    const int rounds = 200;
+    auto started = Clock::now();
+    size_t changed = 0;
+    for (int i = 0; i < rounds; i++) {
+        now += 1000;
+        changed += monitor.sampleOnce(now);
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - started).count() / rounds;
+    expect(changed == 0, "quiet ticks change nothing");
+    printf("quiet tick: %.1f us (%.2f us/device)\n", us, us / count);
+
+    // device 1 trains down to x1 and logs correctable errors, device 2 a fatal one
+    fs::path first = devicesDir / records[0].address;
+    fs::path second = devicesDir / records[1].address;
+    writeFile(first / "current_link_width", "1\n");
+    writeFile(first / "aer_dev_correctable", aerText("TOTAL_ERR_COR", 30));
+    writeFile(second / "aer_dev_fatal", aerText("TOTAL_ERR_FATAL", 1));
+    now += 1000;
+    expect(monitor.sampleOnce(now) == 2, "two devices changed");
+    now += 1000;
+    writeFile(first / "aer_dev_correctable", aerText("TOTAL_ERR_COR", 90));
+    expect(monitor.sampleOnce(now) == 1, "one device changed");
+
+    auto health = monitor.health(60000, now);
+    const PcieLinkHealth* a = nullptr;
+    const PcieLinkHealth* b = nullptr;
+    for (const auto& item : health) {
+        if (item.address == records[0].address) a = &item;
+        if (item.address == records[1].address) b = &item;
+    }
+    expect(a && a->widthDegraded && !a->speedDegraded && a->linkWidth == 1 && a->downtrains == 1, "x1 downtrain seen");
+    expect(a && a->correctable == 90 && a->correctablePerMinute == 90, "90 correctable in the last minute");
+    expect(b && b->fatal == 1 && b->fatalPerMinute == 1 && !b->widthDegraded, "one fatal error");
+
+    // a minute later the rates are back to zero, the totals stay
+    health = monitor.health(60000, now + 61000);
+    expect(health[0].correctablePerMinute == 0 && health[0].correctable == 90, "old errors leave the window");
+
+    std::vector<PcieLinkSample> samples;
+    expect(monitor.history(records[0].address, samples) && samples.size() == 3, "history keeps changes only");
+
+    monitor.setDevices({});
+    expect(monitor.openFiles() == 0, "files closed with the devices");
+
+    fs::remove_all(root);
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+// Linux power supply check and benchmark. Builds a fake
+// /sys/class/power_supply with AC and batteries that report energy (uWh),
+// charge with a voltage (uAh, uV) and charge alone, and checks the
+// aggregated charge, time left and AC state, the per-battery records and
+// long names. Then drives uevents through a PipeUeventSource and checks
+// which ones wake the sampler, that add/remove rescans, and that wake()
+// interrupts a wait. Times fill() and the uevent to wake-up latency.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_power_supply.cpp labs/power_supply_linux.cpp -o bench_power_supply -pthread
+//   ./bench_power_supply [samples=100000]
+#include "power_supply_linux.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double usSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text << "\n";
+}
+
+// a uevent with its NUL separators, as it comes off the socket
+template <size_t N>
+static std::string uevent(const char (&text)[N]) {
+    return std::string(text, N - 1);
+}
+
+static fs::path addSupply(const fs::path& sys, const std::string& name, const std::string& type) {
+    fs::path dir = sys / "class/power_supply" / name;
+    fs::create_directories(dir);
+    writeFile(dir / "type", type);
+    return dir;
+}
+
+static fs::path addMains(const fs::path& sys, bool online) {
+    fs::path dir = addSupply(sys, "AC", "Mains");
+    writeFile(dir / "online", online ? "1" : "0");
+    return dir;
+}
+
+static fs::path addBattery(const fs::path& sys, const std::string& name, const std::string& status) {
+    fs::path dir = addSupply(sys, name, "Battery");
+    writeFile(dir / "status", status);
+    writeFile(dir / "technology", "Li-ion");
+    writeFile(dir / "cycle_count", "120");
+    return dir;
+}
+
+static BatterySnapshot sample(LinuxPowerSupply& supply) {
+    BatterySnapshot snapshot;
+    supply.fill(snapshot);
+    return snapshot;
+}
+
+static void checkAggregation(const fs::path& sys) {
+    fs::remove_all(sys);
+    addMains(sys, false);
+    // 30 of 60 Wh, drawing 10 W
+    fs::path bat0 = addBattery(sys, "BAT0", "Discharging");
+    writeFile(bat0 / "energy_now", "30000000");
+    writeFile(bat0 / "energy_full", "60000000");
+    writeFile(bat0 / "energy_full_design", "66000000");
+    writeFile(bat0 / "power_now", "10000000");
+
+    LinuxPowerSupply one(sys.string(), std::make_unique<PipeUeventSource>());
+    BatterySnapshot snapshot = sample(one);
+    check(snapshot.power.valid && snapshot.power.acLine == AcLineStatus::Offline, "on battery");
+    check(snapshot.power.charge == 50, "energy battery charge: " + std::to_string(snapshot.power.charge));
+    check(snapshot.power.timeLeft == 3 * 3600, "time left from energy and power: " + std::to_string(snapshot.power.timeLeft));
+    check(snapshot.batteryCount == 1 && strcmp(snapshot.batteries[0].name, "BAT0") == 0 &&
+          strcmp(snapshot.batteries[0].chemistry, "LION") == 0, "record name and chemistry");
+    check(snapshot.batteries[0].fullChargedCapacity == 60000 && snapshot.batteries[0].designedCapacity == 66000 &&
+          snapshot.batteries[0].cycleCount == 120, "record capacities in mWh");
+
+    // 1 of 4 Ah at 15 V is 15 of 60 Wh; drawing 0.5 A is 7.5 W
+    fs::path bat1 = addBattery(sys, "BAT1", "Discharging");
+    writeFile(bat1 / "charge_now", "1000000");
+    writeFile(bat1 / "charge_full", "4000000");
+    writeFile(bat1 / "charge_full_design", "4400000");
+    writeFile(bat1 / "current_now", "-500000");
+    writeFile(bat1 / "voltage_now", "15000000");
+    writeFile(bat1 / "voltage_min_design", "14400000");
+    // no voltage: its uAh cannot be added to the others' uWh
+    fs::path bat2 = addBattery(sys, "BAT2", "Discharging");
+    writeFile(bat2 / "charge_now", "3900000");
+    writeFile(bat2 / "charge_full", "4000000");
+    writeFile(bat2 / "current_now", "100000");
+
+    LinuxPowerSupply three(sys.string(), std::make_unique<PipeUeventSource>());
+    snapshot = sample(three);
+    // 45 of 120 Wh; mixing units would say (30 + 1 + 3.9) / (60 + 4 + 4)
+    check(snapshot.power.charge == 37, "charge converted with the voltage: " + std::to_string(snapshot.power.charge));
+    check(snapshot.power.timeLeft == 45 * 3600 * 10 / 175, "time left over energy batteries: " +
+          std::to_string(snapshot.power.timeLeft));
+    check(snapshot.batteryCount == 3, "three records");
+    check(snapshot.batteries[1].fullChargedCapacity == 60000 && snapshot.batteries[1].designedCapacity == 63360,
+          "charge record in mWh, design at the minimum voltage: " +
+          std::to_string(snapshot.batteries[1].designedCapacity));
+    check(snapshot.batteries[2].fullChargedCapacity == -1 && snapshot.batteries[2].designedCapacity == -1,
+          "charge alone has no mWh");
+
+    // only charge without a voltage: still one unit, the ratio holds
+    fs::remove_all(bat0);
+    fs::remove_all(bat1);
+    LinuxPowerSupply chargeOnly(sys.string(), std::make_unique<PipeUeventSource>());
+    snapshot = sample(chargeOnly);
+    check(snapshot.power.charge == 97 && snapshot.power.timeLeft == 39 * 3600,
+          "charge only: " + std::to_string(snapshot.power.charge) + "% " + std::to_string(snapshot.power.timeLeft) + " s");
+
+    // names longer than the record are cut and terminated (it sorts after BAT2)
+    std::string longName(60, 'B');
+    fs::path longBattery = addBattery(sys, longName, "Full");
+    writeFile(longBattery / "technology", "Silicon-carbon");
+    LinuxPowerSupply named(sys.string(), std::make_unique<PipeUeventSource>());
+    snapshot = sample(named);
+    check(snapshot.batteryCount == 2 && strlen(snapshot.batteries[1].name) == sizeof(snapshot.batteries[1].name) - 1 &&
+          strcmp(snapshot.batteries[1].chemistry, "Sili") == 0, "long name and chemistry cut");
+    fs::remove_all(sys);
+}
+
+static void checkUevents(const fs::path& sys, int samples) {
+    fs::remove_all(sys);
+    fs::path ac = addMains(sys, true);
+    fs::path bat0 = addBattery(sys, "BAT0", "Charging");
+    writeFile(bat0 / "energy_now", "30000000");
+    writeFile(bat0 / "energy_full", "60000000");
+    writeFile(bat0 / "power_now", "10000000");
+
+    auto pipe = std::make_unique<PipeUeventSource>();
+    PipeUeventSource* events = pipe.get();
+    LinuxPowerSupply supply(sys.string(), std::move(pipe));
+    BatterySnapshot snapshot = sample(supply);
+    check(snapshot.power.acLine == AcLineStatus::Online && snapshot.power.hasFlag(BatteryFlagCharging), "on AC");
+
+    auto started = Clock::now();
+    check(!supply.waitForChange(std::chrono::milliseconds(20)), "nothing pending: timeout");
+    check(usSince(started) >= 19000, "timeout is waited out");
+
+    events->inject(uevent("change@/devices/virtual/block/loop3\0ACTION=change\0SUBSYSTEM=block"));
+    started = Clock::now();
+    check(!supply.waitForChange(std::chrono::milliseconds(20)), "another subsystem does not wake");
+    check(usSince(started) >= 19000, "another subsystem: the wait goes on");
+
+    // unplugged: the value is read again through the open descriptor
+    writeFile(ac / "online", "0");
+    writeFile(bat0 / "status", "Discharging");
+    events->inject(uevent("change@/devices/LNXSYSTM:00/ACPI0003:00/power_supply/AC\0SUBSYSTEM=power_supply\0POWER_SUPPLY_ONLINE=0"));
+    started = Clock::now();
+    check(supply.waitForChange(std::chrono::milliseconds(1000)), "power_supply uevent wakes");
+    double wakeUs = usSince(started);
+    snapshot = sample(supply);
+    check(snapshot.power.acLine == AcLineStatus::Offline && snapshot.power.timeLeft == 3 * 3600, "unplugged");
+
+    // a new battery is opened after its add event
+    fs::path bat1 = addBattery(sys, "BAT1", "Discharging");
+    writeFile(bat1 / "energy_now", "60000000");
+    writeFile(bat1 / "energy_full", "60000000");
+    check(sample(supply).batteryCount == 1, "not rescanned before the event");
+    events->inject(uevent("add@/devices/platform/test/power_supply/BAT1\0ACTION=add\0SUBSYSTEM=power_supply"));
+    check(supply.waitForChange(std::chrono::milliseconds(1000)), "add wakes");
+    snapshot = sample(supply);
+    check(snapshot.batteryCount == 2 && snapshot.power.charge == 75, "added battery counted");
+    fs::remove_all(bat1);
+    events->inject(uevent("remove@/devices/platform/test/power_supply/BAT1\0ACTION=remove\0SUBSYSTEM=power_supply"));
+    check(supply.waitForChange(std::chrono::milliseconds(1000)), "remove wakes");
+    check(sample(supply).batteryCount == 1, "removed battery dropped");
+
+    // wake() from another thread ends the wait without a change
+    started = Clock::now();
+    std::thread waker([&supply]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        supply.wake();
+    });
+    check(!supply.waitForChange(std::chrono::milliseconds(5000)), "wake() is not a change");
+    double wokenMs = usSince(started) / 1000;
+    waker.join();
+    check(wokenMs < 1000, "wake() interrupts the wait");
+
+    // the sampler's cost: one fill per period
+    started = Clock::now();
+    int valid = 0;
+    for (int i = 0; i < samples; i++) valid += sample(supply).power.valid;
+    double fillUs = usSince(started) / samples;
+    check(valid == samples, "every sample valid");
+
+    // uevent to return from waitForChange, the plug/unplug latency
+    const int rounds = 1000;
+    double totalUs = 0;
+    for (int i = 0; i < rounds; i++) {
+        events->inject(uevent("change@/devices/LNXSYSTM:00/ACPI0003:00/power_supply/AC\0SUBSYSTEM=power_supply"));
+        started = Clock::now();
+        supply.waitForChange(std::chrono::milliseconds(1000));
+        totalUs += usSince(started);
+    }
+
+    printf("2 supplies: fill %.2f us per sample (%d samples)\n", fillUs, samples);
+    printf("uevent wake-up: first %.1f us, %.2f us mean over %d\n", wakeUs, totalUs / rounds, rounds);
+    fs::remove_all(sys);
+}
+
+int main(int argc, char** argv) {
+    int samples = argc > 1 ? atoi(argv[1]) : 100000;
+    fs::path sys = fs::temp_directory_path() / ("power-supply-check-" + std::to_string(getpid()));
+    checkAggregation(sys);
+    checkUevents(sys, samples > 0 ? samples : 1);
+    printf("checks: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+// Storage benchmark engine check. Checks the latency histogram's
+// percentiles against a sorted reference, the config limits, a short run of
+// every pattern on both engines, and the job queue (order, progress,
+// cancel). Then compares io_uring with the pread/pwrite threads on the same
+// workload.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_storage_benchmark.cpp labs/storage_benchmark.cpp -o bench_storage_benchmark -pthread
+//   ./bench_storage_benchmark [directory=/tmp] [seconds per engine=3]
+#include "storage_benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static void checkHistogram() {
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> latency(std::log(80000.0), 1.2);   // around 80 us, long tail
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    for (int i = 0; i < 200000; i++) {
+        uint64_t ns = (uint64_t)latency(rng);
+        if (i % 1000 == 0) ns = i;      // small values land in the exact buckets
+        values.push_back(ns);
+        histogram.record(ns);
+    }
+    std::sort(values.begin(), values.end());
+    for (double q : {0.0, 0.01, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        size_t rank = std::max<size_t>(1, (size_t)std::ceil(q * values.size()));
+        double exact = (double)values[rank - 1];
+        double got = (double)histogram.percentile(q);
+        check(std::fabs(got - exact) <= exact / 32 + 1, "percentile " + std::to_string(q) + ": " +
+              std::to_string(got) + " against " + std::to_string(exact));
+    }
+    check(histogram.min() == values.front() && histogram.max() == values.back(), "min and max");
+    for (int bucket = 0; bucket + 1 < LatencyHistogram::kBuckets; bucket++) {
+        uint64_t low = LatencyHistogram::bucketLow(bucket);
+        if (LatencyHistogram::bucketOf(low) != bucket ||
+            LatencyHistogram::bucketLow(bucket + 1) != low + LatencyHistogram::bucketWidth(bucket)) {
+            check(false, "bucket " + std::to_string(bucket) + " bounds");
+            break;
+        }
+    }
+    check(LatencyHistogram::bucketOf(UINT64_MAX) == LatencyHistogram::kBuckets - 1, "last bucket");
+
+    LatencyHistogram a, b;
+    a.record(10);
+    b.record(1000);
+    a.merge(b);
+    check(a.count() == 2 && a.min() == 10 && a.max() == 1000, "merge");
+}
+
+static void checkConfig(const std::string& directory) {
+    StorageBenchConfig config;
+    config.directory = directory;
+    std::string error;
+    check(validateBenchConfig(config, error), "the defaults are valid");
+    config.blockSize = 1000;
+    check(!validateBenchConfig(config, error), "block size not a multiple of 512");
+    config.blockSize = 4096;
+    config.queueDepth = 0;
+    check(!validateBenchConfig(config, error), "queue depth 0");
+    config.queueDepth = 32;
+    config.fileSize = 64 * 1024;
+    check(!validateBenchConfig(config, error), "file smaller than the requests in flight");
+    BenchPattern pattern;
+    check(parseBenchPattern("randwrite", pattern) && pattern == BenchPattern::RandomWrite, "pattern names");
+    check(!parseBenchPattern("random", pattern), "unknown pattern");
+    BenchEngine engine;
+    check(parseBenchEngine("threads", engine) && engine == BenchEngine::Threads, "engine names");
+}
+
+static StorageBenchConfig shortRun(const std::string& directory, BenchPattern pattern, BenchEngine engine) {
+    StorageBenchConfig config;
+    config.directory = directory;
+    config.pattern = pattern;
+    config.engine = engine;
+    config.blockSize = 4096;
+    config.queueDepth = 8;
+    config.durationMs = 200;
+    config.fileSize = 16ull << 20;
+    return config;
+}
+
+static void checkRuns(const std::string& directory) {
+    for (BenchEngine engine : {BenchEngine::IoUring, BenchEngine::Threads}) {
+        if (engine == BenchEngine::IoUring && !StorageBenchmark::ioUringAvailable()) {
+            printf("io_uring not available here, skipping its runs\n");
+            continue;
+        }
+        for (BenchPattern pattern : {BenchPattern::SequentialRead, BenchPattern::SequentialWrite,
+                                     BenchPattern::RandomRead, BenchPattern::RandomWrite}) {
+            StorageBenchConfig config = shortRun(directory, pattern, engine);
+            StorageBenchmark::Progress progress;
+            StorageBenchResult result;
+            std::string error;
+            std::string name = std::string(benchEngineName(engine)) + " " + benchPatternName(pattern);
+            if (!StorageBenchmark::run(config, progress, result, error)) {
+                check(false, name + ": " + error);
+                continue;
+            }
+            check(result.engine == benchEngineName(engine), name + ": engine " + result.engine);
+            check(result.operations > 0 && result.bytes == result.operations * config.blockSize, name + ": operations and bytes");
+            check(result.seconds >= 0.2 && result.seconds < 5, name + ": duration " + std::to_string(result.seconds));
+            check(result.latencyMin <= result.latencyP50 && result.latencyP50 <= result.latencyP90 &&
+                  result.latencyP90 <= result.latencyP99 && result.latencyP99 <= result.latencyP999 &&
+                  result.latencyP999 <= result.latencyMax, name + ": percentiles in order");
+            check(progress.preparedBytes == config.fileSize, name + ": the file was filled");
+            printf("  %-18s %-7s %9.0f IOPS %8.1f MiB/s  p50 %7.1f us  p99 %8.1f us\n", name.c_str(),
+                   result.direct ? "direct" : "cached", result.iops, result.bytesPerSecond / (1 << 20),
+                   result.latencyP50, result.latencyP99);
+        }
+    }
+
+    // nothing is left in the directory, the file was unlinked when created
+    std::error_code code;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, code)) {
+        check(entry.path().filename().string().rfind(".iapcm-bench-", 0) != 0, "left behind: " + entry.path().string());
+    }
+    StorageBenchConfig config = shortRun(directory, BenchPattern::RandomRead, BenchEngine::Auto);
+    config.directory = directory + "/does-not-exist";
+    StorageBenchmark::Progress progress;
+    StorageBenchResult result;
+    std::string error;
+    check(!StorageBenchmark::run(config, progress, result, error) && !error.empty(), "missing directory fails");
+}
+
+static bool waitFor(StorageBenchQueue& queue, uint64_t id, BenchState state, int timeoutMs) {
+    StorageBenchJob job;
+    for (int waited = 0; waited < timeoutMs; waited += 10) {
+        if (queue.job(id, job) && job.state == state) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static void checkQueue(const std::string& directory) {
+    StorageBenchQueue queue(2);
+    std::string error;
+    StorageBenchConfig bad = shortRun(directory, BenchPattern::RandomRead, BenchEngine::Auto);
+    bad.queueDepth = 0;
+    check(queue.submit(bad, error) == 0 && !error.empty(), "an invalid job is refused");
+
+    StorageBenchConfig longRun = shortRun(directory, BenchPattern::RandomRead, BenchEngine::Auto);
+    longRun.durationMs = 60000;
+    uint64_t first = queue.submit(longRun, error);
+    uint64_t second = queue.submit(shortRun(directory, BenchPattern::SequentialRead, BenchEngine::Auto), error);
+    uint64_t third = queue.submit(shortRun(directory, BenchPattern::RandomWrite, BenchEngine::Auto), error);
+    check(first && second == first + 1 && third == second + 1, "job ids");
+    check(waitFor(queue, first, BenchState::Running, 5000), "the first job runs");
+    StorageBenchJob job;
+    check(queue.job(second, job) && job.state == BenchState::Queued, "the second job waits for the first");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    check(queue.job(first, job) && job.progress > 0 && job.progress < 0.1 && job.operations > 0, "progress of a running job");
+
+    check(queue.cancel(third), "cancel a queued job");
+    check(queue.cancel(first), "cancel a running job");
+    check(waitFor(queue, first, BenchState::Cancelled, 5000), "the running job stops");
+    check(queue.job(first, job) && job.result.operations > 0, "a cancelled run keeps what it measured");
+    check(waitFor(queue, second, BenchState::Done, 10000), "the second job runs after it");
+    check(queue.job(third, job) && job.state == BenchState::Cancelled && job.operations == 0, "the cancelled job never ran");
+    check(!queue.cancel(second), "a finished job cannot be cancelled");
+    check(!queue.job(12345, job), "unknown job");
+
+    // three finished, two kept
+    std::vector<StorageBenchJob> jobs = queue.jobs();
+    check(jobs.size() == 2 && jobs[0].id == second && jobs[1].id == third, "only the last finished jobs are kept");
+}
+
+static void compareEngines(const std::string& directory, uint32_t seconds) {
+    if (!StorageBenchmark::ioUringAvailable()) return;
+    printf("\n4 KiB random reads, queue depth 32, %u s each, 256 MiB file in %s:\n", seconds, directory.c_str());
+    for (bool direct : {true, false}) {
+        for (BenchEngine engine : {BenchEngine::IoUring, BenchEngine::Threads}) {
+            StorageBenchConfig config;
+            config.directory = directory;
+            config.engine = engine;
+            config.direct = direct;
+            config.durationMs = seconds * 1000;
+            StorageBenchmark::Progress progress;
+            StorageBenchResult result;
+            std::string error;
+            // the whole process, so the fill counts too; it is the same for both engines
+            rusage before, after;
+            getrusage(RUSAGE_SELF, &before);
+            if (!StorageBenchmark::run(config, progress, result, error)) {
+                check(false, std::string("timed run: ") + error);
+                continue;
+            }
+            getrusage(RUSAGE_SELF, &after);
+            auto cpuUs = [](const rusage& usage) {
+                return usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+            };
+            printf("  %-8s %-7s %9.0f IOPS %8.1f MiB/s  p50 %7.1f us  p99 %8.1f us  p99.9 %8.1f us  %5.2f us CPU per I/O\n",
+                   result.engine.c_str(), result.direct ? "direct" : "cached", result.iops, result.bytesPerSecond / (1 << 20),
+                   result.latencyP50, result.latencyP99, result.latencyP999,
+                   (cpuUs(after) - cpuUs(before)) / std::max<uint64_t>(1, result.operations));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+    uint32_t seconds = argc > 2 ? (uint32_t)atoi(argv[2]) : 3;
+    checkHistogram();
+    checkConfig(directory);
+    checkRuns(directory);
+    checkQueue(directory);
+    compareEngines(directory, std::max(1u, seconds));
+    printf("checks: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+// Storage report reader check and benchmark.
+//  - checks: random text (ASCII, Cyrillic, CJK, emoji as surrogate pairs,
+//    unpaired surrogates) written as UTF-16LE/BE with and without a BOM and
+//    as UTF-8, read back in odd chunk sizes that split surrogate pairs, and
+//    compared with a reference encoder on every transcoding path;
+//  - benchmark: the old RequestInfoStorage (wifstream, wostringstream, each
+//    wchar_t truncated to a char) against the mapped reader, and the scalar,
+//    SSE2 and AVX2 transcoders on their own.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_storage_report.cpp labs/storage_report.cpp labs/utf16.cpp labs/mapped_file.cpp -o bench_storage_report
+//   ./bench_storage_report [report MiB=32]
+#include "storage_report.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        if (failures < 20) printf("FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static uint64_t state = 0x2545F4914F6CDD1Dull;
+static uint32_t nextRandom() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)state;
+}
+
+static void appendUtf8(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out += (char)c;
+    } else if (c < 0x800) {
+        out += (char)(0xC0 | c >> 6);
+        out += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += (char)(0xE0 | c >> 12);
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    } else {
+        out += (char)(0xF0 | c >> 18);
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+static void appendUnit(std::string& out, uint16_t unit, bool bigEndian) {
+    out += (char)(bigEndian ? unit >> 8 : unit & 0xFF);
+    out += (char)(bigEndian ? unit & 0xFF : unit >> 8);
+}
+
+// UTF-16 bytes and the UTF-8 they must come out as
+static void randomText(size_t codePoints, int asciiPercent, bool bigEndian, std::string& utf16, std::string& utf8) {
+    for (size_t i = 0; i < codePoints; i++) {
+        uint32_t pick = nextRandom() % 100;
+        uint32_t c;
+        if ((int)pick < asciiPercent) {
+            c = nextRandom() % 4 == 0 ? "\r\n\t\""[nextRandom() % 4] : 0x20 + nextRandom() % 0x5F;
+        } else if (pick < 90) {
+            c = 0x410 + nextRandom() % 0x40;            // Cyrillic
+        } else if (pick < 95) {
+            c = 0x4E00 + nextRandom() % 0x5000;         // CJK
+        } else if (pick < 99) {
+            c = 0x1F300 + nextRandom() % 0x300;         // emoji, a surrogate pair
+        } else {
+            // an unpaired surrogate reads as U+FFFD: a low one alone, or a
+            // high one followed by a letter so it cannot meet a low one
+            if (nextRandom() % 2) {
+                appendUnit(utf16, (uint16_t)(0xDC00 + nextRandom() % 0x400), bigEndian);
+                appendUtf8(utf8, 0xFFFD);
+                continue;
+            }
+            appendUnit(utf16, (uint16_t)(0xD800 + nextRandom() % 0x400), bigEndian);
+            appendUtf8(utf8, 0xFFFD);
+            c = 'x';
+        }
+        if (c >= 0x10000) {
+            appendUnit(utf16, (uint16_t)(0xD800 + ((c - 0x10000) >> 10)), bigEndian);
+            appendUnit(utf16, (uint16_t)(0xDC00 + ((c - 0x10000) & 0x3FF)), bigEndian);
+        } else {
+            appendUnit(utf16, (uint16_t)c, bigEndian);
+        }
+        appendUtf8(utf8, c);
+    }
+}
+
+static void writeFile(const fs::path& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+static std::string readReport(const fs::path& path, size_t chunkBytes, TextEncoding& encoding) {
+    StorageReport report;
+    std::string text;
+    if (!report.open(path.string())) return "<open failed>";
+    encoding = report.encoding();
+    report.stream([&text](const char* data, size_t size) {
+        text.append(data, size);
+        return true;
+    }, chunkBytes);
+    return text;
+}
+
+// what RequestInfoStorage did on Windows: MSVC's wifstream widens each byte
+// to a wchar_t (glibc's stops at the first byte over 0x7F), the stream is
+// copied out, then every wchar_t is truncated back to a char
+static std::string oldRequestInfoStorage(const fs::path& path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    std::string bytes = ss.str();
+    std::wstring wcontent(bytes.begin(), bytes.end());
+    return std::string(wcontent.begin(), wcontent.end());
+}
+
+int main(int argc, char* argv[]) {
+    size_t reportMiB = argc > 1 ? strtoul(argv[1], nullptr, 10) : 32;
+    fs::path directory = fs::temp_directory_path() / ("storage_report_" + std::to_string(getpid()));
+    fs::create_directories(directory);
+    fs::path path = directory / "output.txt";
+
+    // --- checks ---
+    struct Case {
+        const char* name;
+        bool bigEndian;
+        bool bom;
+        TextEncoding expected;
+    } cases[] = {
+        { "UTF-16LE with BOM", false, true, TextEncoding::Utf16LE },
+        { "UTF-16BE with BOM", true, true, TextEncoding::Utf16BE },
+        { "UTF-16LE without BOM", false, false, TextEncoding::Utf16LE },
+    };
+    for (const auto& test : cases) {
+        std::string utf16, utf8;
+        // ASCII first, so the BOM-less guess has its zero bytes to count
+        randomText(2000, 100, test.bigEndian, utf16, utf8);
+        randomText(20000, 60, test.bigEndian, utf16, utf8);
+        std::string bytes = test.bom ? (test.bigEndian ? std::string("\xFE\xFF") : std::string("\xFF\xFE")) : std::string();
+        writeFile(path, bytes + utf16);
+        for (size_t chunk : { (size_t)16, (size_t)61, (size_t)4096, (size_t)65536 }) {
+            TextEncoding encoding;
+            std::string text = readReport(path, chunk, encoding);
+            expect(encoding == test.expected, std::string(test.name) + ": encoding");
+            expect(text == utf8, std::string(test.name) + ": text in chunks of " + std::to_string(chunk));
+        }
+        // every transcoding path gives the same bytes
+        const uint8_t* units = (const uint8_t*)utf16.data();
+        std::vector<char> out(utf16.size() / 2 * 3);
+        for (Utf16Path pathKind : { Utf16Path::Scalar, Utf16Path::Sse2, Utf16Path::Avx2 }) {
+            if (pathKind == Utf16Path::Avx2 && utf16BestPath() != Utf16Path::Avx2) continue;
+            if (pathKind != Utf16Path::Scalar && utf16BestPath() == Utf16Path::Scalar) continue;
+            size_t consumed;
+            size_t length = utf16ToUtf8(pathKind, units, utf16.size() / 2, test.bigEndian, true, out.data(), consumed);
+            expect(std::string(out.data(), length) == utf8, std::string(test.name) + ": path " + std::to_string((int)pathKind));
+        }
+    }
+    {
+        std::string utf8 = "\xEF\xBB\xBF" "Диск 0: Samsung SSD 860 EVO, \"C:\\\"\r\n";
+        writeFile(path, utf8);
+        TextEncoding encoding;
+        expect(readReport(path, 16, encoding) == utf8.substr(3) && encoding == TextEncoding::Utf8, "UTF-8 with BOM passes through");
+        writeFile(path, "");
+        expect(readReport(path, 16, encoding).empty(), "empty report");
+    }
+    StorageReport missing;
+    expect(!missing.open((directory / "missing.txt").string()) && !missing.error().empty(), "missing report");
+    printf("checks: %d failures\n", failures);
+
+    // --- benchmark: a report that is mostly ASCII with Cyrillic names ---
+    std::string utf16 = "\xFF\xFE", utf8;
+    while (utf16.size() < reportMiB << 20) randomText(4096, 95, false, utf16, utf8);
+    writeFile(path, utf16);
+    double mib = utf16.size() / 1048576.0;
+
+    auto started = Clock::now();
+    std::string old = oldRequestInfoStorage(path);
+    double oldMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+
+    started = Clock::now();
+    StorageReport report;
+    report.open(path.string());
+    std::string body;
+    body.reserve(report.maxTextSize());
+    report.stream([&body](const char* data, size_t size) {
+        body.append(data, size);
+        return true;
+    });
+    double newMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    expect(body == utf8, "benchmark report read back");
+    expect(old.size() == utf16.size(), "old reader kept one char per byte");
+    printf("%.1f MiB UTF-16 report: RequestInfoStorage %.1f ms (bytes as chars, mangled), StorageReport %.1f ms\n", mib, oldMs, newMs);
+
+    const uint8_t* units = (const uint8_t*)utf16.data() + 2;
+    size_t unitCount = (utf16.size() - 2) / 2;
+    std::vector<char> out(unitCount * 3);
+    const char* names[] = { "scalar", "SSE2", "AVX2" };
+    for (Utf16Path pathKind : { Utf16Path::Scalar, Utf16Path::Sse2, Utf16Path::Avx2 }) {
+        if ((int)pathKind > (int)utf16BestPath()) continue;
+        started = Clock::now();
+        size_t consumed, length = 0;
+        for (int round = 0; round < 3; round++) {
+            length = utf16ToUtf8(pathKind, units, unitCount, false, true, out.data(), consumed);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count() / 3;
+        expect(length == utf8.size(), "transcoded size");
+        printf("  %-6s transcode: %.1f ms, %.0f MiB/s\n", names[(int)pathKind], ms, mib / (ms / 1000));
+    }
+
+    fs::remove_all(directory);
+    printf("%s: %d failures\n", failures ? "FAILED" : "checks passed", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+// Telemetry file check and benchmark. Round-trips samples through the writer
+// and reader, then damages files the ways they get damaged: a torn last
+// block, a flipped byte in a block header or payload in the middle, a block
+// length that points into the next block, and the system clock stepping back
+// between two runs. Checks that each only loses the damaged block and that
+// reopening for writing cuts off nothing but a torn tail. Then times writing
+// and reading a long 1 Hz battery series.
+//
+//   g++ -std=c++20 -O2 -I./labs bench_telemetry_file.cpp labs/telemetry_file.cpp labs/mapped_file.cpp -o bench_telemetry_file
+//   ./bench_telemetry_file [samples=5000000] [directory=/tmp]
+#include "telemetry_file.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        failures++;
+        printf("FAIL: %s\n", what.c_str());
+    }
+}
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static const uint16_t kFields = 3;
+
+// a battery draining and charging at 1 Hz, with a gap now and then
+static TelemetrySample sampleAt(uint64_t i) {
+    TelemetrySample sample;
+    sample.timestampMs = 1700000000000ull + i * 1000 + (i / 500) * 7000 + (i % 3);
+    sample.values[0] = 100 - (int64_t)(i % 200) / 2;
+    sample.values[1] = (i % 200) < 100 ? -(int64_t)(i % 1000) : 3600 - (int64_t)i % 50;
+    sample.values[2] = (i / 100) % 2;
+    return sample;
+}
+
+static bool same(const TelemetrySample& a, const TelemetrySample& b) {
+    return a.timestampMs == b.timestampMs && memcmp(a.values, b.values, sizeof(int64_t) * kFields) == 0;
+}
+
+// samples [0, count) in blocks of blockSamples
+static void writeSeries(const fs::path& path, uint64_t count, size_t blockSamples) {
+    fs::remove(path);
+    TelemetryWriter writer(blockSamples, UINT64_MAX);
+    check(writer.open(path.string(), kFields), "create " + path.string());
+    for (uint64_t i = 0; i < count; i++) writer.append(sampleAt(i));
+    writer.close();
+}
+
+// offset of the header of block `n`
+static size_t blockOffset(const fs::path& path, size_t n) {
+    std::ifstream file(path, std::ios::binary);
+    size_t offset = sizeof(TelemetryFileHeader);
+    for (size_t b = 0; b < n; b++) {
+        TelemetryBlockHeader header;
+        file.seekg((std::streamoff)offset);
+        file.read((char*)&header, sizeof(header));
+        offset += sizeof(header) + header.payloadBytes;
+    }
+    return offset;
+}
+
+static void poke(const fs::path& path, size_t offset, const void* bytes, size_t length) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp((std::streamoff)offset);
+    file.write((const char*)bytes, (std::streamsize)length);
+}
+
+static void flip(const fs::path& path, size_t offset) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg((std::streamoff)offset);
+    char byte = 0;
+    file.get(byte);
+    byte ^= 0x5A;
+    file.seekp((std::streamoff)offset);
+    file.put(byte);
+}
+
+static std::vector<TelemetrySample> readAll(const fs::path& path, TelemetryReader& reader) {
+    check(reader.open(path.string()), "open " + path.string());
+    return reader.read(0, UINT64_MAX);
+}
+
+// every sample read back is the one written, in order, with `missing` blocks of 100 gone
+static bool matches(const std::vector<TelemetrySample>& read, uint64_t count, std::vector<size_t> missing = {}) {
+    size_t at = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        bool lost = false;
+        for (size_t block : missing) lost |= i / 100 == block;
+        if (lost) continue;
+        if (at >= read.size() || !same(read[at], sampleAt(i))) return false;
+        at++;
+    }
+    return at == read.size();
+}
+
+static void checkRoundTrip(const fs::path& path) {
+    writeSeries(path, 1000, 100);
+    TelemetryReader reader;
+    std::vector<TelemetrySample> read = readAll(path, reader);
+    check(reader.blockCount() == 10 && reader.sampleCount() == 1000 && !reader.damaged(), "ten intact blocks");
+    check(matches(read, 1000), "round trip");
+    // a range that starts and ends inside blocks
+    uint64_t from = sampleAt(150).timestampMs, to = sampleAt(649).timestampMs;
+    std::vector<TelemetrySample> range = reader.read(from, to);
+    check(range.size() == 500 && same(range.front(), sampleAt(150)) && same(range.back(), sampleAt(649)), "range query");
+    check(reader.read(to + 1, to + 500).empty(), "a gap holds nothing");
+    reader.close();
+
+    // appending after a reopen continues the series
+    TelemetryWriter writer(100, UINT64_MAX);
+    check(writer.open(path.string(), kFields) && writer.recoveredBytes() == 0, "reopen an intact file");
+    for (uint64_t i = 1000; i < 1200; i++) writer.append(sampleAt(i));
+    writer.close();
+    check(matches(readAll(path, reader), 1200), "appended after a reopen");
+    TelemetryWriter wrongFields;
+    check(!wrongFields.open(path.string(), kFields + 1), "a different field count is refused");
+}
+
+static void checkTornTail(const fs::path& path) {
+    writeSeries(path, 1000, 100);
+    uint64_t size = fs::file_size(path);
+    fs::resize_file(path, size - 5);
+    TelemetryReader reader;
+    check(matches(readAll(path, reader), 900) && reader.damaged(), "a torn last block loses only itself");
+    size_t lastBlock = blockOffset(path, 9);
+    check(reader.validBytes() == lastBlock, "the intact prefix ends before the torn block");
+    reader.close();
+
+    TelemetryWriter writer(100, UINT64_MAX);
+    check(writer.open(path.string(), kFields) && writer.recoveredBytes() == size - 5 - lastBlock, "only the torn tail is cut off");
+    for (uint64_t i = 900; i < 1000; i++) writer.append(sampleAt(i));
+    writer.close();
+    check(matches(readAll(path, reader), 1000) && !reader.damaged(), "written again after the cut");
+
+    // a header cut in half
+    writeSeries(path, 1000, 100);
+    fs::resize_file(path, blockOffset(path, 9) + 10);
+    check(matches(readAll(path, reader), 900) && reader.damaged(), "a torn block header");
+}
+
+static void checkMiddleDamage(const fs::path& path) {
+    TelemetryReader reader;
+
+    // a flipped byte in the second block's magic
+    writeSeries(path, 1000, 100);
+    uint64_t size = fs::file_size(path);
+    flip(path, blockOffset(path, 1));
+    check(matches(readAll(path, reader), 1000, {1}) && reader.blockCount() == 9, "a damaged header loses its block: " +
+          std::to_string(reader.blockCount()) + " blocks");
+    check(!reader.damaged() && reader.validBytes() == size && reader.skippedBytes() > 0, "and nothing after it");
+    reader.close();
+    TelemetryWriter writer(100, UINT64_MAX);
+    check(writer.open(path.string(), kFields) && writer.recoveredBytes() == 0 && fs::file_size(path) == size,
+          "reopening cuts nothing off");
+    writer.close();
+
+    // a flipped byte in a payload: the block fails its CRC when it is read
+    writeSeries(path, 1000, 100);
+    flip(path, blockOffset(path, 4) + sizeof(TelemetryBlockHeader) + 20);
+    check(matches(readAll(path, reader), 1000, {4}), "a damaged payload loses its block");
+    reader.close();
+
+    // a payload length that still fits, pointing into the next block
+    writeSeries(path, 1000, 100);
+    size_t third = blockOffset(path, 2);
+    uint32_t length = 50;
+    poke(path, third + offsetof(TelemetryBlockHeader, payloadBytes), &length, sizeof(length));
+    check(matches(readAll(path, reader), 1000, {2}), "a damaged length loses its block");
+    reader.close();
+
+    // the last block's length damaged: the one before it is whole
+    writeSeries(path, 1000, 100);
+    size_t last = blockOffset(path, 9);
+    length = 3;
+    poke(path, last + offsetof(TelemetryBlockHeader, payloadBytes), &length, sizeof(length));
+    check(matches(readAll(path, reader), 1000, {9}) && reader.validBytes() == last, "a damaged last length");
+}
+
+static void checkClockStep(const fs::path& path) {
+    fs::remove(path);
+    TelemetryWriter writer(100, UINT64_MAX);
+    check(writer.open(path.string(), kFields), "create");
+    for (uint64_t i = 0; i < 150; i++) writer.append(sampleAt(i));
+    writer.flush();
+    // the clock goes back a minute, inside a block and across a flush
+    uint64_t stepped = sampleAt(149).timestampMs - 60000;
+    TelemetrySample sample = sampleAt(150);
+    sample.timestampMs = stepped;
+    check(writer.append(sample), "a sample from before a clock step is kept");
+    writer.flush();
+    sample.timestampMs = stepped + 1000;
+    writer.append(sample);
+    writer.close();
+    uint64_t size = fs::file_size(path);
+
+    check(writer.open(path.string(), kFields) && writer.recoveredBytes() == 0 && fs::file_size(path) == size,
+          "a clock step costs nothing on reopen");
+    sample.timestampMs = stepped + 2000;
+    writer.append(sample);
+    writer.close();
+    TelemetryReader reader;
+    std::vector<TelemetrySample> read = readAll(path, reader);
+    check(read.size() == 153 && !reader.damaged(), "every sample is there: " + std::to_string(read.size()));
+    bool ordered = true;
+    for (size_t i = 1; i < read.size(); i++) ordered &= read[i].timestampMs >= read[i - 1].timestampMs;
+    check(ordered && read.back().timestampMs == sampleAt(149).timestampMs, "stamped with the last time written");
+
+    // a file from before the writer clamped: a block older than the one
+    // before it is left alone, not indexed and not cut off
+    writeSeries(path, 300, 100);
+    std::vector<char> first(blockOffset(path, 1) - sizeof(TelemetryFileHeader));
+    {
+        std::ifstream file(path, std::ios::binary);
+        file.seekg((std::streamoff)sizeof(TelemetryFileHeader));
+        file.read(first.data(), (std::streamsize)first.size());
+    }
+    { std::ofstream(path, std::ios::binary | std::ios::app).write(first.data(), (std::streamsize)first.size()); }
+    size = fs::file_size(path);
+    read = readAll(path, reader);
+    check(matches(read, 300) && !reader.damaged() && reader.skippedBytes() == first.size(), "an out-of-order block is skipped");
+    reader.close();
+    check(writer.open(path.string(), kFields) && writer.recoveredBytes() == 0 && fs::file_size(path) == size,
+          "and kept in the file");
+    writer.close();
+}
+
+int main(int argc, char** argv) {
+    uint64_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    fs::path directory = argc > 2 ? argv[2] : "/tmp";
+    fs::path path = directory / "telemetry-check.tlm";
+
+    checkRoundTrip(path);
+    checkTornTail(path);
+    checkMiddleDamage(path);
+    checkClockStep(path);
+
+    // the battery sampler's defaults: 256 samples or a minute per block
+    fs::remove(path);
+    TelemetryWriter writer;
+    writer.open(path.string(), kFields);
+    auto started = Clock::now();
+    for (uint64_t i = 0; i < count; i++) writer.append(sampleAt(i));
+    writer.close();
+    double writeMs = msSince(started);
+    uint64_t size = fs::file_size(path);
+
+    TelemetryReader reader;
+    started = Clock::now();
+    reader.open(path.string());
+    double openMs = msSince(started);
+    started = Clock::now();
+    uint64_t seen = 0;
+    int64_t sum = 0;
+    reader.scan(0, UINT64_MAX, [&](const TelemetrySample& sample) {
+        seen++;
+        sum += sample.values[0];
+    });
+    double scanMs = msSince(started);
+    check(seen == count, "every sample read back");
+    started = Clock::now();
+    const int queries = 10000;
+    for (int q = 0; q < queries; q++) {
+        uint64_t at = sampleAt((uint64_t)q * 7919 % count).timestampMs;
+        seen += reader.read(at, at + 60000).size();
+    }
+    double queryMs = msSince(started);
+    fs::remove(path);
+
+    printf("%llu samples, %u fields, %llu blocks, %.2f bytes per sample:\n", (unsigned long long)count, kFields,
+           (unsigned long long)reader.blockCount(), (double)size / count);
+    printf("  write          %8.1f ms (%.1f M samples/s, %.0f MiB/s)\n", writeMs, count / writeMs / 1000,
+           size / writeMs / 1000 / 1.048576);
+    printf("  open (index)   %8.1f ms\n", openMs);
+    printf("  full scan      %8.1f ms (%.1f M samples/s)\n", scanMs, count / scanMs / 1000);
+    printf("  1-minute reads %8.2f us each\n", queryMs * 1000 / queries);
+    printf("checks: %d failures\n", failures);
+    (void)sum;
+    return failures ? 1 : 0;
+}
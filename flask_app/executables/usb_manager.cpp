@@ -12,6 +12,7 @@
 #include <dbt.h>
 #include <cfgmgr32.h>
 #include <stdio.h>
+#include "../../labs/hardware_id.hpp"
 
 #pragma comment(lib, "setupapi.lib")
 #pragma comment(lib, "user32.lib")
@@ -58,14 +59,14 @@ public:
             }
 
             std::string deviceInstanceIdStr = std::string(deviceInstanceId);
+            HardwareId id;
+            parseHardwareId(std::string_view(deviceInstanceIdStr), id);
 
-            // Filter logic
-            bool isUsbDevice = deviceInstanceIdStr.find("USB") != std::string::npos;
-            bool isStorageDevice = deviceInstanceIdStr.find("USBSTOR") != std::string::npos;
-            bool isVirtualDevice = deviceInstanceIdStr.find("SWD\\") != std::string::npos ||
-                                  deviceInstanceIdStr.find("STORAGE\\") != std::string::npos;
-            bool isHub = deviceInstanceIdStr.find("ROOT_HUB") != std::string::npos ||
-                        deviceInstanceIdStr.find("HUB") != std::string::npos;
+            // Filter logic: USB, USBSTOR, USBPRINT... enumerators, no hubs
+            bool isUsbDevice = id.enumeratorStartsWith("USB");
+            bool isStorageDevice = id.enumeratorIs("USBSTOR");
+            bool isVirtualDevice = id.enumeratorIs("SWD") || id.enumeratorIs("STORAGE");
+            bool isHub = id.deviceContains("HUB");
 
             if (!isUsbDevice && !isStorageDevice) continue;
             if (isVirtualDevice || isHub) continue;
@@ -93,7 +94,7 @@ public:
             std::string driveLetter = "";
             bool isRemovable = false;
             std::string deviceType = "USB Device";
-            bool isUsbStorageDevice = deviceInstanceIdStr.find("USBSTOR") != std::string::npos;
+            bool isUsbStorageDevice = isStorageDevice;
 
             if (isUsbStorageDevice) {
                 // Brute force check drive letters to find matching removable drives
@@ -0,0 +1,158 @@
+#ifdef _WIN32
+
+#include "battery_devices.hpp"
+#include <setupapi.h>
+#include <batclass.h>  // For battery IOCTLs
+#include <initguid.h>
+#include <devguid.h>   // For GUID_DEVCLASS_BATTERY
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// without device notifications, look for new batteries this often (in fills)
+static const unsigned kFallbackEnumerationInterval = 60;
+
+BatteryDeviceRegistry::BatteryDeviceRegistry() {
+    CM_NOTIFY_FILTER filter = {0};
+    filter.cbSize = sizeof(filter);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = GUID_DEVCLASS_BATTERY;
+    if (CM_Register_Notification(&filter, this, &BatteryDeviceRegistry::onDeviceChange, &notification) != CR_SUCCESS) {
+        std::cerr << "Battery device notifications unavailable, falling back to periodic enumeration" << std::endl;
+        notification = nullptr;
+    }
+}
+
+BatteryDeviceRegistry::~BatteryDeviceRegistry() {
+    if (notification) {
+        CM_Unregister_Notification(notification);
+    }
+    closeAll();
+}
+
+DWORD CALLBACK BatteryDeviceRegistry::onDeviceChange(HCMNOTIFICATION, PVOID context, CM_NOTIFY_ACTION action,
+                                                     PCM_NOTIFY_EVENT_DATA, DWORD) {
+    if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL || action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL) {
+        static_cast<BatteryDeviceRegistry*>(context)->dirty = true;
+    }
+    return ERROR_SUCCESS;
+}
+
+void BatteryDeviceRegistry::closeAll() {
+    for (Device& device : devices) {
+        CloseHandle(device.handle);
+    }
+    devices.clear();
+}
+
+void BatteryDeviceRegistry::enumerate() {
+    closeAll();
+    enumerations++;
+    fillsSinceEnumeration = 0;
+    GUID batteryClassGuid = GUID_DEVCLASS_BATTERY;
+
+    HDEVINFO deviceInfoSet = SetupDiGetClassDevsA(&batteryClassGuid, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to get battery device info set" << std::endl;
+        return;
+    }
+
+    SP_DEVICE_INTERFACE_DATA deviceInterfaceData = {0};
+    deviceInterfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+
+    for (DWORD i = 0; devices.size() < (size_t)kMaxBatteries; i++) {
+        if (!SetupDiEnumDeviceInterfaces(deviceInfoSet, NULL, &batteryClassGuid, i, &deviceInterfaceData)) {
+            // ERROR_NO_MORE_ITEMS is the normal exit condition for the loop.
+            break;
+        }
+
+        DWORD requiredSize = 0;
+        SetupDiGetDeviceInterfaceDetailA(deviceInfoSet, &deviceInterfaceData, NULL, 0, &requiredSize, NULL);
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+            continue;
+        }
+        std::vector<BYTE> buffer(requiredSize);
+        auto* detail = (PSP_DEVICE_INTERFACE_DETAIL_DATA_A)buffer.data();
+        detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A);
+        if (!SetupDiGetDeviceInterfaceDetailA(deviceInfoSet, &deviceInterfaceData, detail, requiredSize, NULL, NULL)) {
+            continue;
+        }
+
+        HANDLE handle = CreateFileA(detail->DevicePath,
+                                    GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                    NULL, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+        Device device;
+        device.handle = handle;
+        snprintf(device.record.name, sizeof(device.record.name), "Battery %lu", (unsigned long)i);
+        devices.push_back(device);
+    }
+
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+}
+
+void BatteryDeviceRegistry::queryInformation(Device& device) {
+    BatteryInfo& record = device.record;
+    memset(record.chemistry, 0, sizeof(record.chemistry));
+    record.designedCapacity = record.fullChargedCapacity = record.cycleCount = -1;
+
+    BATTERY_QUERY_INFORMATION bqi = {0};
+    bqi.BatteryTag = record.tag;
+    bqi.InformationLevel = BatteryInformation;
+
+    BATTERY_INFORMATION batteryInfo = {0};
+    DWORD returned;
+    record.queried = DeviceIoControl(device.handle, IOCTL_BATTERY_QUERY_INFORMATION,
+                                     &bqi, sizeof(bqi),
+                                     &batteryInfo, sizeof(batteryInfo),
+                                     &returned, NULL) != 0;
+    if (!record.queried) {
+        return;
+    }
+    memcpy(record.chemistry, &batteryInfo.Chemistry, 4);
+    record.chemistry[4] = '\0';
+    // BATTERY_UNKNOWN_CAPACITY is all ones, which becomes -1
+    record.designedCapacity = (int32_t)batteryInfo.DesignedCapacity;
+    record.fullChargedCapacity = (int32_t)batteryInfo.FullChargedCapacity;
+    record.cycleCount = (int32_t)batteryInfo.CycleCount;
+}
+
+void BatteryDeviceRegistry::fill(BatterySnapshot& snapshot) {
+    if (!notification && ++fillsSinceEnumeration >= kFallbackEnumerationInterval) {
+        dirty = true;
+    }
+    if (dirty.exchange(false)) {
+        enumerate();
+    }
+
+    snapshot.batteryCount = 0;
+    for (Device& device : devices) {
+        DWORD returned;
+        ULONG wait = 0;
+        ULONG tag = 0;
+        if (!DeviceIoControl(device.handle, IOCTL_BATTERY_QUERY_TAG,
+                             &wait, sizeof(wait),
+                             &tag, sizeof(tag),
+                             &returned, NULL)) {
+            // an empty slot is not a reason to enumerate again, a dead handle is
+            if (GetLastError() != ERROR_FILE_NOT_FOUND) {
+                dirty = true;
+            }
+            continue;
+        }
+        if (tag == 0) {
+            continue;
+        }
+        if (tag != device.record.tag) {
+            device.record.tag = tag;
+            queryInformation(device);
+        }
+        snapshot.batteries[snapshot.batteryCount++] = device.record;
+    }
+}
+
+#endif // _WIN32
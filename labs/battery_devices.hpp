@@ -0,0 +1,48 @@
+#ifndef BATTERY_DEVICES_HPP
+#define BATTERY_DEVICES_HPP
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "lab_01.hpp"
+
+// Battery devices enumerated once through SetupDi, with their handles kept
+// open. Every fill() only asks each handle for its tag; the full information
+// query runs again when the tag changes (battery swapped), and the SetupDi
+// enumeration only when a battery interface arrives or goes away.
+class BatteryDeviceRegistry {
+public:
+    BatteryDeviceRegistry();
+    ~BatteryDeviceRegistry();
+    BatteryDeviceRegistry(const BatteryDeviceRegistry&) = delete;
+    BatteryDeviceRegistry& operator=(const BatteryDeviceRegistry&) = delete;
+
+    void fill(BatterySnapshot& snapshot);
+    unsigned enumerationCount() const { return enumerations; }
+
+private:
+    struct Device {
+        HANDLE handle;
+        BatteryInfo record;
+    };
+
+    void enumerate();
+    void queryInformation(Device& device);
+    void closeAll();
+    static DWORD CALLBACK onDeviceChange(HCMNOTIFICATION notification, PVOID context, CM_NOTIFY_ACTION action,
+                                         PCM_NOTIFY_EVENT_DATA eventData, DWORD eventDataSize);
+
+    std::vector<Device> devices;
+    std::atomic<bool> dirty{true};
+    HCMNOTIFICATION notification = nullptr;
+    unsigned enumerations = 0;
+    unsigned fillsSinceEnumeration = 0;
+};
+
+#endif // _WIN32
+
+#endif // BATTERY_DEVICES_HPP
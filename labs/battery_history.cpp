@@ -0,0 +1,165 @@
+#include "battery_history.hpp"
+#include <algorithm>
+
+void BatteryHistoryBucket::add(const BatteryHistoryBucket& other) {
+    if (other.samples == 0) return;
+    if (samples == 0) {
+        uint64_t start = startMs;
+        *this = other;
+        startMs = start;
+        return;
+    }
+    chargeMean = (chargeMean * samples + other.chargeMean * other.samples) / (samples + other.samples);
+    chargeMin = std::min(chargeMin, other.chargeMin);
+    chargeMax = std::max(chargeMax, other.chargeMax);
+    if (other.timeLeftSamples > 0) {
+        if (timeLeftSamples == 0) {
+            timeLeftMin = other.timeLeftMin;
+            timeLeftMax = other.timeLeftMax;
+            timeLeftMean = other.timeLeftMean;
+        } else {
+            timeLeftMean = (timeLeftMean * timeLeftSamples + other.timeLeftMean * other.timeLeftSamples)
+                           / (timeLeftSamples + other.timeLeftSamples);
+            timeLeftMin = std::min(timeLeftMin, other.timeLeftMin);
+            timeLeftMax = std::max(timeLeftMax, other.timeLeftMax);
+        }
+        timeLeftSamples += other.timeLeftSamples;
+    }
+    samples += other.samples;
+    acTransitions += other.acTransitions;
+    acLineStatus = other.acLineStatus;
+}
+
+BatteryHistory::BatteryHistory(size_t rawCapacity, size_t minuteCapacity, size_t hourCapacity)
+    : raw(rawCapacity), minutes(minuteCapacity), hours(hourCapacity) {
+}
+
+size_t BatteryHistory::memoryBytes() const {
+    return raw.memoryBytes() + minutes.memoryBytes() + hours.memoryBytes();
+}
+
+void BatteryHistory::roll(BatteryHistoryBucket& open, RingBuffer<BatteryHistoryBucket>& ring,
+                          const BatteryHistoryBucket& sample, uint64_t widthMs) {
+    uint64_t start = sample.startMs - sample.startMs % widthMs;
+    if (open.samples > 0 && open.startMs != start) {
+        ring.push(open);
+        open = BatteryHistoryBucket();
+    }
+    if (open.samples == 0) {
+        open.startMs = start;
+    }
+    open.add(sample);
+}
+
+void BatteryHistory::add(const BatterySnapshot& snapshot) {
+    // charge 255 means there is no battery to chart
+    const PowerStatus& power = snapshot.power;
+    if (!power.valid || !power.chargeKnown()) return;
+
+    BatteryHistoryBucket sample;
+    sample.startMs = snapshot.sampledAtMs;
+    sample.samples = 1;
+    sample.chargeMin = sample.chargeMax = power.charge;
+    sample.chargeMean = (float)power.charge;
+    if (power.timeLeft >= 0) {
+        sample.timeLeftSamples = 1;
+        sample.timeLeftMin = sample.timeLeftMax = power.timeLeft;
+        sample.timeLeftMean = (float)power.timeLeft;
+    }
+    sample.acLineStatus = (uint8_t)power.acLine;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Samples must be in time order for the binary search in query(). The
+    // clock stepped back: the sample is stamped with the last time instead,
+    // like TelemetryWriter does, so every tier keeps recording.
+    if (!raw.empty()) sample.startMs = std::max(sample.startMs, raw.back().startMs);
+    if (lastAcLineStatus != 255 && sample.acLineStatus != 255 && lastAcLineStatus != sample.acLineStatus) {
+        sample.acTransitions = 1;
+    }
+    lastAcLineStatus = sample.acLineStatus;
+    raw.push(sample);
+    roll(openMinute, minutes, sample, kMinuteMs);
+    roll(openHour, hours, sample, kHourMs);
+}
+
+BatteryHistoryQuery BatteryHistory::query(uint64_t fromMs, uint64_t toMs, uint64_t resolutionMs, size_t maxPoints) {
+    BatteryHistoryQuery result;
+    if (toMs < fromMs) return result;
+    if (resolutionMs == 0) {
+        resolutionMs = std::max<uint64_t>(1, (toMs - fromMs) / std::max<size_t>(1, maxPoints));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // coarsest first: the first tier that is fine enough is the cheapest to read
+    Tier tiers[] = {
+        { "hour", kHourMs, &hours, &openHour },
+        { "minute", kMinuteMs, &minutes, &openMinute },
+        { "raw", 0, &raw, nullptr },
+    };
+    size_t chosen = 2;
+    for (size_t i = 0; i < 3; i++) {
+        if (tiers[i].widthMs <= resolutionMs) {
+            chosen = i;
+            break;
+        }
+    }
+    // A fine tier's ring covers less time (raw: 6 hours). When it does not
+    // reach back to fromMs, a coarser tier that reaches further is used.
+    auto reaches = [](const Tier& tier) { return tier.ring->empty() ? UINT64_MAX : (*tier.ring)[0].startMs; };
+    while (chosen > 0 && reaches(tiers[chosen]) > fromMs && reaches(tiers[chosen - 1]) < reaches(tiers[chosen])) {
+        chosen--;
+    }
+    const Tier* tier = &tiers[chosen];
+    result.tier = tier->name;
+    result.resolutionMs = std::max(resolutionMs, tier->widthMs);
+
+    const RingBuffer<BatteryHistoryBucket>& ring = *tier->ring;
+    uint64_t alignedFrom = tier->widthMs ? fromMs - fromMs % tier->widthMs : fromMs;
+    size_t lo = 0, hi = ring.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ring[mid].startMs < alignedFrom) lo = mid + 1; else hi = mid;
+    }
+
+    auto emit = [&](const BatteryHistoryBucket& bucket) {
+        uint64_t start = bucket.startMs - bucket.startMs % result.resolutionMs;
+        if (result.points.empty() || result.points.back().startMs != start) {
+            BatteryHistoryBucket merged;
+            merged.startMs = start;
+            result.points.push_back(merged);
+        }
+        result.points.back().add(bucket);
+    };
+    for (size_t i = lo; i < ring.size() && ring[i].startMs <= toMs; i++) {
+        emit(ring[i]);
+    }
+    // the bucket still being filled, so the chart reaches "now"
+    if (tier->open && tier->open->samples > 0 &&
+        tier->open->startMs >= alignedFrom && tier->open->startMs <= toMs) {
+        emit(*tier->open);
+    }
+    return result;
+}
+
+TelemetrySample batterySnapshotToTelemetry(const BatterySnapshot& snapshot) {
+    TelemetrySample sample;
+    sample.timestampMs = snapshot.sampledAtMs;
+    sample.values[0] = snapshot.power.charge;
+    sample.values[1] = snapshot.power.timeLeft;
+    sample.values[2] = (uint8_t)snapshot.power.acLine;
+    sample.values[3] = snapshot.power.batteryFlags;
+    sample.values[4] = snapshot.power.eco;
+    return sample;
+}
+
+BatterySnapshot telemetryToBatterySnapshot(const TelemetrySample& sample) {
+    BatterySnapshot snapshot;
+    snapshot.sampledAtMs = sample.timestampMs;
+    snapshot.power.valid = true;
+    snapshot.power.charge = (uint8_t)sample.values[0];
+    snapshot.power.timeLeft = (int32_t)sample.values[1];
+    snapshot.power.acLine = (AcLineStatus)sample.values[2];
+    snapshot.power.batteryFlags = (uint8_t)sample.values[3];
+    snapshot.power.eco = sample.values[4] != 0;
+    return snapshot;
+}
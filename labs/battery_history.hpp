@@ -0,0 +1,80 @@
+#ifndef BATTERY_HISTORY_HPP
+#define BATTERY_HISTORY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "lab_01.hpp"
+#include "ring_buffer.hpp"
+#include "telemetry_file.hpp"
+
+// Aggregate of the samples that fell into [startMs, startMs + widthMs).
+// A raw sample is a bucket of one.
+struct BatteryHistoryBucket {
+    uint64_t startMs = 0;
+    uint32_t samples = 0;
+    uint8_t chargeMin = 255;
+    uint8_t chargeMax = 0;
+    float chargeMean = 0;
+    uint32_t timeLeftSamples = 0;   // samples with a known time left
+    int32_t timeLeftMin = -1;
+    int32_t timeLeftMax = -1;
+    float timeLeftMean = -1;
+    uint8_t acLineStatus = 255;     // state at the end of the bucket
+    uint16_t acTransitions = 0;     // AC plugged/unplugged inside the bucket
+
+    void add(const BatteryHistoryBucket& other);
+};
+
+struct BatteryHistoryQuery {
+    std::string tier;       // "raw", "minute" or "hour"
+    uint64_t resolutionMs = 0;
+    std::vector<BatteryHistoryBucket> points;
+};
+
+// Raw samples in a ring plus 1-minute and 1-hour tiers that are rolled up
+// as samples arrive. All rings are allocated up front, so the memory cost is
+// fixed at construction (see memoryBytes()).
+class BatteryHistory {
+public:
+    BatteryHistory(size_t rawCapacity = 6 * 3600,       // 6 hours at 1 Hz
+                   size_t minuteCapacity = 7 * 24 * 60, // 7 days
+                   size_t hourCapacity = 365 * 24);     // a year
+    void add(const BatterySnapshot& snapshot);
+    // Picks the coarsest tier that is still at least as fine as resolutionMs.
+    // If that tier does not reach back to fromMs, a coarser one that reaches
+    // further is used instead. Its buckets are then merged to resolutionMs.
+    // resolutionMs == 0 means "about maxPoints points over the range".
+    BatteryHistoryQuery query(uint64_t fromMs, uint64_t toMs, uint64_t resolutionMs, size_t maxPoints = 500);
+    size_t memoryBytes() const;
+
+    static const uint64_t kMinuteMs = 60 * 1000;
+    static const uint64_t kHourMs = 60 * kMinuteMs;
+
+private:
+    struct Tier {
+        const char* name;
+        uint64_t widthMs;
+        RingBuffer<BatteryHistoryBucket>* ring;
+        const BatteryHistoryBucket* open;
+    };
+    void roll(BatteryHistoryBucket& open, RingBuffer<BatteryHistoryBucket>& ring,
+              const BatteryHistoryBucket& sample, uint64_t widthMs);
+
+    std::mutex mutex;
+    RingBuffer<BatteryHistoryBucket> raw;
+    RingBuffer<BatteryHistoryBucket> minutes;
+    RingBuffer<BatteryHistoryBucket> hours;
+    BatteryHistoryBucket openMinute;
+    BatteryHistoryBucket openHour;
+    uint8_t lastAcLineStatus = 255;
+};
+
+// Battery series layout in telemetry files:
+// charge, timeLeft, acLineStatus, batteryFlag, eco
+static const uint16_t kBatteryTelemetryFields = 5;
+TelemetrySample batterySnapshotToTelemetry(const BatterySnapshot& snapshot);
+BatterySnapshot telemetryToBatterySnapshot(const TelemetrySample& sample);
+
+#endif // BATTERY_HISTORY_HPP
@@ -0,0 +1,132 @@
+#include "battery_replay.hpp"
+#include "battery_history.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+ReplayBatterySource::ReplayBatterySource(double speed, bool loop)
+    : speed(speed), loop(loop) {
+}
+
+bool ReplayBatterySource::load(const std::string& path) {
+    char magic[4] = {0};
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        loadError = "Failed to open " + path;
+        return false;
+    }
+    file.read(magic, sizeof(magic));
+    file.close();
+    if (memcmp(magic, "TLM1", 4) == 0) {
+        return loadTelemetry(path);
+    }
+    return loadCsv(path);
+}
+
+bool ReplayBatterySource::loadCsv(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        loadError = "Failed to open " + path;
+        return false;
+    }
+    trace.clear();
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || !isdigit((unsigned char)line[0])) continue;
+
+        TelemetrySample sample;
+        const char* cursor = line.c_str();
+        char* end = nullptr;
+        sample.timestampMs = strtoull(cursor, &end, 10);
+        for (size_t i = 0; i < kBatteryTelemetryFields; i++) {
+            if (*end != ',') {
+                loadError = path + ":" + std::to_string(lineNumber) + ": expected " +
+                            std::to_string(kBatteryTelemetryFields + 1) + " columns";
+                trace.clear();
+                return false;
+            }
+            cursor = end + 1;
+            sample.values[i] = strtoll(cursor, &end, 10);
+        }
+        trace.push_back(sample);
+    }
+    // hand-made traces are not always in order, the history needs them to be
+    std::stable_sort(trace.begin(), trace.end(), [](const TelemetrySample& a, const TelemetrySample& b) {
+        return a.timestampMs < b.timestampMs;
+    });
+    if (trace.empty()) {
+        loadError = path + ": no samples";
+        return false;
+    }
+    return true;
+}
+
+bool ReplayBatterySource::loadTelemetry(const std::string& path) {
+    TelemetryReader reader;
+    if (!reader.open(path)) {
+        loadError = "Failed to read telemetry file " + path;
+        return false;
+    }
+    if (reader.fieldCount() != kBatteryTelemetryFields) {
+        loadError = path + ": not a battery telemetry file";
+        return false;
+    }
+    trace = reader.read(0, UINT64_MAX);
+    if (trace.empty()) {
+        loadError = path + ": no samples";
+        return false;
+    }
+    return true;
+}
+
+uint64_t ReplayBatterySource::timestampOf(size_t index, uint64_t loopCount) const {
+    return trace[index].timestampMs + loopCount * loopLengthMs;
+}
+
+bool ReplayBatterySource::sample(BatterySnapshot& snapshot) {
+    if (trace.empty()) {
+        done = true;
+        return false;
+    }
+    if (position == trace.size()) {
+        if (!loop) {
+            done = true;
+            return false;
+        }
+        position = 0;
+        loops++;
+    }
+    if (!started) {
+        started = true;
+        startedAt = std::chrono::steady_clock::now();
+        firstMs = trace.front().timestampMs;
+        // one average interval between the end of a pass and the next one
+        uint64_t span = trace.back().timestampMs - trace.front().timestampMs;
+        loopLengthMs = span + (trace.size() > 1 ? std::max<uint64_t>(1, span / (trace.size() - 1)) : 1000);
+    }
+
+    snapshot = telemetryToBatterySnapshot(trace[position]);
+    snapshot.sampledAtMs = timestampOf(position, loops);
+    position++;
+    replayed++;
+    return true;
+}
+
+void ReplayBatterySource::waitNext(std::chrono::milliseconds) {
+    if (speed <= 0 || !started) return;
+    size_t next = position;
+    uint64_t nextLoops = loops;
+    if (next == trace.size()) {
+        // the end of a non-looping trace is reported by the next sample() at once
+        if (!loop) return;
+        next = 0;
+        nextLoops++;
+    }
+    // deadlines are relative to the start, so sleep overshoot does not add up
+    std::chrono::duration<double, std::milli> offset((timestampOf(next, nextLoops) - firstMs) / speed);
+    sleepUntil(startedAt + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+}
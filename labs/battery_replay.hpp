@@ -0,0 +1,57 @@
+#ifndef BATTERY_REPLAY_HPP
+#define BATTERY_REPLAY_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "battery_source.hpp"
+#include "telemetry_file.hpp"
+
+// Plays a recorded battery trace back through the sampler, so the telemetry
+// file, history and streams can be driven without a battery.
+//
+// The trace is either a telemetry file written by the server (recognized by
+// its magic) or a CSV file with one sample per line:
+//   timestampMs,charge,timeLeft,acLineStatus,batteryFlag,eco
+// Lines that do not start with a digit (a header, comments) are skipped.
+//
+// Samples keep the spacing of the trace divided by speed; speed 0 means as
+// fast as the sampler and its listeners can take them. The sampler period is
+// not used. With loop, the trace starts over with its timestamps shifted, so
+// time keeps going forward.
+class ReplayBatterySource : public BatterySource {
+public:
+    explicit ReplayBatterySource(double speed = 1.0, bool loop = false);
+    const char* name() const override { return "replay"; }
+
+    bool load(const std::string& path);
+    bool loadCsv(const std::string& path);
+    bool loadTelemetry(const std::string& path);
+    const std::string& error() const { return loadError; }
+
+    bool sample(BatterySnapshot& snapshot) override;
+    void waitNext(std::chrono::milliseconds period) override;
+
+    size_t traceLength() const { return trace.size(); }
+    uint64_t samplesReplayed() const { return replayed; }
+    bool finished() const { return done; }
+
+private:
+    uint64_t timestampOf(size_t index, uint64_t loops) const;
+
+    std::vector<TelemetrySample> trace;
+    std::string loadError;
+    double speed;
+    bool loop;
+    uint64_t loopLengthMs = 0;
+
+    size_t position = 0;        // next sample to play
+    uint64_t loops = 0;
+    uint64_t firstMs = 0;       // timestamp the replay clock starts from
+    bool started = false;
+    std::chrono::steady_clock::time_point startedAt;
+    std::atomic<uint64_t> replayed{0};
+    std::atomic<bool> done{false};
+};
+
+#endif // BATTERY_REPLAY_HPP
@@ -0,0 +1,70 @@
+#include "battery_source.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#include "battery_devices.hpp"
+#elif defined(__linux__)
+#include "power_supply_linux.hpp"
+#endif
+
+void BatterySource::waitNext(std::chrono::milliseconds period) {
+    sleepUntil(std::chrono::steady_clock::now() + period);
+}
+
+void BatterySource::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        woken = true;
+    }
+    wakeup.notify_all();
+}
+
+// A wake() that came before the wait still counts, so a stop request
+// between two samples is not lost.
+void BatterySource::sleepUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeup.wait_until(lock, deadline, [this] { return woken; });
+    woken = false;
+}
+
+SystemBatterySource::SystemBatterySource() {
+#ifdef __linux__
+    powerSupply = std::make_unique<LinuxPowerSupply>();
+#endif
+#ifdef _WIN32
+    batteryDevices = std::make_unique<BatteryDeviceRegistry>();
+#endif
+}
+
+SystemBatterySource::~SystemBatterySource() = default;
+
+bool SystemBatterySource::sample(BatterySnapshot& snapshot) {
+#ifdef _WIN32
+    SYSTEM_POWER_STATUS sps;
+    // GetSystemPowerStatus returns a non-zero value on success.
+    if (GetSystemPowerStatus(&sps)) {
+        PowerStatus& power = snapshot.power;
+        power.valid = true;
+        power.charge = sps.BatteryLifePercent;
+        power.batteryFlags = sps.BatteryFlag;
+        power.acLine = (AcLineStatus)sps.ACLineStatus;
+        // BatteryLifeTime is (DWORD)-1 when unknown
+        power.timeLeft = (int32_t)sps.BatteryLifeTime;
+        // According to documentation, SystemStatusFlag is 1 if battery saver is on.
+        power.eco = sps.SystemStatusFlag == 1;
+    }
+    batteryDevices->fill(snapshot);
+#elif defined(__linux__)
+    powerSupply->fill(snapshot);
+#endif
+    return true;
+}
+
+#ifdef __linux__
+void SystemBatterySource::waitNext(std::chrono::milliseconds period) {
+    powerSupply->waitForChange(period);
+}
+
+void SystemBatterySource::wake() {
+    powerSupply->wake();
+}
+#endif
@@ -0,0 +1,65 @@
+#ifndef BATTERY_SOURCE_HPP
+#define BATTERY_SOURCE_HPP
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "lab_01.hpp"
+
+#ifdef __linux__
+class LinuxPowerSupply;
+#endif
+#ifdef _WIN32
+class BatteryDeviceRegistry;
+#endif
+
+// Where the sampler gets its samples from. The sampler thread calls sample()
+// and waitNext() in turn; wake() comes from other threads to stop it.
+class BatterySource {
+public:
+    virtual ~BatterySource() = default;
+    virtual const char* name() const = 0;
+    // Fills the power status and battery records. sampledAtMs is preset to
+    // the current time, sources with their own clock overwrite it.
+    // Returns false when the source has nothing more to give.
+    virtual bool sample(BatterySnapshot& snapshot) = 0;
+    // Blocks until the next sample is due or wake() is called
+    virtual void waitNext(std::chrono::milliseconds period);
+    // Cuts the current (or the next) waitNext short
+    virtual void wake();
+
+protected:
+    void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+private:
+    std::mutex wakeMutex;
+    std::condition_variable wakeup;
+    bool woken = false;
+};
+
+// The machine's own batteries: GetSystemPowerStatus plus the battery device
+// registry on Windows, sysfs power_supply on Linux.
+class SystemBatterySource : public BatterySource {
+public:
+    SystemBatterySource();
+    ~SystemBatterySource() override;
+    const char* name() const override { return "system"; }
+    bool sample(BatterySnapshot& snapshot) override;
+#ifdef __linux__
+    // a power_supply uevent cuts the wait short, so plug/unplug is seen at once
+    void waitNext(std::chrono::milliseconds period) override;
+    void wake() override;
+#endif
+
+private:
+#ifdef __linux__
+    std::unique_ptr<LinuxPowerSupply> powerSupply;
+#endif
+#ifdef _WIN32
+    // open battery handles and tags, re-enumerated only when devices change
+    std::unique_ptr<BatteryDeviceRegistry> batteryDevices;
+#endif
+};
+
+#endif // BATTERY_SOURCE_HPP
@@ -0,0 +1,455 @@
+#include "block_devices.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+BlockDeviceEnumerator::BlockDeviceEnumerator(std::string sysfsRoot, std::string procRoot, unsigned workers)
+    : sysRoot(std::move(sysfsRoot)), procfsRoot(std::move(procRoot)), pool(workers) {}
+
+bool BlockDeviceEnumerator::nameLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t endA = i, endB = j;
+            while (endA < a.size() && isdigit((unsigned char)a[endA])) endA++;
+            while (endB < b.size() && isdigit((unsigned char)b[endB])) endB++;
+            unsigned long long numberA = strtoull(a.c_str() + i, nullptr, 10);
+            unsigned long long numberB = strtoull(b.c_str() + j, nullptr, 10);
+            if (numberA != numberB) return numberA < numberB;
+            i = endA;
+            j = endB;
+            continue;
+        }
+        // letter runs: the shorter run first, as the kernel names sdz, sdaa
+        size_t endA = i, endB = j;
+        while (endA < a.size() && !isdigit((unsigned char)a[endA])) endA++;
+        while (endB < b.size() && !isdigit((unsigned char)b[endB])) endB++;
+        int order = a.compare(i, endA - i, b, j, endB - j);
+        if (order != 0) {
+            // same family ("sd" + letters) goes by length first
+            bool sameFamily = endA - i >= 2 && endB - j >= 2 && a[i] == b[j] && a[i + 1] == b[j + 1];
+            if (sameFamily && endA - i != endB - j) return endA - i < endB - j;
+            return order < 0;
+        }
+        i = endA;
+        j = endB;
+    }
+    return a.size() - i < b.size() - j;
+}
+
+#ifdef __linux__
+
+// Attribute text into buffer, without the trailing newline and padding. 0 if
+// missing or unreadable.
+static size_t readAttribute(int dir, const char* name, char* buffer, size_t size) {
+    int fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length <= 0) return 0;
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == ' ')) length--;
+    buffer[length] = '\0';
+    return (size_t)length;
+}
+
+static bool readNumber(int dir, const char* name, unsigned long long& value) {
+    char buffer[32];
+    if (readAttribute(dir, name, buffer, sizeof(buffer)) == 0) return false;
+    char* end;
+    value = strtoull(buffer, &end, 10);
+    return end != buffer;
+}
+
+static bool readWholeFile(const std::string& path, std::string& text) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    // proc files report a size of 0, so read until the end
+    text.resize(16 * 1024);
+    size_t total = 0;
+    for (;;) {
+        if (total == text.size()) text.resize(text.size() * 2);
+        ssize_t length = read(fd, &text[total], text.size() - total);
+        if (length <= 0) break;
+        total += (size_t)length;
+    }
+    close(fd);
+    text.resize(total);
+    return true;
+}
+
+static inline uint64_t deviceKey(uint32_t major, uint32_t minor) {
+    return (uint64_t)major << 32 | minor;
+}
+
+struct PartitionLine {
+    uint32_t major;
+    uint32_t minor;
+    uint64_t sizeBytes;
+    std::string name;
+};
+
+// "major minor  #blocks  name", a header line and a blank line first;
+// #blocks are 1 KiB
+static void parsePartitions(const std::string& text, std::vector<PartitionLine>& lines) {
+    const char* p = text.c_str();
+    std::string row;
+    while (*p) {
+        const char* end = strchr(p, '\n');
+        if (!end) end = p + strlen(p);
+        // strtoul would skip a blank line's newline into the next line
+        row.assign(p, end);
+        const char* start = row.c_str();
+        char* next;
+        unsigned long major = strtoul(start, &next, 10);
+        if (next != start) {
+            PartitionLine line;
+            line.major = (uint32_t)major;
+            line.minor = (uint32_t)strtoul(next, &next, 10);
+            line.sizeBytes = strtoull(next, &next, 10) * 1024;
+            while (*next == ' ') next++;
+            line.name = next;
+            if (!line.name.empty()) lines.push_back(std::move(line));
+        }
+        p = *end ? end + 1 : end;
+    }
+}
+
+// mountinfo escapes space, tab, newline and backslash as \ooo
+static std::string unescapeMountField(const char* p, size_t length) {
+    std::string field;
+    field.reserve(length);
+    for (size_t i = 0; i < length; i++) {
+        if (p[i] == '\\' && i + 3 < length &&
+            p[i + 1] >= '0' && p[i + 1] <= '3' && p[i + 2] >= '0' && p[i + 2] <= '7' && p[i + 3] >= '0' && p[i + 3] <= '7') {
+            field += (char)((p[i + 1] - '0') << 6 | (p[i + 2] - '0') << 3 | (p[i + 3] - '0'));
+            i += 3;
+        } else {
+            field += p[i];
+        }
+    }
+    return field;
+}
+
+// "36 35 8:1 / /boot rw,relatime shared:2 - ext4 /dev/sda1 rw"
+static void parseMountinfo(const std::string& text, std::unordered_map<uint64_t, std::vector<BlockMount>>& mounts) {
+    const char* p = text.c_str();
+    const char* fields[12];
+    size_t lengths[12];
+    while (*p) {
+        const char* end = strchr(p, '\n');
+        if (!end) end = p + strlen(p);
+        // mount id, parent, major:minor, root, mount point, options, then
+        // optional fields up to "-", then type, source and super options
+        int count = 0, separator = -1;
+        const char* q = p;
+        while (q < end && count < 12) {
+            while (q < end && *q == ' ') q++;
+            if (q == end) break;
+            const char* start = q;
+            while (q < end && *q != ' ') q++;
+            if (separator < 0 && q - start == 1 && *start == '-' && count >= 6) {
+                separator = count;
+                continue;
+            }
+            // optional fields are not kept, the slots after them are
+            if (separator < 0 && count >= 6) continue;
+            fields[count] = start;
+            lengths[count] = (size_t)(q - start);
+            count++;
+        }
+        if (separator >= 0 && count >= 8) {
+            char* next;
+            unsigned long major = strtoul(fields[2], &next, 10);
+            if (*next == ':') {
+                unsigned long minor = strtoul(next + 1, nullptr, 10);
+                BlockMount mount;
+                mount.mountPoint = unescapeMountField(fields[4], lengths[4]);
+                mount.fsType.assign(fields[6], lengths[6]);
+                mount.source = unescapeMountField(fields[7], lengths[7]);
+                mount.readOnly = lengths[5] >= 2 && strncmp(fields[5], "ro", 2) == 0 &&
+                                 (lengths[5] == 2 || fields[5][2] == ',');
+                mounts[deviceKey((uint32_t)major, (uint32_t)minor)].push_back(std::move(mount));
+            }
+        }
+        p = *end ? end + 1 : end;
+    }
+}
+
+// sda1 -> sda, nvme0n1p2 -> nvme0n1, mmcblk0p1 -> mmcblk0
+static bool parentDisk(const std::string& name, const std::unordered_map<std::string, size_t>& disks, size_t& disk) {
+    size_t end = name.size();
+    while (end > 0 && isdigit((unsigned char)name[end - 1])) end--;
+    if (end == 0 || end == name.size()) return false;
+    auto it = disks.find(name.substr(0, end));
+    if (it == disks.end() && end >= 2 && name[end - 1] == 'p' && isdigit((unsigned char)name[end - 2])) {
+        it = disks.find(name.substr(0, end - 1));
+    }
+    if (it == disks.end()) return false;
+    disk = it->second;
+    return true;
+}
+
+// "mq-deadline kyber [bfq] none", "none" alone on older kernels
+static void parseSchedulers(const char* text, BlockDevice& device) {
+    const char* p = text;
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+        const char* start = p;
+        while (*p && *p != ' ') p++;
+        bool active = *start == '[';
+        std::string name(active ? start + 1 : start, (size_t)(p - start) - (active ? 2 : 0));
+        if (active || device.scheduler.empty()) device.scheduler = name;
+        device.schedulers.push_back(std::move(name));
+    }
+}
+
+// self is the disk's own line of /proc/partitions, which has its numbers and
+// size; disks without a medium are not listed there and read them from sysfs
+static bool readDisk(int blockDir, const std::string& name, const PartitionLine* self,
+                     const std::vector<const PartitionLine*>& partitions, BlockDevice& device) {
+    int dir = openat(blockDir, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0) return false;
+    device.name = name;
+    char buffer[256];
+    unsigned long long value;
+    if (self) {
+        device.major = self->major;
+        device.minor = self->minor;
+        device.sizeBytes = self->sizeBytes;
+    } else {
+        if (readAttribute(dir, "dev", buffer, sizeof(buffer))) {
+            char* next;
+            device.major = (uint32_t)strtoul(buffer, &next, 10);
+            if (*next == ':') device.minor = (uint32_t)strtoul(next + 1, nullptr, 10);
+        }
+        // always 512-byte sectors, whatever the logical block size
+        if (readNumber(dir, "size", value)) device.sizeBytes = value * 512;
+    }
+    if (readNumber(dir, "removable", value)) device.removable = value != 0;
+    if (readNumber(dir, "ro", value)) device.readOnly = value != 0;
+    if (readNumber(dir, "queue/rotational", value)) device.rotational = value != 0;
+    if (readNumber(dir, "queue/logical_block_size", value)) device.logicalBlockSize = (uint32_t)value;
+    if (readNumber(dir, "queue/physical_block_size", value)) device.physicalBlockSize = (uint32_t)value;
+    if (readNumber(dir, "queue/nr_requests", value)) device.requests = (uint32_t)value;
+    if (readAttribute(dir, "queue/scheduler", buffer, sizeof(buffer))) parseSchedulers(buffer, device);
+    if (readAttribute(dir, "device/vendor", buffer, sizeof(buffer))) device.vendor = buffer;
+    if (readAttribute(dir, "device/model", buffer, sizeof(buffer))) device.model = buffer;
+    if (readNumber(dir, "device/queue_depth", value)) device.queueDepth = (int)value;
+
+    for (const PartitionLine* line : partitions) {
+        // sda1 in /proc/partitions is only a partition of sda if sda has it,
+        // and its start is the one file that says so
+        char path[256];
+        snprintf(path, sizeof(path), "%s/start", line->name.c_str());
+        if (!readNumber(dir, path, value)) continue;
+        BlockPartition partition;
+        partition.name = line->name;
+        partition.major = line->major;
+        partition.minor = line->minor;
+        partition.startSector = value;
+        partition.sizeBytes = line->sizeBytes;
+        // the number is the name's tail: sda1, nvme0n1p2
+        size_t digits = line->name.size();
+        while (digits > 0 && isdigit((unsigned char)line->name[digits - 1])) digits--;
+        partition.number = (uint32_t)strtoul(line->name.c_str() + digits, nullptr, 10);
+        device.partitions.push_back(std::move(partition));
+    }
+    std::sort(device.partitions.begin(), device.partitions.end(),
+              [](const BlockPartition& a, const BlockPartition& b) { return a.number < b.number; });
+    close(dir);
+    return true;
+}
+
+std::vector<BlockDevice> BlockDeviceEnumerator::enumerate() {
+    std::vector<BlockDevice> devices;
+    std::string path = sysRoot + "/block";
+    int blockDir = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (blockDir < 0) return devices;
+
+    std::vector<std::string> names;
+    // fdopendir takes the descriptor over, so it gets its own copy
+    DIR* listing = fdopendir(dup(blockDir));
+    if (listing) {
+        while (dirent* entry = readdir(listing)) {
+            if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+        }
+        closedir(listing);
+    }
+    std::sort(names.begin(), names.end(), nameLess);
+    std::unordered_map<std::string, size_t> disks;
+    disks.reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++) disks[names[i]] = i;
+
+    // partitions go to their disk by name, checked against sysfs in readDisk
+    std::string text;
+    std::vector<PartitionLine> lines;
+    if (readWholeFile(procfsRoot + "/partitions", text)) parsePartitions(text, lines);
+    std::vector<const PartitionLine*> selves(names.size(), nullptr);
+    std::vector<std::vector<const PartitionLine*>> partitions(names.size());
+    for (const PartitionLine& line : lines) {
+        auto it = disks.find(line.name);
+        size_t disk;
+        if (it != disks.end()) {
+            selves[it->second] = &line;
+        } else if (parentDisk(line.name, disks, disk)) {
+            partitions[disk].push_back(&line);
+        }
+    }
+
+    devices.resize(names.size());
+    std::vector<char> found(names.size(), 0);
+    pool.parallelFor(names.size(), [&](size_t i) {
+        found[i] = readDisk(blockDir, names[i], selves[i], partitions[i], devices[i]);
+    });
+    close(blockDir);
+
+    std::unordered_map<uint64_t, std::vector<BlockMount>> mounts;
+    if (readWholeFile(procfsRoot + "/self/mountinfo", text)) parseMountinfo(text, mounts);
+    auto mountsOf = [&mounts](uint32_t major, uint32_t minor, std::vector<BlockMount>& into) {
+        auto it = mounts.find(deviceKey(major, minor));
+        if (it != mounts.end()) into = it->second;
+    };
+
+    size_t kept = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+        BlockDevice& device = devices[i];
+        // unused loop and ram devices; an empty card reader is still a drive
+        if (!found[i] || (device.sizeBytes == 0 && !device.removable)) continue;
+        mountsOf(device.major, device.minor, device.mounts);
+        for (BlockPartition& partition : device.partitions) {
+            mountsOf(partition.major, partition.minor, partition.mounts);
+        }
+        if (kept != i) devices[kept] = std::move(device);
+        kept++;
+    }
+    devices.resize(kept);
+    return devices;
+}
+
+static const size_t kUeventBufferSize = 8192;
+
+// "action@devpath\0ACTION=add\0DEVPATH=...\0SUBSYSTEM=block\0..."
+static bool isBlockUevent(const char* event, size_t length) {
+    static const char key[] = "SUBSYSTEM=block";
+    const char* p = event;
+    const char* end = event + length;
+    while (p < end) {
+        size_t field = strnlen(p, (size_t)(end - p));
+        if (field == sizeof(key) - 1 && memcmp(p, key, field) == 0) return true;
+        p += field + 1;
+    }
+    return false;
+}
+
+BlockInventory::BlockInventory(std::string sysfsRoot, std::string procRoot, std::unique_ptr<UeventSource> source)
+    : enumerator(std::move(sysfsRoot), std::move(procRoot)), uevents(std::move(source)) {
+    if (!uevents) {
+        uevents = std::make_unique<NetlinkUeventSource>();
+    }
+    // only procfs raises POLLPRI when the mount table changes
+    std::string path = enumerator.procRoot() + "/self/mountinfo";
+    mountinfoFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+BlockInventory::~BlockInventory() {
+    if (mountinfoFd >= 0) close(mountinfoFd);
+}
+
+bool BlockInventory::available() {
+    return true;
+}
+
+bool BlockInventory::stale() {
+    bool changed = invalidated || !snapshot;
+    // drained every time, so old events do not pile up in the socket
+    if (uevents->fd() >= 0) {
+        char buffer[kUeventBufferSize];
+        for (;;) {
+            ssize_t length = uevents->receive(buffer, sizeof(buffer));
+            if (length < 0) {
+                // the socket overflowed and events were lost
+                if (errno == ENOBUFS) {
+                    changed = true;
+                    continue;
+                }
+                break;
+            }
+            if (length == 0) break;
+            if (isBlockUevent(buffer, (size_t)length)) changed = true;
+        }
+    } else if (std::chrono::steady_clock::now() - enumeratedAt >= rescanInterval) {
+        changed = true;
+    }
+    if (mountinfoFd >= 0) {
+        pollfd watch{ mountinfoFd, POLLPRI, 0 };
+        if (poll(&watch, 1, 0) > 0 && (watch.revents & (POLLPRI | POLLERR))) changed = true;
+    }
+    return changed;
+}
+
+#else // !__linux__
+
+std::vector<BlockDevice> BlockDeviceEnumerator::enumerate() {
+    return {};
+}
+
+BlockInventory::BlockInventory(std::string sysfsRoot, std::string procRoot)
+    : enumerator(std::move(sysfsRoot), std::move(procRoot)) {}
+
+BlockInventory::~BlockInventory() {}
+
+bool BlockInventory::available() {
+    return false;
+}
+
+bool BlockInventory::stale() {
+    return invalidated || !snapshot || std::chrono::steady_clock::now() - enumeratedAt >= rescanInterval;
+}
+
+#endif // __linux__
+
+std::shared_ptr<const BlockInventorySnapshot> BlockInventory::current() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stale()) return snapshot;
+
+    auto started = std::chrono::steady_clock::now();
+    auto next = std::make_shared<BlockInventorySnapshot>();
+    next->devices = enumerator.enumerate();
+    enumeratedAt = std::chrono::steady_clock::now();
+    next->enumerationUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(enumeratedAt - started).count();
+    invalidated = false;
+    enumerationCount++;
+    if (!snapshot) {
+        next->generation = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    } else {
+        next->generation = next->devices == snapshot->devices ? snapshot->generation : snapshot->generation + 1;
+    }
+    snapshot = next;
+    return snapshot;
+}
+
+void BlockInventory::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    invalidated = true;
+}
+
+void BlockInventory::setRescanInterval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rescanInterval = interval;
+}
+
+uint64_t BlockInventory::enumerations() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return enumerationCount;
+}
@@ -0,0 +1,145 @@
+#ifndef BLOCK_DEVICES_HPP
+#define BLOCK_DEVICES_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "worker_pool.hpp"
+#ifdef __linux__
+#include "power_supply_linux.hpp"
+#endif
+
+// One line of mountinfo that mounts a block device
+struct BlockMount {
+    std::string mountPoint;
+    std::string fsType;
+    std::string source;         // what was passed to mount, e.g. /dev/nvme0n1p2
+    bool readOnly = false;
+
+    bool operator==(const BlockMount&) const = default;
+};
+
+struct BlockPartition {
+    std::string name;           // nvme0n1p2
+    uint32_t major = 0;
+    uint32_t minor = 0;
+    uint32_t number = 0;        // 2 for nvme0n1p2
+    uint64_t startSector = 0;   // 512-byte sectors from the start of the disk
+    uint64_t sizeBytes = 0;
+    std::vector<BlockMount> mounts;
+
+    bool operator==(const BlockPartition&) const = default;
+};
+
+// A disk of /sys/block: a drive, a SCSI LUN, an NVMe namespace, a loop or
+// device-mapper device.
+struct BlockDevice {
+    std::string name;           // sda, nvme0n1, dm-0
+    uint32_t major = 0;
+    uint32_t minor = 0;
+    std::string vendor;         // device/vendor, SCSI and ATA only
+    std::string model;          // device/model
+    uint64_t sizeBytes = 0;
+    uint32_t logicalBlockSize = 512;
+    uint32_t physicalBlockSize = 512;
+    bool rotational = false;
+    bool removable = false;
+    bool readOnly = false;
+    int queueDepth = -1;        // device/queue_depth of a SCSI device, -1 without one
+    uint32_t requests = 0;      // queue/nr_requests
+    std::string scheduler;      // the active one, "none" for none
+    std::vector<std::string> schedulers;
+    std::vector<BlockPartition> partitions;
+    std::vector<BlockMount> mounts;   // a filesystem on the whole disk
+
+    bool operator==(const BlockDevice&) const = default;
+};
+
+// Reads <sysfs>/block/* and <proc>/partitions and <proc>/self/mountinfo into
+// typed records. /proc/partitions gives the numbers and size of every disk
+// and partition in one read, so a disk's directory is only opened for its
+// queue and model attributes and its partitions' start sectors. Disks are
+// spread over a worker pool like the PCI devices. Both roots are
+// configurable so a fake tree can stand in for the real ones. Linux only;
+// elsewhere the list is empty.
+class BlockDeviceEnumerator {
+public:
+    explicit BlockDeviceEnumerator(std::string sysfsRoot = "/sys", std::string procRoot = "/proc", unsigned workers = 0);
+
+    // disks in name order ("sdb" before "sdaa", "nvme0n2" before "nvme0n10"),
+    // partitions in number order. Empty disks (loop, ram) are left out,
+    // removable drives without a medium are kept.
+    std::vector<BlockDevice> enumerate();
+    const std::string& sysfsRoot() const { return sysRoot; }
+    const std::string& procRoot() const { return procfsRoot; }
+    unsigned threadCount() const { return pool.threadCount(); }
+
+    // "sdb" < "sdaa" < "sdab", digits compare as numbers
+    static bool nameLess(const std::string& a, const std::string& b);
+
+private:
+    std::string sysRoot;
+    std::string procfsRoot;
+    WorkerPool pool;
+};
+
+struct BlockInventorySnapshot {
+    uint64_t generation = 0;
+    std::vector<BlockDevice> devices;
+    uint64_t enumerationUs = 0;     // how long the last enumeration took
+};
+
+// The enumerated disks, kept until something says they are stale: a uevent
+// of the block subsystem (disks and partitions coming and going, media
+// changes, resizes) or a change of the mount table, which the kernel
+// signals as POLLPRI on mountinfo. Without a uevent socket the list is
+// enumerated again at most once a second instead.
+//
+// Generations work like the PCI topology's: they start from the startup
+// time in milliseconds and move only when an enumeration differs from the
+// last one, so the rendered answer can be cached per generation.
+class BlockInventory {
+public:
+#ifdef __linux__
+    // uevents defaults to the kernel's netlink socket
+    explicit BlockInventory(std::string sysfsRoot = "/sys", std::string procRoot = "/proc",
+                            std::unique_ptr<UeventSource> uevents = nullptr);
+#else
+    explicit BlockInventory(std::string sysfsRoot = "/sys", std::string procRoot = "/proc");
+#endif
+    ~BlockInventory();
+    BlockInventory(const BlockInventory&) = delete;
+    BlockInventory& operator=(const BlockInventory&) = delete;
+
+    // the list, enumerated again first if it is stale
+    std::shared_ptr<const BlockInventorySnapshot> current();
+    // the next current() enumerates again
+    void invalidate();
+    // false where there is no native enumerator (Windows)
+    static bool available();
+    // Without uevents (no netlink socket, Windows) a list older than this
+    // is enumerated again; 1 s by default
+    void setRescanInterval(std::chrono::milliseconds interval);
+
+    uint64_t enumerations();
+
+private:
+    bool stale();
+
+    BlockDeviceEnumerator enumerator;
+#ifdef __linux__
+    std::unique_ptr<UeventSource> uevents;
+    int mountinfoFd = -1;
+#endif
+    std::mutex mutex;
+    std::shared_ptr<const BlockInventorySnapshot> snapshot;
+    bool invalidated = true;
+    uint64_t enumerationCount = 0;
+    std::chrono::steady_clock::time_point enumeratedAt;
+    std::chrono::milliseconds rescanInterval{1000};
+};
+
+#endif // BLOCK_DEVICES_HPP
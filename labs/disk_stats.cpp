@@ -0,0 +1,284 @@
+#include "disk_stats.hpp"
+#include "timer_slack.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DiskStatsMonitor::DiskStatsMonitor(std::string procRoot, std::string sysfs, size_t history)
+    : diskstatsPath(procRoot + "/diskstats"), sysfsRoot(std::move(sysfs)), historyLength(history), buffer(64 * 1024) {}
+
+DiskStatsMonitor::~DiskStatsMonitor() {
+    stop();
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+static uint64_t nowMilliseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static inline const char* parseNumber(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (uint64_t)(*p++ - '0');
+    return p;
+}
+
+// counters are unsigned long in the kernel, 32 bits wide on 32-bit systems;
+// a smaller value is a wrap or a reset and counts from zero
+static inline uint64_t counterDelta(uint64_t now, uint64_t before) {
+    return now >= before ? now - before : now;
+}
+
+DiskStatsMonitor::Device* DiskStatsMonitor::findDevice(const char* name, size_t length, size_t line) {
+    // the kernel keeps the order of the lines, so the device is usually where it was
+    if (line < devices.size()) {
+        Device* device = devices[line].get();
+        if (device->name.size() == length && memcmp(device->name.data(), name, length) == 0) return device;
+    }
+    auto it = byName.find(std::string(name, length));
+    return it == byName.end() ? nullptr : it->second;
+}
+
+bool DiskStatsMonitor::sampleOnce(uint64_t nowMs) {
+    if (nowMs == 0) nowMs = nowMilliseconds();
+    auto started = std::chrono::steady_clock::now();
+    size_t length = 0;
+#ifdef __linux__
+    if (fd < 0) {
+        fd = open(diskstatsPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+    }
+    // offset 0 makes procfs generate the file again; a full buffer may have
+    // been cut short, so it grows and the tick reads again
+    for (;;) {
+        ssize_t count = pread(fd, buffer.data(), buffer.size(), 0);
+        if (count < 0) return false;
+        if ((size_t)count < buffer.size()) {
+            length = (size_t)count;
+            break;
+        }
+        buffer.resize(buffer.size() * 2);
+    }
+#else
+    return false;
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tickCount++;
+        std::vector<std::unique_ptr<Device>> added;
+        bool reordered = false;
+        lineDevices.clear();
+        const char* p = buffer.data();
+        const char* end = p + length;
+        for (size_t line = 0; p < end; line++) {
+            const char* lineEnd = (const char*)memchr(p, '\n', (size_t)(end - p));
+            if (!lineEnd) lineEnd = end;
+            // "   8       0 sda 1207 353 61858 402 ..."
+            uint64_t major, minor;
+            const char* q = parseNumber(skipSpaces(p, lineEnd), lineEnd, major);
+            q = parseNumber(skipSpaces(q, lineEnd), lineEnd, minor);
+            const char* name = skipSpaces(q, lineEnd);
+            q = name;
+            while (q < lineEnd && *q != ' ' && *q != '\t') q++;
+            size_t nameLength = (size_t)(q - name);
+            uint64_t counters[CounterCount];
+            int count = 0;
+            for (; count < CounterCount; count++) {
+                q = skipSpaces(q, lineEnd);
+                if (q == lineEnd) break;
+                q = parseNumber(q, lineEnd, counters[count]);
+            }
+            p = lineEnd + 1;
+            if (nameLength == 0 || count < CounterCount) continue;
+
+            Device* device = findDevice(name, nameLength, line);
+            if (!device) {
+                added.push_back(std::make_unique<Device>(historyLength));
+                device = added.back().get();
+                device->name.assign(name, nameLength);
+                device->major = (uint32_t)major;
+                device->minor = (uint32_t)minor;
+#ifdef __linux__
+                // whole disks are in /sys/block, partitions only below them
+                std::string path = sysfsRoot + "/block/" + device->name;
+                device->partition = access(path.c_str(), F_OK) != 0;
+#endif
+                reordered = true;
+            } else if (line >= devices.size() || devices[line].get() != device) {
+                reordered = true;
+            }
+            lineDevices.push_back(device);
+
+            if (device->sampledAtMs != 0 && nowMs > device->sampledAtMs) {
+                double seconds = (nowMs - device->sampledAtMs) / 1000.0;
+                uint64_t deltas[CounterCount];
+                for (int i = 0; i < CounterCount; i++) deltas[i] = counterDelta(counters[i], device->counters[i]);
+                DiskIoSample sample;
+                sample.timestampMs = nowMs;
+                sample.intervalMs = (uint32_t)(nowMs - device->sampledAtMs);
+                sample.readIops = (float)(deltas[ReadsCompleted] / seconds);
+                sample.writeIops = (float)(deltas[WritesCompleted] / seconds);
+                // diskstats sectors are 512 bytes whatever the device uses
+                sample.readBytesPerSecond = (float)(deltas[SectorsRead] * 512 / seconds);
+                sample.writeBytesPerSecond = (float)(deltas[SectorsWritten] * 512 / seconds);
+                if (deltas[ReadsCompleted]) sample.readLatencyMs = (float)deltas[ReadMs] / deltas[ReadsCompleted];
+                if (deltas[WritesCompleted]) sample.writeLatencyMs = (float)deltas[WriteMs] / deltas[WritesCompleted];
+                sample.queueDepth = (float)(deltas[WeightedMs] / (seconds * 1000));
+                sample.utilization = std::min(1.0f, (float)(deltas[IoMs] / (seconds * 1000)));
+                sample.inFlight = (uint32_t)counters[InFlight];
+                device->history.push(sample);
+            }
+            memcpy(device->counters, counters, sizeof(counters));
+            device->sampledAtMs = nowMs;
+        }
+
+        // devices came or went: rebuild the list in file order
+        if (reordered || lineDevices.size() != devices.size()) {
+            std::unordered_map<Device*, std::unique_ptr<Device>> owned;
+            for (auto& device : devices) owned[device.get()] = std::move(device);
+            for (auto& device : added) owned[device.get()] = std::move(device);
+            std::vector<std::unique_ptr<Device>> ordered;
+            ordered.reserve(lineDevices.size());
+            for (Device* device : lineDevices) {
+                auto it = owned.find(device);
+                if (it != owned.end() && it->second) ordered.push_back(std::move(it->second));
+            }
+            // the ones left in owned are gone from the file
+            byName.clear();
+            for (auto& device : ordered) byName[device->name] = device.get();
+            devices.swap(ordered);
+        }
+        tickUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count();
+    }
+
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    for (const auto& listener : listeners) listener(nowMs);
+    return true;
+}
+
+void DiskStatsMonitor::addListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    listeners.push_back(std::move(listener));
+}
+
+void DiskStatsMonitor::samplerLoop() {
+    while (running) {
+        sampleOnce();
+        adoptTimerSlack();
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(periodMs.load()), [this] { return !running; });
+    }
+}
+
+void DiskStatsMonitor::start(std::chrono::milliseconds period) {
+    setPeriod(period);
+    if (running.exchange(true)) return;
+    sampler = std::thread(&DiskStatsMonitor::samplerLoop, this);
+}
+
+void DiskStatsMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (sampler.joinable()) sampler.join();
+}
+
+void DiskStatsMonitor::setPeriod(std::chrono::milliseconds period) {
+    periodMs = std::max<int64_t>(period.count(), 10);
+}
+
+std::vector<DiskIoStats> DiskStatsMonitor::stats(uint64_t windowMs, uint64_t nowMs) {
+    if (nowMs == 0) nowMs = nowMilliseconds();
+    uint64_t start = nowMs > windowMs ? nowMs - windowMs : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<DiskIoStats> result;
+    result.reserve(devices.size());
+    for (const auto& pointer : devices) {
+        const Device& device = *pointer;
+        DiskIoStats item;
+        item.name = device.name;
+        item.major = device.major;
+        item.minor = device.minor;
+        item.partition = device.partition;
+        item.reads = device.counters[ReadsCompleted];
+        item.writes = device.counters[WritesCompleted];
+        item.bytesRead = device.counters[SectorsRead] * 512;
+        item.bytesWritten = device.counters[SectorsWritten] * 512;
+        if (!device.history.empty()) {
+            item.last = device.history.back();
+            // rates weighted by tick length; latencies by the requests behind them
+            double totalMs = 0, reads = 0, writes = 0, readMs = 0, writeMs = 0;
+            for (size_t i = device.history.size(); i-- > 0; ) {
+                const DiskIoSample& sample = device.history[i];
+                if (windowMs > 0 ? sample.timestampMs <= start : i + 1 < device.history.size()) break;
+                double ms = sample.intervalMs;
+                totalMs += ms;
+                item.readIops += sample.readIops * ms;
+                item.writeIops += sample.writeIops * ms;
+                item.readBytesPerSecond += sample.readBytesPerSecond * ms;
+                item.writeBytesPerSecond += sample.writeBytesPerSecond * ms;
+                item.queueDepth += sample.queueDepth * ms;
+                item.utilization += sample.utilization * ms;
+                item.peakUtilization = std::max<double>(item.peakUtilization, sample.utilization);
+                double sampleReads = sample.readIops * ms / 1000, sampleWrites = sample.writeIops * ms / 1000;
+                reads += sampleReads;
+                writes += sampleWrites;
+                readMs += sample.readLatencyMs * sampleReads;
+                writeMs += sample.writeLatencyMs * sampleWrites;
+            }
+            if (totalMs > 0) {
+                item.readIops /= totalMs;
+                item.writeIops /= totalMs;
+                item.readBytesPerSecond /= totalMs;
+                item.writeBytesPerSecond /= totalMs;
+                item.queueDepth /= totalMs;
+                item.utilization /= totalMs;
+            }
+            if (reads > 0) item.readLatencyMs = readMs / reads;
+            if (writes > 0) item.writeLatencyMs = writeMs / writes;
+            item.saturated = item.utilization >= 0.9;
+        }
+        result.push_back(std::move(item));
+    }
+    return result;
+}
+
+bool DiskStatsMonitor::history(const std::string& name, std::vector<DiskIoSample>& samples) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = byName.find(name);
+    if (it == byName.end()) return false;
+    samples.clear();
+    const Device& device = *it->second;
+    samples.reserve(device.history.size());
+    for (size_t i = 0; i < device.history.size(); i++) samples.push_back(device.history[i]);
+    return true;
+}
+
+size_t DiskStatsMonitor::deviceCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return devices.size();
+}
+
+uint64_t DiskStatsMonitor::ticks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tickCount;
+}
+
+uint64_t DiskStatsMonitor::lastTickUs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tickUs;
+}
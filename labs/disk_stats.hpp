@@ -0,0 +1,137 @@
+#ifndef DISK_STATS_HPP
+#define DISK_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ring_buffer.hpp"
+
+// One tick of one device, worked out from the counter deltas since the tick
+// before. Kept small, every device gets one per tick.
+struct DiskIoSample {
+    uint64_t timestampMs = 0;
+    uint32_t intervalMs = 0;        // since the previous tick
+    float readIops = 0;
+    float writeIops = 0;
+    float readBytesPerSecond = 0;
+    float writeBytesPerSecond = 0;
+    float readLatencyMs = 0;        // mean time per completed request
+    float writeLatencyMs = 0;
+    float queueDepth = 0;           // mean requests in flight (iostat aqu-sz)
+    float utilization = 0;          // share of the interval with I/O in flight, 0..1
+    uint32_t inFlight = 0;          // at the moment of the tick
+};
+
+struct DiskIoStats {
+    std::string name;
+    uint32_t major = 0;
+    uint32_t minor = 0;
+    bool partition = false;         // not in <sysfs>/block
+    // totals as the kernel counts them
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    DiskIoSample last;
+    // over the requested window, weighted by the length of each tick
+    double readIops = 0;
+    double writeIops = 0;
+    double readBytesPerSecond = 0;
+    double writeBytesPerSecond = 0;
+    double readLatencyMs = 0;       // weighted by requests, not by time
+    double writeLatencyMs = 0;
+    double queueDepth = 0;
+    double utilization = 0;
+    double peakUtilization = 0;
+    // busy at least 90% of the window: requests wait for the device
+    bool saturated = false;
+};
+
+// Samples <proc>/diskstats: the file stays open and each tick is one pread
+// of it, parsed in place. IOPS, throughput, latency, queue depth and
+// utilization come from the deltas of the counters, the same arithmetic as
+// iostat -x. Each device keeps a ring of its last samples. Devices appear
+// and disappear with the lines of the file (a USB disk plugged in or
+// pulled). Linux only, elsewhere there is no file and nothing is sampled.
+class DiskStatsMonitor {
+public:
+    using Listener = std::function<void(uint64_t timestampMs)>;
+
+    explicit DiskStatsMonitor(std::string procRoot = "/proc", std::string sysfsRoot = "/sys", size_t historyLength = 300);
+    ~DiskStatsMonitor();
+    DiskStatsMonitor(const DiskStatsMonitor&) = delete;
+    DiskStatsMonitor& operator=(const DiskStatsMonitor&) = delete;
+
+    // One tick at nowMs (0 - the system clock); false if the file could not be read
+    bool sampleOnce(uint64_t nowMs = 0);
+
+    void start(std::chrono::milliseconds period);
+    void stop();
+    bool isRunning() const { return running; }
+    // takes effect after the current wait
+    void setPeriod(std::chrono::milliseconds period);
+    std::chrono::milliseconds period() const { return std::chrono::milliseconds(periodMs.load()); }
+    // Called after every tick on the sampler thread
+    void addListener(Listener listener);
+
+    // every device, averages over the windowMs before nowMs (0 - the
+    // system clock, window 0 - the last tick only)
+    std::vector<DiskIoStats> stats(uint64_t windowMs = 10000, uint64_t nowMs = 0);
+    bool history(const std::string& name, std::vector<DiskIoSample>& samples);
+    size_t deviceCount();
+    uint64_t ticks();
+    uint64_t lastTickUs();          // how long the last tick took
+
+private:
+    // the fields of a diskstats line after the name, in file order
+    enum Counter {
+        ReadsCompleted, ReadsMerged, SectorsRead, ReadMs,
+        WritesCompleted, WritesMerged, SectorsWritten, WriteMs,
+        InFlight, IoMs, WeightedMs, CounterCount
+    };
+    struct Device {
+        std::string name;
+        uint32_t major = 0;
+        uint32_t minor = 0;
+        bool partition = false;
+        uint64_t counters[CounterCount] = {};
+        uint64_t sampledAtMs = 0;
+        RingBuffer<DiskIoSample> history;
+
+        explicit Device(size_t historyLength) : history(historyLength) {}
+    };
+    Device* findDevice(const char* name, size_t length, size_t line);
+    void samplerLoop();
+
+    std::string diskstatsPath;
+    std::string sysfsRoot;
+    size_t historyLength;
+    int fd = -1;
+    std::vector<char> buffer;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Device>> devices;   // in file order
+    std::unordered_map<std::string, Device*> byName;
+    std::vector<Device*> lineDevices;               // this tick's, reused
+    uint64_t tickCount = 0;
+    uint64_t tickUs = 0;
+
+    std::mutex listenersMutex;
+    std::vector<Listener> listeners;
+
+    std::atomic<bool> running{false};
+    std::atomic<int64_t> periodMs{1000};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread sampler;
+};
+
+#endif // DISK_STATS_HPP
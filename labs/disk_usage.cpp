@@ -0,0 +1,549 @@
+#include "disk_usage.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct FileRecord {
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t allocated = 0;
+    int64_t mtimeNs = 0;
+};
+
+// largest first, ties by name so the order does not depend on the workers
+bool largerFile(const FileRecord& a, const FileRecord& b) {
+    return a.bytes != b.bytes ? a.bytes > b.bytes : a.name < b.name;
+}
+
+} // namespace
+
+struct DirectoryNode {
+    std::string name;
+    DirectoryNode* parent = nullptr;
+    int depth = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t mtimeNs = 0;
+    // false if the directory changed within a second of being read: its
+    // mtime may not have moved for a later change in the same tick
+    bool reusable = false;
+    uint64_t ownBytes = 0;
+    uint64_t ownAllocated = 0;
+    uint64_t ownFiles = 0;
+    uint64_t errors = 0;
+    // its largest files, a min-heap while it is read, largest first after;
+    // cut to what could still make the overall top after the scan
+    std::vector<FileRecord> largest;
+    bool largestComplete = true;    // nothing was cut
+    std::vector<FileRecord> hot;    // modified within the hot window
+    std::vector<std::unique_ptr<DirectoryNode>> children;  // by name
+    DirectoryUsage total;
+
+    std::string path() const {
+        if (!parent) return "";
+        std::string above = parent->path();
+        return above.empty() ? name : above + "/" + name;
+    }
+};
+
+struct DiskUsageScanner::Tree {
+    std::unique_ptr<DirectoryNode> root;
+};
+
+namespace {
+
+void addFile(DirectoryNode& node, FileRecord&& file, int64_t hotSinceNs) {
+    node.ownBytes += file.bytes;
+    node.ownAllocated += file.allocated;
+    node.ownFiles++;
+    if (file.mtimeNs >= hotSinceNs) node.hot.push_back(file);
+    // min-heap on size: the front is the smallest kept
+    auto& heap = node.largest;
+    if (heap.size() < DiskUsageScanner::kMaxTop) {
+        heap.push_back(std::move(file));
+        std::push_heap(heap.begin(), heap.end(), largerFile);
+    } else if (largerFile(file, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), largerFile);
+        heap.back() = std::move(file);
+        std::push_heap(heap.begin(), heap.end(), largerFile);
+    }
+}
+
+const DirectoryNode* findChild(const DirectoryNode* previous, const std::string& name) {
+    if (!previous) return nullptr;
+    auto it = std::lower_bound(previous->children.begin(), previous->children.end(), name,
+                               [](const std::unique_ptr<DirectoryNode>& child, const std::string& key) { return child->name < key; });
+    return it != previous->children.end() && (*it)->name == name ? it->get() : nullptr;
+}
+
+// post-order without recursion, deep trees do not run out of stack
+void addUpTotals(DirectoryNode& root) {
+    std::vector<std::pair<DirectoryNode*, size_t>> stack{{&root, 0}};
+    while (!stack.empty()) {
+        auto& [node, next] = stack.back();
+        if (next < node->children.size()) {
+            DirectoryNode* child = node->children[next++].get();
+            stack.push_back({child, 0});
+            continue;
+        }
+        DirectoryUsage& total = node->total;
+        total.bytes = node->ownBytes;
+        total.allocatedBytes = node->ownAllocated;
+        total.files = node->ownFiles;
+        total.directories = node->children.size();
+        for (const auto& child : node->children) {
+            total.bytes += child->total.bytes;
+            total.allocatedBytes += child->total.allocatedBytes;
+            total.files += child->total.files;
+            total.directories += child->total.directories;
+        }
+        stack.pop_back();
+    }
+}
+
+template <typename Visit>
+void forEachNode(DirectoryNode& root, Visit&& visit) {
+    std::vector<DirectoryNode*> stack{&root};
+    while (!stack.empty()) {
+        DirectoryNode* node = stack.back();
+        stack.pop_back();
+        visit(*node);
+        for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) stack.push_back(it->get());
+    }
+}
+
+void buildReport(DirectoryNode& root, const DiskUsageOptions& options, DiskUsageReport& report) {
+    addUpTotals(root);
+    report.total = root.total;
+    report.total.path = "";
+    report.directories.clear();
+    report.errors = 0;
+
+    // every file still kept is a candidate; the ones past the overall top
+    // few hundred are dropped from the kept tree, a rescan rarely needs them
+    const size_t keep = DiskUsageScanner::kMaxTop * 4;
+    std::vector<uint64_t> sizes;
+    forEachNode(root, [&](DirectoryNode& node) {
+        report.errors += node.errors;
+        if (node.depth <= options.depth) {
+            DirectoryUsage usage = node.total;
+            usage.path = node.path();
+            report.directories.push_back(std::move(usage));
+        }
+        for (const auto& file : node.largest) {
+            if (sizes.size() < keep) {
+                sizes.push_back(file.bytes);
+                std::push_heap(sizes.begin(), sizes.end(), std::greater<uint64_t>());
+            } else if (file.bytes > sizes.front()) {
+                std::pop_heap(sizes.begin(), sizes.end(), std::greater<uint64_t>());
+                sizes.back() = file.bytes;
+                std::push_heap(sizes.begin(), sizes.end(), std::greater<uint64_t>());
+            }
+        }
+    });
+    uint64_t threshold = sizes.size() < keep ? 0 : sizes.front();
+
+    // ties go by the directory's place in the tree, then by name
+    std::vector<std::pair<const FileRecord*, const DirectoryNode*>> candidates;
+    std::vector<size_t> order;
+    forEachNode(root, [&](DirectoryNode& node) {
+        if (threshold > 0) {
+            auto cut = std::partition_point(node.largest.begin(), node.largest.end(),
+                                            [&](const FileRecord& file) { return file.bytes >= threshold; });
+            if (cut != node.largest.end()) {
+                node.largest.erase(cut, node.largest.end());
+                node.largestComplete = false;
+            }
+        }
+        for (const auto& file : node.largest) {
+            candidates.push_back({&file, &node});
+            order.push_back(candidates.size() - 1);
+        }
+    });
+    size_t top = std::min(options.top, DiskUsageScanner::kMaxTop);
+    auto larger = [&](size_t a, size_t b) {
+        uint64_t sizeA = candidates[a].first->bytes, sizeB = candidates[b].first->bytes;
+        return sizeA != sizeB ? sizeA > sizeB : a < b;
+    };
+    if (order.size() > top) {
+        std::partial_sort(order.begin(), order.begin() + top, order.end(), larger);
+        order.resize(top);
+    } else {
+        std::sort(order.begin(), order.end(), larger);
+    }
+    report.largest.clear();
+    for (size_t index : order) {
+        const auto& [file, node] = candidates[index];
+        std::string directory = node->path();
+        report.largest.push_back({directory.empty() ? file->name : directory + "/" + file->name, file->bytes, file->mtimeNs / 1000000});
+    }
+}
+
+int64_t realtimeNs() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+const unsigned kStatxMask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_BLOCKS | STATX_MTIME;
+
+int64_t statxMtimeNs(const struct statx& stx) {
+    return stx.stx_mtime.tv_sec * 1000000000ll + stx.stx_mtime.tv_nsec;
+}
+
+class Scan {
+public:
+    Scan(int rootFd, uint64_t rootDevice, const DiskUsageOptions& options, unsigned workers, size_t fdBudget)
+        : rootFd(rootFd), rootDevice(rootDevice), options(options), queues(workers), fdBudget(fdBudget) {
+        hotSinceNs = options.hotWindowMs > 0 ? realtimeNs() - options.hotWindowMs * 1000000 : INT64_MAX;
+    }
+
+    void push(unsigned worker, DirectoryNode* node, const DirectoryNode* previous, int fd) {
+        outstanding.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[worker].mutex);
+            queues[worker].tasks.push_back({node, previous, fd});
+        }
+        queued.fetch_add(1);
+        if (idle.load() > 0) {
+            // a worker between its idle check and its wait would miss the notify
+            { std::lock_guard<std::mutex> lock(idleMutex); }
+            idleWake.notify_one();
+        }
+    }
+
+    void work(unsigned worker) {
+        std::vector<char> buffer(64 * 1024);
+        for (;;) {
+            Task task;
+            if (take(worker, task)) {
+                process(task, worker, buffer);
+                if (outstanding.fetch_sub(1) == 1) {
+                    { std::lock_guard<std::mutex> lock(idleMutex); }
+                    idleWake.notify_all();
+                }
+                continue;
+            }
+            // others are still reading and may push more: sleep until they do
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idle.fetch_add(1);
+            idleWake.wait(lock, [this]() { return queued.load() > 0 || outstanding.load() == 0; });
+            idle.fetch_sub(1);
+            if (outstanding.load() == 0) return;
+        }
+    }
+
+    std::atomic<uint64_t> listed{0};
+    std::atomic<uint64_t> reused{0};
+    std::atomic<uint64_t> stats{0};
+
+private:
+    struct Task {
+        DirectoryNode* node = nullptr;
+        const DirectoryNode* previous = nullptr;
+        int fd = -1;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // the newest of our own (depth first, its fds close soon), else the
+    // oldest of someone else's (near the root, likely a big subtree)
+    bool take(unsigned worker, Task& task) {
+        {
+            Queue& own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& other = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = other.tasks.front();
+                other.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void process(Task& task, unsigned worker, std::vector<char>& buffer) {
+        DirectoryNode& node = *task.node;
+        int fd = task.fd;
+        if (fd >= 0) {
+            openFds.fetch_sub(1);
+        } else {
+            std::string path = node.path();
+            fd = openat(rootFd, path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (fd < 0) {
+                node.errors++;
+                return;
+            }
+        }
+        const DirectoryNode* previous = task.previous;
+        bool unchanged = previous && !options.full && previous->reusable && previous->inode == node.inode &&
+                         previous->device == node.device && previous->mtimeNs == node.mtimeNs;
+        if (!unchanged || !reuse(node, *previous, fd, worker)) list(node, previous, fd, worker, buffer);
+        close(fd);
+    }
+
+    // the children are statted to see whether they changed, the files only
+    // if they are hot; false if the directory turns out to need reading
+    bool reuse(DirectoryNode& node, const DirectoryNode& previous, int fd, unsigned worker) {
+        node.ownBytes = previous.ownBytes;
+        node.ownAllocated = previous.ownAllocated;
+        node.ownFiles = previous.ownFiles;
+        node.largest = previous.largest;
+        node.largestComplete = previous.largestComplete;
+        node.reusable = true;
+        struct statx stx;
+        for (const FileRecord& old : previous.hot) {
+            stats.fetch_add(1, std::memory_order_relaxed);
+            if (statx(fd, old.name.c_str(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, kStatxMask, &stx) != 0) return false;
+            FileRecord file{old.name, stx.stx_size, stx.stx_blocks * 512, statxMtimeNs(stx)};
+            node.ownBytes += file.bytes - old.bytes;
+            node.ownAllocated += file.allocated - old.allocated;
+            auto it = std::find_if(node.largest.begin(), node.largest.end(),
+                                   [&](const FileRecord& item) { return item.name == file.name; });
+            if (it != node.largest.end()) {
+                // a smaller file not kept might now be larger than it
+                if (file.bytes < it->bytes && !node.largestComplete) return false;
+                node.largest.erase(it);
+            }
+            if (node.largest.size() < DiskUsageScanner::kMaxTop || largerFile(file, node.largest.back())) {
+                node.largest.insert(std::upper_bound(node.largest.begin(), node.largest.end(), file, largerFile), file);
+                if (node.largest.size() > DiskUsageScanner::kMaxTop) {
+                    node.largest.pop_back();
+                    node.largestComplete = false;
+                }
+            }
+            if (file.mtimeNs >= hotSinceNs) node.hot.push_back(std::move(file));
+        }
+        for (const auto& old : previous.children) {
+            stats.fetch_add(1, std::memory_order_relaxed);
+            if (statx(fd, old->name.c_str(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, kStatxMask, &stx) != 0 ||
+                !S_ISDIR(stx.stx_mode)) {
+                return false;
+            }
+            // mounted over since (or kept by a scan that crossed mounts):
+            // list() leaves it out
+            if (options.oneFileSystem && makedev(stx.stx_dev_major, stx.stx_dev_minor) != rootDevice) return false;
+            addChild(node, old->name, stx);
+        }
+        reused.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < node.children.size(); i++) {
+            schedule(*node.children[i], previous.children[i].get(), fd, worker);
+        }
+        return true;
+    }
+
+    void list(DirectoryNode& node, const DirectoryNode* previous, int fd, unsigned worker, std::vector<char>& buffer) {
+        node.ownBytes = node.ownAllocated = node.ownFiles = 0;
+        node.largest.clear();
+        node.largestComplete = true;
+        node.hot.clear();
+        node.children.clear();
+        int64_t listedAt = realtimeNs();
+        listed.fetch_add(1, std::memory_order_relaxed);
+        struct statx stx;
+        for (;;) {
+            long count = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (count < 0) {
+                node.errors++;
+                break;
+            }
+            if (count == 0) break;
+            for (long offset = 0; offset < count; ) {
+                const linux_dirent64* entry = (const linux_dirent64*)(buffer.data() + offset);
+                offset += entry->d_reclen;
+                const char* name = entry->d_name;
+                if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+                stats.fetch_add(1, std::memory_order_relaxed);
+                if (statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, kStatxMask, &stx) != 0) {
+                    node.errors++;
+                    continue;
+                }
+                if (S_ISDIR(stx.stx_mode)) {
+                    if (options.oneFileSystem && makedev(stx.stx_dev_major, stx.stx_dev_minor) != rootDevice) continue;
+                    addChild(node, name, stx);
+                } else {
+                    // symlinks count as themselves, they are not followed
+                    addFile(node, FileRecord{name, stx.stx_size, stx.stx_blocks * 512, statxMtimeNs(stx)}, hotSinceNs);
+                }
+            }
+        }
+        node.reusable = listedAt - node.mtimeNs > 1000000000ll;
+        std::sort(node.largest.begin(), node.largest.end(), largerFile);
+        std::sort(node.children.begin(), node.children.end(),
+                  [](const auto& a, const auto& b) { return a->name < b->name; });
+        for (auto& child : node.children) schedule(*child, findChild(previous, child->name), fd, worker);
+    }
+
+    void addChild(DirectoryNode& node, const std::string& name, const struct statx& stx) {
+        auto child = std::make_unique<DirectoryNode>();
+        child->name = name;
+        child->parent = &node;
+        child->depth = node.depth + 1;
+        child->device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        child->inode = stx.stx_ino;
+        child->mtimeNs = statxMtimeNs(stx);
+        node.children.push_back(std::move(child));
+    }
+
+    void schedule(DirectoryNode& child, const DirectoryNode* previous, int parentFd, unsigned worker) {
+        int fd = -1;
+        if (openFds.fetch_add(1) < (int64_t)fdBudget) {
+            fd = openat(parentFd, child.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        }
+        if (fd < 0) openFds.fetch_sub(1);
+        push(worker, &child, previous, fd);
+    }
+
+    int rootFd;
+    uint64_t rootDevice;
+    const DiskUsageOptions& options;
+    int64_t hotSinceNs;
+    std::vector<Queue> queues;
+    size_t fdBudget;
+    std::atomic<int64_t> outstanding{0};
+    std::atomic<int64_t> openFds{0};    // held by queued tasks
+    std::atomic<int64_t> queued{0};     // in the queues, not taken yet
+    std::atomic<int> idle{0};
+    std::mutex idleMutex;
+    std::condition_variable idleWake;
+};
+
+#endif
+
+} // namespace
+
+DiskUsageScanner::DiskUsageScanner(unsigned workers, size_t maxOpen) : pool(workers), maxOpenDirectories(maxOpen) {}
+
+DiskUsageScanner::~DiskUsageScanner() = default;
+
+void DiskUsageScanner::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    trees.clear();
+}
+
+#ifdef __linux__
+
+bool DiskUsageScanner::scan(const std::string& rootPath, const DiskUsageOptions& options, DiskUsageReport& report, std::string& error) {
+    auto started = std::chrono::steady_clock::now();
+    std::string root = rootPath.size() > 1 && rootPath.back() == '/' ? rootPath.substr(0, rootPath.size() - 1) : rootPath;
+    int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct statx stx;
+    if (rootFd < 0 || statx(rootFd, "", AT_EMPTY_PATH, kStatxMask, &stx) != 0) {
+        error = root + ": " + strerror(errno);
+        if (rootFd >= 0) close(rootFd);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<Tree> previous = trees[root];
+    auto tree = std::make_shared<Tree>();
+    tree->root = std::make_unique<DirectoryNode>();
+    DirectoryNode& node = *tree->root;
+    node.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    node.inode = stx.stx_ino;
+    node.mtimeNs = statxMtimeNs(stx);
+
+    Scan scan(rootFd, node.device, options, pool.threadCount(), maxOpenDirectories);
+    // the root task opens "." itself; rootFd stays open for the directories past the fd budget
+    scan.push(0, &node, previous ? previous->root.get() : nullptr, -1);
+    pool.parallelFor(pool.threadCount(), [&scan](size_t worker) { scan.work((unsigned)worker); });
+    close(rootFd);
+
+    report = DiskUsageReport();
+    report.root = root;
+    buildReport(node, options, report);
+    report.listedDirectories = scan.listed;
+    report.reusedDirectories = scan.reused;
+    report.statCalls = scan.stats;
+    trees[root] = tree;
+    report.scanUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+#else
+
+bool DiskUsageScanner::scan(const std::string& rootPath, const DiskUsageOptions& options, DiskUsageReport& report, std::string& error) {
+    namespace fs = std::filesystem;
+    auto started = std::chrono::steady_clock::now();
+    std::error_code code;
+    if (!fs::is_directory(rootPath, code)) {
+        error = rootPath + " is not a directory";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    report = DiskUsageReport();
+    DirectoryNode root;
+    std::vector<std::pair<DirectoryNode*, fs::path>> pending{{&root, fs::path(rootPath)}};
+    while (!pending.empty()) {
+        auto [node, path] = pending.back();
+        pending.pop_back();
+        report.listedDirectories++;
+        for (fs::directory_iterator it(path, code), end; !code && it != end; it.increment(code)) {
+            std::error_code entryCode;
+            report.statCalls++;
+            if (it->is_directory(entryCode) && !it->is_symlink(entryCode)) {
+                auto child = std::make_unique<DirectoryNode>();
+                child->name = it->path().filename().string();
+                child->parent = node;
+                child->depth = node->depth + 1;
+                node->children.push_back(std::move(child));
+                pending.push_back({node->children.back().get(), it->path()});
+            } else {
+                uint64_t size = it->is_regular_file(entryCode) ? it->file_size(entryCode) : 0;
+                addFile(*node, FileRecord{it->path().filename().string(), size, size, 0}, INT64_MAX);
+            }
+        }
+        if (code) {
+            node->errors++;
+            code.clear();
+        }
+        std::sort(node->largest.begin(), node->largest.end(), largerFile);
+        std::sort(node->children.begin(), node->children.end(),
+                  [](const auto& a, const auto& b) { return a->name < b->name; });
+    }
+    report.root = rootPath;
+    buildReport(root, options, report);
+    report.scanUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    (void)maxOpenDirectories;
+    return true;
+}
+
+#endif
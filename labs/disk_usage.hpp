@@ -0,0 +1,91 @@
+#ifndef DISK_USAGE_HPP
+#define DISK_USAGE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "worker_pool.hpp"
+
+struct DirectoryUsage {
+    std::string path;               // relative to the scanned root, "" for the root
+    uint64_t bytes = 0;             // apparent size of every file below
+    uint64_t allocatedBytes = 0;    // blocks on the disk
+    uint64_t files = 0;
+    uint64_t directories = 0;       // below it, itself not counted
+};
+
+struct FileUsage {
+    std::string path;
+    uint64_t bytes = 0;
+    int64_t modifiedMs = 0;
+};
+
+struct DiskUsageOptions {
+    size_t top = 20;                // largest files to return, at most kMaxTop
+    int depth = 1;                  // directory totals down to this depth
+    bool full = false;              // ignore the cache and list everything again
+    bool oneFileSystem = true;      // do not descend into other mounts, like du -x
+    // Files modified this recently are statted again on a rescan even when
+    // their directory did not change: a file that is being written (a
+    // recording) grows without touching its directory's mtime.
+    int64_t hotWindowMs = 60000;
+};
+
+struct DiskUsageReport {
+    std::string root;
+    DirectoryUsage total;
+    std::vector<DirectoryUsage> directories;    // depth first, by name
+    std::vector<FileUsage> largest;             // largest first
+    uint64_t errors = 0;                        // entries that could not be read
+    uint64_t listedDirectories = 0;             // read with getdents this scan
+    uint64_t reusedDirectories = 0;             // taken from the last scan
+    uint64_t statCalls = 0;
+    uint64_t scanUs = 0;
+};
+
+// Adds up a directory tree on all workers of a pool. Each worker keeps a
+// deque of directories: it takes its own newest ones and steals the oldest
+// ones of the others when it runs dry, so one deep subtree does not leave
+// the rest idle. Directories are read with getdents64 and their entries
+// statted with statx relative to the directory's fd, so the kernel never
+// walks a path again. Directory fds are handed from parent to child up to a
+// budget; past it a directory is opened from the root instead.
+//
+// The last tree of every root is kept. A rescan skips reading a directory
+// whose mtime has not moved since (nothing was created, removed or renamed
+// in it) and reuses its files, statting only the ones modified within the
+// hot window. Only the subdirectories are statted to see whether they
+// changed, so a second scan of an unchanged tree costs one statx per
+// directory. A directory modified within a second of being read may change
+// again without its mtime moving and is always read again.
+//
+// Linux only for the parallel scan; elsewhere the tree is walked with
+// std::filesystem on the calling thread and nothing is cached.
+class DiskUsageScanner {
+public:
+    static constexpr size_t kMaxTop = 100;
+
+    explicit DiskUsageScanner(unsigned workers = 0, size_t maxOpenDirectories = 256);
+    ~DiskUsageScanner();
+    DiskUsageScanner(const DiskUsageScanner&) = delete;
+    DiskUsageScanner& operator=(const DiskUsageScanner&) = delete;
+
+    // false and a message if the root cannot be opened
+    bool scan(const std::string& root, const DiskUsageOptions& options, DiskUsageReport& report, std::string& error);
+    // drops the kept trees
+    void clear();
+    unsigned threadCount() const { return pool.threadCount(); }
+
+    struct Tree;
+
+private:
+    WorkerPool pool;
+    size_t maxOpenDirectories;
+    std::mutex mutex;       // one scan at a time, they share the pool
+    std::map<std::string, std::shared_ptr<Tree>> trees;
+};
+
+#endif // DISK_USAGE_HPP
@@ -0,0 +1,336 @@
+#include "file_follow.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// the smallest read that always gets past a whole character
+static const size_t kMinRead = 16;
+
+FileFollower::FileFollower(std::string path) : filePath(std::move(path)) {
+#ifdef __linux__
+    size_t slash = filePath.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filePath.substr(0, slash);
+    fileName = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    const uint32_t mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                          IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, directory.c_str(), mask) < 0) {
+        // no directory to watch (yet): look at the file on every read
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+FileFollower::~FileFollower() {
+#ifdef __linux__
+    if (current.fd >= 0) close(current.fd);
+    if (previous.fd >= 0) close(previous.fd);
+    if (inotifyFd >= 0) close(inotifyFd);
+#endif
+}
+
+#ifdef __linux__
+
+void FileFollower::drainEvents() {
+    alignas(inotify_event) char events[4096];
+    for (;;) {
+        ssize_t count = ::read(inotifyFd, events, sizeof(events));
+        if (count <= 0) return;
+        for (ssize_t offset = 0; offset < count; ) {
+            const inotify_event* event = (const inotify_event*)(events + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                dirty = true;
+            } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                // the directory itself went away, events stop coming
+                dirty = true;
+                close(inotifyFd);
+                inotifyFd = -1;
+                return;
+            } else if (event->len > 0 && fileName == event->name) {
+                dirty = true;
+            }
+        }
+    }
+}
+
+bool FileFollower::openFile() {
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        lastError = filePath + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    Followed file;
+    file.fd = fd;
+    file.device = info.st_dev;
+    file.inode = info.st_ino;
+    file.base = current.base + current.size;
+    current = std::move(file);
+    opened = true;
+    updateSize((uint64_t)info.st_size);
+    return true;
+}
+
+bool FileFollower::refresh() {
+    if (inotifyFd >= 0) {
+        drainEvents();
+        if (current.fd >= 0 && !dirty) return true;
+    }
+    dirty = false;
+    checkCount++;
+    struct stat named;
+    bool exists = stat(filePath.c_str(), &named) == 0;
+    if (current.fd < 0) {
+        if (!exists) {
+            lastError = filePath + ": " + strerror(errno);
+            return false;
+        }
+        return openFile();
+    }
+    struct stat info;
+    if (fstat(current.fd, &info) != 0) {
+        lastError = filePath + ": " + strerror(errno);
+        return false;
+    }
+    if (exists && ((uint64_t)named.st_ino != current.inode || (uint64_t)named.st_dev != current.device)) {
+        // rotated: a new file has the name, the old one ends where it is now
+        // and stays open for whoever is still reading it
+        current.size = std::max(current.size, (uint64_t)info.st_size);
+        if (previous.fd >= 0) close(previous.fd);
+        previous = std::move(current);
+        current = Followed();
+        current.base = previous.base;
+        current.size = previous.size;
+        rotations++;
+        return openFile();
+    }
+    updateSize((uint64_t)info.st_size);
+    return true;
+}
+
+bool FileFollower::readBytes(const Followed& file, uint64_t offset, size_t length, std::vector<char>& into) {
+    into.resize(length);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = pread(file.fd, into.data() + done, length - done, (off_t)(offset + done));
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) {
+            lastError = filePath + ": " + strerror(errno);
+            return false;
+        }
+        if (count == 0) break;      // truncated under us, the next refresh sees it
+        done += (size_t)count;
+    }
+    into.resize(done);
+    return true;
+}
+
+bool FileFollower::watching() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return inotifyFd >= 0;
+}
+
+#else
+
+bool FileFollower::openFile() {
+    std::error_code code;
+    uint64_t length = std::filesystem::file_size(filePath, code);
+    if (code) {
+        lastError = filePath + ": " + code.message();
+        return false;
+    }
+    opened = true;
+    updateSize(length);
+    return true;
+}
+
+bool FileFollower::refresh() {
+    checkCount++;
+    if (!opened) return openFile();
+    std::error_code code;
+    uint64_t length = std::filesystem::file_size(filePath, code);
+    if (code) {
+        // moved away or deleted; keep what was seen until it is back
+        return true;
+    }
+    updateSize(length);
+    return true;
+}
+
+bool FileFollower::readBytes(const Followed&, uint64_t offset, size_t length, std::vector<char>& into) {
+    std::ifstream file(std::filesystem::u8path(filePath), std::ios::binary);
+    if (!file) {
+        lastError = filePath + ": cannot open";
+        return false;
+    }
+    into.resize(length);
+    file.seekg((std::streamoff)offset);
+    file.read(into.data(), (std::streamsize)length);
+    into.resize((size_t)file.gcount());
+    return true;
+}
+
+bool FileFollower::watching() { return false; }
+
+#endif
+
+// A file that got shorter was truncated. One that did not may still have
+// been written over from the start (a report saved again, a log cleared and
+// refilled before we looked): then the bytes just before the old end are
+// different. Either way the file starts over at a new base.
+void FileFollower::updateSize(uint64_t length) {
+    Followed& file = current;
+    bool rewritten = length < file.size;
+    if (!rewritten && !file.edge.empty()) {
+        std::vector<char> again;
+        rewritten = readBytes(file, file.size - file.edge.size(), file.edge.size(), again) && again != file.edge;
+    }
+    if (rewritten) {
+        file.base += file.size;
+        file.size = 0;
+        file.replaced = true;
+        file.encodingKnown = false;
+        rotations++;
+    }
+    if (length != file.size || rewritten) {
+        file.size = length;
+        size_t edgeLength = (size_t)std::min<uint64_t>(file.size, 64);
+        if (!readBytes(file, file.size - edgeLength, edgeLength, file.edge)) file.edge.clear();
+    }
+    detectEncoding(file);
+}
+
+// once there is something to look at; a file that starts empty is decided
+// by its first bytes
+void FileFollower::detectEncoding(Followed& file) {
+    if (file.encodingKnown || file.size == 0) return;
+    std::vector<char> head;
+    if (!readBytes(file, 0, (size_t)std::min<uint64_t>(file.size, 4096), head)) return;
+    // one byte cannot be told from the start of UTF-16
+    if (head.size() < 2) return;
+    file.encoding = detectTextEncoding((const uint8_t*)head.data(), head.size(), file.bomLength);
+    file.encodingKnown = true;
+}
+
+// the length of `data` without a UTF-8 sequence that is cut off at the end
+static size_t completeUtf8(const char* data, size_t length) {
+    size_t start = length;
+    // back to the lead byte of the last sequence, at most 3 continuation bytes
+    while (start > 0 && length - start < 4 && ((unsigned char)data[start - 1] & 0xC0) == 0x80) start--;
+    if (start == 0) return length;
+    unsigned char lead = (unsigned char)data[start - 1];
+    size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    return length - (start - 1) < need ? start - 1 : length;
+}
+
+// `more` only when maxBytes stopped the read: a character not yet written in
+// full at the end of the file is left for when it is
+bool FileFollower::readRange(Followed& file, uint64_t from, uint64_t to, FollowChunk& chunk) {
+    bool utf16 = file.encodingKnown && file.encoding != TextEncoding::Utf8;
+    bool limited = to < file.size;
+    from = std::max<uint64_t>(from, file.encodingKnown ? file.bomLength : 0);
+    to = std::max(to, from);
+    if (utf16) {
+        // whole code units only
+        from -= (from - file.bomLength) & 1;
+        to -= (to - file.bomLength) & 1;
+    }
+    chunk.start = file.base + from;
+    chunk.next = chunk.start;
+    chunk.more = false;
+    if (to <= from) return true;
+    if (!readBytes(file, from, (size_t)(to - from), buffer)) return false;
+
+    if (!utf16) {
+        size_t keep = buffer.size();
+        if (limited) {
+            // stop after the last whole line if there is one
+            auto newline = std::find(buffer.rbegin(), buffer.rend(), '\n');
+            if (newline != buffer.rend()) keep = (size_t)(buffer.rend() - newline);
+        }
+        keep = completeUtf8(buffer.data(), keep);
+        chunk.text.assign(buffer.data(), keep);
+        chunk.next = chunk.start + keep;
+    } else {
+        size_t units = buffer.size() / 2;
+        transcoded.resize(units * 3);
+        size_t consumed = 0;
+        size_t written = utf16ToUtf8((const uint8_t*)buffer.data(), units, file.encoding == TextEncoding::Utf16BE,
+                                     false, transcoded.data(), consumed);
+        chunk.text.assign(transcoded.data(), written);
+        chunk.next = chunk.start + consumed * 2;
+    }
+    chunk.more = limited && chunk.next < file.base + file.size;
+    return true;
+}
+
+bool FileFollower::read(uint64_t since, size_t maxBytes, FollowChunk& chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    chunk = FollowChunk();
+    if (!refresh()) return false;
+    chunk.rotations = rotations;
+    maxBytes = std::max(maxBytes, kMinRead);
+    if (previous.fd >= 0 && since >= previous.base && since < previous.base + previous.size) {
+        // still in the file that was rotated away: the rest of it, then on
+        // into the current one
+        uint64_t from = since - previous.base;
+        bool rest = from + maxBytes >= previous.size;
+        if (!readRange(previous, from, std::min<uint64_t>(previous.size, from + maxBytes), chunk)) return false;
+        // nothing more will be written to it: what is left is skipped too
+        if (rest) chunk.next = current.base;
+        chunk.more = true;
+        return true;
+    }
+    // before the current file (it was rotated or truncated since), at the
+    // start of one that replaced what was before it, or past its end (an
+    // offset from before a restart): start the current file over
+    if (since < current.base || (since == current.base && current.replaced) ||
+        since > current.base + current.size) {
+        chunk.reset = true;
+        since = current.base;
+    }
+    uint64_t from = since - current.base;
+    return readRange(current, from, std::min<uint64_t>(current.size, from + maxBytes), chunk);
+}
+
+bool FileFollower::tail(size_t tailBytes, size_t maxBytes, FollowChunk& chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    chunk = FollowChunk();
+    if (!refresh()) return false;
+    chunk.rotations = rotations;
+    maxBytes = std::max(maxBytes, kMinRead);
+    uint64_t from = current.size > tailBytes ? current.size - tailBytes : 0;
+    if (from > 0 && !(current.encodingKnown && current.encoding != TextEncoding::Utf8)) {
+        // from the start of the next line
+        std::vector<char> scan;
+        if (!readBytes(current, from, (size_t)std::min<uint64_t>(current.size - from, 4096), scan)) return false;
+        auto newline = std::find(scan.begin(), scan.end(), '\n');
+        if (newline != scan.end()) from += (uint64_t)(newline - scan.begin()) + 1;
+    }
+    return readRange(current, from, std::min<uint64_t>(current.size, from + maxBytes), chunk);
+}
+
+uint64_t FileFollower::end() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return refresh() ? current.base + current.size : 0;
+}
+
+std::string FileFollower::error() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastError;
+}
+
+uint64_t FileFollower::checks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return checkCount;
+}
@@ -0,0 +1,97 @@
+#ifndef FILE_FOLLOW_HPP
+#define FILE_FOLLOW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "utf16.hpp"
+
+// A piece of a followed file. Offsets count bytes of the file, continued
+// across truncation and rotation, so a client keeps passing `next` back as
+// `since` and never sees an offset go backwards.
+struct FollowChunk {
+    uint64_t start = 0;         // offset of the first byte of text
+    uint64_t next = 0;          // where the next read continues
+    std::string text;           // UTF-8, whatever the file's encoding
+    bool reset = false;         // `since` was in a file that is gone; text starts the current one
+    bool more = false;          // there is more past `next` already
+    uint64_t rotations = 0;     // times the file was truncated or replaced
+};
+
+// Follows a file that grows: a log, a report written a bit at a time. The
+// file stays open and only the bytes after the asked-for offset are read.
+//
+// On Linux one inotify watch on the file's directory says when the file was
+// written, truncated, or replaced under its name (rotation: moved away and
+// created again). Without an event since the last read nothing is statted,
+// so polling a quiet file is a read of an empty inotify queue. A rotated
+// file stays open, so a client still in it reads it to its end and goes on
+// into the new one. Elsewhere the file's size is looked at on every read. A
+// file written over from the start without getting shorter is told apart
+// from an append by the bytes just before the old end.
+//
+// UTF-8 text is cut at a line end when the read is limited and never inside
+// a character; UTF-16 (detected from the BOM or the zero bytes, like the
+// storage report) is transcoded and never cut inside a surrogate pair.
+class FileFollower {
+public:
+    explicit FileFollower(std::string path);
+    ~FileFollower();
+    FileFollower(const FileFollower&) = delete;
+    FileFollower& operator=(const FileFollower&) = delete;
+
+    // Up to maxBytes of the file after `since`; false if the file cannot be read
+    bool read(uint64_t since, size_t maxBytes, FollowChunk& chunk);
+    // The last tailBytes of the file, from the start of a line
+    bool tail(size_t tailBytes, size_t maxBytes, FollowChunk& chunk);
+    // offset of the end of the file, 0 if it cannot be read
+    uint64_t end();
+
+    const std::string& path() const { return filePath; }
+    std::string error();
+    bool watching();            // inotify in use
+    uint64_t checks();          // times the file was statted
+
+private:
+    // one file that had the name
+    struct Followed {
+        int fd = -1;
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t size = 0;      // as last seen
+        uint64_t base = 0;      // offset of its first byte
+        bool replaced = false;  // truncated or written over: what was before base is gone
+        bool encodingKnown = false;
+        TextEncoding encoding = TextEncoding::Utf8;
+        size_t bomLength = 0;
+        std::vector<char> edge; // the last bytes before `size`
+    };
+
+    bool refresh();
+    bool openFile();
+    void updateSize(uint64_t length);
+    void detectEncoding(Followed& file);
+    bool readRange(Followed& file, uint64_t from, uint64_t to, FollowChunk& chunk);
+    bool readBytes(const Followed& file, uint64_t offset, size_t length, std::vector<char>& into);
+
+    std::string filePath;
+    std::mutex mutex;
+    std::string lastError;
+    Followed current;
+    Followed previous;          // the last one rotated away, still open
+    uint64_t rotations = 0;
+    uint64_t checkCount = 0;
+    bool opened = false;
+    std::vector<char> buffer;
+    std::string transcoded;
+#ifdef __linux__
+    void drainEvents();
+    int inotifyFd = -1;
+    std::string fileName;       // the name in the watched directory
+    bool dirty = true;
+#endif
+};
+
+#endif // FILE_FOLLOW_HPP
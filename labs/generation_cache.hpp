@@ -0,0 +1,60 @@
+#ifndef GENERATION_CACHE_HPP
+#define GENERATION_CACHE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Rendered responses kept until the generation they were built from moves on.
+// Bodies are shared, so a hit copies a pointer and not the text. Thread safe;
+// two requests missing at once may both build, the last one is kept.
+class GenerationCache {
+public:
+    using Body = std::shared_ptr<const std::string>;
+
+    Body get(const std::string& key, uint64_t generation, const std::function<std::string()>& build) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end() && it->second.generation == generation) {
+                hitCount++;
+                return it->second.body;
+            }
+        }
+        // built outside the lock, builders read files
+        Body body = std::make_shared<const std::string>(build());
+        std::lock_guard<std::mutex> lock(mutex);
+        missCount++;
+        entries[key] = Entry{ generation, body };
+        return body;
+    }
+
+    void erase(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.erase(key);
+    }
+
+    uint64_t hits() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hitCount;
+    }
+    uint64_t misses() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return missCount;
+    }
+
+private:
+    struct Entry {
+        uint64_t generation;
+        Body body;
+    };
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+#endif // GENERATION_CACHE_HPP
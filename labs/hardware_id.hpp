@@ -0,0 +1,355 @@
+#ifndef HARDWARE_ID_HPP
+#define HARDWARE_ID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Fields of a Windows hardware or instance ID, e.g.
+//   PCI\VEN_8086&DEV_A370&SUBSYS_00748086&REV_10\3&11583659&0&A3
+//   USB\VID_046D&PID_C077&MI_01\7&2A5C0F4&0&0001
+//   \\?\hid#vid_046d&pid_c077#7&1234abcd&0&0000#{4d1e55b2-f16f-11cf-88cb-001111000030}
+enum class HardwareIdField : uint16_t {
+    Vendor = 1 << 0,        // VEN_, PCI
+    Device = 1 << 1,        // DEV_
+    Subsystem = 1 << 2,     // SUBSYS_, device then vendor
+    Revision = 1 << 3,      // REV_, 2 digits on PCI, 4 on USB
+    ClassCode = 1 << 4,     // CC_, base class, sub class, interface
+    UsbVendor = 1 << 5,     // VID_
+    UsbProduct = 1 << 6,    // PID_
+    Interface = 1 << 7,     // MI_
+};
+
+// Parsed in place: the views point into the parsed text, so it has to outlive
+// them. Keys are matched without regard to case (device interface paths are
+// lower case), a field with malformed digits is left unset.
+template <typename Char>
+struct BasicHardwareId {
+    std::basic_string_view<Char> enumerator;    // "PCI", "USB", "HID", "USBSTOR"
+    std::basic_string_view<Char> device;        // "VEN_8086&DEV_A370&..."
+    std::basic_string_view<Char> instance;      // after the device part, empty in hardware IDs
+    uint16_t fields = 0;
+    uint16_t vendorId = 0;
+    uint16_t deviceId = 0;
+    uint16_t subsystemVendorId = 0;
+    uint16_t subsystemDeviceId = 0;
+    uint16_t revision = 0;
+    uint32_t classCode = 0;     // always 24 bits, CC_0C is 0x0C0000
+    uint8_t classDigits = 0;    // 2, 4 or 6: how much of classCode was given
+    uint16_t usbVendorId = 0;
+    uint16_t usbProductId = 0;
+    uint8_t interfaceNumber = 0;
+
+    bool has(HardwareIdField field) const { return (fields & (uint16_t)field) != 0; }
+
+    // names in upper case; "USB" matches USB\..., not USBSTOR\...
+    bool enumeratorIs(std::string_view name) const {
+        if (enumerator.size() != name.size()) return false;
+        for (size_t i = 0; i < name.size(); i++) {
+            if (hardwareIdUpper(enumerator[i]) != (unsigned char)name[i]) return false;
+        }
+        return true;
+    }
+    bool enumeratorStartsWith(std::string_view prefix) const {
+        if (enumerator.size() < prefix.size()) return false;
+        for (size_t i = 0; i < prefix.size(); i++) {
+            if (hardwareIdUpper(enumerator[i]) != (unsigned char)prefix[i]) return false;
+        }
+        return true;
+    }
+    bool deviceContains(std::string_view text) const {
+        for (size_t start = 0; start + text.size() <= device.size(); start++) {
+            size_t i = 0;
+            while (i < text.size() && hardwareIdUpper(device[start + i]) == (unsigned char)text[i]) i++;
+            if (i == text.size()) return true;
+        }
+        return false;
+    }
+
+    template <typename C>
+    static unsigned hardwareIdUpper(C c) {
+        unsigned value = (unsigned)c;
+        return value >= 'a' && value <= 'z' ? value - 32 : value;
+    }
+};
+
+using HardwareId = BasicHardwareId<char>;
+using WideHardwareId = BasicHardwareId<wchar_t>;
+
+namespace hardware_id_detail {
+
+template <typename Char>
+inline int hexDigit(Char c) {
+    unsigned value = (unsigned)c;
+    if (value >= '0' && value <= '9') return (int)(value - '0');
+    value |= 0x20;
+    if (value >= 'a' && value <= 'f') return (int)(value - 'a' + 10);
+    return -1;
+}
+
+// the whole of text as hex, minDigits..maxDigits long
+template <typename Char>
+inline bool parseHex(std::basic_string_view<Char> text, size_t minDigits, size_t maxDigits, uint32_t& value) {
+    if (text.size() < minDigits || text.size() > maxDigits) return false;
+    value = 0;
+    for (Char c : text) {
+        int digit = hexDigit(c);
+        if (digit < 0) return false;
+        value = value << 4 | (uint32_t)digit;
+    }
+    return true;
+}
+
+template <typename Char>
+inline bool isSeparator(Char c) {
+    return c == Char('\\') || c == Char('#');
+}
+
+// device interface paths start with \\?\ (or \??\ in the kernel)
+template <typename Char>
+inline std::basic_string_view<Char> withoutPathPrefix(std::basic_string_view<Char> text) {
+    if (text.size() >= 4 && text[0] == Char('\\') && (text[1] == Char('\\') || text[1] == Char('?')) &&
+        (text[2] == Char('?') || text[2] == Char('.')) && text[3] == Char('\\')) {
+        text.remove_prefix(4);
+    }
+    return text;
+}
+
+// the instance part, which starts after the separator at `i`
+template <typename Char>
+inline std::basic_string_view<Char> instanceAfter(std::basic_string_view<Char> text, size_t i) {
+    if (i >= text.size()) return {};
+    size_t start = ++i;
+    while (i < text.size() && !isSeparator(text[i])) i++;
+    return text.substr(start, i - start);
+}
+
+constexpr uint64_t packKey(const char* name) {
+    uint64_t key = 0;
+    for (; *name; name++) key = key << 8 | (unsigned char)*name;
+    return key;
+}
+
+// one KEY_value token of the device part; the key is packed into an integer,
+// upper case, so that matching it is a switch
+template <typename Char>
+inline void parseToken(std::basic_string_view<Char> token, BasicHardwareId<Char>& id) {
+    uint64_t key = 0;
+    size_t i = 0;
+    for (; i < token.size() && token[i] != Char('_'); i++) {
+        unsigned c = BasicHardwareId<Char>::hardwareIdUpper(token[i]);
+        if (i == 6 || c > 0x7F) return;
+        key = key << 8 | c;
+    }
+    if (i == token.size()) return;
+    std::basic_string_view<Char> text = token.substr(i + 1);
+    uint32_t value;
+    switch (key) {
+    case packKey("CC"):
+        if ((text.size() % 2) == 0 && parseHex(text, 2, 6, value)) {
+            id.classCode = value << (4 * (6 - text.size()));
+            id.classDigits = (uint8_t)text.size();
+            id.fields |= (uint16_t)HardwareIdField::ClassCode;
+        }
+        break;
+    case packKey("MI"):
+        if (parseHex(text, 2, 2, value)) {
+            id.interfaceNumber = (uint8_t)value;
+            id.fields |= (uint16_t)HardwareIdField::Interface;
+        }
+        break;
+    case packKey("REV"):
+        if (parseHex(text, 2, 4, value)) {
+            id.revision = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::Revision;
+        }
+        break;
+    case packKey("VEN"):
+        if (parseHex(text, 4, 4, value)) {
+            id.vendorId = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::Vendor;
+        }
+        break;
+    case packKey("DEV"):
+        if (parseHex(text, 4, 4, value)) {
+            id.deviceId = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::Device;
+        }
+        break;
+    case packKey("VID"):
+        if (parseHex(text, 4, 4, value)) {
+            id.usbVendorId = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::UsbVendor;
+        }
+        break;
+    case packKey("PID"):
+        if (parseHex(text, 4, 4, value)) {
+            id.usbProductId = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::UsbProduct;
+        }
+        break;
+    case packKey("SUBSYS"):
+        if (parseHex(text, 8, 8, value)) {
+            id.subsystemDeviceId = (uint16_t)(value >> 16);
+            id.subsystemVendorId = (uint16_t)value;
+            id.fields |= (uint16_t)HardwareIdField::Subsystem;
+        }
+        break;
+    }
+}
+
+} // namespace hardware_id_detail
+
+// One ID, in one pass and without allocating. Returns false if no field was found.
+template <typename Char>
+inline bool parseHardwareId(std::basic_string_view<Char> text, BasicHardwareId<Char>& id) {
+    using namespace hardware_id_detail;
+    id = BasicHardwareId<Char>();
+    text = withoutPathPrefix(text);
+    // enumerator \ device & tokens \ instance; interface paths use # and add #{class GUID}
+    const size_t length = text.size();
+    size_t i = 0;
+    while (i < length && !isSeparator(text[i])) i++;
+    id.enumerator = text.substr(0, i);
+    if (i == length) return false;
+    size_t start = ++i;
+    size_t tokenStart = start;
+    for (; i < length; i++) {
+        Char c = text[i];
+        if (c == Char('&')) {
+            parseToken(text.substr(tokenStart, i - tokenStart), id);
+            tokenStart = i + 1;
+        } else if (isSeparator(c)) {
+            break;
+        }
+    }
+    parseToken(text.substr(tokenStart, i - tokenStart), id);
+    id.device = text.substr(start, i - start);
+    id.instance = instanceAfter(text, i);
+    return id.fields != 0;
+}
+
+template <typename Char>
+inline bool parseHardwareId(const Char* text, BasicHardwareId<Char>& id) {
+    return parseHardwareId(std::basic_string_view<Char>(text), id);
+}
+
+// Only the enumerator, the device part and the USB VID_ and PID_ fields,
+// for callers that need nothing else (lab_05's device lists and arrival
+// paths); the instance is left empty. The same rules as parseHardwareId for
+// those two, but a VID_/PID_ token is checked where it starts and its four
+// digits are read in place, and the other tokens are only skipped.
+template <typename Char>
+inline bool parseUsbHardwareId(std::basic_string_view<Char> text, BasicHardwareId<Char>& id) {
+    using namespace hardware_id_detail;
+    using Id = BasicHardwareId<Char>;
+    id = Id();
+    text = withoutPathPrefix(text);
+    const Char* data = text.data();
+    const size_t length = text.size();
+    size_t i = 0;
+    while (i < length && !isSeparator(data[i])) i++;
+    id.enumerator = text.substr(0, i);
+    if (i == length) return false;
+    const size_t start = ++i;
+    // the device part ends at the first separator, found with memchr (wmemchr)
+    auto find = [data](size_t from, size_t to, Char c) -> size_t {
+        const Char* found = from < to ? std::char_traits<Char>::find(data + from, to - from, c) : nullptr;
+        return found ? (size_t)(found - data) : to;
+    };
+    const size_t end = find(start, find(start, length, Char('\\')), Char('#'));
+    uint16_t fields = 0;
+    uint16_t vendorId = 0, productId = 0;
+    while (i < end) {
+        // i is at the start of a token: VID_xxxx or PID_xxxx, exactly
+        unsigned key = Id::hardwareIdUpper(data[i]);
+        int d0 = -1, d1 = -1, d2 = -1, d3 = -1;
+        if (end - i >= 8 && (key == 'V' || key == 'P') && Id::hardwareIdUpper(data[i + 1]) == 'I' &&
+            Id::hardwareIdUpper(data[i + 2]) == 'D' && data[i + 3] == Char('_') &&
+            (end - i == 8 || data[i + 8] == Char('&'))) {
+            d0 = hexDigit(data[i + 4]);
+            d1 = hexDigit(data[i + 5]);
+            d2 = hexDigit(data[i + 6]);
+            d3 = hexDigit(data[i + 7]);
+        }
+        if ((d0 | d1 | d2 | d3) >= 0) {
+            uint16_t value = (uint16_t)(d0 << 12 | d1 << 8 | d2 << 4 | d3);
+            if (key == 'V') {
+                vendorId = value;
+                fields |= (uint16_t)HardwareIdField::UsbVendor;
+            } else {
+                productId = value;
+                fields |= (uint16_t)HardwareIdField::UsbProduct;
+            }
+            i += 9;
+        } else {
+            // tokens are short, a call costs more than looking at them
+            while (i < end && data[i] != Char('&')) i++;
+            i++;
+        }
+    }
+    id.device = text.substr(start, end - start);
+    id.fields = fields;
+    id.usbVendorId = vendorId;
+    id.usbProductId = productId;
+    return fields != 0;
+}
+
+namespace hardware_id_detail {
+
+// the list walk and merge of parseHardwareIdList, with `parse` for each ID
+template <typename Char, typename Parse>
+inline bool parseList(const Char* list, size_t length, BasicHardwareId<Char>& id, Parse parse) {
+    id = BasicHardwareId<Char>();
+    BasicHardwareId<Char> entry;
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (list[i] != Char(0)) continue;
+        if (i == start) break;      // the empty string ends the list
+        parse(std::basic_string_view<Char>(list + start, i - start), entry);
+        if (start == 0) {
+            id = entry;
+        } else {
+            uint16_t missing = entry.fields & ~id.fields;
+            if (missing & (uint16_t)HardwareIdField::Vendor) id.vendorId = entry.vendorId;
+            if (missing & (uint16_t)HardwareIdField::Device) id.deviceId = entry.deviceId;
+            if (missing & (uint16_t)HardwareIdField::Subsystem) {
+                id.subsystemVendorId = entry.subsystemVendorId;
+                id.subsystemDeviceId = entry.subsystemDeviceId;
+            }
+            if (missing & (uint16_t)HardwareIdField::Revision) id.revision = entry.revision;
+            if (missing & (uint16_t)HardwareIdField::UsbVendor) id.usbVendorId = entry.usbVendorId;
+            if (missing & (uint16_t)HardwareIdField::UsbProduct) id.usbProductId = entry.usbProductId;
+            if (missing & (uint16_t)HardwareIdField::Interface) id.interfaceNumber = entry.interfaceNumber;
+            if (entry.classDigits > id.classDigits) {
+                id.classCode = entry.classCode;
+                id.classDigits = entry.classDigits;
+            }
+            id.fields |= entry.fields;
+        }
+        start = i + 1;
+    }
+    return id.fields != 0;
+}
+
+} // namespace hardware_id_detail
+
+// A REG_MULTI_SZ list (SPDRP_HARDWAREID, SPDRP_COMPATIBLEIDS) of at most
+// `length` characters. Views come from the first ID; a field takes the value
+// of the first ID that has it, the class code the most specific one.
+template <typename Char>
+inline bool parseHardwareIdList(const Char* list, size_t length, BasicHardwareId<Char>& id) {
+    return hardware_id_detail::parseList(list, length, id, [](std::basic_string_view<Char> text, BasicHardwareId<Char>& entry) {
+        parseHardwareId(text, entry);
+    });
+}
+
+// the same with parseUsbHardwareId, for USB VID/PID only
+template <typename Char>
+inline bool parseUsbHardwareIdList(const Char* list, size_t length, BasicHardwareId<Char>& id) {
+    return hardware_id_detail::parseList(list, length, id, [](std::basic_string_view<Char> text, BasicHardwareId<Char>& entry) {
+        parseUsbHardwareId(text, entry);
+    });
+}
+
+#endif // HARDWARE_ID_HPP
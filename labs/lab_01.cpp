@@ -1,27 +1,30 @@
 #include "./lab_01.hpp"
-#include <windows.h>
-#include <powrprof.h>
 #include <iostream>
 #include <string>
-#include <setupapi.h>
-#include <batclass.h>  // For battery IOCTLs
-#include <initguid.h>
-#include <devguid.h>   // For GUID_DEVCLASS_BATTERY
 #include <sstream>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include "battery_source.hpp"
+#include "timer_slack.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#include <powrprof.h>
+#endif
 // }
 // bool EnterSleep(bool hibernate) {
 //     return SetSuspendState(hibernate, FALSE, FALSE) != 0;
 // }
 
-std::string batteryFlagToString(BYTE flag) {
+std::string batteryFlagToString(uint8_t flag) {
     std::string result;
 
-    if (flag == 255) return "Unknown status";
-    if (flag & 128) result += "No system battery; ";
-    if (flag & 8) result += "Charging; ";
-    if (flag & 4) result += "Critical (less than 5%); ";
-    if (flag & 2) result += "Low (less than 33%); ";
-    if (flag & 1) result += "High (more than 66%); ";
+    if (flag == BatteryFlagUnknown) return "Unknown status";
+    if (flag & BatteryFlagNoSystemBattery) result += "No system battery; ";
+    if (flag & BatteryFlagCharging) result += "Charging; ";
+    if (flag & BatteryFlagCritical) result += "Critical (less than 5%); ";
+    if (flag & BatteryFlagLow) result += "Low (less than 33%); ";
+    if (flag & BatteryFlagHigh) result += "High (more than 66%); ";
     if (flag == 0) result = "Battery status normal";
 
     if (result.empty())
@@ -32,11 +35,80 @@ std::string batteryFlagToString(BYTE flag) {
     return result;
 }
 
+std::string acLineStatusToString(AcLineStatus acLine) {
+    if (acLine == AcLineStatus::Online){
+        return "Online";
+    }
+    else if (acLine == AcLineStatus::Offline)
+    {
+        return "Ofline";
+    }
+    return "Unknown" + std::to_string((int)acLine);
+}
+
+double BatteryInfo::wearLevel() const {
+    if (designedCapacity <= 0 || fullChargedCapacity < 0) return -1;
+    // a new battery can hold a bit more than designed, that is no wear
+    return std::max(0.0, 1.0 - (double)fullChargedCapacity / designedCapacity);
+}
+
+BatteryFleetStats BatterySnapshot::fleetStats() const {
+    BatteryFleetStats stats;
+    stats.batteries = batteryCount;
+    int64_t designed = 0, full = 0, cycles = 0;
+    int withCapacity = 0, withCycles = 0;
+    for (int i = 0; i < batteryCount; i++) {
+        const BatteryInfo& battery = batteries[i];
+        if (battery.designedCapacity > 0 && battery.fullChargedCapacity >= 0) {
+            designed += battery.designedCapacity;
+            full += battery.fullChargedCapacity;
+            withCapacity++;
+        }
+        if (battery.cycleCount >= 0) {
+            cycles += battery.cycleCount;
+            withCycles++;
+        }
+    }
+    if (withCapacity > 0) {
+        stats.designedCapacity = designed;
+        stats.fullChargedCapacity = full;
+        stats.wearLevel = std::max(0.0, 1.0 - (double)full / designed);
+    }
+    if (withCycles > 0) {
+        stats.meanCycleCount = (double)cycles / withCycles;
+    }
+    return stats;
+}
+
+static uint64_t unixTimeMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string batteryInfoToString(const BatterySnapshot& snapshot) {
+    std::stringstream ss;
+    for (int i = 0; i < snapshot.batteryCount; i++) {
+        const BatteryInfo& battery = snapshot.batteries[i];
+        ss << "Found Battery " << i << ": " << battery.name << "\n";
+        if (!battery.queried) {
+            ss << "  Failed to query battery information.\n";
+            continue;
+        }
+        ss << "  Chemistry: " << (battery.chemistry[0] ? battery.chemistry : "Unknown") << "\n";
+        ss << "  Designed Capacity: " << (battery.designedCapacity == -1 ? "Unknown" : std::to_string(battery.designedCapacity)) << "\n";
+        ss << "  Full Charged Capacity: " << (battery.fullChargedCapacity == -1 ? "Unknown" : std::to_string(battery.fullChargedCapacity)) << "\n";
+        ss << "  Cycle Count: " << (battery.cycleCount == -1 ? "Unknown" : std::to_string(battery.cycleCount)) << "\n";
+    }
+    if (ss.str().empty()) {
+        ss << "No batteries found or could not be queried.\n";
+    }
+    return ss.str();
+}
+
 std::string batteryMonitor::getStatus(){
-    SYSTEM_POWER_STATUS status;
-    if (GetSystemPowerStatus(&status)){
-        std::string batteryFlag = batteryFlagToString(status.BatteryFlag);
-        return batteryFlag;
+    PowerStatus power = published.load().power;
+    if (power.valid){
+        return batteryFlagToString(power.batteryFlags);
     }
     else {
         return "Error";
@@ -44,37 +116,20 @@ std::string batteryMonitor::getStatus(){
 }
 
 std::string batteryMonitor::getPowerMode(){
-    SYSTEM_POWER_STATUS status;
-    if (GetSystemPowerStatus(&status)) {
-        std::string acLineStatus;
-        if ((int)status.ACLineStatus == 1){
-            acLineStatus = "Online";
-        }
-        else if ((int)status.ACLineStatus == 0)
-        {
-            acLineStatus = "Ofline";
-        }
-        else {
-            acLineStatus = "Unknown" + std::to_string((int)status.ACLineStatus);
-        }
-        
-        return acLineStatus;
+    PowerStatus power = published.load().power;
+    if (power.valid) {
+        return acLineStatusToString(power.acLine);
     } else {
         return "Failed to get power status.";
     }
 }
 
 int batteryMonitor::getCharge(){
-    // returns charge in percents
-    SYSTEM_POWER_STATUS status;
-    if (GetSystemPowerStatus(&status)){
-        return (int)status.BatteryLifePercent;
-    }
-    else {
-        return 255;
-    }
+    // returns charge in percents, 255 if unknown
+    return published.load().power.charge;
 }
 
+#ifdef _WIN32
 int batteryMonitor::sleep(){
     return SetSuspendState(false, false, false) != 0;
 }
@@ -82,135 +137,131 @@ int batteryMonitor::sleep(){
 int batteryMonitor::hibernate(){
     return SetSuspendState(true, false, false) != 0;
 }
+#else
+// needs the rights to write /sys/power/state
+static int writePowerState(const char* state) {
+    std::ofstream file("/sys/power/state");
+    file << state;
+    file.flush();
+    return file.good() ? 1 : 0;
+}
+
+int batteryMonitor::sleep(){
+    return writePowerState("mem");
+}
+
+int batteryMonitor::hibernate(){
+    return writePowerState("disk");
+}
+#endif
 
 int batteryMonitor::getTimeLeft(){
-    SYSTEM_POWER_STATUS sps;
-    if (GetSystemPowerStatus(&sps)) {
-        return (int)sps.BatteryLifeTime;
-    } else {
-        return -1;
-    }
+    return published.load().power.timeLeft;
 }
 
 std::string batteryMonitor::isEco() {
-    SYSTEM_POWER_STATUS sps;
-    // GetSystemPowerStatus returns a non-zero value on success.
-    if (GetSystemPowerStatus(&sps)) {
-        // According to documentation, SystemStatusFlag is 1 if battery saver is on.
-        if (sps.SystemStatusFlag == 1) {
-            return "On";
-        }
-    }
-    // If the function fails or the flag is not set, it's off.
-    return "Off";
+    // If the query failed or the flag is not set, it's off.
+    return published.load().power.eco ? "On" : "Off";
 }
 
+std::string batteryMonitor::getBatteryInfo() {
+    return batteryInfoToString(published.load());
+}
 
-batteryMonitor::batteryMonitor(){
 
+batteryMonitor::batteryMonitor()
+    : batteryMonitor(std::make_unique<SystemBatterySource>()) {
 }
 
+batteryMonitor::batteryMonitor(std::unique_ptr<BatterySource> source)
+    : source(std::move(source)) {
+}
 
-std::string batteryMonitor::getBatteryInfo() {
-    std::stringstream ss;
-    GUID batteryClassGuid = GUID_DEVCLASS_BATTERY;
+batteryMonitor::~batteryMonitor(){
+    stopSampler();
+}
+
+BatterySnapshot batteryMonitor::getSnapshot() const {
+    return published.load();
+}
+
+const char* batteryMonitor::getSourceName() const {
+    return source->name();
+}
 
-    HDEVINFO deviceInfoSet = SetupDiGetClassDevs(&batteryClassGuid, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
-    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
-        ss << "Failed to get device info set\n";
-        return ss.str();
+// The only place that talks to the OS (through the source)
+bool batteryMonitor::sample(BatterySnapshot& snapshot) {
+    auto started = std::chrono::steady_clock::now();
+    snapshot = BatterySnapshot();
+    snapshot.sampledAtMs = unixTimeMs();
+    if (!source->sample(snapshot)) {
+        return false;
     }
+    snapshot.sampleDurationUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    return true;
+}
 
-    SP_DEVICE_INTERFACE_DATA deviceInterfaceData = {0};
-    deviceInterfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+void batteryMonitor::publish(const BatterySnapshot& snapshot) {
+    published.store(snapshot);
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    for (auto& listener : listeners) {
+        listener(snapshot);
+    }
+}
 
-    for (DWORD i = 0; ; i++) {
-        if (!SetupDiEnumDeviceInterfaces(deviceInfoSet, NULL, &batteryClassGuid, i, &deviceInterfaceData)) {
-            if (GetLastError() == ERROR_NO_MORE_ITEMS) {
-                // This is the normal exit condition for the loop.
-                break;
-            }
-            // An unexpected error occurred.
-            break;
-        }
+void batteryMonitor::addSampleListener(std::function<void(const BatterySnapshot&)> listener) {
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    listeners.push_back(std::move(listener));
+}
 
-        DWORD requiredSize = 0;
-        SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &deviceInterfaceData, NULL, 0, &requiredSize, NULL);
-        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
-            ss << "Failed to get required size for device interface detail\n";
-            continue;
+void batteryMonitor::samplerLoop() {
+    BatterySnapshot snapshot;
+    while (samplerRunning) {
+        source->waitNext(getSamplerPeriod());
+        if (!samplerRunning) break;
+        adoptTimerSlack();
+        if (!sample(snapshot)) {
+            // a replay ran out of samples
+            samplerRunning = false;
+            break;
         }
+        publish(snapshot);
+    }
+}
 
-        PSP_DEVICE_INTERFACE_DETAIL_DATA deviceDetailData = (PSP_DEVICE_INTERFACE_DETAIL_DATA)malloc(requiredSize);
-        if (deviceDetailData == NULL) {
-            ss << "Failed to allocate memory for device detail data\n";
-            continue;
-        }
-        deviceDetailData->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
-
-        if (SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &deviceInterfaceData, deviceDetailData, requiredSize, NULL, NULL)) {
-            ss << "Found Battery " << i << ": " << deviceDetailData->DevicePath << "\n";
-            HANDLE batteryHandle = CreateFile(deviceDetailData->DevicePath,
-                                              GENERIC_READ | GENERIC_WRITE,
-                                              FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                              NULL, OPEN_EXISTING,
-                                              FILE_ATTRIBUTE_NORMAL, NULL);
-
-            if (batteryHandle != INVALID_HANDLE_VALUE) {
-                DWORD returned;
-                ULONG batteryTag = 0;
-                BATTERY_QUERY_INFORMATION bqi = {0};
-
-                if (!DeviceIoControl(batteryHandle, IOCTL_BATTERY_QUERY_TAG,
-                                     NULL, 0,
-                                     &bqi.BatteryTag, sizeof(bqi.BatteryTag),
-                                     &returned, NULL) || bqi.BatteryTag == 0) {
-                    ss << "  Failed to get a valid battery tag.\n";
-                    CloseHandle(batteryHandle);
-                    free(deviceDetailData);
-                    continue;
-                }
-                
-                bqi.InformationLevel = BatteryInformation;
-
-                BATTERY_INFORMATION batteryInfo = {0};
-                if (!DeviceIoControl(batteryHandle, IOCTL_BATTERY_QUERY_INFORMATION,
-                                     &bqi, sizeof(bqi),
-                                     &batteryInfo, sizeof(batteryInfo),
-                                     &returned, NULL)) {
-                    
-                    // **** THIS IS THE CRITICAL CHANGE ****
-                    DWORD errorCode = GetLastError();
-                    LPSTR messageBuffer = nullptr;
-                    size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-                                                 NULL, errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, NULL);
-                    
-                    ss << "  Failed to query battery information. Error " << errorCode << ": " << messageBuffer << "\n";
-                    
-                    // Free the buffer allocated by FormatMessageA.
-                    LocalFree(messageBuffer);
-
-                } else {
-                    char chemistry[5] = {0};
-                    memcpy(chemistry, &batteryInfo.Chemistry, 4);
-
-                    ss << "  Chemistry: " << chemistry << "\n";
-                    ss << "  Designed Capacity: " << (batteryInfo.DesignedCapacity == -1 ? "Unknown" : std::to_string(batteryInfo.DesignedCapacity)) << "\n";
-                    ss << "  Full Charged Capacity: " << (batteryInfo.FullChargedCapacity == -1 ? "Unknown" : std::to_string(batteryInfo.FullChargedCapacity)) << "\n";
-                    ss << "  Cycle Count: " << (batteryInfo.CycleCount == -1 ? "Unknown" : std::to_string(batteryInfo.CycleCount)) << "\n";
-                }
-
-                CloseHandle(batteryHandle);
-            } else {
-                ss << "  Failed to open battery device handle.\n";
-            }
-        }
-        free(deviceDetailData);
+void batteryMonitor::startSampler(std::chrono::milliseconds period) {
+    setSamplerPeriod(period);
+    if (samplerRunning.exchange(true)) {
+        return;
+    }
+    // the previous loop may have ended on its own
+    if (samplerThread.joinable()) {
+        samplerThread.join();
     }
+    // publish the first sample before anyone can ask for it
+    BatterySnapshot snapshot;
+    if (!sample(snapshot)) {
+        samplerRunning = false;
+        return;
+    }
+    publish(snapshot);
+    samplerThread = std::thread(&batteryMonitor::samplerLoop, this);
+}
 
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
-    if (ss.str().empty()) {
-        ss << "No batteries found or could not be queried.\n";
+void batteryMonitor::stopSampler() {
+    samplerRunning = false;
+    source->wake();
+    if (samplerThread.joinable()) {
+        samplerThread.join();
     }
-    return ss.str();
-}
\ No newline at end of file
+}
+
+// takes effect after the current wait
+void batteryMonitor::setSamplerPeriod(std::chrono::milliseconds period) {
+    periodMs = period.count() > 0 ? period.count() : 1;
+}
+
+std::chrono::milliseconds batteryMonitor::getSamplerPeriod() const {
+    return std::chrono::milliseconds(periodMs.load());
+}
@@ -2,10 +2,103 @@
 #define LAB_02
 
 #include <string>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <memory>
+#include "seqlock.hpp"
+
+class BatterySource;
+
+static const int kMaxBatteries = 4;
+
+// SYSTEM_POWER_STATUS::ACLineStatus
+enum class AcLineStatus : uint8_t {
+    Offline = 0,
+    Online = 1,
+    Unknown = 255,
+};
+
+// SYSTEM_POWER_STATUS::BatteryFlag bits; 0 is "normal", 255 alone is "unknown"
+enum BatteryFlag : uint8_t {
+    BatteryFlagHigh = 1,            // more than 66%
+    BatteryFlagLow = 2,             // less than 33%
+    BatteryFlagCritical = 4,        // less than 5%
+    BatteryFlagCharging = 8,
+    BatteryFlagNoSystemBattery = 128,
+    BatteryFlagUnknown = 255,
+};
+
+// The system-wide part of a sample, one GetSystemPowerStatus call
+struct PowerStatus {
+    bool valid = false;             // false if the power status query failed
+    uint8_t charge = 255;           // percents, 255 - unknown
+    uint8_t batteryFlags = BatteryFlagUnknown;
+    AcLineStatus acLine = AcLineStatus::Unknown;
+    int32_t timeLeft = -1;          // seconds, -1 - unknown
+    bool eco = false;               // battery saver
+
+    bool chargeKnown() const { return charge <= 100; }
+    bool flagsKnown() const { return batteryFlags != BatteryFlagUnknown; }
+    bool hasFlag(BatteryFlag flag) const { return flagsKnown() && (batteryFlags & flag) != 0; }
+    bool operator==(const PowerStatus&) const = default;
+};
+
+// One battery device as reported by IOCTL_BATTERY_QUERY_INFORMATION
+// (or the power_supply class on Linux). Capacities are in mWh, -1 - unknown.
+struct BatteryInfo {
+    char name[48] = {0};            // "Battery 0" / "BAT0"
+    uint32_t tag = 0;               // battery tag, changes when the battery is swapped
+    bool queried = false;           // false if the information query failed
+    char chemistry[5] = {0};        // e.g. "LION"
+    int32_t designedCapacity = -1;
+    int32_t fullChargedCapacity = -1;
+    int32_t cycleCount = -1;
+
+    // 0 - as designed, 0.2 - lost a fifth of its capacity, -1 - unknown
+    double wearLevel() const;
+    bool operator==(const BatteryInfo&) const = default;
+};
+
+// Totals over all batteries of a sample, -1 where nothing is known
+struct BatteryFleetStats {
+    int batteries = 0;
+    int64_t designedCapacity = -1;      // mWh
+    int64_t fullChargedCapacity = -1;   // mWh, of the batteries with a known design capacity
+    double wearLevel = -1;              // capacity-weighted
+    double meanCycleCount = -1;
+};
+
+// Everything the lab01 dashboard shows, taken in one sampler tick.
+// Kept trivially copyable so the sampler can publish it through a seqlock.
+struct BatterySnapshot {
+    uint64_t sampledAtMs = 0;       // unix time in milliseconds
+    uint32_t sampleDurationUs = 0;  // how long the OS queries took
+    PowerStatus power;
+    int batteryCount = 0;
+    BatteryInfo batteries[kMaxBatteries];
+
+    BatteryFleetStats fleetStats() const;
+};
+
+// Text formatters behind the old per-field endpoints
+std::string batteryFlagToString(uint8_t flags);
+std::string acLineStatusToString(AcLineStatus acLine);
+// the text /getInfo has always returned, built from the battery records
+std::string batteryInfoToString(const BatterySnapshot& snapshot);
 
 class batteryMonitor{
     public:
+    // samples the machine's own batteries
     batteryMonitor();
+    // samples from source instead, e.g. a ReplayBatterySource
+    explicit batteryMonitor(std::unique_ptr<BatterySource> source);
+    ~batteryMonitor();
     std::string getStatus();
     int getCharge();
     std::string getPowerMode();
@@ -14,8 +107,34 @@ class batteryMonitor{
     // info as a string
     std::string getBatteryInfo();
     // time in seconds
-    int getTimeLeft(); 
+    int getTimeLeft();
     std::string isEco();
+
+    // All OS queries happen on the sampler thread, the getters above and
+    // getSnapshot() only read the last published sample (no syscalls, no locks).
+    void startSampler(std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+    void stopSampler();
+    void setSamplerPeriod(std::chrono::milliseconds period);
+    std::chrono::milliseconds getSamplerPeriod() const;
+    BatterySnapshot getSnapshot() const;
+    // false once stopped or when the source ran out of samples
+    bool isSamplerRunning() const { return samplerRunning; }
+    const char* getSourceName() const;
+    // Called on the sampler thread right after every published sample
+    void addSampleListener(std::function<void(const BatterySnapshot&)> listener);
+
+    private:
+    bool sample(BatterySnapshot& snapshot);
+    void publish(const BatterySnapshot& snapshot);
+    void samplerLoop();
+
+    std::unique_ptr<BatterySource> source;
+    Seqlock<BatterySnapshot> published;
+    std::atomic<int64_t> periodMs{1000};
+    std::atomic<bool> samplerRunning{false};
+    std::thread samplerThread;
+    std::mutex listenersMutex;
+    std::vector<std::function<void(const BatterySnapshot&)>> listeners;
 };
 
 #endif // LAB_02
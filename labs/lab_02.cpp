@@ -1,45 +1,86 @@
 #include "./lab_02.hpp"
 
-#include "pci_codes.h"
+#include "pci_vendors.hpp"
+#include "pci_ids.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#ifdef _WIN32
 #include <windows.h>
 #include <setupapi.h>
 #include <cfgmgr32.h>
-
-
+#include "hardware_id.hpp"
+#elif defined(__linux__)
+#include <memory>
+#include "pci_sysfs.hpp"
+#endif
 
 std::string find_vendor_name(unsigned short id) {
-    int n = sizeof(PciVenTable) / sizeof(PciVenTable[0]);
-    for (int i = 0; i < n; i++) {
-        if (PciVenTable[i].VenId == id) {
-            return PciVenTable[i].VenFull;
-        }
+    // pci.ids is more complete when there is one, the built-in table otherwise
+    std::string_view name = PciIdsDatabase::system().vendorName(id);
+    if (!name.empty()) {
+        return std::string(name);
     }
-    return "Unknown Vendor [" + id + std::string("]");
+    const PCI_VENTABLE* vendor = PciVendors.find(id);
+    if (vendor) {
+        return vendor->VenFull;
+    }
+    char unknown[32];
+    snprintf(unknown, sizeof(unknown), "Unknown Vendor [%04X]", id);
+    return unknown;
 }
 
-static std::pair<std::string, std::string> ExtractVidDid(const std::wstring& hardwareId) {
-    std::string vid;
-    std::string did;
-
-    std::wstring firstId = hardwareId.c_str();
-    std::string hardwareIdStr(firstId.begin(), firstId.end());
-    size_t venPos = hardwareIdStr.find("VEN_");
-    if (venPos != std::string::npos) {
-        vid = hardwareIdStr.substr(venPos + 4, 4);
+static void resolveNames(std::vector<PciDeviceRecord>& devices) {
+    PciIdsDatabase& database = PciIdsDatabase::system();
+    for (auto& device : devices) {
+        device.vendorName = find_vendor_name(device.vendorId);
+        device.deviceName = std::string(database.deviceName(device.vendorId, device.deviceId));
     }
-    vid = std::string("[") + vid + std::string("] ") + find_vendor_name((unsigned short)strtol(vid.c_str(), NULL, 16));
+}
 
-    size_t devPos = hardwareIdStr.find("DEV_");
-    if (devPos != std::string::npos) {
-        did = hardwareIdStr.substr(devPos + 4, 4);
+#ifdef _WIN32
+
+static void ExtractVidDid(const wchar_t* hardwareIds, size_t length, PciDeviceRecord& record) {
+    WideHardwareId id;
+    parseHardwareIdList(hardwareIds, length, id);
+    if (id.has(HardwareIdField::Vendor)) record.vendorId = id.vendorId;
+    if (id.has(HardwareIdField::Device)) record.deviceId = id.deviceId;
+    if (id.has(HardwareIdField::Subsystem)) {
+        record.subsystemVendorId = id.subsystemVendorId;
+        record.subsystemDeviceId = id.subsystemDeviceId;
     }
+    if (id.has(HardwareIdField::Revision)) record.revision = (uint8_t)id.revision;
+}
 
-    return {vid, did};
+// "0000:bb:dd.f" from the bus number and device << 16 | function, empty for
+// nodes the PCI bus driver did not enumerate (e.g. the root complex)
+static std::string PciAddressOf(DEVINST instance) {
+    wchar_t enumerator[32] = {0};
+    ULONG size = sizeof(enumerator);
+    if (CM_Get_DevNode_Registry_PropertyW(instance, CM_DRP_ENUMERATOR_NAME, NULL, enumerator, &size, 0) != CR_SUCCESS ||
+        wcscmp(enumerator, L"PCI") != 0) {
+        return std::string();
+    }
+    DWORD bus = 0, address = 0;
+    size = sizeof(bus);
+    if (CM_Get_DevNode_Registry_PropertyW(instance, CM_DRP_BUSNUMBER, NULL, &bus, &size, 0) != CR_SUCCESS) {
+        return std::string();
+    }
+    size = sizeof(address);
+    if (CM_Get_DevNode_Registry_PropertyW(instance, CM_DRP_ADDRESS, NULL, &address, &size, 0) != CR_SUCCESS) {
+        return std::string();
+    }
+    char text[16];
+    snprintf(text, sizeof(text), "0000:%02lx:%02lx.%lx",
+             (unsigned long)bus & 0xFF, (unsigned long)(address >> 16) & 0x1F, (unsigned long)address & 0x7);
+    return text;
 }
 
-std::vector<std::pair<std::string, std::string>> EnumeratePCIDevices()
+std::vector<PciDeviceRecord> EnumeratePCIDevices()
 {
-    std::vector<std::pair<std::string, std::string>> devices;
+    std::vector<PciDeviceRecord> devices;
     HDEVINFO deviceInfoSet = SetupDiGetClassDevsW(
         NULL,
         L"PCI",
@@ -53,11 +94,107 @@ std::vector<std::pair<std::string, std::string>> EnumeratePCIDevices()
     while (SetupDiEnumDeviceInfo(deviceInfoSet, deviceIndex, &deviceInfoData)) {
         wchar_t hardwareId[1024] = {0};
         if (SetupDiGetDeviceRegistryPropertyW(deviceInfoSet, &deviceInfoData, SPDRP_HARDWAREID, NULL, (PBYTE)hardwareId, sizeof(hardwareId), NULL)) {
-            devices.push_back(ExtractVidDid(hardwareId));
+            PciDeviceRecord record;
+            ExtractVidDid(hardwareId, sizeof(hardwareId) / sizeof(wchar_t), record);
+
+            // the class code is only in the compatible IDs ("PCI\CC_0C0330"),
+            // further down the list than the first one
+            wchar_t compatibleIds[1024] = {0};
+            if (SetupDiGetDeviceRegistryPropertyW(deviceInfoSet, &deviceInfoData, SPDRP_COMPATIBLEIDS, NULL, (PBYTE)compatibleIds, sizeof(compatibleIds), NULL)) {
+                WideHardwareId compatible;
+                parseHardwareIdList(compatibleIds, sizeof(compatibleIds) / sizeof(wchar_t), compatible);
+                if (compatible.has(HardwareIdField::ClassCode)) record.classCode = compatible.classCode;
+            }
+
+            wchar_t service[256] = {0};
+            if (SetupDiGetDeviceRegistryPropertyW(deviceInfoSet, &deviceInfoData, SPDRP_SERVICE, NULL, (PBYTE)service, sizeof(service), NULL)) {
+                std::wstring name(service);
+                record.driver = std::string(name.begin(), name.end());
+            }
+
+            record.address = PciAddressOf(deviceInfoData.DevInst);
+            DEVINST parent;
+            if (CM_Get_Parent(&parent, deviceInfoData.DevInst, 0) == CR_SUCCESS) {
+                record.parent = PciAddressOf(parent);
+            }
+            devices.push_back(std::move(record));
         }
         deviceIndex++;
     }
     SetupDiDestroyDeviceInfoList(deviceInfoSet);
 
+    std::stable_sort(devices.begin(), devices.end(), [](const PciDeviceRecord& a, const PciDeviceRecord& b) {
+        return a.address < b.address;
+    });
+    resolveNames(devices);
     return devices;
-}
\ No newline at end of file
+}
+
+void SetPciSysfsRoot(const std::string&) {}
+
+// config space is only reachable through a kernel driver on Windows
+size_t ReadPCIConfigSpace(const std::string&, uint8_t*, size_t) {
+    return 0;
+}
+
+int ReadPCIIommuGroup(const std::string&) {
+    return -1;
+}
+
+#elif defined(__linux__)
+
+static std::mutex enumeratorMutex;
+static std::string sysfsRoot = "/sys";
+static std::unique_ptr<SysfsPciEnumerator> enumerator;
+
+void SetPciSysfsRoot(const std::string& root) {
+    std::lock_guard<std::mutex> lock(enumeratorMutex);
+    sysfsRoot = root;
+    enumerator.reset();
+}
+
+std::vector<PciDeviceRecord> EnumeratePCIDevices()
+{
+    std::vector<PciDeviceRecord> devices;
+    {
+        // the enumerator (and its threads) is kept between requests
+        std::lock_guard<std::mutex> lock(enumeratorMutex);
+        if (!enumerator) enumerator = std::make_unique<SysfsPciEnumerator>(sysfsRoot);
+        devices = enumerator->enumerate();
+    }
+    resolveNames(devices);
+    return devices;
+}
+
+size_t ReadPCIConfigSpace(const std::string& address, uint8_t* buffer, size_t size)
+{
+    std::lock_guard<std::mutex> lock(enumeratorMutex);
+    if (!enumerator) enumerator = std::make_unique<SysfsPciEnumerator>(sysfsRoot);
+    return enumerator->readConfig(address, buffer, size);
+}
+
+int ReadPCIIommuGroup(const std::string& address)
+{
+    std::lock_guard<std::mutex> lock(enumeratorMutex);
+    if (!enumerator) enumerator = std::make_unique<SysfsPciEnumerator>(sysfsRoot);
+    return enumerator->readIommuGroup(address);
+}
+
+#else
+
+void SetPciSysfsRoot(const std::string&) {}
+
+size_t ReadPCIConfigSpace(const std::string&, uint8_t*, size_t) {
+    return 0;
+}
+
+int ReadPCIIommuGroup(const std::string&) {
+    return -1;
+}
+
+std::vector<PciDeviceRecord> EnumeratePCIDevices()
+{
+    return {};
+}
+
+#endif
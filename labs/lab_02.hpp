@@ -3,8 +3,54 @@
 
 #include <string>
 #include <vector>
-#include <utility>
+#include <cstdint>
 
-std::vector<std::pair<std::string, std::string>> EnumeratePCIDevices();
+// One memory or I/O window of a device (a BAR or the expansion ROM)
+struct PciResource {
+    uint8_t index = 0;          // 0-5 BARs, 6 ROM
+    uint64_t start = 0;
+    uint64_t size = 0;
+    uint64_t flags = 0;         // IORESOURCE_* flags on Linux
 
-#endif // PCI_DEVICE_ENUMERATOR_H
\ No newline at end of file
+    bool operator==(const PciResource&) const = default;
+};
+
+struct PciDeviceRecord {
+    std::string address;        // domain:bus:device.function, e.g. "0000:00:1f.3"
+    std::string parent;         // address of the bridge above, empty on a root bus
+    uint16_t vendorId = 0xFFFF;
+    uint16_t deviceId = 0xFFFF;
+    uint16_t subsystemVendorId = 0;
+    uint16_t subsystemDeviceId = 0;
+    uint32_t classCode = 0;     // class << 16 | subclass << 8 | prog-if
+    uint8_t revision = 0;
+    std::string vendorName;
+    std::string deviceName;
+    std::string driver;         // bound driver (service on Windows), empty if none
+    // PCIe link, 0 - not PCIe or not reported
+    float linkSpeed = 0;        // GT/s
+    int linkWidth = 0;          // lanes
+    float maxLinkSpeed = 0;
+    int maxLinkWidth = 0;
+    std::vector<PciResource> resources;
+
+    bool operator==(const PciDeviceRecord&) const = default;
+};
+
+// Vendor name from pci.ids if there is one, from the built-in table otherwise
+std::string find_vendor_name(unsigned short id);
+
+// SetupDi on Windows, sysfs (/sys/bus/pci/devices) on Linux. Sorted by address.
+std::vector<PciDeviceRecord> EnumeratePCIDevices();
+
+// Raw config space of the device at address into buffer, bytes read. Linux
+// only (sysfs); 0 elsewhere and for unknown addresses.
+size_t ReadPCIConfigSpace(const std::string& address, uint8_t* buffer, size_t size);
+
+// IOMMU group of the device, -1 if it has none or the platform does not say
+int ReadPCIIommuGroup(const std::string& address);
+
+// Linux: the sysfs mount to read instead of /sys, e.g. a fake tree. No-op elsewhere.
+void SetPciSysfsRoot(const std::string& root);
+
+#endif // PCI_DEVICE_ENUMERATOR_H
@@ -1,24 +1,38 @@
 #include "./lab_03.hpp"
-#include <stringapiset.h>
+#include "file_follow.hpp"
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct FollowedReport {
+    explicit FollowedReport(const std::string& filename) : follower(filename) {}
+    FileFollower follower;
+    std::string text;
+    uint64_t next = 0;
+};
 
-std::wstring StringToWString(const std::string& str) {
-    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
-    std::wstring wstrTo(size_needed, 0);
-    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
-    return wstrTo;
 }
 
 std::string RequestInfoStorage(const std::string& filename) {
-    std::wstring wfilename = StringToWString(filename);
-    std::wifstream file(wfilename.c_str(), std::ios::in | std::ios::binary);
-    if (!file) {
-        std::wcerr << L"Failed to open file: " << wfilename << std::endl;
-        return "";
-    }
-    std::wostringstream wss;
-    wss << file.rdbuf();
-    std::wstring wcontent = wss.str();
-    // Convert wide string content back to std::string if needed.
-    // For example, convert from UTF-16 to UTF-8 here.
-    return std::string(wcontent.begin(), wcontent.end()); // Simplified conversion
-}
\ No newline at end of file
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<FollowedReport>> reports;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<FollowedReport>& report = reports[filename];
+    if (!report) report = std::make_unique<FollowedReport>(filename);
+
+    FollowChunk chunk;
+    do {
+        if (!report->follower.read(report->next, 4 << 20, chunk)) {
+            std::cerr << report->follower.error() << std::endl;
+            reports.erase(filename);
+            return "";
+        }
+        if (chunk.reset) report->text.clear();
+        report->text += chunk.text;
+        report->next = chunk.next;
+    } while (chunk.more && chunk.next > chunk.start);
+    return report->text;
+}
@@ -2,13 +2,14 @@
 #define LAB_03
 
 
-#include <fstream>
-#include <sstream>
 #include <string>
-#include <iostream>
-#include <cstring>
+#include "storage_report.hpp"
 
 
+// The whole report as UTF-8, empty if it cannot be read. The server streams
+// the report with StorageReport instead; this is for callers that want text.
+// The text of every file asked for is kept, and asking again reads only what
+// was appended since (the whole file again if it was replaced).
 std::string RequestInfoStorage(const std::string& filename);
 
-#endif // LAB_03
\ No newline at end of file
+#endif // LAB_03
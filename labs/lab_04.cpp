@@ -315,6 +315,13 @@ std::string CameraCapture::getCurrentTempFrame() {
         return ""; // Return empty string if recording to avoid conflicts
     }
     
+    // Rate limit from the power policy: reuse the last frame instead of waking the camera
+    if (!lastTempFramePath.empty() &&
+        std::chrono::steady_clock::now() - lastTempFrameAt < getPreviewInterval() &&
+        std::filesystem::exists(lastTempFramePath)) {
+        return lastTempFramePath;
+    }
+    
     cv::Mat frame = getCurrentFrame();
     
     if (frame.empty()) {
@@ -356,6 +363,15 @@ std::string CameraCapture::getCurrentTempFrame() {
     
     // Update the last temp frame path
     lastTempFramePath = outputFilename;
+    lastTempFrameAt = std::chrono::steady_clock::now();
     std::cout << "Created temporary preview frame: " << outputFilename << std::endl;
     return outputFilename;
+}
+
+void CameraCapture::setPreviewInterval(std::chrono::milliseconds interval) {
+    previewIntervalMs = interval.count() > 0 ? interval.count() : 0;
+}
+
+std::chrono::milliseconds CameraCapture::getPreviewInterval() const {
+    return std::chrono::milliseconds(previewIntervalMs.load());
 }
\ No newline at end of file
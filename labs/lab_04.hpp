@@ -6,6 +6,7 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <opencv2/opencv.hpp>
 
@@ -32,6 +33,8 @@ private:
     std::string lastTempFramePath;  // Track the last temporary frame for immediate deletion
     std::thread recordingThread;    // Thread for continuous video recording
     std::atomic<bool> recordingActive{false};  // Flag for recording thread
+    std::atomic<int64_t> previewIntervalMs{0};  // Minimum age of a preview frame before a new one is grabbed
+    std::chrono::steady_clock::time_point lastTempFrameAt;
     
 public:
     CameraCapture(int index = 0);
@@ -72,6 +75,10 @@ public:
     
     // Get current frame as a temporary file (for preview, will be auto-deleted)
     std::string getCurrentTempFrame();
+
+    // Preview requests faster than this get the last frame again (0 - no limit)
+    void setPreviewInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds getPreviewInterval() const;
 };
 
 #endif // LAB_04_HPP
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <cctype>  // for std::tolower
 #include "lab_05.hpp"
+#include "hardware_id.hpp"
 
 static std::ofstream gLog;
 
@@ -23,6 +24,26 @@ static void logf(const std::string& s){
     printf("%s%s\n", ts, s.c_str());
 }
 
+// USB\VID_xxxx&PID_xxxx\...: a USB device or one of its interfaces, not a root hub
+static bool IsUsbDeviceId(const std::string& instanceId){
+    HardwareId id;
+    parseUsbHardwareId(std::string_view(instanceId), id);
+    return id.enumeratorIs("USB") && id.has(HardwareIdField::UsbVendor);
+}
+
+// USB\... or HID\VID_...: an input device that sits on USB
+static bool IsUsbInputId(const std::string& instanceId){
+    HardwareId id;
+    parseUsbHardwareId(std::string_view(instanceId), id);
+    return id.enumeratorIs("USB") || (id.enumeratorIs("HID") && id.has(HardwareIdField::UsbVendor));
+}
+
+static bool IsUsbStorId(const std::string& instanceId){
+    HardwareId id;
+    parseUsbHardwareId(std::string_view(instanceId), id);
+    return id.enumeratorIs("USBSTOR");
+}
+
 static bool IsUsbDrive(char letter){
     std::string path = "\\\\.\\";
     path.push_back(letter);
@@ -396,12 +417,12 @@ static int EjectUsbDriveManual(char driveLetter) {
             logf("  [DEBUG] Проверяю родительское устройство (уровень " + std::to_string(level) + "): " + parentInstanceStr.substr(0, 100));
             
             // Ищем USBSTOR или любое USB устройство (USB\VID_...)
-            if (parentInstanceStr.find("USBSTOR\\") != std::string::npos) {
+            if (IsUsbStorId(parentInstanceStr)) {
                 logf("  ✓ Найдено USBSTOR устройство в дереве: " + parentInstanceStr.substr(0, 100));
                 usbStorInst = parentInst;
                 foundUsbStor = true;
                 break;
-            } else if (parentInstanceStr.find("USB\\") == 0 && parentInstanceStr.find("VID_") != std::string::npos) {
+            } else if (IsUsbDeviceId(parentInstanceStr)) {
                 // Найдено USB устройство с VID/PID - это может быть наше устройство
                 logf("  ✓ Найдено USB устройство в дереве: " + parentInstanceStr.substr(0, 100));
                 usbStorInst = parentInst;
@@ -640,14 +661,12 @@ static int DisableUsbMouseManual() {
                         char instanceId[512] = {0};
                         if (SetupDiGetDeviceInstanceIdA(hDevInfo, &devInfoData, instanceId, sizeof(instanceId), nullptr)) {
                             std::string instanceStr(instanceId);
-                            std::transform(instanceStr.begin(), instanceStr.end(), instanceStr.begin(), ::tolower);
 
                             logf("  [DEBUG] Проверяю HID устройство #" + std::to_string(i) + ": " + std::string(description) + " (" + instanceStr.substr(0, 60) + ")");
 
                             // Проверяем, что это USB устройство и мышь
                             // USB устройство должно иметь VID_ в instance ID (не просто HID)
-                            bool isUsb = (instanceStr.find("usb\\") != std::string::npos) ||
-                                        (instanceStr.find("hid\\vid_") != std::string::npos);
+                            bool isUsb = IsUsbInputId(instanceStr);
                             bool isMouse = (descStr.find("mouse") != std::string::npos) &&
                                           (descStr.find("keyboard") == std::string::npos) &&
                                           (descStr.find("keypad") == std::string::npos);
@@ -671,7 +690,7 @@ static int DisableUsbMouseManual() {
                                         logf("  [DEBUG] Проверяю родительское устройство (уровень " + std::to_string(level) + "): " + parentInstanceStr.substr(0, 80));
 
                                         // Ищем USB устройство с VID/PID
-                                        if (parentInstanceStr.find("USB\\") == 0 && parentInstanceStr.find("VID_") != std::string::npos) {
+                                        if (IsUsbDeviceId(parentInstanceStr)) {
                                             logf("  ✓ Найдено USB устройство для мыши: " + parentInstanceStr.substr(0, 80));
                                             mouseDevInst = parentInst;
                                             foundUsbDevice = true;
@@ -732,7 +751,6 @@ static int DisableUsbMouseManual() {
                 char instanceId[512] = {0};
                 if (SetupDiGetDeviceInstanceIdA(hDevInfo, &devInfoData, instanceId, sizeof(instanceId), nullptr)) {
                     std::string instanceStr(instanceId);
-                    std::transform(instanceStr.begin(), instanceStr.end(), instanceStr.begin(), ::tolower);
 
                     char description[256] = {0};
                     SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData, SPDRP_DEVICEDESC, nullptr, (PBYTE)description, sizeof(description), nullptr);
@@ -740,8 +758,7 @@ static int DisableUsbMouseManual() {
                     logf("  [DEBUG] Проверяю мышь #" + std::to_string(i) + ": " + std::string(description) + " (" + instanceStr.substr(0, 60) + ")");
 
                     // Проверяем, что это USB устройство (должно иметь VID_ в instance ID)
-                    bool isUsb = (instanceStr.find("usb\\") != std::string::npos) ||
-                                (instanceStr.find("hid\\vid_") != std::string::npos);
+                    bool isUsb = IsUsbInputId(instanceStr);
 
                     if (isUsb) {
                         // Поднимаемся по дереву устройств вверх, ища USB устройство с VID/PID
@@ -762,7 +779,7 @@ static int DisableUsbMouseManual() {
                                 logf("  [DEBUG] Проверяю родительское устройство (уровень " + std::to_string(level) + "): " + parentInstanceStr.substr(0, 80));
 
                                 // Ищем USB устройство с VID/PID
-                                if (parentInstanceStr.find("USB\\") == 0 && parentInstanceStr.find("VID_") != std::string::npos) {
+                                if (IsUsbDeviceId(parentInstanceStr)) {
                                     logf("  ✓ Найдено USB устройство для мыши: " + parentInstanceStr.substr(0, 80));
                                     mouseDevInst = parentInst;
                                     foundUsbDevice = true;
@@ -848,7 +865,7 @@ static int DisableUsbMouseManual() {
                                     logf("  [DEBUG] Проверяю родительское устройство (уровень " + std::to_string(level) + "): " + parentInstanceStr.substr(0, 80));
 
                                     // Ищем USB устройство с VID/PID
-                                    if (parentInstanceStr.find("USB\\") == 0 && parentInstanceStr.find("VID_") != std::string::npos) {
+                                    if (IsUsbDeviceId(parentInstanceStr)) {
                                         logf("  ✓ Найдено USB устройство для мыши: " + parentInstanceStr.substr(0, 80));
                                         mouseDevInst = parentInst;
                                         foundMouse = true;
@@ -1113,7 +1130,11 @@ static LRESULT CALLBACK WndProc(HWND h, UINT m, WPARAM w, LPARAM l){
         if(hdr && hdr->dbch_devicetype==DBT_DEVTYP_DEVICEINTERFACE){
             auto* di=(PDEV_BROADCAST_DEVICEINTERFACE_A)hdr;
             std::string path = di && di->dbcc_name? di->dbcc_name : "";
-            if(w==DBT_DEVICEARRIVAL && path.find("USB#") != std::string::npos){
+            // \\?\USB#VID_xxxx&PID_xxxx#...#{GUID}
+            HardwareId pathId;
+            parseUsbHardwareId(std::string_view(path), pathId);
+            bool isUsbPath = pathId.enumeratorIs("USB");
+            if(w==DBT_DEVICEARRIVAL && isUsbPath){
                 // При подключении USB устройства проверяем, не отключено ли оно программно
                 // и если да - включаем его автоматически
                 logf("[DEBUG] USB устройство подключено: " + path.substr(0, 80));
@@ -1125,7 +1146,7 @@ static LRESULT CALLBACK WndProc(HWND h, UINT m, WPARAM w, LPARAM l){
 
                 SetTimer(S.hwnd, 1, 2000, nullptr); 
             }
-            if(w==DBT_DEVICEREMOVECOMPLETE && path.find("USB#") != std::string::npos){
+            if(w==DBT_DEVICEREMOVECOMPLETE && isUsbPath){
                 logf("[DEBUG] USB устройство отключено: "+path.substr(0,80));
                 
                 auto currentDisks = list_removable_letters();
@@ -1321,9 +1342,17 @@ int disableUsbMouseManual() {
     return DisableUsbMouseManual();
 }
 
+// usb_log.txt is followed once per process: the monitor and getUSBLog()
+// share the follower, its inotify watch and its open file
+static FileFollower& UsbLogFollower() {
+    static FileFollower follower("usb_log.txt");
+    return follower;
+}
+
 std::string getUSBLog() {
-    // For now, return a static string - a real implementation would need to read the log file
-    return "USB log functionality would be implemented here";
+    FollowChunk chunk;
+    if (!UsbLogFollower().tail(64 * 1024, 64 * 1024, chunk)) return "";
+    return chunk.text;
 }
 
 std::vector<InputDevice> listInputDevices() {
@@ -1380,19 +1409,20 @@ std::vector<InputDevice> listInputDevices() {
                     // Get hardware ID to extract VID/PID
                     char hardwareId[512] = {0};
                     if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData, SPDRP_HARDWAREID, nullptr, (PBYTE)hardwareId, sizeof(hardwareId), nullptr)) {
-                        std::string hwId = std::string(hardwareId);
                         std::string vid = "Unknown";
                         std::string pid = "Unknown";
                         
-                        // Extract VID and PID from hardware ID
-                        size_t vidPos = hwId.find("VID_");
-                        if (vidPos != std::string::npos) {
-                            vid = hwId.substr(vidPos + 4, 4);  // 4 characters after VID_
+                        // Extract VID and PID from the hardware ID list
+                        HardwareId id;
+                        parseUsbHardwareIdList(hardwareId, sizeof(hardwareId), id);
+                        char hex[8];
+                        if (id.has(HardwareIdField::UsbVendor)) {
+                            snprintf(hex, sizeof(hex), "%04X", id.usbVendorId);
+                            vid = hex;
                         }
-                        
-                        size_t pidPos = hwId.find("PID_");
-                        if (pidPos != std::string::npos) {
-                            pid = hwId.substr(pidPos + 4, 4);  // 4 characters after PID_
+                        if (id.has(HardwareIdField::UsbProduct)) {
+                            snprintf(hex, sizeof(hex), "%04X", id.usbProductId);
+                            pid = hex;
                         }
                         
                         InputDevice device;
@@ -1425,7 +1455,7 @@ std::vector<InputDevice> listInputDevices() {
 }
 
 // Implementation of the USBMonitor class
-USBMonitor::USBMonitor() : isMonitoring(false) {
+USBMonitor::USBMonitor() : isMonitoring(false), logFollower(UsbLogFollower()) {
     gLog.open("usb_log.txt", std::ios::app);
 }
 
@@ -1471,5 +1501,15 @@ std::vector<InputDevice> USBMonitor::listInputDevices() {
 }
 
 std::string USBMonitor::getCurrentLog() {
-    return "USB Monitor log";
+    FollowChunk chunk;
+    if (!tailLog(chunk)) return "";
+    return chunk.text;
+}
+
+bool USBMonitor::tailLog(FollowChunk& chunk, size_t tailBytes) {
+    return logFollower.tail(tailBytes, tailBytes, chunk);
+}
+
+bool USBMonitor::readLog(uint64_t since, FollowChunk& chunk, size_t maxBytes) {
+    return logFollower.read(since, maxBytes, chunk);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include "file_follow.hpp"
 
 // Function declarations for USB operations
 std::vector<char> listRemovableDrives();
@@ -49,11 +50,18 @@ public:
     // Function to list input devices
     std::vector<InputDevice> listInputDevices();
     
-    // Get current log
+    // Get current log: the last 64 KiB of usb_log.txt
     std::string getCurrentLog();
+
+    // The log after `since` (a `next` from an earlier chunk), read from
+    // where the last read stopped rather than from the start of the file
+    bool readLog(uint64_t since, FollowChunk& chunk, size_t maxBytes = 256 * 1024);
+    // The last tailBytes of the log, from the start of a line
+    bool tailLog(FollowChunk& chunk, size_t tailBytes = 64 * 1024);
     
 private:
     bool isMonitoring;
+    FileFollower& logFollower;     // the one getUSBLog() reads too
     // Add other private members as needed
 };
 
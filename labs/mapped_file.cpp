@@ -0,0 +1,84 @@
+#include "mapped_file.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    // paths are UTF-8 (the lab 3 report lives under a Cyrillic directory)
+    int wideLength = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    if (wideLength <= 0) return false;
+    std::wstring widePath(wideLength, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], wideLength);
+    HANDLE fh = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fh, &fileSize)) {
+        CloseHandle(fh);
+        return false;
+    }
+    // mapping an empty file fails, and there is nothing to map anyway
+    if (fileSize.QuadPart > 0) {
+        HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mh) {
+            CloseHandle(fh);
+            return false;
+        }
+        bytes = (const uint8_t*)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+        if (!bytes) {
+            CloseHandle(mh);
+            CloseHandle(fh);
+            return false;
+        }
+        mappingHandle = mh;
+    }
+    fileHandle = fh;
+    length = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        bytes = (const uint8_t*)mapped;
+    }
+    ::close(fd);
+    length = (size_t)st.st_size;
+#endif
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mappingHandle) CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle) CloseHandle((HANDLE)fileHandle);
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (bytes) munmap((void*)bytes, length);
+#endif
+    bytes = nullptr;
+    length = 0;
+    opened = false;
+}
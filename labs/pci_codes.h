@@ -1,11 +1,16 @@
+#ifndef PCI_CODES_H
+#define PCI_CODES_H
+
+// Read-only data: constexpr puts the tables and their strings in .rodata
+
 typedef struct _PCI_VENTABLE
 {
 	unsigned short	VenId ;
-	char *	VenShort ;
-	char *	VenFull ;
+	const char *	VenShort ;
+	const char *	VenFull ;
 }  PCI_VENTABLE, *PPCI_VENTABLE ;
 
-PCI_VENTABLE	PciVenTable [] =
+inline constexpr PCI_VENTABLE	PciVenTable [] =
 {
 	{ 0x0033, "", "Paradyne Corp." } ,
 	{ 0x003D, "well", "master" } ,
@@ -1507,10 +1512,13 @@ PCI_VENTABLE	PciVenTable [] =
 	{ 0xFA57, "Interagon", "Interagon AS" } ,
 } ;
 
+// Use this value for loop control during searching:
+#define	PCI_VENTABLE_LEN	(sizeof(PciVenTable)/sizeof(PCI_VENTABLE))
+
 // Use this value for loop control during searching:
 #define	PCI_CLASSCODETABLE_LEN	(sizeof(PciClassCodeTable)/sizeof(PCI_CLASSCODETABLE))
 
-char *	PciCommandFlags [] =
+inline constexpr const char *	PciCommandFlags [] =
 {
 	"I/O Access",
 	"Memory Access",
@@ -1531,10 +1539,10 @@ char *	PciCommandFlags [] =
 } ;
 
 // Use this value for loop control during searching:
-#define	PCI_COMMANDFLAGS_LEN	(sizeof(PciCommandFlags)/sizeof(char *))
+#define	PCI_COMMANDFLAGS_LEN	(sizeof(PciCommandFlags)/sizeof(const char *))
 
 
-char *	PciStatusFlags [] =
+inline constexpr const char *	PciStatusFlags [] =
 {
 	"Reserved 0",
 	"Reserved 1",
@@ -1555,10 +1563,10 @@ char *	PciStatusFlags [] =
 } ;
 
 // Use this value for loop control during searching:
-#define	PCI_STATUSFLAGS_LEN	(sizeof(PciStatusFlags)/sizeof(char *))
+#define	PCI_STATUSFLAGS_LEN	(sizeof(PciStatusFlags)/sizeof(const char *))
 
 
-char *	PciDevSelFlags [] =
+inline constexpr const char *	PciDevSelFlags [] =
 {
 	"Fast Devsel Speed",     // TypeC
 	"Medium Devsel Speed",   // TypeB
@@ -1567,4 +1575,6 @@ char *	PciDevSelFlags [] =
 } ;
 
 // Use this value for loop control during searching:
-#define	PCI_DEVSELFLAGS_LEN	(sizeof(PciDevSelFlags)/sizeof(char *))
\ No newline at end of file
+#define	PCI_DEVSELFLAGS_LEN	(sizeof(PciDevSelFlags)/sizeof(const char *))
+
+#endif // PCI_CODES_H
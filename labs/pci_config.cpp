@@ -0,0 +1,249 @@
+#include "pci_config.hpp"
+
+static uint16_t read16(const uint8_t* data, size_t offset) {
+    return (uint16_t)(data[offset] | data[offset + 1] << 8);
+}
+
+static uint32_t read32(const uint8_t* data, size_t offset) {
+    return (uint32_t)data[offset] | (uint32_t)data[offset + 1] << 8 |
+           (uint32_t)data[offset + 2] << 16 | (uint32_t)data[offset + 3] << 24;
+}
+
+const PciCapability* PciConfigSpace::findCapability(uint16_t id, bool extended) const {
+    for (int i = 0; i < capabilityCount; i++) {
+        if (capabilities[i].id == id && capabilities[i].extended == extended) return &capabilities[i];
+    }
+    return nullptr;
+}
+
+static void decodeBars(const uint8_t* data, int registers, PciConfigSpace& decoded) {
+    for (int i = 0; i < registers; i++) {
+        uint32_t low = read32(data, 0x10 + i * 4);
+        if (low == 0) continue;
+        PciBar& bar = decoded.bars[decoded.barCount++];
+        bar.index = (uint8_t)i;
+        bar.io = low & 1;
+        if (bar.io) {
+            bar.address = low & ~3u;
+            continue;
+        }
+        bar.prefetchable = low & 8;
+        bar.address = low & ~15u;
+        // type 2 is a 64-bit BAR, the next register is the upper half
+        if ((low >> 1 & 3) == 2 && i + 1 < registers) {
+            bar.is64 = true;
+            bar.address |= (uint64_t)read32(data, 0x10 + (i + 1) * 4) << 32;
+            i++;
+        }
+    }
+}
+
+static bool addCapability(PciConfigSpace& decoded, const PciCapability& capability) {
+    if (decoded.capabilityCount == PciConfigSpace::kMaxCapabilities) {
+        decoded.capabilitiesTruncated = true;
+        return false;
+    }
+    decoded.capabilities[decoded.capabilityCount++] = capability;
+    return true;
+}
+
+// Each entry is "id, next"; pointers are dword aligned and above the header.
+// 48 entries is the most that fit in the 192 bytes, so a longer walk has looped.
+static void walkCapabilities(const uint8_t* data, size_t length, uint8_t pointer, PciConfigSpace& decoded) {
+    size_t limit = length < 256 ? length : 256;
+    for (int steps = 0; pointer; steps++) {
+        pointer &= 0xFC;
+        if (pointer < 0x40 || pointer + 2u > limit || steps == 48) {
+            decoded.capabilitiesTruncated = true;
+            return;
+        }
+        PciCapability capability;
+        capability.offset = pointer;
+        capability.id = data[pointer];
+        if (!addCapability(decoded, capability)) return;
+        pointer = data[pointer + 1];
+    }
+}
+
+// Extended capabilities start at 0x100; the header is id:16 version:4 next:12
+static void walkExtendedCapabilities(const uint8_t* data, size_t length, PciConfigSpace& decoded) {
+    if (length < 0x104) return;
+    uint32_t header = read32(data, 0x100);
+    if (header == 0 || header == 0xFFFFFFFF) return;
+    size_t offset = 0x100;
+    for (int steps = 0; offset; steps++) {
+        if (offset < 0x100 || offset + 4 > length || steps == 960) {
+            decoded.capabilitiesTruncated = true;
+            return;
+        }
+        header = read32(data, offset);
+        PciCapability capability;
+        capability.offset = (uint16_t)offset;
+        capability.id = (uint16_t)header;
+        capability.version = header >> 16 & 0xF;
+        capability.extended = true;
+        if (!addCapability(decoded, capability)) return;
+        offset = header >> 20 & 0xFFC;
+    }
+}
+
+static void decodeExpress(const uint8_t* data, size_t length, PciConfigSpace& decoded) {
+    const PciCapability* capability = decoded.findCapability(0x10);
+    if (!capability || capability->offset + 0x14u > length) return;
+    size_t base = capability->offset;
+    PciExpressInfo& express = decoded.express;
+    uint16_t flags = read16(data, base + 0x02);
+    express.present = true;
+    express.version = flags & 0xF;
+    express.portType = flags >> 4 & 0xF;
+    uint32_t linkCapabilities = read32(data, base + 0x0C);
+    express.maxLinkSpeed = linkCapabilities & 0xF;
+    express.maxLinkWidth = linkCapabilities >> 4 & 0x3F;
+    uint16_t linkStatus = read16(data, base + 0x12);
+    express.linkSpeed = linkStatus & 0xF;
+    express.linkWidth = linkStatus >> 4 & 0x3F;
+}
+
+bool decodePciConfig(const uint8_t* data, size_t length, PciConfigSpace& decoded) {
+    decoded = PciConfigSpace();
+    if (!data || length < 64 || read16(data, 0) == 0xFFFF) return false;
+    decoded.length = length;
+    decoded.vendorId = read16(data, 0x00);
+    decoded.deviceId = read16(data, 0x02);
+    decoded.command = read16(data, 0x04);
+    decoded.status = read16(data, 0x06);
+    decoded.revision = data[0x08];
+    decoded.classCode = (uint32_t)data[0x0B] << 16 | (uint32_t)data[0x0A] << 8 | data[0x09];
+    decoded.headerType = data[0x0E] & 0x7F;
+    decoded.multiFunction = data[0x0E] & 0x80;
+    decoded.interruptLine = data[0x3C];
+    decoded.interruptPin = data[0x3D];
+
+    uint8_t capabilityPointer = 0;
+    switch (decoded.headerType) {
+    case 0:
+        decodeBars(data, 6, decoded);
+        decoded.subsystemVendorId = read16(data, 0x2C);
+        decoded.subsystemDeviceId = read16(data, 0x2E);
+        capabilityPointer = data[0x34];
+        break;
+    case 1:
+        decodeBars(data, 2, decoded);
+        decoded.primaryBus = data[0x18];
+        decoded.secondaryBus = data[0x19];
+        decoded.subordinateBus = data[0x1A];
+        capabilityPointer = data[0x34];
+        break;
+    case 2:
+        // CardBus: the list pointer moved to 0x14, the bus numbers follow it
+        decoded.primaryBus = data[0x18];
+        decoded.secondaryBus = data[0x19];
+        decoded.subordinateBus = data[0x1A];
+        capabilityPointer = data[0x14];
+        break;
+    }
+    // status bit 4: the capability list is there
+    if (decoded.statusBit(4)) {
+        walkCapabilities(data, length, capabilityPointer, decoded);
+    }
+    decodeExpress(data, length, decoded);
+    if (decoded.express.present) {
+        walkExtendedCapabilities(data, length, decoded);
+    }
+    return true;
+}
+
+size_t decodePciConfigs(const PciConfigDump* dumps, size_t count, PciConfigSpace* decoded) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        valid += decodePciConfig(dumps[i].data, dumps[i].length, decoded[i]);
+    }
+    return valid;
+}
+
+const char* pciCapabilityName(uint16_t id) {
+    switch (id) {
+    case 0x01: return "Power Management";
+    case 0x02: return "AGP";
+    case 0x03: return "Vital Product Data";
+    case 0x04: return "Slot Identification";
+    case 0x05: return "MSI";
+    case 0x06: return "CompactPCI Hot Swap";
+    case 0x07: return "PCI-X";
+    case 0x08: return "HyperTransport";
+    case 0x09: return "Vendor Specific";
+    case 0x0A: return "Debug Port";
+    case 0x0B: return "CompactPCI Central Resource Control";
+    case 0x0C: return "PCI Hot-Plug";
+    case 0x0D: return "Bridge Subsystem Vendor ID";
+    case 0x0E: return "AGP 8x";
+    case 0x0F: return "Secure Device";
+    case 0x10: return "PCI Express";
+    case 0x11: return "MSI-X";
+    case 0x12: return "SATA Data/Index Configuration";
+    case 0x13: return "Advanced Features";
+    case 0x14: return "Enhanced Allocation";
+    case 0x15: return "Flattening Portal Bridge";
+    default: return "Unknown";
+    }
+}
+
+const char* pciExtendedCapabilityName(uint16_t id) {
+    switch (id) {
+    case 0x0001: return "Advanced Error Reporting";
+    case 0x0002: return "Virtual Channel";
+    case 0x0003: return "Device Serial Number";
+    case 0x0004: return "Power Budgeting";
+    case 0x0005: return "Root Complex Link Declaration";
+    case 0x0006: return "Root Complex Internal Link Control";
+    case 0x0007: return "Root Complex Event Collector Endpoint Association";
+    case 0x0008: return "Multi-Function Virtual Channel";
+    case 0x0009: return "Virtual Channel";
+    case 0x000A: return "Root Complex Register Block";
+    case 0x000B: return "Vendor Specific";
+    case 0x000D: return "Access Control Services";
+    case 0x000E: return "Alternative Routing-ID Interpretation";
+    case 0x000F: return "Address Translation Services";
+    case 0x0010: return "Single Root I/O Virtualization";
+    case 0x0011: return "Multi-Root I/O Virtualization";
+    case 0x0012: return "Multicast";
+    case 0x0013: return "Page Request";
+    case 0x0015: return "Resizable BAR";
+    case 0x0016: return "Dynamic Power Allocation";
+    case 0x0017: return "TPH Requester";
+    case 0x0018: return "Latency Tolerance Reporting";
+    case 0x0019: return "Secondary PCI Express";
+    case 0x001B: return "Process Address Space ID";
+    case 0x001D: return "Downstream Port Containment";
+    case 0x001E: return "L1 PM Substates";
+    case 0x001F: return "Precision Time Measurement";
+    case 0x0023: return "Designated Vendor-Specific";
+    case 0x0025: return "Data Link Feature";
+    case 0x0026: return "Physical Layer 16.0 GT/s";
+    case 0x0027: return "Lane Margining at the Receiver";
+    case 0x002A: return "Physical Layer 32.0 GT/s";
+    default: return "Unknown";
+    }
+}
+
+const char* pciExpressPortTypeName(uint8_t type) {
+    switch (type) {
+    case 0x0: return "Endpoint";
+    case 0x1: return "Legacy Endpoint";
+    case 0x4: return "Root Port";
+    case 0x5: return "Upstream Switch Port";
+    case 0x6: return "Downstream Switch Port";
+    case 0x7: return "PCIe to PCI Bridge";
+    case 0x8: return "PCI to PCIe Bridge";
+    case 0x9: return "Root Complex Integrated Endpoint";
+    case 0xA: return "Root Complex Event Collector";
+    default: return "Unknown";
+    }
+}
+
+const char* pciLinkSpeedName(uint8_t code) {
+    static const char* const speeds[] = {
+        "", "2.5 GT/s", "5.0 GT/s", "8.0 GT/s", "16.0 GT/s", "32.0 GT/s", "64.0 GT/s"
+    };
+    return code < sizeof(speeds) / sizeof(speeds[0]) ? speeds[code] : "";
+}
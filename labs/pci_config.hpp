@@ -0,0 +1,97 @@
+#ifndef PCI_CONFIG_HPP
+#define PCI_CONFIG_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoder for raw PCI configuration space: a sysfs "config" file, or a dump
+// captured elsewhere. 64 bytes give the header, 256 the capability list, and
+// 4096 the PCIe extended capabilities.
+//
+// The decoder reads the bytes in place and fills a fixed-size struct, so a
+// batch of devices decodes into a preallocated array without touching the
+// heap. Names come from the tables in pci_codes.h and static strings.
+
+struct PciBar {
+    uint8_t index = 0;          // BAR register 0-5
+    bool io = false;
+    bool is64 = false;          // takes this register and the next one
+    bool prefetchable = false;
+    uint64_t address = 0;       // sizes are not in config space, see PciResource
+};
+
+struct PciCapability {
+    uint16_t offset = 0;
+    uint16_t id = 0;
+    uint8_t version = 0;        // extended capabilities only
+    bool extended = false;
+};
+
+// From the PCI Express capability, when there is one
+struct PciExpressInfo {
+    bool present = false;
+    uint8_t version = 0;
+    uint8_t portType = 0;       // 0 endpoint, 4 root port, 5/6 switch ports, ...
+    uint8_t linkSpeed = 0;      // 1 = 2.5 GT/s, 2 = 5, 3 = 8, 4 = 16, 5 = 32, 6 = 64
+    uint8_t linkWidth = 0;
+    uint8_t maxLinkSpeed = 0;
+    uint8_t maxLinkWidth = 0;
+};
+
+struct PciConfigSpace {
+    static constexpr int kMaxBars = 6;
+    static constexpr int kMaxCapabilities = 48;
+
+    size_t length = 0;          // bytes decoded from
+    uint16_t vendorId = 0xFFFF;
+    uint16_t deviceId = 0xFFFF;
+    uint16_t command = 0;
+    uint16_t status = 0;
+    uint8_t revision = 0;
+    uint32_t classCode = 0;
+    uint8_t headerType = 0;     // 0 device, 1 PCI bridge, 2 CardBus bridge
+    bool multiFunction = false;
+    uint16_t subsystemVendorId = 0;
+    uint16_t subsystemDeviceId = 0;
+    uint8_t interruptLine = 0;
+    uint8_t interruptPin = 0;   // 0 none, 1-4 INTA-INTD
+    // bridges only
+    uint8_t primaryBus = 0;
+    uint8_t secondaryBus = 0;
+    uint8_t subordinateBus = 0;
+
+    uint8_t barCount = 0;
+    PciBar bars[kMaxBars];
+    uint8_t capabilityCount = 0;
+    PciCapability capabilities[kMaxCapabilities];
+    // a list pointed outside the data, looped, or had more entries than fit
+    bool capabilitiesTruncated = false;
+    PciExpressInfo express;
+
+    bool commandBit(int bit) const { return command >> bit & 1; }
+    bool statusBit(int bit) const { return status >> bit & 1; }
+    // index into PciDevSelFlags
+    uint8_t devselTiming() const { return status >> 9 & 3; }
+    const PciCapability* findCapability(uint16_t id, bool extended = false) const;
+};
+
+// False if there is no header (under 64 bytes, or an absent function reading all ones)
+bool decodePciConfig(const uint8_t* data, size_t length, PciConfigSpace& decoded);
+
+// One dump of a batch; the bytes are not copied
+struct PciConfigDump {
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+};
+
+// Decodes count dumps into decoded[0..count). Returns how many had a header.
+size_t decodePciConfigs(const PciConfigDump* dumps, size_t count, PciConfigSpace* decoded);
+
+// Static names, "Unknown" for IDs not listed
+const char* pciCapabilityName(uint16_t id);
+const char* pciExtendedCapabilityName(uint16_t id);
+const char* pciExpressPortTypeName(uint8_t type);
+// "8.0 GT/s" for 3, "" for 0 or unknown codes
+const char* pciLinkSpeedName(uint8_t code);
+
+#endif // PCI_CONFIG_HPP
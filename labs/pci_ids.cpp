@@ -0,0 +1,288 @@
+#include "pci_ids.hpp"
+#include <algorithm>
+#include <cstring>
+
+static const size_t npos = (size_t)-1;
+
+static bool parseHex(const uint8_t* p, int digits, uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < digits; i++) {
+        uint8_t c = p[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        value = value << 4 | digit;
+    }
+    return true;
+}
+
+bool PciIdsDatabase::open(const std::string& path) {
+    close();
+    if (!file.open(path)) return false;
+    filePath = path;
+    return true;
+}
+
+void PciIdsDatabase::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+    filePath.clear();
+    vendors.clear();
+    classes.clear();
+    classesIndexed = false;
+}
+
+std::string_view PciIdsDatabase::text(Name name) const {
+    return std::string_view((const char*)file.data() + name.offset, name.length);
+}
+
+// Line helpers over the mapped text
+namespace {
+struct Lines {
+    const uint8_t* data;
+    size_t size;
+
+    size_t end(size_t line) const {
+        const void* newline = memchr(data + line, '\n', size - line);
+        return newline ? (const uint8_t*)newline - data : size;
+    }
+    size_t next(size_t line) const {
+        size_t e = end(line);
+        return e < size ? e + 1 : size;
+    }
+    bool isVendor(size_t line, uint32_t& id) const {
+        return line + 6 <= size && parseHex(data + line, 4, id) && data[line + 4] == ' ' && data[line + 5] == ' ';
+    }
+    // the text after "<prefix>  " up to the end of the line, without a trailing \r
+    bool name(size_t line, size_t prefix, uint32_t& offset, uint32_t& length) const {
+        size_t e = end(line);
+        size_t start = line + prefix;
+        while (start < e && data[start] == ' ') start++;
+        if (start == line + prefix) return false;
+        if (e > start && data[e - 1] == '\r') e--;
+        offset = (uint32_t)start;
+        length = (uint32_t)(e - start);
+        return true;
+    }
+};
+}
+
+// Binary search over byte offsets: from the middle of a range, the next
+// vendor line tells which half the wanted vendor is in.
+size_t PciIdsDatabase::findVendorLine(uint16_t id) const {
+    Lines lines{ file.data(), file.size() };
+    size_t lo = 0, hi = file.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t line = mid;
+        if (line > 0 && lines.data[line - 1] != '\n') {
+            line = lines.next(line);
+        }
+        uint32_t found = 0;
+        while (line < hi && !lines.isVendor(line, found)) {
+            line = lines.next(line);
+        }
+        if (line >= hi) {
+            hi = mid;
+        } else if (found < id) {
+            lo = lines.next(line);
+        } else if (found > id) {
+            hi = mid;
+        } else {
+            return line;
+        }
+    }
+    return npos;
+}
+
+std::string_view PciIdsDatabase::lineName(size_t line, size_t prefix) const {
+    Lines lines{ file.data(), file.size() };
+    Name name;
+    if (!lines.name(line, prefix, name.offset, name.length)) return std::string_view();
+    return text(name);
+}
+
+void PciIdsDatabase::indexVendor(Vendor& entry, size_t line) {
+    Lines lines{ file.data(), file.size() };
+    entry.known = true;
+    entry.line = (uint32_t)line;
+
+    bool sorted = true;
+    for (line = lines.next(line); line < lines.size; line = lines.next(line)) {
+        uint8_t c = lines.data[line];
+        if (c == '#' || c == '\n' || c == '\r') continue;
+        if (c != '\t') break;
+        uint32_t id;
+        if (line + 5 <= lines.size && parseHex(lines.data + line + 1, 4, id)) {
+            sorted = sorted && (entry.deviceIds.empty() || entry.deviceIds.back() < id);
+            entry.deviceIds.push_back((uint16_t)id);
+            entry.deviceLines.push_back((uint32_t)line);
+        }
+        // "\t\tssss dddd  name" subsystem lines are left for subsystemName()
+    }
+
+    // the file is sorted, but lookups must not depend on it
+    if (!sorted) {
+        std::vector<size_t> order(entry.deviceIds.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&entry](size_t a, size_t b) {
+            return entry.deviceIds[a] < entry.deviceIds[b];
+        });
+        std::vector<uint16_t> ids;
+        std::vector<uint32_t> offsets;
+        for (size_t i : order) {
+            ids.push_back(entry.deviceIds[i]);
+            offsets.push_back(entry.deviceLines[i]);
+        }
+        entry.deviceIds.swap(ids);
+        entry.deviceLines.swap(offsets);
+    }
+    entry.deviceIds.shrink_to_fit();
+    entry.deviceLines.shrink_to_fit();
+}
+
+const PciIdsDatabase::Vendor& PciIdsDatabase::vendor(uint16_t id) {
+    auto it = vendors.find(id);
+    if (it != vendors.end()) return it->second;
+    // unknown vendors are remembered too, so they cost one search only
+    Vendor& entry = vendors[id];
+    size_t line = file.isOpen() ? findVendorLine(id) : npos;
+    if (line != npos) {
+        indexVendor(entry, line);
+    }
+    return entry;
+}
+
+size_t PciIdsDatabase::findDevice(const Vendor& entry, uint16_t device) const {
+    auto it = std::lower_bound(entry.deviceIds.begin(), entry.deviceIds.end(), device);
+    if (it == entry.deviceIds.end() || *it != device) return npos;
+    return entry.deviceLines[it - entry.deviceIds.begin()];
+}
+
+std::string_view PciIdsDatabase::vendorName(uint16_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Vendor& entry = vendor(id);
+    return entry.known ? lineName(entry.line, 4) : std::string_view();
+}
+
+std::string_view PciIdsDatabase::deviceName(uint16_t vendorId, uint16_t deviceId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t line = findDevice(vendor(vendorId), deviceId);
+    return line != npos ? lineName(line, 5) : std::string_view();
+}
+
+std::string_view PciIdsDatabase::subsystemName(uint16_t vendorId, uint16_t deviceId,
+                                               uint16_t subVendor, uint16_t subDevice) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t line = findDevice(vendor(vendorId), deviceId);
+    if (line == npos) return std::string_view();
+    Lines lines{ file.data(), file.size() };
+    for (line = lines.next(line); line + 11 <= lines.size; line = lines.next(line)) {
+        const uint8_t* p = lines.data + line;
+        if (p[0] == '#') continue;
+        if (p[0] != '\t' || p[1] != '\t') break;
+        uint32_t v, d;
+        if (parseHex(p + 2, 4, v) && p[6] == ' ' && parseHex(p + 7, 4, d) && v == subVendor && d == subDevice) {
+            return lineName(line, 11);
+        }
+    }
+    return std::string_view();
+}
+
+// The class list ("C cc  name", "\tss  name", "\t\tpp  name") closes the file,
+// so it is found by walking back from the end to the last vendor line.
+void PciIdsDatabase::indexClasses() {
+    classesIndexed = true;
+    Lines lines{ file.data(), file.size() };
+    size_t start = npos;
+    size_t line = lines.size;
+    while (line > 0) {
+        size_t previous = line - 1;
+        while (previous > 0 && lines.data[previous - 1] != '\n') previous--;
+        uint32_t id;
+        if (lines.data[previous] == 'C' && previous + 1 < lines.size && lines.data[previous + 1] == ' ') {
+            start = previous;
+        } else if (lines.isVendor(previous, id)) {
+            break;
+        }
+        line = previous;
+    }
+    if (start == npos) return;
+
+    uint32_t baseClass = 0, subclass = 0, value;
+    for (line = start; line < lines.size; line = lines.next(line)) {
+        const uint8_t* p = lines.data + line;
+        size_t left = lines.size - line;
+        Name name;
+        if (left >= 4 && p[0] == 'C' && p[1] == ' ' && parseHex(p + 2, 2, value)) {
+            baseClass = value;
+            if (lines.name(line, 4, name.offset, name.length)) classes[baseClass << 16] = name;
+        } else if (left >= 4 && p[0] == '\t' && p[1] == '\t' && parseHex(p + 2, 2, value)) {
+            if (lines.name(line, 4, name.offset, name.length))
+                classes[2u << 24 | baseClass << 16 | subclass << 8 | value] = name;
+        } else if (left >= 3 && p[0] == '\t' && parseHex(p + 1, 2, value)) {
+            subclass = value;
+            if (lines.name(line, 3, name.offset, name.length))
+                classes[1u << 24 | baseClass << 16 | subclass << 8] = name;
+        }
+    }
+}
+
+std::string_view PciIdsDatabase::className(uint8_t baseClass) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!classesIndexed && file.isOpen()) indexClasses();
+    auto it = classes.find((uint32_t)baseClass << 16);
+    return it != classes.end() ? text(it->second) : std::string_view();
+}
+
+std::string_view PciIdsDatabase::subclassName(uint8_t baseClass, uint8_t subclass) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!classesIndexed && file.isOpen()) indexClasses();
+    auto it = classes.find(1u << 24 | (uint32_t)baseClass << 16 | (uint32_t)subclass << 8);
+    return it != classes.end() ? text(it->second) : std::string_view();
+}
+
+std::string_view PciIdsDatabase::progIfName(uint8_t baseClass, uint8_t subclass, uint8_t progIf) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!classesIndexed && file.isOpen()) indexClasses();
+    auto it = classes.find(2u << 24 | (uint32_t)baseClass << 16 | (uint32_t)subclass << 8 | progIf);
+    return it != classes.end() ? text(it->second) : std::string_view();
+}
+
+size_t PciIdsDatabase::memoryBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    // hash nodes are counted as the entry plus two pointers
+    size_t bytes = vendors.bucket_count() * sizeof(void*) + classes.bucket_count() * sizeof(void*);
+    for (const auto& [id, entry] : vendors) {
+        bytes += sizeof(id) + sizeof(entry) + 2 * sizeof(void*);
+        bytes += entry.deviceIds.capacity() * sizeof(uint16_t) + entry.deviceLines.capacity() * sizeof(uint32_t);
+    }
+    bytes += classes.size() * (sizeof(uint32_t) + sizeof(Name) + 2 * sizeof(void*));
+    return bytes;
+}
+
+size_t PciIdsDatabase::indexedVendors() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return vendors.size();
+}
+
+PciIdsDatabase& PciIdsDatabase::system() {
+    static PciIdsDatabase database;
+    static std::once_flag opened;
+    std::call_once(opened, [] {
+        const char* candidates[] = {
+#ifndef _WIN32
+            "/usr/share/hwdata/pci.ids",
+            "/usr/share/misc/pci.ids",
+            "/usr/share/pci.ids",
+#endif
+            "pci.ids",
+        };
+        for (const char* candidate : candidates) {
+            if (database.open(candidate)) break;
+        }
+    });
+    return database;
+}
@@ -0,0 +1,84 @@
+#ifndef PCI_IDS_HPP
+#define PCI_IDS_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.hpp"
+
+// Names from a pci.ids database (https://pci-ids.ucw.cz), read in place.
+//
+// open() only maps the file. Vendors are found by binary search over the
+// mapped text (the file is sorted by vendor ID), and a vendor's device
+// lines are indexed the first time that vendor is looked up. The
+// class list at the end of the file is indexed on the first class lookup.
+// Index entries point into the mapping, so no name is ever copied and the
+// returned views stay valid until close().
+//
+// Lookups are thread-safe; empty views mean "unknown".
+class PciIdsDatabase {
+public:
+    PciIdsDatabase() = default;
+    PciIdsDatabase(const PciIdsDatabase&) = delete;
+    PciIdsDatabase& operator=(const PciIdsDatabase&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    const std::string& path() const { return filePath; }
+
+    std::string_view vendorName(uint16_t vendor);
+    std::string_view deviceName(uint16_t vendor, uint16_t device);
+    std::string_view subsystemName(uint16_t vendor, uint16_t device, uint16_t subVendor, uint16_t subDevice);
+
+    std::string_view className(uint8_t baseClass);
+    std::string_view subclassName(uint8_t baseClass, uint8_t subclass);
+    std::string_view progIfName(uint8_t baseClass, uint8_t subclass, uint8_t progIf);
+
+    // size of the mapped text and of the indexes built so far
+    size_t fileBytes() const { return file.size(); }
+    size_t memoryBytes();
+    size_t indexedVendors();
+
+    // The first candidate that opens: the system databases, then ./pci.ids.
+    // Opened once on first use; check isOpen() on the result.
+    static PciIdsDatabase& system();
+
+private:
+    // offset and length of a name in the mapping
+    struct Name {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+    // Six bytes per device: its ID and where its line starts. Names are cut
+    // out of the line when asked for, and subsystem lines (which follow
+    // their device line) are only read by subsystemName().
+    struct Vendor {
+        bool known = false;
+        uint32_t line = 0;
+        std::vector<uint16_t> deviceIds;
+        std::vector<uint32_t> deviceLines;
+    };
+    std::string_view text(Name name) const;
+    // the name on the line starting at offset line, after prefix characters
+    std::string_view lineName(size_t line, size_t prefix) const;
+    const Vendor& vendor(uint16_t id);
+    size_t findVendorLine(uint16_t id) const;
+    void indexVendor(Vendor& entry, size_t line);
+    // start of the device's line, or npos
+    size_t findDevice(const Vendor& entry, uint16_t device) const;
+    void indexClasses();
+
+    MappedFile file;
+    std::string filePath;
+    std::mutex mutex;
+    std::unordered_map<uint16_t, Vendor> vendors;
+    bool classesIndexed = false;
+    // key: level << 24 | class << 16 | subclass << 8 | prog-if
+    std::unordered_map<uint32_t, Name> classes;
+};
+
+#endif // PCI_IDS_HPP
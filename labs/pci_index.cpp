@@ -0,0 +1,181 @@
+#include "pci_index.hpp"
+#include <algorithm>
+#include <iterator>
+
+// PCI base classes by the short names operators use
+static const struct {
+    const char* name;
+    uint8_t baseClass;
+} kClassNames[] = {
+    { "unclassified", 0x00 }, { "storage", 0x01 }, { "network", 0x02 }, { "display", 0x03 },
+    { "multimedia", 0x04 }, { "memory", 0x05 }, { "bridge", 0x06 }, { "communication", 0x07 },
+    { "system", 0x08 }, { "input", 0x09 }, { "docking", 0x0A }, { "processor", 0x0B },
+    { "serial", 0x0C }, { "wireless", 0x0D }, { "intelligent", 0x0E }, { "satellite", 0x0F },
+    { "encryption", 0x10 }, { "signal", 0x11 }, { "accelerator", 0x12 }, { "instrumentation", 0x13 },
+    { "coprocessor", 0x40 },
+};
+
+static std::string lower(std::string_view text) {
+    std::string result(text);
+    for (char& c : result) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c + 32);
+    }
+    return result;
+}
+
+static bool parseHex(std::string_view text, uint32_t& value) {
+    if (text.empty() || text.size() > 6) return false;
+    value = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        value = value << 4 | (uint32_t)digit;
+    }
+    return true;
+}
+
+static uint32_t classKey(uint32_t classCode, int digits) {
+    uint32_t mask = 0xFFFFFFu << (4 * (6 - digits)) & 0xFFFFFFu;
+    return (uint32_t)digits << 24 | (classCode & mask);
+}
+
+// comma separated items, blanks around them dropped
+template <typename Visit>
+static bool forEachItem(std::string_view list, Visit visit) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (!item.empty() && !visit(item)) return false;
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return true;
+}
+
+// matches are appended, narrow() sorts them once
+static void unite(std::vector<uint32_t>& into, const std::vector<uint32_t>& from) {
+    into.insert(into.end(), from.begin(), from.end());
+}
+
+PciInventoryIndex::PciInventoryIndex(std::vector<PciTopologyNode> nodes, uint64_t generation)
+    : generationNumber(generation), all(std::move(nodes)) {
+    std::unordered_map<std::string, size_t> deviceSlots;
+    for (uint32_t position = 0; position < all.size(); position++) {
+        const PciDeviceRecord& device = all[position].device;
+        for (int digits = 2; digits <= 6; digits += 2) {
+            byClass[classKey(device.classCode, digits)].push_back(position);
+        }
+        byVendor[device.vendorId].push_back(position);
+
+        if (byVendor[device.vendorId].size() == 1) {
+            vendorNames.push_back({ lower(device.vendorName), device.vendorId });
+        }
+        std::string name = lower(device.vendorName + " " + device.deviceName);
+        auto slot = deviceSlots.emplace(name, deviceNames.size());
+        if (slot.second) deviceNames.push_back({ std::move(name), {} });
+        deviceNames[slot.first->second].positions.push_back(position);
+    }
+}
+
+bool PciInventoryIndex::matchClass(std::string_view value, std::vector<uint32_t>& positions, std::string& error) const {
+    std::string name = lower(value);
+    uint32_t code = 0;
+    int digits = 0;
+    for (const auto& entry : kClassNames) {
+        if (name == entry.name) {
+            code = (uint32_t)entry.baseClass << 16;
+            digits = 2;
+            break;
+        }
+    }
+    if (digits == 0) {
+        if (value.size() % 2 != 0 || !parseHex(value, code)) {
+            error = "class must be a class name (storage, network, ...) or a hex class code, not " + std::string(value);
+            return false;
+        }
+        digits = (int)value.size();
+        code <<= 4 * (6 - digits);
+    }
+    auto it = byClass.find(classKey(code, digits));
+    if (it != byClass.end()) unite(positions, it->second);
+    return true;
+}
+
+void PciInventoryIndex::matchVendor(std::string_view value, std::vector<uint32_t>& positions) const {
+    uint32_t id;
+    if (value.size() == 4 && parseHex(value, id)) {
+        auto it = byVendor.find((uint16_t)id);
+        if (it != byVendor.end()) unite(positions, it->second);
+        return;
+    }
+    std::string text = lower(value);
+    for (const auto& entry : vendorNames) {
+        if (entry.text.find(text) != std::string::npos) unite(positions, byVendor.at(entry.vendorId));
+    }
+}
+
+void PciInventoryIndex::matchName(std::string_view value, std::vector<uint32_t>& positions) const {
+    std::string text = lower(value);
+    for (const auto& entry : deviceNames) {
+        if (entry.text.find(text) != std::string::npos) unite(positions, entry.positions);
+    }
+}
+
+bool PciInventoryIndex::filter(const PciFilter& filter, std::vector<uint32_t>& positions, std::string& error) const {
+    positions.clear();
+    bool first = true;
+    // each filter narrows what the ones before it left
+    auto narrow = [&positions, &first](std::vector<uint32_t>& matched) {
+        std::sort(matched.begin(), matched.end());
+        matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+        if (first) {
+            positions.swap(matched);
+            first = false;
+            return;
+        }
+        std::vector<uint32_t> both;
+        std::set_intersection(positions.begin(), positions.end(), matched.begin(), matched.end(), std::back_inserter(both));
+        positions.swap(both);
+    };
+    if (!filter.classes.empty()) {
+        std::vector<uint32_t> matched;
+        if (!forEachItem(filter.classes, [&](std::string_view item) { return matchClass(item, matched, error); })) {
+            return false;
+        }
+        narrow(matched);
+    }
+    if (!filter.vendors.empty()) {
+        std::vector<uint32_t> matched;
+        forEachItem(filter.vendors, [&](std::string_view item) {
+            matchVendor(item, matched);
+            return true;
+        });
+        narrow(matched);
+    }
+    if (!filter.name.empty()) {
+        std::vector<uint32_t> matched;
+        matchName(filter.name, matched);
+        narrow(matched);
+    }
+    if (first) {
+        positions.resize(all.size());
+        for (uint32_t i = 0; i < all.size(); i++) positions[i] = i;
+    }
+    return true;
+}
+
+std::shared_ptr<const PciInventoryIndex> PciInventory::current() {
+    uint64_t generation = topology.refresh();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!index || index->generation() != generation) {
+        uint64_t nodesGeneration;
+        std::vector<PciTopologyNode> nodes = topology.nodes(nodesGeneration);
+        index = std::make_shared<const PciInventoryIndex>(std::move(nodes), nodesGeneration);
+    }
+    return index;
+}
@@ -0,0 +1,80 @@
+#ifndef PCI_INDEX_HPP
+#define PCI_INDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "pci_topology.hpp"
+
+// Filters of the PCI list, as given in the query string. Each one is a comma
+// separated list whose items are ORed; the filters are ANDed.
+//   classes: base class names ("storage", "network") or class code prefixes
+//            in hex ("01", "0108", "010802")
+//   vendors: vendor IDs in hex ("8086") or parts of vendor names ("intel")
+//   name:    part of the vendor or device name, any case; one item, names
+//            have commas in them
+struct PciFilter {
+    std::string classes;
+    std::string vendors;
+    std::string name;
+
+    bool empty() const { return classes.empty() && vendors.empty() && name.empty(); }
+};
+
+// One generation of the PCI list with secondary indexes over it: class code
+// prefixes and vendor IDs map to positions in nodes(), and every distinct
+// "vendor device" name is kept once, lower case, with its positions. A name
+// query scans the distinct names, which stay few even when SR-IOV adds
+// thousands of identical virtual functions. Immutable once built.
+class PciInventoryIndex {
+public:
+    PciInventoryIndex(std::vector<PciTopologyNode> nodes, uint64_t generation);
+
+    uint64_t generation() const { return generationNumber; }
+    const std::vector<PciTopologyNode>& nodes() const { return all; }
+
+    // Positions into nodes(), ascending. False with a message for a value
+    // that is neither a class name nor hex.
+    bool filter(const PciFilter& filter, std::vector<uint32_t>& positions, std::string& error) const;
+
+private:
+    struct VendorName {
+        std::string text;               // lower case
+        uint16_t vendorId;
+    };
+    struct DeviceName {
+        std::string text;               // "vendor device", lower case
+        std::vector<uint32_t> positions;
+    };
+    bool matchClass(std::string_view value, std::vector<uint32_t>& positions, std::string& error) const;
+    void matchVendor(std::string_view value, std::vector<uint32_t>& positions) const;
+    void matchName(std::string_view value, std::vector<uint32_t>& positions) const;
+
+    uint64_t generationNumber;
+    std::vector<PciTopologyNode> all;
+    // key: digits << 24 | class code with the rest zeroed, digits 2, 4 or 6
+    std::unordered_map<uint32_t, std::vector<uint32_t>> byClass;
+    std::unordered_map<uint16_t, std::vector<uint32_t>> byVendor;
+    std::vector<VendorName> vendorNames;
+    std::vector<DeviceName> deviceNames;
+};
+
+// The index of the topology's current generation, rebuilt on the first
+// request after the generation moved.
+class PciInventory {
+public:
+    explicit PciInventory(PciTopology& topology) : topology(topology) {}
+
+    std::shared_ptr<const PciInventoryIndex> current();
+
+private:
+    PciTopology& topology;
+    std::mutex mutex;
+    std::shared_ptr<const PciInventoryIndex> index;
+};
+
+#endif // PCI_INDEX_HPP
@@ -0,0 +1,234 @@
+#ifdef __linux__
+
+#include "pci_sysfs.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// below this many devices the calling thread reads them alone
+static const size_t kParallelDevices = 48;
+
+SysfsPciEnumerator::SysfsPciEnumerator(std::string root, unsigned workers)
+    : sysfsRoot(std::move(root)), pool(workers) {}
+
+// Attribute text into buffer, without the trailing newline. 0 if missing or
+// unreadable (link attributes fail with EINVAL on devices that are not PCIe).
+static size_t readAttribute(int dir, const char* name, char* buffer, size_t size) {
+    int fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length <= 0) return 0;
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == ' ')) length--;
+    buffer[length] = '\0';
+    return (size_t)length;
+}
+
+// "0x8086"
+static bool readHex(int dir, const char* name, unsigned long& value) {
+    char buffer[32];
+    if (readAttribute(dir, name, buffer, sizeof(buffer)) == 0) return false;
+    char* end;
+    value = strtoul(buffer, &end, 16);
+    return end != buffer;
+}
+
+// "8.0 GT/s PCIe", "Unknown" (no link) reads as 0
+static float readLinkSpeed(int dir, const char* name) {
+    char buffer[64];
+    if (readAttribute(dir, name, buffer, sizeof(buffer)) == 0) return 0;
+    return strtof(buffer, nullptr);
+}
+
+static int readLinkWidth(int dir, const char* name) {
+    char buffer[16];
+    if (readAttribute(dir, name, buffer, sizeof(buffer)) == 0) return 0;
+    return atoi(buffer);
+}
+
+// One "start end flags" line per BAR, then the ROM and the bridge windows;
+// unused ones are all zeros.
+static void readResources(int dir, std::vector<PciResource>& resources) {
+    char buffer[2048];
+    if (readAttribute(dir, "resource", buffer, sizeof(buffer)) == 0) return;
+    char* line = buffer;
+    for (uint8_t index = 0; line && *line && index <= 6; index++) {
+        char* end;
+        PciResource resource;
+        resource.index = index;
+        resource.start = strtoull(line, &end, 16);
+        uint64_t last = strtoull(end, &end, 16);
+        resource.flags = strtoull(end, &end, 16);
+        if (last > resource.start || resource.flags) {
+            resource.size = last - resource.start + 1;
+            resources.push_back(resource);
+        }
+        line = strchr(end, '\n');
+        if (line) line++;
+    }
+}
+
+// The standard header at the start of config space holds the IDs, class and
+// revision, so one read replaces six attribute files. Unprivileged reads get
+// the first 64 bytes, which is all that is needed here.
+static bool readConfigHeader(int dir, PciDeviceRecord& record) {
+    uint8_t header[64];
+    int fd = openat(dir, "config", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t length = pread(fd, header, sizeof(header), 0);
+    close(fd);
+    if (length < (ssize_t)sizeof(header)) return false;
+    auto word = [&header](int offset) { return (uint16_t)(header[offset] | header[offset + 1] << 8); };
+    if (word(0x00) == 0xFFFF) return false;
+    record.vendorId = word(0x00);
+    record.deviceId = word(0x02);
+    record.revision = header[0x08];
+    record.classCode = (uint32_t)header[0x0B] << 16 | (uint32_t)header[0x0A] << 8 | header[0x09];
+    // only type 0 headers have the subsystem here; bridges keep it in a capability
+    if ((header[0x0E] & 0x7F) != 0) return false;
+    record.subsystemVendorId = word(0x2C);
+    record.subsystemDeviceId = word(0x2E);
+    return true;
+}
+
+// <root>/bus/pci/devices/<address> links to the device's place in the tree,
+// e.g. ../../../devices/pci0000:00/0000:00:1c.0/0000:02:00.0, so the path
+// component before the address is the upstream bridge (or "pci0000:00").
+static void readParent(int devicesDir, const char* address, std::string& parent) {
+    char target[512];
+    ssize_t length = readlinkat(devicesDir, address, target, sizeof(target) - 1);
+    if (length <= 0) return;
+    target[length] = '\0';
+    char* last = strrchr(target, '/');
+    if (!last) return;
+    *last = '\0';
+    char* previous = strrchr(target, '/');
+    const char* component = previous ? previous + 1 : target;
+    if (strncmp(component, "pci", 3) != 0 && strchr(component, ':') && strchr(component, '.')) {
+        parent = component;
+    }
+}
+
+// the last component of a symlink in dir, e.g. driver -> ../../bus/pci/drivers/nvme
+static bool readLinkName(int dir, const char* name, std::string& value) {
+    char target[512];
+    ssize_t length = readlinkat(dir, name, target, sizeof(target) - 1);
+    if (length <= 0) return false;
+    target[length] = '\0';
+    const char* last = strrchr(target, '/');
+    value = last ? last + 1 : target;
+    return true;
+}
+
+bool SysfsPciEnumerator::readDevice(int devicesDir, const char* address, PciDeviceRecord& record) {
+    int dir = openat(devicesDir, address, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0) return false;
+
+    record.address = address;
+    bool found = readConfigHeader(dir, record);
+    if (!found) {
+        // no config file (or a bridge): the kernel's attributes, one per file
+        unsigned long vendor, device, value;
+        found = record.vendorId != 0xFFFF ||
+                (readHex(dir, "vendor", vendor) && readHex(dir, "device", device));
+        if (found && record.vendorId == 0xFFFF) {
+            record.vendorId = (uint16_t)vendor;
+            record.deviceId = (uint16_t)device;
+            if (readHex(dir, "class", value)) record.classCode = (uint32_t)value & 0xFFFFFF;
+            if (readHex(dir, "revision", value)) record.revision = (uint8_t)value;
+        }
+        if (found) {
+            if (readHex(dir, "subsystem_vendor", value)) record.subsystemVendorId = (uint16_t)value;
+            if (readHex(dir, "subsystem_device", value)) record.subsystemDeviceId = (uint16_t)value;
+        }
+    }
+    if (found) {
+        readParent(devicesDir, address, record.parent);
+        // a rebind changes the record, so the device's generation moves
+        readLinkName(dir, "driver", record.driver);
+        // conventional PCI devices fail the first read, and so would the rest
+        record.linkSpeed = readLinkSpeed(dir, "current_link_speed");
+        if (record.linkSpeed > 0) {
+            record.linkWidth = readLinkWidth(dir, "current_link_width");
+            record.maxLinkSpeed = readLinkSpeed(dir, "max_link_speed");
+            record.maxLinkWidth = readLinkWidth(dir, "max_link_width");
+        }
+        readResources(dir, record.resources);
+    }
+    close(dir);
+    return found;
+}
+
+size_t SysfsPciEnumerator::readConfig(const std::string& address, uint8_t* buffer, size_t size) const {
+    // the address comes from a URL, so it may only name an entry of the directory
+    if (address.empty() || address[0] == '.' || address.find('/') != std::string::npos) return 0;
+    std::string path = sysfsRoot + "/bus/pci/devices/" + address + "/config";
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    size_t total = 0;
+    while (total < size) {
+        ssize_t length = pread(fd, buffer + total, size - total, (off_t)total);
+        if (length <= 0) break;
+        total += (size_t)length;
+    }
+    close(fd);
+    return total;
+}
+
+int SysfsPciEnumerator::readIommuGroup(const std::string& address) const {
+    if (address.empty() || address[0] == '.' || address.find('/') != std::string::npos) return -1;
+    std::string path = sysfsRoot + "/bus/pci/devices/" + address;
+    int dir = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0) return -1;
+    std::string group;
+    bool linked = readLinkName(dir, "iommu_group", group);
+    close(dir);
+    return linked && !group.empty() ? atoi(group.c_str()) : -1;
+}
+
+std::vector<PciDeviceRecord> SysfsPciEnumerator::enumerate() {
+    std::vector<PciDeviceRecord> devices;
+    std::string path = sysfsRoot + "/bus/pci/devices";
+    int devicesDir = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (devicesDir < 0) return devices;
+
+    std::vector<std::string> addresses;
+    // fdopendir takes the descriptor over, so it gets its own copy
+    DIR* listing = fdopendir(dup(devicesDir));
+    if (listing) {
+        while (dirent* entry = readdir(listing)) {
+            if (entry->d_name[0] != '.') addresses.push_back(entry->d_name);
+        }
+        closedir(listing);
+    }
+    // "dddd:bb:dd.f" is fixed width, so text order is address order
+    std::sort(addresses.begin(), addresses.end());
+
+    devices.resize(addresses.size());
+    std::vector<char> found(addresses.size(), 0);
+    auto read = [&](size_t i) {
+        found[i] = readDevice(devicesDir, addresses[i].c_str(), devices[i]);
+    };
+    // a laptop's few dozen devices are read before the workers would be awake
+    if (addresses.size() < kParallelDevices) {
+        for (size_t i = 0; i < addresses.size(); i++) read(i);
+    } else {
+        pool.parallelFor(addresses.size(), read);
+    }
+    close(devicesDir);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+        if (found[i]) {
+            if (kept != i) devices[kept] = std::move(devices[i]);
+            kept++;
+        }
+    }
+    devices.resize(kept);
+    return devices;
+}
+
+#endif // __linux__
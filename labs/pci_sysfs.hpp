@@ -0,0 +1,45 @@
+#ifndef PCI_SYSFS_HPP
+#define PCI_SYSFS_HPP
+
+#ifdef __linux__
+
+#include <string>
+#include <vector>
+#include "lab_02.hpp"
+#include "worker_pool.hpp"
+
+// Lists <root>/bus/pci/devices and reads each device's attributes (IDs, class,
+// link, resources) relative to a descriptor of its directory. Larger trees
+// are spread over a small worker pool, since the cost is one open/read/close
+// per attribute and nothing else; a few dozen devices are read inline. The root is configurable so a fake tree can
+// stand in for /sys.
+//
+// Names are left empty; EnumeratePCIDevices() fills them in.
+class SysfsPciEnumerator {
+public:
+    explicit SysfsPciEnumerator(std::string sysfsRoot = "/sys", unsigned workers = 0);
+
+    // sorted by address
+    std::vector<PciDeviceRecord> enumerate();
+    const std::string& root() const { return sysfsRoot; }
+    unsigned threadCount() const { return pool.threadCount(); }
+
+    // Raw config space of one device (<root>/bus/pci/devices/<address>/config)
+    // into buffer. Bytes read, 0 for an unknown address. Without privileges
+    // the kernel returns the first 64 bytes only.
+    size_t readConfig(const std::string& address, uint8_t* buffer, size_t size) const;
+
+    // number at the end of <address>/iommu_group, -1 without one
+    int readIommuGroup(const std::string& address) const;
+
+    // reads one device directory (<root>/bus/pci/devices/<address>), false if it has no IDs
+    static bool readDevice(int devicesDir, const char* address, PciDeviceRecord& record);
+
+private:
+    std::string sysfsRoot;
+    WorkerPool pool;
+};
+
+#endif // __linux__
+
+#endif // PCI_SYSFS_HPP
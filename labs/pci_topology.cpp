@@ -0,0 +1,170 @@
+#include "pci_topology.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+PciTopology::PciTopology(Enumerate enumerateDevices, size_t maxLog)
+    : enumerate(enumerateDevices ? std::move(enumerateDevices) : Enumerate(EnumeratePCIDevices)),
+      maxLogEntries(maxLog ? maxLog : 1) {
+    currentGeneration = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    logStart = currentGeneration;
+}
+
+bool PciTopology::parseAddress(const std::string& address, PciTopologyNode& node) {
+    unsigned domain, bus, slot, function;
+    int length = 0;
+    if (sscanf(address.c_str(), "%4x:%2x:%2x.%1x%n", &domain, &bus, &slot, &function, &length) != 4 ||
+        (size_t)length != address.size()) {
+        return false;
+    }
+    node.domain = (uint16_t)domain;
+    node.bus = (uint8_t)bus;
+    node.slot = (uint8_t)slot;
+    node.function = (uint8_t)function;
+    return true;
+}
+
+uint64_t PciTopology::refresh(std::chrono::milliseconds maxAge) {
+    std::lock_guard<std::mutex> refreshLock(refreshMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (enumerated && std::chrono::steady_clock::now() - enumeratedAt < maxAge) {
+            return currentGeneration;
+        }
+    }
+    // enumerating takes milliseconds, readers are not held up meanwhile
+    return update(enumerate());
+}
+
+void PciTopology::addListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    listeners.push_back(std::move(listener));
+}
+
+uint64_t PciTopology::update(std::vector<PciDeviceRecord> records) {
+    std::unique_lock<std::mutex> lock(mutex);
+    enumerated = true;
+    enumeratedAt = std::chrono::steady_clock::now();
+
+    uint64_t next = currentGeneration + 1;
+    std::vector<LogEntry> entries;
+    std::map<std::string, PciTopologyNode> updated;
+    for (auto& record : records) {
+        PciTopologyNode node;
+        parseAddress(record.address, node);
+        auto old = devices.find(record.address);
+        if (old == devices.end()) {
+            node.generation = next;
+            entries.push_back({ next, PciChangeKind::Added, record.address });
+        } else if (!(old->second.device == record)) {
+            node.generation = next;
+            entries.push_back({ next, PciChangeKind::Changed, record.address });
+        } else {
+            node.generation = old->second.generation;
+        }
+        std::string address = record.address;
+        node.device = std::move(record);
+        updated.emplace(std::move(address), std::move(node));
+    }
+    for (const auto& [address, node] : devices) {
+        if (!updated.count(address)) {
+            entries.push_back({ next, PciChangeKind::Removed, address });
+        }
+    }
+    if (entries.empty()) return currentGeneration;
+
+    devices.swap(updated);
+    linkChildren();
+    currentGeneration = next;
+    for (auto& entry : entries) log.push_back(std::move(entry));
+    while (log.size() > maxLogEntries) {
+        // entries of this generation are going, so it is the oldest complete "since"
+        logStart = log.front().generation;
+        log.pop_front();
+    }
+    // generations are rare, copying the records keeps listeners outside the lock
+    uint64_t generation = currentGeneration;
+    std::vector<PciDeviceRecord> current;
+    current.reserve(devices.size());
+    for (const auto& [address, node] : devices) current.push_back(node.device);
+    lock.unlock();
+
+    std::lock_guard<std::mutex> listenersLock(listenersMutex);
+    for (auto& listener : listeners) listener(generation, current);
+    return generation;
+}
+
+void PciTopology::linkChildren() {
+    for (auto& [address, node] : devices) node.children.clear();
+    for (const auto& [address, node] : devices) {
+        auto parent = devices.find(node.device.parent);
+        if (parent != devices.end()) parent->second.children.push_back(address);
+    }
+}
+
+uint64_t PciTopology::generation() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return currentGeneration;
+}
+
+std::vector<PciTopologyNode> PciTopology::nodes(uint64_t& generation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation = currentGeneration;
+    std::vector<PciTopologyNode> result;
+    result.reserve(devices.size());
+    for (const auto& [address, node] : devices) result.push_back(node);
+    return result;
+}
+
+std::vector<std::string> PciTopology::roots() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> result;
+    for (const auto& [address, node] : devices) {
+        if (!devices.count(node.device.parent)) result.push_back(address);
+    }
+    return result;
+}
+
+bool PciTopology::find(const std::string& address, PciTopologyNode& node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = devices.find(address);
+    if (it == devices.end()) return false;
+    node = it->second;
+    return true;
+}
+
+PciChanges PciTopology::changesSince(uint64_t since) {
+    std::lock_guard<std::mutex> lock(mutex);
+    PciChanges changes;
+    changes.generation = currentGeneration;
+    if (since == currentGeneration) return changes;
+    if (since < logStart || since > currentGeneration) {
+        changes.reset = true;
+        for (const auto& [address, node] : devices) changes.added.push_back(node);
+        return changes;
+    }
+
+    // the first entry after since tells whether the node existed at since
+    auto first = std::upper_bound(log.begin(), log.end(), since, [](uint64_t value, const LogEntry& entry) {
+        return value < entry.generation;
+    });
+    std::unordered_map<std::string, bool> existedAtSince;
+    std::vector<const std::string*> touched;
+    for (auto it = first; it != log.end(); ++it) {
+        if (existedAtSince.emplace(it->address, it->kind != PciChangeKind::Added).second) {
+            touched.push_back(&it->address);
+        }
+    }
+    std::sort(touched.begin(), touched.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+    for (const std::string* address : touched) {
+        bool existed = existedAtSince[*address];
+        auto now = devices.find(*address);
+        if (now != devices.end()) {
+            (existed ? changes.changed : changes.added).push_back(now->second);
+        } else if (existed) {
+            changes.removed.push_back(*address);
+        }
+    }
+    return changes;
+}
@@ -0,0 +1,91 @@
+#ifndef PCI_TOPOLOGY_HPP
+#define PCI_TOPOLOGY_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "lab_02.hpp"
+
+struct PciTopologyNode {
+    PciDeviceRecord device;
+    uint16_t domain = 0;
+    uint8_t bus = 0;
+    uint8_t slot = 0;           // device number
+    uint8_t function = 0;
+    uint64_t generation = 0;    // when the node was added or last changed
+    std::vector<std::string> children;  // functions behind this bridge
+};
+
+enum class PciChangeKind { Added, Removed, Changed };
+
+struct PciChanges {
+    uint64_t generation = 0;    // the generation the changes lead to
+    // since was older than the kept log (or from another run): reload everything
+    bool reset = false;
+    std::vector<PciTopologyNode> added;
+    std::vector<PciTopologyNode> changed;
+    std::vector<std::string> removed;
+};
+
+// The PCI functions keyed by address, with a generation number that goes up
+// by one for every enumeration that differs from the last. Each difference
+// is logged with its generation, so a client that has seen generation N asks
+// for changesSince(N) and gets only the nodes that were added, removed or
+// changed after it, folded into their final state.
+class PciTopology {
+public:
+    using Enumerate = std::function<std::vector<PciDeviceRecord>()>;
+    using Listener = std::function<void(uint64_t generation, const std::vector<PciDeviceRecord>& devices)>;
+
+    // enumerate defaults to EnumeratePCIDevices
+    explicit PciTopology(Enumerate enumerate = nullptr, size_t maxLogEntries = 4096);
+
+    // Enumerates again if the last enumeration is older than maxAge
+    uint64_t refresh(std::chrono::milliseconds maxAge = std::chrono::milliseconds(1000));
+    // Applies an enumeration; returns the generation after it
+    uint64_t update(std::vector<PciDeviceRecord> devices);
+
+    uint64_t generation();
+    // Called with every new generation, on the thread whose refresh() or
+    // update() produced it, after the model has been updated
+    void addListener(Listener listener);
+    // all nodes sorted by address, with the generation they belong to
+    std::vector<PciTopologyNode> nodes(uint64_t& generation);
+    // functions on root buses, the tree starts from them
+    std::vector<std::string> roots();
+    bool find(const std::string& address, PciTopologyNode& node);
+    PciChanges changesSince(uint64_t since);
+
+    static bool parseAddress(const std::string& address, PciTopologyNode& node);
+
+private:
+    struct LogEntry {
+        uint64_t generation;
+        PciChangeKind kind;
+        std::string address;
+    };
+    void linkChildren();
+
+    Enumerate enumerate;
+    size_t maxLogEntries;
+    std::mutex listenersMutex;
+    std::vector<Listener> listeners;
+    std::mutex refreshMutex;        // one enumeration at a time
+    std::mutex mutex;
+    std::map<std::string, PciTopologyNode> devices;
+    std::deque<LogEntry> log;
+    // Generations start from the startup time in milliseconds, so a client
+    // holding a generation from before a restart is told to reload.
+    uint64_t currentGeneration = 0;
+    // changes after this generation are all in the log
+    uint64_t logStart = 0;
+    bool enumerated = false;
+    std::chrono::steady_clock::time_point enumeratedAt;
+};
+
+#endif // PCI_TOPOLOGY_HPP
@@ -0,0 +1,57 @@
+#ifndef PCI_VENDORS_HPP
+#define PCI_VENDORS_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include "pci_codes.h"
+
+// Minimal perfect hash over the 16-bit vendor IDs of PciVenTable, built at
+// compile time. One bit per possible ID says whether the vendor is known;
+// the number of set bits below it is the vendor's index in the (sorted)
+// table. A lookup is a shift, a mask and a popcount, and the whole index is
+// 10 KB of read-only data.
+class PciVendorIndex {
+public:
+    constexpr PciVendorIndex(const PCI_VENTABLE* table, size_t count) : table(table) {
+        for (size_t i = 0; i < count; i++) {
+            uint16_t id = table[i].VenId;
+            present[id >> 6] |= uint64_t(1) << (id & 63);
+        }
+        uint16_t rank = 0;
+        for (size_t word = 0; word < kWords; word++) {
+            ranks[word] = rank;
+            rank += (uint16_t)std::popcount(present[word]);
+        }
+    }
+
+    // nullptr for an unknown vendor
+    constexpr const PCI_VENTABLE* find(uint16_t id) const {
+        uint64_t word = present[id >> 6];
+        uint64_t bit = uint64_t(1) << (id & 63);
+        if (!(word & bit)) return nullptr;
+        return &table[ranks[id >> 6] + std::popcount(word & (bit - 1))];
+    }
+
+    static constexpr bool isStrictlySorted(const PCI_VENTABLE* table, size_t count) {
+        for (size_t i = 1; i < count; i++) {
+            if (table[i - 1].VenId >= table[i].VenId) return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t kWords = 65536 / 64;
+    const PCI_VENTABLE* table;
+    std::array<uint64_t, kWords> present{};
+    std::array<uint16_t, kWords> ranks{};
+};
+
+// the rank is only the table index if the IDs are in ascending order
+static_assert(PciVendorIndex::isStrictlySorted(PciVenTable, PCI_VENTABLE_LEN),
+              "PciVenTable must be sorted by VenId without duplicates");
+
+inline constexpr PciVendorIndex PciVendors(PciVenTable, PCI_VENTABLE_LEN);
+
+#endif // PCI_VENDORS_HPP
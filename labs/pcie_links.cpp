@@ -0,0 +1,273 @@
+#include "pcie_links.hpp"
+#include "timer_slack.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char* kAerFiles[3] = { "aer_dev_correctable", "aer_dev_nonfatal", "aer_dev_fatal" };
+
+PcieLinkMonitor::PcieLinkMonitor(std::string root, size_t history, size_t openFiles)
+    : sysfsRoot(std::move(root)), historyLength(history), maxOpenFiles(openFiles) {}
+
+PcieLinkMonitor::~PcieLinkMonitor() {
+    stop();
+    std::lock_guard<std::mutex> lock(sampleMutex);
+    for (auto& device : devices) closeFiles(*device);
+}
+
+bool PcieLinkMonitor::openFile(CounterFile& file, const std::string& path) {
+#ifdef __linux__
+    // probe it, a missing file means the kernel does not report it
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    file.path = path;
+    if (openCount < maxOpenFiles) {
+        file.fd = fd;
+        openCount++;
+    } else {
+        close(fd);
+    }
+    return true;
+#else
+    (void)file;
+    (void)path;
+    return false;
+#endif
+}
+
+bool PcieLinkMonitor::readFile(CounterFile& file, char* buffer, size_t size, size_t& length) {
+    length = 0;
+#ifdef __linux__
+    ssize_t count;
+    if (file.fd >= 0) {
+        count = pread(file.fd, buffer, size - 1, 0);
+    } else {
+        int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        count = read(fd, buffer, size - 1);
+        close(fd);
+    }
+    if (count <= 0) return false;
+    length = (size_t)count;
+    buffer[length] = '\0';
+    if (file.last.size() == length && memcmp(file.last.data(), buffer, length) == 0) return false;
+    file.last.assign(buffer, length);
+    return true;
+#else
+    (void)file;
+    (void)buffer;
+    (void)size;
+    return false;
+#endif
+}
+
+void PcieLinkMonitor::closeFiles(Device& device) {
+#ifdef __linux__
+    CounterFile* files[] = { &device.speedFile, &device.widthFile, &device.aerFiles[0], &device.aerFiles[1], &device.aerFiles[2] };
+    for (CounterFile* file : files) {
+        if (file->fd >= 0) {
+            close(file->fd);
+            file->fd = -1;
+            openCount--;
+        }
+    }
+#else
+    (void)device;
+#endif
+}
+
+void PcieLinkMonitor::setDevices(const std::vector<PciDeviceRecord>& records) {
+    std::lock_guard<std::mutex> sampleLock(sampleMutex);
+    std::vector<std::unique_ptr<Device>> kept;
+    for (const auto& record : records) {
+        if (record.maxLinkWidth <= 0) continue;
+        auto existing = std::find_if(devices.begin(), devices.end(), [&record](const std::unique_ptr<Device>& device) {
+            return device && device->address == record.address;
+        });
+        if (existing != devices.end()) {
+            kept.push_back(std::move(*existing));
+            continue;
+        }
+        auto device = std::make_unique<Device>(historyLength);
+        device->address = record.address;
+        device->maxLinkSpeed = record.maxLinkSpeed;
+        device->maxLinkWidth = record.maxLinkWidth;
+        std::string directory = sysfsRoot + "/bus/pci/devices/" + record.address + "/";
+        openFile(device->speedFile, directory + "current_link_speed");
+        openFile(device->widthFile, directory + "current_link_width");
+        device->hasAer = true;
+        for (int i = 0; i < 3; i++) {
+            device->hasAer = openFile(device->aerFiles[i], directory + kAerFiles[i]) && device->hasAer;
+        }
+        kept.push_back(std::move(device));
+    }
+    for (auto& device : devices) {
+        if (device) closeFiles(*device);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.swap(kept);
+}
+
+// "TOTAL_ERR_COR 3" closes the list on current kernels; without it, the
+// per-error lines are summed
+static uint64_t parseAerTotal(const char* text) {
+    const char* total = strstr(text, "TOTAL_");
+    if (total) {
+        const char* value = strchr(total, ' ');
+        return value ? strtoull(value, nullptr, 10) : 0;
+    }
+    uint64_t sum = 0;
+    for (const char* line = text; line && *line; ) {
+        const char* value = strchr(line, ' ');
+        const char* end = strchr(line, '\n');
+        if (value && (!end || value < end)) sum += strtoull(value, nullptr, 10);
+        line = end ? end + 1 : nullptr;
+    }
+    return sum;
+}
+
+static uint64_t nowMilliseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+size_t PcieLinkMonitor::sampleOnce(uint64_t nowMs) {
+    if (nowMs == 0) nowMs = nowMilliseconds();
+    std::lock_guard<std::mutex> sampleLock(sampleMutex);
+    size_t changedDevices = 0;
+    char buffer[1024];
+    size_t length;
+    for (auto& pointer : devices) {
+        Device& device = *pointer;
+        bool speedChanged = readFile(device.speedFile, buffer, sizeof(buffer), length);
+        float speed = speedChanged ? strtof(buffer, nullptr) : 0;
+        bool widthChanged = readFile(device.widthFile, buffer, sizeof(buffer), length);
+        int width = widthChanged ? atoi(buffer) : 0;
+        bool aerChanged[3];
+        uint64_t aerTotals[3] = { 0, 0, 0 };
+        for (int i = 0; i < 3; i++) {
+            aerChanged[i] = device.hasAer && readFile(device.aerFiles[i], buffer, sizeof(buffer), length);
+            if (aerChanged[i]) aerTotals[i] = parseAerTotal(buffer);
+        }
+        if (!speedChanged && !widthChanged && !aerChanged[0] && !aerChanged[1] && !aerChanged[2]) continue;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        PcieLinkSample sample = device.current;
+        sample.timestampMs = nowMs;
+        sample.correctable = sample.nonFatal = sample.fatal = 0;
+        if (speedChanged) sample.linkSpeed = speed;
+        if (widthChanged) sample.linkWidth = (uint8_t)width;
+        uint32_t* deltas[3] = { &sample.correctable, &sample.nonFatal, &sample.fatal };
+        for (int i = 0; i < 3; i++) {
+            if (!aerChanged[i]) continue;
+            // the first read is the baseline; a reset (lower total) counts from zero
+            if (device.sampled) {
+                uint64_t delta = aerTotals[i] >= device.totals[i] ? aerTotals[i] - device.totals[i] : aerTotals[i];
+                *deltas[i] = (uint32_t)std::min<uint64_t>(delta, UINT32_MAX);
+            }
+            device.totals[i] = aerTotals[i];
+        }
+        if (device.sampled && (sample.linkWidth < device.current.linkWidth || sample.linkSpeed < device.current.linkSpeed)) {
+            device.downtrains++;
+        }
+        device.current = sample;
+        device.sampled = true;
+        device.history.push(sample);
+        changedDevices++;
+    }
+    return changedDevices;
+}
+
+void PcieLinkMonitor::samplerLoop() {
+    while (running) {
+        sampleOnce();
+        adoptTimerSlack();
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(periodMs.load()), [this] { return !running; });
+    }
+}
+
+void PcieLinkMonitor::start(std::chrono::milliseconds period) {
+    setPeriod(period);
+    if (running.exchange(true)) return;
+    sampler = std::thread(&PcieLinkMonitor::samplerLoop, this);
+}
+
+void PcieLinkMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (sampler.joinable()) sampler.join();
+}
+
+void PcieLinkMonitor::setPeriod(std::chrono::milliseconds period) {
+    periodMs = std::max<int64_t>(period.count(), 10);
+}
+
+std::vector<PcieLinkHealth> PcieLinkMonitor::health(uint64_t windowMs, uint64_t nowMs) {
+    if (nowMs == 0) nowMs = nowMilliseconds();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<PcieLinkHealth> result;
+    result.reserve(devices.size());
+    for (const auto& pointer : devices) {
+        const Device& device = *pointer;
+        PcieLinkHealth item;
+        item.address = device.address;
+        item.linkSpeed = device.current.linkSpeed;
+        item.linkWidth = device.current.linkWidth;
+        item.maxLinkSpeed = device.maxLinkSpeed;
+        item.maxLinkWidth = device.maxLinkWidth;
+        item.widthDegraded = device.sampled && item.linkWidth > 0 && item.linkWidth < item.maxLinkWidth;
+        item.speedDegraded = device.sampled && item.linkSpeed > 0 && item.linkSpeed < item.maxLinkSpeed;
+        item.downtrains = device.downtrains;
+        item.hasAer = device.hasAer;
+        item.correctable = device.totals[0];
+        item.nonFatal = device.totals[1];
+        item.fatal = device.totals[2];
+        // history only has the ticks that changed, so the sums are the counts
+        if (windowMs > 0) {
+            uint64_t start = nowMs > windowMs ? nowMs - windowMs : 0;
+            uint64_t sums[3] = { 0, 0, 0 };
+            for (size_t i = device.history.size(); i-- > 0; ) {
+                const PcieLinkSample& sample = device.history[i];
+                if (sample.timestampMs <= start) break;
+                sums[0] += sample.correctable;
+                sums[1] += sample.nonFatal;
+                sums[2] += sample.fatal;
+            }
+            double minutes = windowMs / 60000.0;
+            item.correctablePerMinute = sums[0] / minutes;
+            item.nonFatalPerMinute = sums[1] / minutes;
+            item.fatalPerMinute = sums[2] / minutes;
+        }
+        result.push_back(std::move(item));
+    }
+    return result;
+}
+
+bool PcieLinkMonitor::history(const std::string& address, std::vector<PcieLinkSample>& samples) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& device : devices) {
+        if (device->address != address) continue;
+        samples.clear();
+        for (size_t i = 0; i < device->history.size(); i++) samples.push_back(device->history[i]);
+        return true;
+    }
+    return false;
+}
+
+size_t PcieLinkMonitor::deviceCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return devices.size();
+}
+
+size_t PcieLinkMonitor::openFiles() {
+    std::lock_guard<std::mutex> lock(sampleMutex);
+    return openCount;
+}
@@ -0,0 +1,126 @@
+#ifndef PCIE_LINKS_HPP
+#define PCIE_LINKS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lab_02.hpp"
+#include "ring_buffer.hpp"
+
+// One entry of a device's history: the link at that moment and how many AER
+// errors were counted since the entry before. Entries are only kept for
+// ticks where something changed, so a quiet device costs no history.
+struct PcieLinkSample {
+    uint64_t timestampMs = 0;
+    float linkSpeed = 0;        // GT/s
+    uint8_t linkWidth = 0;
+    uint32_t correctable = 0;
+    uint32_t nonFatal = 0;
+    uint32_t fatal = 0;
+};
+
+struct PcieLinkHealth {
+    std::string address;
+    float linkSpeed = 0;
+    int linkWidth = 0;
+    float maxLinkSpeed = 0;
+    int maxLinkWidth = 0;
+    // Below what the link is capable of. Fewer lanes is the failure this
+    // is for; a slower speed can also be power saving (ASPM, idle GPUs).
+    bool widthDegraded = false;
+    bool speedDegraded = false;
+    uint32_t downtrains = 0;    // times the width or speed dropped while sampled
+    bool hasAer = false;
+    uint64_t correctable = 0;   // totals as the kernel reports them
+    uint64_t nonFatal = 0;
+    uint64_t fatal = 0;
+    double correctablePerMinute = 0;    // over the requested window
+    double nonFatalPerMinute = 0;
+    double fatalPerMinute = 0;
+};
+
+// Samples the PCIe link and the AER counters of the devices it is given.
+//
+// The attribute files (current_link_speed/width, aer_dev_correctable,
+// aer_dev_nonfatal, aer_dev_fatal) stay open and are re-read with one pread
+// each per tick; a file whose text is the same as last time is not parsed.
+// Files over the open-file budget are opened for each read instead.
+// Linux only, elsewhere the devices have no files and nothing is sampled.
+class PcieLinkMonitor {
+public:
+    explicit PcieLinkMonitor(std::string sysfsRoot = "/sys", size_t historyLength = 256, size_t maxOpenFiles = 512);
+    ~PcieLinkMonitor();
+    PcieLinkMonitor(const PcieLinkMonitor&) = delete;
+    PcieLinkMonitor& operator=(const PcieLinkMonitor&) = delete;
+
+    // Devices to sample; PCIe devices only, the rest are skipped. Devices
+    // already sampled keep their files and history.
+    void setDevices(const std::vector<PciDeviceRecord>& devices);
+    // One tick at nowMs (0 - the system clock). Returns the devices that changed.
+    size_t sampleOnce(uint64_t nowMs = 0);
+
+    void start(std::chrono::milliseconds period);
+    void stop();
+    bool isRunning() const { return running; }
+    // takes effect after the current wait
+    void setPeriod(std::chrono::milliseconds period);
+    std::chrono::milliseconds period() const { return std::chrono::milliseconds(periodMs.load()); }
+
+    // rates over the windowMs before nowMs (0 - the system clock)
+    std::vector<PcieLinkHealth> health(uint64_t windowMs = 60000, uint64_t nowMs = 0);
+    bool history(const std::string& address, std::vector<PcieLinkSample>& samples);
+    size_t deviceCount();
+    size_t openFiles();
+
+private:
+    struct CounterFile {
+        std::string path;
+        int fd = -1;
+        std::string last;       // text of the previous read
+    };
+    struct Device {
+        std::string address;
+        float maxLinkSpeed = 0;
+        int maxLinkWidth = 0;
+        // read by the sampler only
+        CounterFile speedFile, widthFile;
+        CounterFile aerFiles[3];
+        bool hasAer = false;
+        bool sampled = false;
+        // guarded by mutex
+        PcieLinkSample current;
+        uint64_t totals[3] = { 0, 0, 0 };
+        uint32_t downtrains = 0;
+        RingBuffer<PcieLinkSample> history;
+
+        explicit Device(size_t historyLength) : history(historyLength) {}
+    };
+    bool openFile(CounterFile& file, const std::string& path);
+    // true if the text differs from the last read
+    bool readFile(CounterFile& file, char* buffer, size_t size, size_t& length);
+    void closeFiles(Device& device);
+    void samplerLoop();
+
+    std::string sysfsRoot;
+    size_t historyLength;
+    size_t maxOpenFiles;
+    size_t openCount = 0;
+
+    std::mutex sampleMutex;     // device table and files: setDevices, sampleOnce
+    std::mutex mutex;           // sampled state
+    std::vector<std::unique_ptr<Device>> devices;
+
+    std::atomic<bool> running{false};
+    std::atomic<int64_t> periodMs{5000};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread sampler;
+};
+
+#endif // PCIE_LINKS_HPP
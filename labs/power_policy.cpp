@@ -0,0 +1,208 @@
+#include "power_policy.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#endif
+#include <cstdlib>
+#include <string>
+#include "timer_slack.hpp"
+
+PowerPolicy PowerPolicy::performance() {
+    return PowerPolicy();
+}
+
+PowerPolicy PowerPolicy::saver() {
+    PowerPolicy policy;
+    policy.mode = PowerPolicyMode::Saver;
+    policy.samplerPeriod = std::chrono::milliseconds(5000);
+    policy.previewInterval = std::chrono::milliseconds(1000);
+    policy.timerSlack = std::chrono::milliseconds(50);
+    policy.telemetryFlushInterval = std::chrono::milliseconds(15 * 60 * 1000);
+    policy.linkSamplerPeriod = std::chrono::milliseconds(30 * 1000);
+    policy.diskStatsPeriod = std::chrono::milliseconds(5000);
+    policy.blockRescanInterval = std::chrono::milliseconds(10 * 1000);
+    policy.deferBackgroundJobs = true;
+    return policy;
+}
+
+const char* powerPolicyModeToString(PowerPolicyMode mode) {
+    return mode == PowerPolicyMode::Saver ? "saver" : "performance";
+}
+
+static uint64_t unixTimeMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+PowerPolicyController::PowerPolicyController(PowerPolicy performance, PowerPolicy saver)
+    : performancePolicy(performance), saverPolicy(saver), policy(performance), changedAt(unixTimeMs()) {
+}
+
+PowerPolicyController::~PowerPolicyController() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobWake.notify_all();
+    if (jobThread.joinable()) jobThread.join();
+}
+
+void PowerPolicyController::update(const PowerStatus& power) {
+    if (!power.valid) return;
+    if (power.eco) {
+        apply(PowerPolicyMode::Saver, "eco");
+    } else if (power.acLine == AcLineStatus::Offline) {
+        apply(PowerPolicyMode::Saver, "battery");
+    } else if (power.acLine == AcLineStatus::Online) {
+        apply(PowerPolicyMode::Performance, "ac");
+    }
+}
+
+void PowerPolicyController::apply(PowerPolicyMode mode, const char* reason) {
+    PowerPolicy next;
+    std::vector<std::function<void(const PowerPolicy&)>> notify;
+    std::vector<Job> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (changes > 0 && policy.mode == mode) {
+            why = reason;
+            return;
+        }
+        policy = mode == PowerPolicyMode::Saver ? saverPolicy : performancePolicy;
+        why = reason;
+        changedAt = unixTimeMs();
+        changes++;
+        next = policy;
+        notify = listeners;
+        if (!policy.deferBackgroundJobs) {
+            released.swap(deferred);
+        }
+    }
+    for (auto& listener : notify) {
+        listener(next);
+    }
+    applyTimerSlack(next.timerSlack);
+    if (released.empty()) return;
+    // a deferred rescan can take minutes, not on the caller's (sampler) thread
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (stopping) return;
+        for (Job& job : released) {
+            jobs.push_back(std::move(job));
+        }
+        if (!jobThread.joinable()) {
+            jobThread = std::thread(&PowerPolicyController::jobLoop, this);
+        }
+    }
+    jobWake.notify_one();
+}
+
+void PowerPolicyController::jobLoop() {
+    std::unique_lock<std::mutex> lock(jobMutex);
+    while (true) {
+        jobWake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) return;
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+        adoptTimerSlack();
+        job.run();
+        lock.lock();
+    }
+}
+
+PowerPolicy PowerPolicyController::current() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return policy;
+}
+
+const char* PowerPolicyController::reason() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return why;
+}
+
+uint64_t PowerPolicyController::changedAtMs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return changedAt;
+}
+
+uint64_t PowerPolicyController::transitions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    // the first apply() sets the initial mode, it is not a transition
+    return changes > 0 ? changes - 1 : 0;
+}
+
+void PowerPolicyController::addListener(std::function<void(const PowerPolicy&)> listener) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listeners.push_back(std::move(listener));
+}
+
+void PowerPolicyController::runOrDefer(const std::string& name, std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (policy.deferBackgroundJobs) {
+            for (Job& queued : deferred) {
+                if (queued.name == name) {
+                    queued.run = std::move(job);
+                    return;
+                }
+            }
+            deferred.push_back({ name, std::move(job) });
+            return;
+        }
+    }
+    job();
+}
+
+std::vector<std::string> PowerPolicyController::deferredJobs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> names;
+    for (const Job& job : deferred) {
+        names.push_back(job.name);
+    }
+    return names;
+}
+
+void applyTimerSlack(std::chrono::milliseconds slack) {
+#ifdef _WIN32
+#ifdef PROCESS_POWER_THROTTLING_CURRENT_VERSION
+    // EcoQoS: lower clocks for our threads and no high timer resolution requests
+    PROCESS_POWER_THROTTLING_STATE state = {0};
+    state.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+    state.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED | PROCESS_POWER_THROTTLING_IGNORE_TIMER_RESOLUTION;
+    state.StateMask = slack.count() > 0 ? state.ControlMask : 0;
+    SetProcessInformation(GetCurrentProcess(), ProcessPowerThrottling, &state, sizeof(state));
+#endif
+#elif defined(__linux__)
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(slack).count();
+    timerSlackNs.store(ns, std::memory_order_relaxed);
+    timerSlackGeneration.fetch_add(1, std::memory_order_release);
+    adoptTimerSlack();
+    // the other threads through /proc/<tid>/timerslack_ns (Linux 4.6+; it is
+    // not under task/, and 0 is the default there too). Without CAP_SYS_NICE
+    // the kernel refuses, and they adopt it on their next wakeup instead
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks) return;
+    std::string value = std::to_string(ns);
+    pid_t self = (pid_t)gettid();
+    while (dirent* entry = readdir(tasks)) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9' || atoi(entry->d_name) == self) continue;
+        std::string path = std::string("/proc/") + entry->d_name + "/timerslack_ns";
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        if (write(fd, value.data(), value.size()) < 0) {
+            // EPERM: the same for every other thread
+            close(fd);
+            break;
+        }
+        close(fd);
+    }
+    closedir(tasks);
+#else
+    (void)slack;
+#endif
+}
@@ -0,0 +1,109 @@
+#ifndef POWER_POLICY_HPP
+#define POWER_POLICY_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lab_01.hpp"
+
+enum class PowerPolicyMode : uint8_t {
+    Performance,    // on AC
+    Saver,          // on battery or with battery saver on
+};
+
+// What each subsystem should do in one mode
+struct PowerPolicy {
+    PowerPolicyMode mode = PowerPolicyMode::Performance;
+    std::chrono::milliseconds samplerPeriod{1000};
+    // a preview request younger than this gets the previous frame again
+    std::chrono::milliseconds previewInterval{0};
+    // how late the OS may fire our timers so it can batch wakeups, 0 - default
+    std::chrono::milliseconds timerSlack{0};
+    // telemetry blocks are written at least this often
+    std::chrono::milliseconds telemetryFlushInterval{60 * 1000};
+    // PCIe link speed/width and AER counters are read this often
+    std::chrono::milliseconds linkSamplerPeriod{5000};
+    // /proc/diskstats is read at most this often, 0 - as configured
+    std::chrono::milliseconds diskStatsPeriod{0};
+    // the block device list is enumerated again after this when no uevents say when
+    std::chrono::milliseconds blockRescanInterval{1000};
+    bool deferBackgroundJobs = false;
+
+    static PowerPolicy performance();
+    static PowerPolicy saver();
+};
+
+const char* powerPolicyModeToString(PowerPolicyMode mode);
+
+// Picks the policy from the sampled power status and tells the subsystems.
+// update() is meant to be a sampler listener, so policy listeners run on
+// the sampler thread and must be quick. The deferred jobs released on the
+// way back to AC run one after another on the controller's job thread.
+class PowerPolicyController {
+public:
+    PowerPolicyController(PowerPolicy performance = PowerPolicy::performance(),
+                          PowerPolicy saver = PowerPolicy::saver());
+    // released jobs not started yet are dropped
+    ~PowerPolicyController();
+
+    // Saver on battery or with eco on, performance back on AC. An unknown
+    // AC state keeps the current mode.
+    void update(const PowerStatus& power);
+    // switches now (also the initial state for listeners added later)
+    void apply(PowerPolicyMode mode, const char* reason);
+
+    PowerPolicy current() const;
+    const char* reason() const;
+    uint64_t changedAtMs() const;
+    uint64_t transitions() const;
+
+    // called with the new policy on every mode change
+    void addListener(std::function<void(const PowerPolicy&)> listener);
+
+    // Runs job now, or queues it while the policy defers background jobs.
+    // A queued job with the same name is replaced, so repeated requests
+    // (another rescan, another flush) run once, on the job thread, when AC
+    // comes back.
+    void runOrDefer(const std::string& name, std::function<void()> job);
+    std::vector<std::string> deferredJobs() const;
+
+private:
+    struct Job {
+        std::string name;
+        std::function<void()> run;
+    };
+
+    PowerPolicy performancePolicy;
+    PowerPolicy saverPolicy;
+
+    mutable std::mutex mutex;
+    PowerPolicy policy;
+    const char* why = "startup";
+    uint64_t changedAt = 0;
+    uint64_t changes = 0;
+    std::vector<std::function<void(const PowerPolicy&)>> listeners;
+    std::vector<Job> deferred;
+
+    // released jobs, started on the first release
+    void jobLoop();
+    std::mutex jobMutex;
+    std::condition_variable jobWake;
+    std::deque<Job> jobs;
+    bool stopping = false;
+    std::thread jobThread;
+};
+
+// Lets the OS coalesce this process's timer wakeups. On Linux timer slack
+// is per thread: set here for the calling thread and, through
+// /proc/<tid>/timerslack_ns, for the others when the process may;
+// the rest pick it up in adoptTimerSlack() (timer_slack.hpp). EcoQoS power
+// throttling of the whole process on Windows.
+void applyTimerSlack(std::chrono::milliseconds slack);
+
+#endif // POWER_POLICY_HPP
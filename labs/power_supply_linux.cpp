@@ -0,0 +1,343 @@
+#ifdef __linux__
+
+#include "power_supply_linux.hpp"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/netlink.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+
+static const char* kAttributeFiles[] = {
+    "type", "online", "status", "capacity", "time_to_empty_now", "energy_now", "energy_full",
+    "energy_full_design", "power_now", "charge_now", "charge_full", "charge_full_design",
+    "current_now", "voltage_now", "voltage_min_design", "cycle_count", "technology"
+};
+
+// copies what fits and terminates, like strncpy without the padding
+static void copyName(char* to, size_t size, const char* from) {
+    size_t length = std::min(strlen(from), size - 1);
+    memcpy(to, from, length);
+    to[length] = '\0';
+}
+
+// sysfs "technology" to the four-letter codes Windows uses for chemistry
+static const char* chemistryCode(const std::string& technology) {
+    if (technology == "Li-ion") return "LION";
+    if (technology == "Li-poly") return "LiP";
+    if (technology == "NiMH") return "NiMH";
+    if (technology == "NiCd") return "NiCd";
+    if (technology == "LiFe") return "LiFe";
+    return technology.c_str();
+}
+
+NetlinkUeventSource::NetlinkUeventSource() {
+    sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (sock < 0) {
+        perror("uevent socket");
+        return;
+    }
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid = 0;
+    addr.nl_groups = 1; // kernel broadcast group
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("uevent bind");
+        close(sock);
+        sock = -1;
+    }
+}
+
+NetlinkUeventSource::~NetlinkUeventSource() {
+    if (sock >= 0) close(sock);
+}
+
+ssize_t NetlinkUeventSource::receive(char* buffer, size_t size) {
+    return recv(sock, buffer, size, MSG_DONTWAIT);
+}
+
+PipeUeventSource::PipeUeventSource() {
+    // packet mode keeps event boundaries like the netlink datagrams do
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK | O_DIRECT) < 0) {
+        perror("uevent pipe");
+    }
+}
+
+PipeUeventSource::~PipeUeventSource() {
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+}
+
+ssize_t PipeUeventSource::receive(char* buffer, size_t size) {
+    return read(fds[0], buffer, size);
+}
+
+bool PipeUeventSource::inject(const std::string& event) {
+    return write(fds[1], event.data(), event.size()) == (ssize_t)event.size();
+}
+
+LinuxPowerSupply::LinuxPowerSupply(std::string sysfsRoot, std::unique_ptr<UeventSource> source)
+    : root(std::move(sysfsRoot)), uevents(std::move(source)) {
+    if (!uevents) {
+        uevents = std::make_unique<NetlinkUeventSource>();
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    if (uevents->fd() >= 0) {
+        ev.data.fd = uevents->fd();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, uevents->fd(), &ev);
+    }
+    rescan();
+}
+
+LinuxPowerSupply::~LinuxPowerSupply() {
+    closeSupplies();
+    if (epollFd >= 0) close(epollFd);
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+void LinuxPowerSupply::closeSupplies() {
+    for (Supply& supply : supplies) {
+        for (int fd : supply.fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+    supplies.clear();
+}
+
+void LinuxPowerSupply::rescan() {
+    closeSupplies();
+    std::string dirPath = root + "/class/power_supply";
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir) {
+        return;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        Supply supply;
+        supply.name = entry->d_name;
+        for (int i = 0; i < AttributeCount; i++) {
+            std::string path = dirPath + "/" + supply.name + "/" + kAttributeFiles[i];
+            supply.fds[i] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        supplies.push_back(supply);
+    }
+    closedir(dir);
+    // stable order so BAT0 is always the first battery
+    std::sort(supplies.begin(), supplies.end(),
+              [](const Supply& a, const Supply& b) { return a.name < b.name; });
+}
+
+bool LinuxPowerSupply::readAttribute(const Supply& supply, Attribute attribute, std::string& value) const {
+    int fd = supply.fds[attribute];
+    if (fd < 0) return false;
+    char buffer[128];
+    // offset 0 makes sysfs regenerate the value, no lseek needed
+    ssize_t n = pread(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return false;
+    while (n > 0 && (buffer[n - 1] == '\n' || buffer[n - 1] == ' ')) n--;
+    value.assign(buffer, n);
+    return true;
+}
+
+long LinuxPowerSupply::readNumber(const Supply& supply, Attribute attribute, long fallback) const {
+    std::string value;
+    if (!readAttribute(supply, attribute, value) || value.empty()) return fallback;
+    char* end = nullptr;
+    long number = strtol(value.c_str(), &end, 10);
+    return end == value.c_str() ? fallback : number;
+}
+
+void LinuxPowerSupply::fill(BatterySnapshot& snapshot) {
+    bool haveMains = false;
+    bool mainsOnline = false;
+    bool haveBattery = false;
+    bool charging = false;
+    bool discharging = false;
+    // Batteries report energy_* (uWh) or charge_* (uAh). Charge is turned
+    // into energy with the voltage; batteries without one are summed apart
+    // and only count when no battery reports energy, so units never mix.
+    int64_t energyNow = 0, energyFull = 0, powerNow = 0;
+    int64_t chargeNow = 0, chargeFull = 0, currentNow = 0;
+    bool haveEnergy = false;
+    long capacity = -1;
+    long timeToEmpty = -1;
+    int batteryCount = 0;
+
+    for (const Supply& supply : supplies) {
+        std::string type;
+        readAttribute(supply, Type, type);
+        if (type == "Mains" || type == "USB") {
+            haveMains = true;
+            mainsOnline = mainsOnline || readNumber(supply, Online, 0) == 1;
+            continue;
+        }
+        if (type != "Battery") continue;
+
+        std::string status, technology;
+        readAttribute(supply, Status, status);
+        readAttribute(supply, Technology, technology);
+        charging = charging || status == "Charging";
+        discharging = discharging || status == "Discharging";
+        if (!haveBattery) {
+            capacity = readNumber(supply, Capacity, -1);
+            timeToEmpty = readNumber(supply, TimeToEmpty, -1);
+        }
+        haveBattery = true;
+
+        int64_t now = readNumber(supply, EnergyNow, -1);
+        int64_t full = readNumber(supply, EnergyFull, 0);
+        int64_t design = readNumber(supply, EnergyFullDesign, -1);
+        int64_t rate = readNumber(supply, PowerNow, 0);
+        bool energy = now >= 0;
+        if (!energy) {
+            now = readNumber(supply, ChargeNow, 0);
+            full = readNumber(supply, ChargeFull, 0);
+            design = readNumber(supply, ChargeFullDesign, -1);
+            rate = readNumber(supply, CurrentNow, 0);
+            // uAh * uV / 10^6 = uWh; the design capacity is rated at the minimum voltage
+            int64_t voltage = readNumber(supply, VoltageNow, 0);
+            int64_t designVoltage = readNumber(supply, VoltageMinDesign, voltage);
+            if (voltage > 0) {
+                now = now * voltage / 1000000;
+                full = full * voltage / 1000000;
+                rate = rate * voltage / 1000000;
+                if (design >= 0) design = design * (designVoltage > 0 ? designVoltage : voltage) / 1000000;
+                energy = true;
+            }
+        }
+        if (rate < 0) rate = -rate;
+        if (energy) {
+            haveEnergy = true;
+            energyNow += now;
+            energyFull += full;
+            powerNow += rate;
+        } else {
+            chargeNow += now;
+            chargeFull += full;
+            currentNow += rate;
+        }
+        long cycles = readNumber(supply, CycleCount, -1);
+
+        if (batteryCount < kMaxBatteries) {
+            BatteryInfo& record = snapshot.batteries[batteryCount++];
+            record = BatteryInfo();
+            copyName(record.name, sizeof(record.name), supply.name.c_str());
+            copyName(record.chemistry, sizeof(record.chemistry), chemistryCode(technology));
+            record.queried = true;
+            // the records use mWh like Windows; mAh alone cannot be converted
+            record.designedCapacity = !energy || design < 0 ? -1 : (int32_t)(design / 1000);
+            record.fullChargedCapacity = !energy || full <= 0 ? -1 : (int32_t)(full / 1000);
+            record.cycleCount = (int32_t)cycles;
+        }
+    }
+    if (!haveEnergy) {
+        energyNow = chargeNow;
+        energyFull = chargeFull;
+        powerNow = currentNow;
+    }
+
+    snapshot.batteryCount = batteryCount;
+    PowerStatus& power = snapshot.power;
+    power.valid = !supplies.empty();
+    if (!power.valid) return;
+
+    if (haveBattery) {
+        if (energyFull > 0) {
+            capacity = (long)(energyNow * 100 / energyFull);
+        }
+        power.charge = capacity < 0 ? 255 : (uint8_t)std::min(capacity, 100L);
+        uint8_t flags = 0;
+        if (charging) flags |= BatteryFlagCharging;
+        if (capacity >= 0 && capacity < 5) flags |= BatteryFlagCritical;
+        else if (capacity >= 0 && capacity < 33) flags |= BatteryFlagLow;
+        else if (capacity > 66) flags |= BatteryFlagHigh;
+        power.batteryFlags = flags;
+        if (discharging) {
+            if (timeToEmpty >= 0) {
+                power.timeLeft = (int32_t)timeToEmpty;
+            } else if (powerNow > 0) {
+                power.timeLeft = (int32_t)(energyNow * 3600 / powerNow);
+            }
+        }
+    } else {
+        power.charge = 255;
+        power.batteryFlags = BatteryFlagNoSystemBattery;
+    }
+
+    if (haveMains) {
+        power.acLine = mainsOnline ? AcLineStatus::Online : AcLineStatus::Offline;
+    } else if (haveBattery) {
+        power.acLine = discharging ? AcLineStatus::Offline : AcLineStatus::Online;
+    }
+}
+
+// Returns true if any of the pending events is about a power supply
+bool LinuxPowerSupply::drainUevents() {
+    bool relevant = false;
+    bool supplySetChanged = false;
+    char buffer[8192];
+    ssize_t n;
+    while ((n = uevents->receive(buffer, sizeof(buffer) - 1)) > 0) {
+        buffer[n] = '\0';
+        bool powerSupply = false;
+        // "action@devpath" followed by NUL separated KEY=VALUE pairs
+        for (ssize_t i = 0; i < n; i += strlen(buffer + i) + 1) {
+            if (strcmp(buffer + i, "SUBSYSTEM=power_supply") == 0) {
+                powerSupply = true;
+            }
+        }
+        if (!powerSupply) continue;
+        relevant = true;
+        if (strncmp(buffer, "add@", 4) == 0 || strncmp(buffer, "remove@", 7) == 0) {
+            supplySetChanged = true;
+        }
+    }
+    if (supplySetChanged) {
+        rescan();
+    }
+    return relevant;
+}
+
+bool LinuxPowerSupply::waitForChange(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+
+        epoll_event events[2];
+        int n = epoll_wait(epollFd, events, 2, (int)left);
+        if (n < 0 && errno != EINTR) return false;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t value;
+                read(wakeFd, &value, sizeof(value));
+                return false;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == uevents->fd() && drainUevents()) {
+                return true;
+            }
+        }
+        // only unrelated subsystems spoke, keep waiting for the rest of the period
+    }
+}
+
+void LinuxPowerSupply::wake() {
+    uint64_t one = 1;
+    write(wakeFd, &one, sizeof(one));
+}
+
+#endif // __linux__
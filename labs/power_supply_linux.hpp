@@ -0,0 +1,91 @@
+#ifndef POWER_SUPPLY_LINUX_HPP
+#define POWER_SUPPLY_LINUX_HPP
+
+#ifdef __linux__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <sys/types.h>
+#include "lab_01.hpp"
+
+// Where kernel uevents come from. The netlink socket is the real thing,
+// PipeUeventSource lets tests inject events without a kernel or a battery.
+class UeventSource {
+public:
+    virtual ~UeventSource() = default;
+    // pollable descriptor, readable when an event is pending
+    virtual int fd() const = 0;
+    // reads one event ("action@devpath\0KEY=VALUE\0..."), -1 if none is pending
+    virtual ssize_t receive(char* buffer, size_t size) = 0;
+};
+
+class NetlinkUeventSource : public UeventSource {
+public:
+    NetlinkUeventSource();
+    ~NetlinkUeventSource() override;
+    int fd() const override { return sock; }
+    ssize_t receive(char* buffer, size_t size) override;
+
+private:
+    int sock = -1;
+};
+
+class PipeUeventSource : public UeventSource {
+public:
+    PipeUeventSource();
+    ~PipeUeventSource() override;
+    int fd() const override { return fds[0]; }
+    ssize_t receive(char* buffer, size_t size) override;
+    // event is written as one packet, e.g. "change@/class/power_supply/BAT0\0SUBSYSTEM=power_supply"
+    bool inject(const std::string& event);
+
+private:
+    int fds[2] = {-1, -1};
+};
+
+// Reads <root>/class/power_supply/* through descriptors that stay open between
+// samples (one pread each) and sleeps in epoll until a power_supply uevent or
+// the timeout, so plug/unplug shows up without a tight polling loop.
+class LinuxPowerSupply {
+public:
+    explicit LinuxPowerSupply(std::string sysfsRoot = "/sys",
+                              std::unique_ptr<UeventSource> uevents = nullptr);
+    ~LinuxPowerSupply();
+
+    // (re)opens the attribute files of every supply
+    void rescan();
+    // fills everything except timestamps from the open descriptors
+    void fill(BatterySnapshot& snapshot);
+    // true if a power_supply uevent arrived, false on timeout or wake()
+    bool waitForChange(std::chrono::milliseconds timeout);
+    // interrupts waitForChange from another thread
+    void wake();
+
+private:
+    enum Attribute {
+        Type, Online, Status, Capacity, TimeToEmpty, EnergyNow, EnergyFull, EnergyFullDesign,
+        PowerNow, ChargeNow, ChargeFull, ChargeFullDesign, CurrentNow, VoltageNow, VoltageMinDesign,
+        CycleCount, Technology, AttributeCount
+    };
+    struct Supply {
+        std::string name;
+        int fds[AttributeCount];
+    };
+
+    bool readAttribute(const Supply& supply, Attribute attribute, std::string& value) const;
+    long readNumber(const Supply& supply, Attribute attribute, long fallback) const;
+    bool drainUevents();
+    void closeSupplies();
+
+    std::string root;
+    std::unique_ptr<UeventSource> uevents;
+    std::vector<Supply> supplies;
+    int epollFd = -1;
+    int wakeFd = -1;
+};
+
+#endif // __linux__
+
+#endif // POWER_SUPPLY_LINUX_HPP
@@ -0,0 +1,40 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Fixed-capacity ring, all memory is allocated in the constructor.
+// When full, push() overwrites the oldest element. Not thread safe.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : items(capacity > 0 ? capacity : 1) {}
+
+    void push(const T& item) {
+        items[(head + count) % items.size()] = item;
+        if (count < items.size()) {
+            count++;
+        } else {
+            head = (head + 1) % items.size();
+        }
+    }
+
+    // 0 is the oldest element
+    const T& operator[](size_t index) const { return items[(head + index) % items.size()]; }
+    T& operator[](size_t index) { return items[(head + index) % items.size()]; }
+
+    const T& back() const { return (*this)[count - 1]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return items.size(); }
+    size_t memoryBytes() const { return items.size() * sizeof(T); }
+    void clear() { head = 0; count = 0; }
+
+private:
+    std::vector<T> items;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+#endif // RING_BUFFER_HPP
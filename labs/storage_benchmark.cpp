@@ -0,0 +1,688 @@
+#include "storage_benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const kPatternNames[] = {"read", "write", "randread", "randwrite"};
+static const char* const kEngineNames[] = {"auto", "io_uring", "threads"};
+static const char* const kStateNames[] = {"queued", "preparing", "running", "done", "failed", "cancelled"};
+
+const char* benchPatternName(BenchPattern pattern) { return kPatternNames[(int)pattern]; }
+const char* benchEngineName(BenchEngine engine) { return kEngineNames[(int)engine]; }
+const char* benchStateName(BenchState state) { return kStateNames[(int)state]; }
+
+bool parseBenchPattern(const std::string& text, BenchPattern& pattern) {
+    for (int i = 0; i < 4; i++) {
+        if (text == kPatternNames[i]) {
+            pattern = (BenchPattern)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseBenchEngine(const std::string& text, BenchEngine& engine) {
+    for (int i = 0; i < 3; i++) {
+        if (text == kEngineNames[i]) {
+            engine = (BenchEngine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool validateBenchConfig(const StorageBenchConfig& config, std::string& error) {
+    if (config.directory.empty()) {
+        error = "a directory for the test file is required";
+    } else if (config.blockSize < 512 || config.blockSize > (64u << 20) || config.blockSize % 512) {
+        error = "block size must be a multiple of 512 up to 64 MiB";
+    } else if (config.queueDepth < 1 || config.queueDepth > 256) {
+        error = "queue depth must be between 1 and 256";
+    } else if (config.durationMs < 100 || config.durationMs > 600000) {
+        error = "duration must be between 0.1 and 600 seconds";
+    } else if (config.fileSize < (1ull << 20) || config.fileSize < (uint64_t)config.blockSize * config.queueDepth ||
+               config.fileSize > (1ull << 40)) {
+        error = "file size must be at least 1 MiB and one block per request in flight, at most 1 TiB";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < (2u << kSubBits)) return (int)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    return (2 << kSubBits) + (exponent - kSubBits - 1) * (1 << kSubBits) +
+           (int)((ns >> (exponent - kSubBits)) & ((1 << kSubBits) - 1));
+}
+
+uint64_t LatencyHistogram::bucketLow(int bucket) {
+    if (bucket < (2 << kSubBits)) return (uint64_t)bucket;
+    int k = bucket - (2 << kSubBits);
+    int shift = k / (1 << kSubBits) + 1;
+    return (uint64_t)((1 << kSubBits) + k % (1 << kSubBits)) << shift;
+}
+
+uint64_t LatencyHistogram::bucketWidth(int bucket) {
+    if (bucket < (2 << kSubBits)) return 1;
+    return 1ull << ((bucket - (2 << kSubBits)) / (1 << kSubBits) + 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[bucketOf(ns)]++;
+    total++;
+    sum += ns;
+    minimum = std::min(minimum, ns);
+    maximum = std::max(maximum, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < kBuckets; i++) buckets[i] += other.buckets[i];
+    total += other.total;
+    sum += other.sum;
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)std::ceil(std::clamp(q, 0.0, 1.0) * total);
+    rank = std::clamp<uint64_t>(rank, 1, total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t middle = bucketLow(i) + bucketWidth(i) / 2;
+            return std::clamp(middle, min(), maximum);
+        }
+    }
+    return maximum;
+}
+
+#ifdef __linux__
+
+static uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string errnoText(const char* what, int code) {
+    return std::string(what) + ": " + strerror(code);
+}
+
+// splitmix64, one per thread; cheap and good enough to spread offsets
+static inline uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void fillRandom(void* data, size_t size, uint64_t seed) {
+    uint64_t* words = (uint64_t*)data;
+    for (size_t i = 0; i < size / 8; i++) words[i] = nextRandom(seed);
+}
+
+namespace {
+
+// page-aligned memory, as O_DIRECT wants it
+struct AlignedBuffer {
+    void* data = nullptr;
+    explicit AlignedBuffer(size_t size) {
+        if (posix_memalign(&data, 4096, size) != 0) data = nullptr;
+    }
+    ~AlignedBuffer() { free(data); }
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+};
+
+struct FileDescriptor {
+    int fd = -1;
+    ~FileDescriptor() {
+        if (fd >= 0) close(fd);
+    }
+};
+
+bool isRead(BenchPattern pattern) {
+    return pattern == BenchPattern::SequentialRead || pattern == BenchPattern::RandomRead;
+}
+
+bool isRandom(BenchPattern pattern) {
+    return pattern == BenchPattern::RandomRead || pattern == BenchPattern::RandomWrite;
+}
+
+// The submission and completion rings of an io_uring instance, mapped from
+// the kernel. Only what one thread submitting reads and writes needs.
+class Ring {
+public:
+    ~Ring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqSize);
+        if (sqRing) munmap(sqRing, sqSize);
+        if (fd >= 0) close(fd);
+    }
+
+    // false and errno on failure
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) return false;
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqSize = cqSize = std::max(sqSize, cqSize);
+        sqRing = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            return false;
+        }
+        if (single) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                return false;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* mapped = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (mapped == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)mapped;
+
+        char* sq = (char*)sqRing;
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        char* cq = (char*)cqRing;
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+        return true;
+    }
+
+    void queue(bool read, int file, void* buffer, uint32_t length, uint64_t offset, uint64_t tag) {
+        unsigned index = localTail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = file;
+        sqe->addr = (uint64_t)(uintptr_t)buffer;
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sqArray[index] = index;
+        localTail++;
+        pending++;
+    }
+
+    // hands the queued entries to the kernel and waits for `wait` completions
+    bool enter(unsigned wait) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        for (;;) {
+            int submitted = (int)syscall(__NR_io_uring_enter, fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (submitted >= 0) {
+                pending -= std::min<unsigned>(pending, (unsigned)submitted);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    template <typename Handler>
+    unsigned reap(Handler&& handler) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        for (; head != tail; head++, count++) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            handler(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    int fd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqSize = 0;
+    size_t cqSize = 0;
+    size_t sqesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned localTail = 0;
+    unsigned pending = 0;
+};
+
+struct Workload {
+    const StorageBenchConfig& config;
+    StorageBenchmark::Progress& progress;
+    int fd;
+    uint64_t blocks;            // in the file
+    uint64_t startNs;
+    uint64_t deadlineNs;
+    std::atomic<uint64_t> nextBlock{0};     // sequential patterns
+
+    uint64_t offset(uint64_t& random) {
+        uint64_t block = isRandom(config.pattern) ? nextRandom(random) % blocks
+                                                  : nextBlock.fetch_add(1, std::memory_order_relaxed) % blocks;
+        return block * config.blockSize;
+    }
+    bool keepGoing(uint64_t now) const {
+        return now < deadlineNs && !progress.cancel.load(std::memory_order_relaxed);
+    }
+    void report(uint64_t now, uint64_t operations, uint64_t bytes) {
+        progress.operations.fetch_add(operations, std::memory_order_relaxed);
+        progress.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        progress.elapsedMs.store((now - startNs) / 1000000, std::memory_order_relaxed);
+    }
+};
+
+enum class RingOutcome { Ok, Unsupported, Failed };
+
+RingOutcome runIoUring(Workload& work, LatencyHistogram& histogram, std::string& error) {
+    const StorageBenchConfig& config = work.config;
+    Ring ring;
+    if (!ring.setup(config.queueDepth)) return RingOutcome::Unsupported;
+    AlignedBuffer buffers((size_t)config.blockSize * config.queueDepth);
+    if (!buffers.data) {
+        error = "out of memory for the I/O buffers";
+        return RingOutcome::Failed;
+    }
+    fillRandom(buffers.data, (size_t)config.blockSize * config.queueDepth, work.startNs);
+    std::vector<uint64_t> submittedAt(config.queueDepth);
+    bool read = isRead(config.pattern);
+    uint64_t random = work.startNs ^ 0x5EED;
+
+    auto issue = [&](uint64_t slot, uint64_t now) {
+        submittedAt[slot] = now;
+        ring.queue(read, work.fd, (char*)buffers.data + slot * config.blockSize, config.blockSize, work.offset(random), slot);
+    };
+    uint64_t now = nowNs();
+    for (uint32_t slot = 0; slot < config.queueDepth; slot++) issue(slot, now);
+    unsigned inFlight = config.queueDepth;
+    bool anyCompleted = false;
+    int failure = 0;
+    while (inFlight > 0) {
+        if (!ring.enter(1)) {
+            if (!anyCompleted) return RingOutcome::Unsupported;
+            error = errnoText("io_uring_enter", errno);
+            return RingOutcome::Failed;
+        }
+        now = nowNs();
+        bool more = failure == 0 && work.keepGoing(now);
+        uint64_t operations = 0, bytes = 0;
+        ring.reap([&](uint64_t slot, int result) {
+            inFlight--;
+            if (result < 0) {
+                if (failure == 0) failure = -result;
+                return;
+            }
+            anyCompleted = true;
+            histogram.record(now - submittedAt[slot]);
+            operations++;
+            bytes += (uint64_t)result;
+            if (more) {
+                issue(slot, now);
+                inFlight++;
+            }
+        });
+        work.report(now, operations, bytes);
+    }
+    if (failure != 0) {
+        // READ/WRITE opcodes came with 5.6; older kernels reject them
+        if (!anyCompleted && failure == EINVAL && config.engine == BenchEngine::Auto) return RingOutcome::Unsupported;
+        error = errnoText(read ? "read" : "write", failure);
+        return RingOutcome::Failed;
+    }
+    return RingOutcome::Ok;
+}
+
+bool runThreads(Workload& work, LatencyHistogram& histogram, std::string& error) {
+    const StorageBenchConfig& config = work.config;
+    std::vector<LatencyHistogram> histograms(config.queueDepth);
+    std::mutex errorMutex;
+    std::atomic<bool> failed{false};
+    bool read = isRead(config.pattern);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < config.queueDepth; t++) {
+        threads.emplace_back([&, t] {
+            AlignedBuffer buffer(config.blockSize);
+            if (!buffer.data) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = "out of memory for the I/O buffers";
+                failed = true;
+                return;
+            }
+            fillRandom(buffer.data, config.blockSize, work.startNs + t);
+            uint64_t random = work.startNs ^ (0x5EED + t);
+            uint64_t now = nowNs();
+            while (!failed.load(std::memory_order_relaxed) && work.keepGoing(now)) {
+                uint64_t offset = work.offset(random);
+                uint64_t started = now;
+                ssize_t done = read ? pread(work.fd, buffer.data, config.blockSize, (off_t)offset)
+                                    : pwrite(work.fd, buffer.data, config.blockSize, (off_t)offset);
+                now = nowNs();
+                if (done < 0) {
+                    if (errno == EINTR) continue;
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!failed) error = errnoText(read ? "pread" : "pwrite", errno);
+                    failed = true;
+                    return;
+                }
+                histograms[t].record(now - started);
+                work.report(now, 1, (uint64_t)done);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (const auto& item : histograms) histogram.merge(item);
+    return !failed;
+}
+
+// Creates, unlinks and fills the test file. direct comes back false if the
+// filesystem refused O_DIRECT.
+bool prepareFile(const StorageBenchConfig& config, StorageBenchmark::Progress& progress, uint64_t fileSize,
+                 FileDescriptor& file, bool& direct, std::string& error) {
+    struct stat info;
+    if (stat(config.directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        error = config.directory + " is not a directory";
+        return false;
+    }
+    struct statvfs space;
+    if (statvfs(config.directory.c_str(), &space) == 0 &&
+        (uint64_t)space.f_bavail * space.f_frsize < fileSize + (16ull << 20)) {
+        error = "not enough free space in " + config.directory;
+        return false;
+    }
+    static std::atomic<uint64_t> fileCounter{0};
+    std::string path = config.directory + "/.iapcm-bench-" + std::to_string(getpid()) + "-" + std::to_string(fileCounter++);
+    int flags = O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC;
+    direct = config.direct;
+    file.fd = open(path.c_str(), flags | (direct ? O_DIRECT : 0), 0600);
+    if (file.fd < 0 && direct && errno == EINVAL) {
+        direct = false;
+        file.fd = open(path.c_str(), flags, 0600);
+    }
+    if (file.fd < 0) {
+        error = errnoText(path.c_str(), errno);
+        return false;
+    }
+    // gone from the directory at once; the blocks are freed when the fd closes
+    unlink(path.c_str());
+
+    const size_t chunk = 1 << 20;
+    AlignedBuffer buffer(chunk);
+    if (!buffer.data) {
+        error = "out of memory for the fill buffer";
+        return false;
+    }
+    fillRandom(buffer.data, chunk, nowNs());
+    for (uint64_t written = 0; written < fileSize; ) {
+        if (progress.cancel) return false;
+        // a different first word per chunk, so deduplicating drives cannot fold the file
+        ((uint64_t*)buffer.data)[0] = written;
+        size_t length = (size_t)std::min<uint64_t>(chunk, fileSize - written);
+        ssize_t done = pwrite(file.fd, buffer.data, length, (off_t)written);
+        if (done <= 0) {
+            if (done < 0 && errno == EINTR) continue;
+            error = done < 0 ? errnoText("filling the test file", errno) : "filling the test file: no progress";
+            return false;
+        }
+        written += (uint64_t)done;
+        progress.preparedBytes = written;
+    }
+    if (fdatasync(file.fd) != 0) {
+        error = errnoText("fdatasync", errno);
+        return false;
+    }
+    // buffered reads start from the disk, not from what the fill left cached
+    posix_fadvise(file.fd, 0, 0, POSIX_FADV_DONTNEED);
+    return true;
+}
+
+} // namespace
+
+bool StorageBenchmark::available() { return true; }
+
+bool StorageBenchmark::ioUringAvailable() {
+    // setting a ring up to find out is a few syscalls; the kernel won't change
+    static const bool available = [] {
+        Ring ring;
+        return ring.setup(1);
+    }();
+    return available;
+}
+
+bool StorageBenchmark::run(const StorageBenchConfig& config, Progress& progress, StorageBenchResult& result, std::string& error) {
+    if (!validateBenchConfig(config, error)) return false;
+    progress.state = (int)BenchState::Preparing;
+    uint64_t fileSize = config.fileSize / config.blockSize * config.blockSize;
+    FileDescriptor file;
+    bool direct = false;
+    if (!prepareFile(config, progress, fileSize, file, direct, error)) {
+        if (progress.cancel) error = "cancelled";
+        return false;
+    }
+
+    progress.state = (int)BenchState::Running;
+    uint64_t start = nowNs();
+    Workload work{config, progress, file.fd, fileSize / config.blockSize, start, start + config.durationMs * 1000000ull};
+    LatencyHistogram histogram;
+    bool ok;
+    result.engine = "threads";
+    if (config.engine == BenchEngine::Threads) {
+        ok = runThreads(work, histogram, error);
+    } else {
+        RingOutcome outcome = runIoUring(work, histogram, error);
+        if (outcome == RingOutcome::Unsupported && config.engine == BenchEngine::IoUring) {
+            error = errnoText("io_uring", errno ? errno : ENOSYS);
+            return false;
+        }
+        if (outcome == RingOutcome::Unsupported) {
+            // nothing ran yet, start over with threads
+            histogram = LatencyHistogram();
+            progress.operations = 0;
+            progress.bytes = 0;
+            work.startNs = nowNs();
+            work.deadlineNs = work.startNs + config.durationMs * 1000000ull;
+            ok = runThreads(work, histogram, error);
+        } else {
+            result.engine = "io_uring";
+            ok = outcome == RingOutcome::Ok;
+        }
+    }
+    if (!ok) return false;
+    // buffered writes may still sit in the page cache; they are not done until on the disk
+    if (!direct && !isRead(config.pattern) && fdatasync(file.fd) != 0) {
+        error = errnoText("fdatasync", errno);
+        return false;
+    }
+    uint64_t finished = nowNs();
+
+    result.direct = direct;
+    result.operations = histogram.count();
+    result.bytes = progress.bytes;
+    result.seconds = (finished - work.startNs) / 1e9;
+    if (result.seconds > 0) {
+        result.iops = result.operations / result.seconds;
+        result.bytesPerSecond = result.bytes / result.seconds;
+    }
+    result.latencyMin = histogram.min() / 1000.0;
+    result.latencyMean = histogram.mean() / 1000.0;
+    result.latencyP50 = histogram.percentile(0.50) / 1000.0;
+    result.latencyP90 = histogram.percentile(0.90) / 1000.0;
+    result.latencyP99 = histogram.percentile(0.99) / 1000.0;
+    result.latencyP999 = histogram.percentile(0.999) / 1000.0;
+    result.latencyMax = histogram.max() / 1000.0;
+    return true;
+}
+
+#else
+
+bool StorageBenchmark::available() { return false; }
+
+bool StorageBenchmark::ioUringAvailable() { return false; }
+
+bool StorageBenchmark::run(const StorageBenchConfig&, Progress&, StorageBenchResult&, std::string& error) {
+    error = "the storage benchmark needs Linux";
+    return false;
+}
+
+#endif
+
+StorageBenchQueue::StorageBenchQueue(size_t keep) : keepFinished(keep) {}
+
+StorageBenchQueue::~StorageBenchQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (auto& entry : entries) entry->progress.cancel = true;
+    }
+    wake.notify_all();
+    if (runner.joinable()) runner.join();
+}
+
+uint64_t StorageBenchQueue::submit(const StorageBenchConfig& config, std::string& error) {
+    if (!StorageBenchmark::available()) {
+        error = "the storage benchmark needs Linux";
+        return 0;
+    }
+    if (!validateBenchConfig(config, error)) return 0;
+    std::error_code code;
+    if (!std::filesystem::is_directory(config.directory, code)) {
+        error = config.directory + " is not a directory";
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = std::make_shared<Entry>();
+    entry->job.id = nextId++;
+    entry->job.config = config;
+    entries.push_back(entry);
+    // started with the first job, so a server that never benchmarks has no thread for it
+    if (!runner.joinable()) runner = std::thread(&StorageBenchQueue::runnerLoop, this);
+    wake.notify_all();
+    return entry->job.id;
+}
+
+void StorageBenchQueue::runnerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        std::shared_ptr<Entry> next;
+        wake.wait(lock, [&] {
+            if (stopping) return true;
+            for (auto& entry : entries) {
+                if (entry->job.state == BenchState::Queued) {
+                    next = entry;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (stopping) return;
+        next->job.state = BenchState::Preparing;
+        lock.unlock();
+
+        StorageBenchResult result;
+        std::string error;
+        bool ok = StorageBenchmark::run(next->job.config, next->progress, result, error);
+
+        lock.lock();
+        if (next->progress.cancel) {
+            // what ran before the cancel is kept, marked as cut short
+            next->job.state = BenchState::Cancelled;
+            if (ok) next->job.result = result;
+        } else if (ok) {
+            next->job.state = BenchState::Done;
+            next->job.result = result;
+        } else {
+            next->job.state = BenchState::Failed;
+            next->job.error = error;
+        }
+        // forget the oldest finished jobs beyond the ones kept
+        size_t finished = 0;
+        for (auto& entry : entries) finished += entry->job.state >= BenchState::Done;
+        for (auto it = entries.begin(); it != entries.end() && finished > keepFinished; ) {
+            if ((*it)->job.state >= BenchState::Done) {
+                it = entries.erase(it);
+                finished--;
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+StorageBenchJob StorageBenchQueue::snapshot(const Entry& entry) {
+    StorageBenchJob job = entry.job;
+    if (job.state == BenchState::Preparing || job.state == BenchState::Running) {
+        job.state = (BenchState)entry.progress.state.load();
+    }
+    job.elapsedMs = entry.progress.elapsedMs;
+    job.operations = entry.progress.operations;
+    job.bytes = entry.progress.bytes;
+    if (job.state == BenchState::Preparing) {
+        job.progress = (double)entry.progress.preparedBytes / job.config.fileSize;
+    } else if (job.state == BenchState::Running) {
+        job.progress = std::min(1.0, (double)job.elapsedMs / job.config.durationMs);
+    } else if (job.state == BenchState::Done) {
+        job.progress = 1;
+    }
+    return job;
+}
+
+bool StorageBenchQueue::job(uint64_t id, StorageBenchJob& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : entries) {
+        if (entry->job.id == id) {
+            job = snapshot(*entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<StorageBenchJob> StorageBenchQueue::jobs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<StorageBenchJob> result;
+    result.reserve(entries.size());
+    for (auto& entry : entries) result.push_back(snapshot(*entry));
+    return result;
+}
+
+bool StorageBenchQueue::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : entries) {
+        if (entry->job.id != id) continue;
+        if (entry->job.state == BenchState::Queued) {
+            entry->job.state = BenchState::Cancelled;
+            return true;
+        }
+        if (entry->job.state >= BenchState::Done) return false;
+        entry->progress.cancel = true;
+        return true;
+    }
+    return false;
+}
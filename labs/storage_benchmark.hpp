@@ -0,0 +1,161 @@
+#ifndef STORAGE_BENCHMARK_HPP
+#define STORAGE_BENCHMARK_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class BenchPattern { SequentialRead, SequentialWrite, RandomRead, RandomWrite };
+enum class BenchEngine { Auto, IoUring, Threads };
+
+// "read", "write", "randread", "randwrite" as fio names them
+const char* benchPatternName(BenchPattern pattern);
+bool parseBenchPattern(const std::string& text, BenchPattern& pattern);
+const char* benchEngineName(BenchEngine engine);
+bool parseBenchEngine(const std::string& text, BenchEngine& engine);
+
+struct StorageBenchConfig {
+    std::string directory;              // where the temp file goes, e.g. a mount point
+    BenchPattern pattern = BenchPattern::RandomRead;
+    uint32_t blockSize = 4096;          // a multiple of 512
+    uint32_t queueDepth = 32;           // requests in flight (threads for the fallback)
+    uint32_t durationMs = 10000;
+    uint64_t fileSize = 256ull << 20;   // written once before the run
+    bool direct = true;                 // O_DIRECT, past the page cache
+    BenchEngine engine = BenchEngine::Auto;
+};
+
+// false and a message if the values are out of range
+bool validateBenchConfig(const StorageBenchConfig& config, std::string& error);
+
+// Request latencies in a log-linear histogram: 16 buckets per power of two,
+// so a percentile is off by at most 1/32 and recording never allocates.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kBuckets = (2 << kSubBits) + (63 - kSubBits) * (1 << kSubBits);
+
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    // q in [0, 1]; the middle of the bucket that holds it
+    uint64_t percentile(double q) const;
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minimum : 0; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total ? (double)sum / total : 0; }
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketLow(int bucket);
+    static uint64_t bucketWidth(int bucket);
+
+private:
+    uint64_t buckets[kBuckets] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t minimum = UINT64_MAX;
+    uint64_t maximum = 0;
+};
+
+struct StorageBenchResult {
+    std::string engine;                 // the one that ran: "io_uring" or "threads"
+    bool direct = false;                // false if O_DIRECT was asked for but refused
+    uint64_t operations = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    double iops = 0;
+    double bytesPerSecond = 0;
+    // microseconds
+    double latencyMin = 0;
+    double latencyMean = 0;
+    double latencyP50 = 0;
+    double latencyP90 = 0;
+    double latencyP99 = 0;
+    double latencyP999 = 0;
+    double latencyMax = 0;
+};
+
+enum class BenchState { Queued, Preparing, Running, Done, Failed, Cancelled };
+const char* benchStateName(BenchState state);
+
+struct StorageBenchJob {
+    uint64_t id = 0;
+    StorageBenchConfig config;
+    BenchState state = BenchState::Queued;
+    double progress = 0;                // 0..1 of the current phase
+    uint64_t elapsedMs = 0;             // of the run, preparation not counted
+    uint64_t operations = 0;            // so far
+    uint64_t bytes = 0;
+    StorageBenchResult result;          // once Done
+    std::string error;                  // once Failed
+};
+
+// Runs one workload against a temp file in config.directory and returns the
+// result. The file is unlinked as soon as it is created, so nothing is left
+// behind even if the process dies; it is filled with random data first so
+// reads hit allocated blocks and writes do not extend it.
+//
+// The io_uring engine keeps queueDepth requests in flight from one thread
+// through the raw system calls (no liburing needed). Where io_uring is not
+// available (old kernels, seccomp, Windows builds) the fallback runs
+// queueDepth threads doing pread/pwrite. With O_DIRECT the buffers are
+// page-aligned; a filesystem that refuses O_DIRECT (tmpfs) runs buffered and
+// says so in the result.
+class StorageBenchmark {
+public:
+    struct Progress {
+        std::atomic<int> state{(int)BenchState::Preparing};
+        std::atomic<uint64_t> preparedBytes{0};
+        std::atomic<uint64_t> operations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> elapsedMs{0};
+        std::atomic<bool> cancel{false};
+    };
+
+    static bool run(const StorageBenchConfig& config, Progress& progress, StorageBenchResult& result, std::string& error);
+    // false on Windows builds
+    static bool available();
+    // tried once, the answer is kept
+    static bool ioUringAvailable();
+};
+
+// Benchmark jobs for the API: submitted jobs run one after the other on a
+// thread of their own, so two runs never compete for the same disk. The
+// last few finished jobs are kept for their results.
+class StorageBenchQueue {
+public:
+    explicit StorageBenchQueue(size_t keepFinished = 16);
+    ~StorageBenchQueue();
+    StorageBenchQueue(const StorageBenchQueue&) = delete;
+    StorageBenchQueue& operator=(const StorageBenchQueue&) = delete;
+
+    // the job id, or 0 and a message
+    uint64_t submit(const StorageBenchConfig& config, std::string& error);
+    bool job(uint64_t id, StorageBenchJob& job);
+    std::vector<StorageBenchJob> jobs();
+    // a queued job is dropped, a running one stops at the next request
+    bool cancel(uint64_t id);
+
+private:
+    struct Entry {
+        StorageBenchJob job;
+        StorageBenchmark::Progress progress;
+    };
+    void runnerLoop();
+    StorageBenchJob snapshot(const Entry& entry);
+
+    size_t keepFinished;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Entry>> entries;   // oldest first
+    uint64_t nextId = 1;
+    bool stopping = false;
+    std::thread runner;
+};
+
+#endif // STORAGE_BENCHMARK_HPP
@@ -0,0 +1,49 @@
+#include "storage_report.hpp"
+
+bool StorageReport::open(const std::string& path) {
+    lastError.clear();
+    if (!file.open(path)) {
+        lastError = "Failed to open storage report " + path;
+        return false;
+    }
+    textEncoding = detectTextEncoding(file.data(), file.size(), bomLength);
+    return true;
+}
+
+size_t StorageReport::maxTextSize() const {
+    size_t bytes = file.size() - bomLength;
+    // a UTF-16 unit is at most 3 bytes of UTF-8 (a surrogate pair is 4 for 2 units)
+    return textEncoding == TextEncoding::Utf8 ? bytes : bytes / 2 * 3;
+}
+
+bool StorageReport::stream(const Sink& sink, size_t chunkBytes) {
+    if (!file.isOpen()) return false;
+    const uint8_t* data = file.data() + bomLength;
+    size_t size = file.size() - bomLength;
+    if (chunkBytes < 16) chunkBytes = 16;
+
+    if (textEncoding == TextEncoding::Utf8) {
+        for (size_t offset = 0; offset < size; offset += chunkBytes) {
+            size_t length = size - offset < chunkBytes ? size - offset : chunkBytes;
+            if (!sink((const char*)data + offset, length)) return false;
+        }
+        return true;
+    }
+
+    // an odd trailing byte is not a unit and is dropped
+    size_t units = size / 2;
+    size_t chunkUnits = chunkBytes / 3;
+    buffer.resize(chunkUnits * 3);
+    bool bigEndian = textEncoding == TextEncoding::Utf16BE;
+    size_t unit = 0;
+    while (unit < units) {
+        size_t count = units - unit < chunkUnits ? units - unit : chunkUnits;
+        bool last = unit + count == units;
+        size_t consumed;
+        size_t length = utf16ToUtf8(data + 2 * unit, count, bigEndian, last, buffer.data(), consumed);
+        // a surrogate pair split by the chunk starts the next one
+        unit += consumed;
+        if (length > 0 && !sink(buffer.data(), length)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef STORAGE_REPORT_HPP
+#define STORAGE_REPORT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "utf16.hpp"
+
+// The storage report of lab 3 (a text file written by the tool on the XP
+// machine, UTF-16 with a BOM as a rule), read as UTF-8 text.
+//
+// The file is memory-mapped and read once front to back. UTF-8 comes out
+// as slices of the mapping, UTF-16 is transcoded a chunk at a time into one
+// reused buffer, so no copy of the whole text is made here.
+class StorageReport {
+public:
+    // Text chunks in file order; return false to stop
+    using Sink = std::function<bool(const char* data, size_t size)>;
+
+    bool open(const std::string& path);
+    const std::string& error() const { return lastError; }
+    TextEncoding encoding() const { return textEncoding; }
+    size_t fileSize() const { return file.size(); }
+    // upper bound of the UTF-8 size, for reserving the response
+    size_t maxTextSize() const;
+
+    // false if the sink stopped
+    bool stream(const Sink& sink, size_t chunkBytes = 64 * 1024);
+
+private:
+    MappedFile file;
+    TextEncoding textEncoding = TextEncoding::Utf8;
+    size_t bomLength = 0;
+    std::string lastError;
+    std::vector<char> buffer;
+};
+
+#endif // STORAGE_REPORT_HPP
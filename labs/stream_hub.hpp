@@ -0,0 +1,54 @@
+#ifndef STREAM_HUB_HPP
+#define STREAM_HUB_HPP
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// Fan-out of already serialized messages to push subscribers (websocket
+// connections or anything else with send_text). Every change is serialized
+// once by the caller and the same string goes to all subscribers.
+template <typename Connection>
+class StreamHub {
+public:
+    // New subscribers get the latest full state first, then only updates
+    void subscribe(Connection& conn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fullState.empty()) {
+            conn.send_text(fullState);
+        }
+        subscribers.insert(&conn);
+    }
+
+    void unsubscribe(Connection& conn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscribers.erase(&conn);
+    }
+
+    // Sets what future subscribers start from without notifying anyone
+    void setState(std::string state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fullState = std::move(state);
+    }
+
+    // update goes to current subscribers, state is what future subscribers start from
+    void publish(const std::string& update, std::string state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fullState = std::move(state);
+        for (Connection* conn : subscribers) {
+            conn->send_text(update);
+        }
+    }
+
+    size_t subscriberCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return subscribers.size();
+    }
+
+private:
+    std::mutex mutex;
+    std::string fullState;
+    std::unordered_set<Connection*> subscribers;
+};
+
+#endif // STREAM_HUB_HPP
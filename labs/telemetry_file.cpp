@@ -0,0 +1,312 @@
+#include "telemetry_file.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+static const char kFileMagic[4] = { 'T', 'L', 'M', '1' };
+
+uint32_t telemetryCrc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)ready;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// false if the varint runs past end
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) return false;
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------- writer
+
+TelemetryWriter::TelemetryWriter(size_t samplesPerBlock, uint64_t maxBlockAgeMs)
+    : blockLimit(samplesPerBlock > 0 ? samplesPerBlock : 1), blockAgeLimit(maxBlockAgeMs) {
+    payload.reserve(blockLimit * (1 + kMaxTelemetryFields) * 2);
+}
+
+TelemetryWriter::~TelemetryWriter() {
+    close();
+}
+
+bool TelemetryWriter::open(const std::string& path, uint16_t fieldCount) {
+    close();
+    if (fieldCount == 0 || fieldCount > kMaxTelemetryFields) return false;
+    fields = fieldCount;
+    truncated = 0;
+    lastMs = 0;
+
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec)) {
+        uint64_t fileSize = std::filesystem::file_size(path, ec);
+        TelemetryReader reader;
+        if (!reader.open(path) || reader.fieldCount() != fieldCount) {
+            std::cerr << "Telemetry file " << path << " is not usable, not writing to it" << std::endl;
+            return false;
+        }
+        // everything after the last good block is a torn write; damaged
+        // blocks before it stay, the reader skips them
+        size_t validBytes = reader.validBytes();
+        lastMs = reader.lastMs();
+        reader.close();
+        if (validBytes < fileSize) {
+            truncated = fileSize - validBytes;
+            std::filesystem::resize_file(path, validBytes, ec);
+            std::cerr << "Telemetry file " << path << ": dropped " << truncated << " damaged bytes" << std::endl;
+        }
+        file = fopen(path.c_str(), "ab");
+        return file != nullptr;
+    }
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    TelemetryFileHeader header{};
+    memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = 1;
+    header.fieldCount = fieldCount;
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+    return true;
+}
+
+void TelemetryWriter::close() {
+    if (file) {
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void TelemetryWriter::putVarint(uint64_t value) {
+    while (value >= 0x80) {
+        payload.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    payload.push_back((uint8_t)value);
+}
+
+bool TelemetryWriter::append(const TelemetrySample& sample) {
+    if (!file) return false;
+    // The clock stepped back: the sample is stamped with the last time
+    // written instead, so blocks stay in time order for the reader's index.
+    TelemetrySample stamped = sample;
+    stamped.timestampMs = std::max(sample.timestampMs, lastMs);
+
+    if (blockSamples == 0) {
+        blockFirstMs = stamped.timestampMs;
+        previousDelta = 0;
+        for (uint16_t i = 0; i < fields; i++) putVarint(zigzag(stamped.values[i]));
+    } else {
+        int64_t delta = (int64_t)(stamped.timestampMs - previous.timestampMs);
+        putVarint(zigzag(delta - previousDelta));
+        previousDelta = delta;
+        for (uint16_t i = 0; i < fields; i++) putVarint(zigzag(stamped.values[i] - previous.values[i]));
+    }
+    previous = stamped;
+    lastMs = stamped.timestampMs;
+    blockSamples++;
+
+    if (blockSamples >= blockLimit || stamped.timestampMs - blockFirstMs >= blockAgeLimit) {
+        return flush();
+    }
+    return true;
+}
+
+bool TelemetryWriter::flush() {
+    if (!file || blockSamples == 0) return true;
+    TelemetryBlockHeader header{};
+    header.magic = kTelemetryBlockMagic;
+    header.sampleCount = blockSamples;
+    header.firstMs = blockFirstMs;
+    header.lastMs = previous.timestampMs;
+    header.payloadBytes = (uint32_t)payload.size();
+    header.crc = telemetryCrc32(payload.data(), payload.size());
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(payload.data(), 1, payload.size(), file) == payload.size() &&
+              fflush(file) == 0;
+    payload.clear();
+    blockSamples = 0;
+    return ok;
+}
+
+// ---------------------------------------------------------------- reader
+
+TelemetryReader::~TelemetryReader() {
+    close();
+}
+
+bool TelemetryReader::open(const std::string& path) {
+    close();
+    if (!file.open(path) || file.size() < sizeof(TelemetryFileHeader)) {
+        file.close();
+        return false;
+    }
+    data = file.data();
+    size = file.size();
+
+    TelemetryFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 || header.version != 1 ||
+        header.fieldCount == 0 || header.fieldCount > kMaxTelemetryFields) {
+        close();
+        return false;
+    }
+    fields = header.fieldCount;
+
+    // hop over block headers; payloads are only checked, not decoded
+    size_t offset = sizeof(TelemetryFileHeader);
+    uint64_t lastMs = 0;
+    bool lastChecked = true;    // the CRC of index.back() was checked
+    auto wellFormed = [this](size_t at, TelemetryBlockHeader& block) {
+        if (at + sizeof(TelemetryBlockHeader) > size) return false;
+        memcpy(&block, data + at, sizeof(block));
+        return block.magic == kTelemetryBlockMagic && block.sampleCount > 0 &&
+               block.payloadBytes <= size - at - sizeof(block) && block.lastMs >= block.firstMs;
+    };
+    auto intact = [this](size_t at, const TelemetryBlockHeader& block) {
+        return telemetryCrc32(data + at + sizeof(block), block.payloadBytes) == block.crc;
+    };
+    while (offset < size) {
+        TelemetryBlockHeader block;
+        if (!wellFormed(offset, block)) {
+            // The hop landed on garbage. Either the last block's length was
+            // damaged (then its payload fails the CRC and it goes too) or
+            // this header was: look for the next intact block after it.
+            size_t from = offset;
+            if (!lastChecked) {
+                const BlockRef& last = index.back();
+                lastChecked = true;
+                if (telemetryCrc32(data + last.offset, last.payloadBytes) != last.crc) {
+                    from = last.offset - sizeof(TelemetryBlockHeader);
+                    samples -= last.sampleCount;
+                    index.pop_back();
+                    lastMs = index.empty() ? 0 : index.back().lastMs;
+                }
+            }
+            size_t next = from + 1;
+            for (; next + sizeof(TelemetryBlockHeader) <= size; next++) {
+                uint32_t magic;
+                memcpy(&magic, data + next, sizeof(magic));
+                if (magic == kTelemetryBlockMagic && wellFormed(next, block) && intact(next, block)) break;
+            }
+            if (next + sizeof(TelemetryBlockHeader) > size) {
+                // nothing intact after it: a torn tail
+                offset = from;
+                break;
+            }
+            skipped += next - from;
+            offset = next;
+            lastChecked = true;
+        } else {
+            lastChecked = false;
+        }
+        size_t payloadOffset = offset + sizeof(block);
+        if (block.firstMs < lastMs) {
+            // Written before the writer clamped timestamps across a clock
+            // step: left in the file, but not indexed, the index is kept
+            // in time order.
+            skipped += sizeof(block) + block.payloadBytes;
+        } else {
+            index.push_back({ block.firstMs, block.lastMs, payloadOffset, block.sampleCount, block.payloadBytes, block.crc });
+            samples += block.sampleCount;
+            lastMs = block.lastMs;
+        }
+        offset = payloadOffset + block.payloadBytes;
+    }
+    if (!index.empty() && !lastChecked) {
+        // where torn writes end up
+        const BlockRef& last = index.back();
+        if (last.offset + last.payloadBytes == offset &&
+            telemetryCrc32(data + last.offset, last.payloadBytes) != last.crc) {
+            offset = last.offset - sizeof(TelemetryBlockHeader);
+            samples -= last.sampleCount;
+            index.pop_back();
+        }
+    }
+    valid = offset;
+    damagedTail = offset != size;
+    return true;
+}
+
+void TelemetryReader::close() {
+    file.close();
+    data = nullptr;
+    size = 0;
+    valid = 0;
+    skipped = 0;
+    fields = 0;
+    samples = 0;
+    damagedTail = false;
+    index.clear();
+}
+
+void TelemetryReader::scan(uint64_t fromMs, uint64_t toMs,
+                           const std::function<void(const TelemetrySample&)>& visit) const {
+    // first block that ends at or after fromMs
+    size_t lo = 0, hi = index.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (index[mid].lastMs < fromMs) lo = mid + 1; else hi = mid;
+    }
+
+    for (size_t b = lo; b < index.size() && index[b].firstMs <= toMs; b++) {
+        const BlockRef& block = index[b];
+        if (telemetryCrc32(data + block.offset, block.payloadBytes) != block.crc) {
+            continue;
+        }
+        const uint8_t* p = data + block.offset;
+        const uint8_t* end = p + block.payloadBytes;
+        TelemetrySample sample;
+        sample.timestampMs = block.firstMs;
+        int64_t delta = 0;
+        for (uint32_t n = 0; n < block.sampleCount; n++) {
+            uint64_t raw;
+            bool ok = true;
+            if (n > 0) {
+                ok = getVarint(p, end, raw);
+                delta += unzigzag(raw);
+                sample.timestampMs += delta;
+            }
+            for (uint16_t i = 0; ok && i < fields; i++) {
+                ok = getVarint(p, end, raw);
+                sample.values[i] += unzigzag(raw);
+            }
+            if (!ok || sample.timestampMs > toMs) break;
+            if (sample.timestampMs >= fromMs) visit(sample);
+        }
+        if (block.lastMs > toMs) return;
+    }
+}
+
+std::vector<TelemetrySample> TelemetryReader::read(uint64_t fromMs, uint64_t toMs) const {
+    std::vector<TelemetrySample> result;
+    scan(fromMs, toMs, [&result](const TelemetrySample& sample) { result.push_back(sample); });
+    return result;
+}
@@ -0,0 +1,143 @@
+#ifndef TELEMETRY_FILE_HPP
+#define TELEMETRY_FILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <functional>
+#include "mapped_file.hpp"
+
+// Append-only telemetry series file.
+//
+//   file   := FileHeader Block*
+//   Block  := BlockHeader payload[payloadBytes]
+//   payload: for every sample after the first one, the timestamp as a
+//            zig-zag varint delta-of-delta, then every field as a zig-zag varint
+//            delta from the previous sample. The first sample's timestamp is
+//            BlockHeader::firstMs and its fields are deltas from zero.
+//
+// Blocks are self-contained and carry a CRC, so a torn write only loses the
+// last block and a damaged block in the middle only loses itself: the reader
+// looks for the next intact block header after it. Blocks are in time order;
+// the writer stamps samples from before a clock step with the last time
+// written. Readers
+// mmap the file and hop over block headers to build the index, the payload is
+// only decoded for blocks that overlap the query.
+
+static const size_t kMaxTelemetryFields = 8;
+
+struct TelemetrySample {
+    uint64_t timestampMs = 0;
+    int64_t values[kMaxTelemetryFields] = {0};
+};
+
+#pragma pack(push, 1)
+struct TelemetryFileHeader {
+    char magic[4];          // "TLM1"
+    uint16_t version;
+    uint16_t fieldCount;
+    uint32_t reserved;
+};
+
+struct TelemetryBlockHeader {
+    uint32_t magic;         // kTelemetryBlockMagic
+    uint32_t sampleCount;
+    uint64_t firstMs;
+    uint64_t lastMs;
+    uint32_t payloadBytes;
+    uint32_t crc;           // CRC-32 of the payload
+};
+#pragma pack(pop)
+
+static const uint32_t kTelemetryBlockMagic = 0x314b4c42; // "BLK1"
+
+uint32_t telemetryCrc32(const uint8_t* data, size_t size);
+
+class TelemetryWriter {
+public:
+    // samplesPerBlock and maxBlockAgeMs bound how much a crash can lose
+    TelemetryWriter(size_t samplesPerBlock = 256, uint64_t maxBlockAgeMs = 60 * 1000);
+    ~TelemetryWriter();
+
+    // Creates the file or validates an existing one; a torn tail after the
+    // last intact block is cut off, damaged blocks before it are left
+    bool open(const std::string& path, uint16_t fieldCount);
+    void close();
+    // a sample older than the last one written is stamped with its time
+    bool append(const TelemetrySample& sample);
+    // writes the block being built, even if it is not full
+    bool flush();
+    // takes effect for the block being built as well
+    void setMaxBlockAge(uint64_t maxBlockAgeMs) { blockAgeLimit = maxBlockAgeMs; }
+    // bytes cut off by open() while recovering
+    uint64_t recoveredBytes() const { return truncated; }
+
+private:
+    void putVarint(uint64_t value);
+
+    FILE* file = nullptr;
+    uint16_t fields = 0;
+    size_t blockLimit;
+    uint64_t blockAgeLimit;
+    uint64_t truncated = 0;
+    uint64_t lastMs = 0;        // newest timestamp written
+
+    std::vector<uint8_t> payload;
+    uint32_t blockSamples = 0;
+    uint64_t blockFirstMs = 0;
+    TelemetrySample previous;
+    int64_t previousDelta = 0;
+};
+
+class TelemetryReader {
+public:
+    TelemetryReader() = default;
+    ~TelemetryReader();
+    TelemetryReader(const TelemetryReader&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+    // Maps the file and indexes its blocks by hopping over their headers.
+    // Past a malformed header it looks for the next block with an intact
+    // header and CRC. Otherwise only the last block's CRC is checked here
+    // (that is where torn writes end up), the others are checked by scan().
+    bool open(const std::string& path);
+    void close();
+
+    uint16_t fieldCount() const { return fields; }
+    size_t blockCount() const { return index.size(); }
+    size_t sampleCount() const { return samples; }
+    bool damaged() const { return damagedTail; }
+    // the file up to the end of the last intact block
+    size_t validBytes() const { return valid; }
+    // bytes of damaged or out-of-order blocks before that, not indexed
+    size_t skippedBytes() const { return skipped; }
+    uint64_t lastMs() const { return index.empty() ? 0 : index.back().lastMs; }
+
+    // Calls visit for every sample with fromMs <= timestamp <= toMs, in order.
+    // Blocks whose CRC does not match are skipped.
+    void scan(uint64_t fromMs, uint64_t toMs, const std::function<void(const TelemetrySample&)>& visit) const;
+    std::vector<TelemetrySample> read(uint64_t fromMs, uint64_t toMs) const;
+
+private:
+    struct BlockRef {
+        uint64_t firstMs;
+        uint64_t lastMs;
+        size_t offset;      // of the payload
+        uint32_t sampleCount;
+        uint32_t payloadBytes;
+        uint32_t crc;
+    };
+
+    MappedFile file;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint16_t fields = 0;
+    size_t samples = 0;
+    size_t valid = 0;
+    size_t skipped = 0;
+    bool damagedTail = false;
+    std::vector<BlockRef> index;
+};
+
+#endif // TELEMETRY_FILE_HPP
@@ -0,0 +1,29 @@
+#ifndef TIMER_SLACK_HPP
+#define TIMER_SLACK_HPP
+
+#include <atomic>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// Timer slack is per thread on Linux. applyTimerSlack() (power_policy.hpp)
+// sets it on every thread it is allowed to and publishes it here; the
+// samplers call adoptTimerSlack() once per pass, so a thread it could not
+// reach takes the new slack on its next wakeup.
+inline std::atomic<uint64_t> timerSlackNs{0};
+inline std::atomic<uint32_t> timerSlackGeneration{0};
+
+// a load and a compare unless the slack changed since this thread last looked
+inline void adoptTimerSlack() {
+#ifdef __linux__
+    thread_local uint32_t adopted = 0;
+    uint32_t generation = timerSlackGeneration.load(std::memory_order_acquire);
+    if (generation == adopted) return;
+    adopted = generation;
+    // 0 restores the thread's default slack
+    prctl(PR_SET_TIMERSLACK, (unsigned long)timerSlackNs.load(std::memory_order_relaxed));
+#endif
+}
+
+#endif // TIMER_SLACK_HPP
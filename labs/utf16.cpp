@@ -0,0 +1,178 @@
+#include "utf16.hpp"
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTF16_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+TextEncoding detectTextEncoding(const uint8_t* data, size_t size, size_t& bomLength) {
+    bomLength = 0;
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        bomLength = 3;
+        return TextEncoding::Utf8;
+    }
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        bomLength = 2;
+        return TextEncoding::Utf16LE;
+    }
+    if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        bomLength = 2;
+        return TextEncoding::Utf16BE;
+    }
+    // no BOM: count zero bytes at even and odd offsets over the first 1 KiB
+    size_t sample = size < 1024 ? size & ~(size_t)1 : 1024;
+    size_t evenZeros = 0, oddZeros = 0;
+    for (size_t i = 0; i < sample; i += 2) {
+        evenZeros += data[i] == 0;
+        oddZeros += data[i + 1] == 0;
+    }
+    size_t pairs = sample / 2;
+    if (pairs > 0 && oddZeros * 2 > pairs && evenZeros * 8 < pairs) return TextEncoding::Utf16LE;
+    if (pairs > 0 && evenZeros * 2 > pairs && oddZeros * 8 < pairs) return TextEncoding::Utf16BE;
+    return TextEncoding::Utf8;
+}
+
+static inline uint16_t loadUnit(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? (uint16_t)(p[0] << 8 | p[1]) : (uint16_t)(p[1] << 8 | p[0]);
+}
+
+// One code point starting at unit i; returns the units used, 0 if a high
+// surrogate at the end waits for the next call
+static inline size_t convertOne(const uint8_t* input, size_t i, size_t units, bool bigEndian, bool last, char*& o) {
+    uint32_t c = loadUnit(input + 2 * i, bigEndian);
+    if (c < 0x80) {
+        *o++ = (char)c;
+        return 1;
+    }
+    if (c < 0x800) {
+        *o++ = (char)(0xC0 | c >> 6);
+        *o++ = (char)(0x80 | (c & 0x3F));
+        return 1;
+    }
+    if (c >= 0xD800 && c <= 0xDBFF) {
+        if (i + 1 == units && !last) return 0;
+        uint32_t low = i + 1 < units ? loadUnit(input + 2 * (i + 1), bigEndian) : 0;
+        if (low >= 0xDC00 && low <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+            *o++ = (char)(0xF0 | c >> 18);
+            *o++ = (char)(0x80 | ((c >> 12) & 0x3F));
+            *o++ = (char)(0x80 | ((c >> 6) & 0x3F));
+            *o++ = (char)(0x80 | (c & 0x3F));
+            return 2;
+        }
+        c = 0xFFFD;
+    } else if (c >= 0xDC00 && c <= 0xDFFF) {
+        c = 0xFFFD;
+    }
+    *o++ = (char)(0xE0 | c >> 12);
+    *o++ = (char)(0x80 | ((c >> 6) & 0x3F));
+    *o++ = (char)(0x80 | (c & 0x3F));
+    return 1;
+}
+
+#ifdef UTF16_X86
+
+// 8 units to 8 bytes if all of them are ASCII
+static inline bool asciiBlockSse2(const uint8_t* input, bool bigEndian, char* out) {
+    __m128i v = _mm_loadu_si128((const __m128i*)input);
+    if (bigEndian) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    __m128i high = _mm_and_si128(v, _mm_set1_epi16((short)0xFF80));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) return false;
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(v, v));
+    return true;
+}
+
+#if defined(__GNUC__)
+#define UTF16_AVX2 1
+#define UTF16_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#define UTF16_AVX2 1
+#define UTF16_TARGET_AVX2
+#endif
+
+#ifdef UTF16_AVX2
+// 16 units to 16 bytes if all of them are ASCII
+UTF16_TARGET_AVX2
+static bool asciiBlockAvx2(const uint8_t* input, bool bigEndian, char* out) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)input);
+    if (bigEndian) v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+    if (!_mm256_testz_si256(v, _mm256_set1_epi16((short)0xFF80))) return false;
+    // packus works per 128-bit lane, the two low quadwords hold the bytes
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+    _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(packed));
+    return true;
+}
+#endif
+
+#endif // UTF16_X86
+
+Utf16Path utf16BestPath() {
+#ifdef UTF16_X86
+#if defined(__GNUC__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    static const bool avx2 = []() {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        // OSXSAVE and the OS saving the YMM registers
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+#else
+    static const bool avx2 = false;
+#endif
+    return avx2 ? Utf16Path::Avx2 : Utf16Path::Sse2;
+#else
+    return Utf16Path::Scalar;
+#endif
+}
+
+size_t utf16ToUtf8(Utf16Path path, const uint8_t* input, size_t units, bool bigEndian, bool last, char* out, size_t& consumed) {
+    char* o = out;
+    size_t i = 0;
+    while (i < units) {
+        // a block that is not all ASCII goes through the scalar loop whole,
+        // so non-Latin text does not retry the vector test at every unit
+        size_t block = 1;
+#ifdef UTF16_AVX2
+        if (path == Utf16Path::Avx2 && i + 16 <= units) {
+            if (asciiBlockAvx2(input + 2 * i, bigEndian, o)) {
+                i += 16;
+                o += 16;
+                continue;
+            }
+            block = 16;
+        } else
+#endif
+#ifdef UTF16_X86
+        if (path != Utf16Path::Scalar && i + 8 <= units) {
+            if (asciiBlockSse2(input + 2 * i, bigEndian, o)) {
+                i += 8;
+                o += 8;
+                continue;
+            }
+            block = 8;
+        }
+#endif
+        size_t end = i + block;
+        while (i < end && i < units) {
+            size_t used = convertOne(input, i, units, bigEndian, last, o);
+            if (used == 0) {
+                consumed = i;
+                return (size_t)(o - out);
+            }
+            i += used;
+        }
+    }
+    consumed = i;
+    return (size_t)(o - out);
+}
+
+size_t utf16ToUtf8(const uint8_t* input, size_t units, bool bigEndian, bool last, char* out, size_t& consumed) {
+    return utf16ToUtf8(utf16BestPath(), input, units, bigEndian, last, out, consumed);
+}
@@ -0,0 +1,27 @@
+#ifndef UTF16_HPP
+#define UTF16_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+enum class TextEncoding { Utf8, Utf16LE, Utf16BE };
+
+// The encoding of a text file from its byte order mark, or without one from
+// where the zero bytes are (ASCII text in UTF-16 has one in every unit).
+// bomLength is the number of bytes to skip.
+TextEncoding detectTextEncoding(const uint8_t* data, size_t size, size_t& bomLength);
+
+enum class Utf16Path { Scalar, Sse2, Avx2 };
+
+// The fastest path this CPU runs: AVX2 or SSE2 on x86-64, scalar elsewhere
+Utf16Path utf16BestPath();
+
+// UTF-16 code units (raw bytes, little or big endian) to UTF-8. `out` needs
+// room for 3 bytes per unit. Runs of ASCII go through the vector path, the
+// rest one unit at a time. A high surrogate in the last unit is left for the
+// next call unless `last` is set; `consumed` tells how many units were used.
+// Unpaired surrogates become U+FFFD. Returns the bytes written.
+size_t utf16ToUtf8(const uint8_t* input, size_t units, bool bigEndian, bool last, char* out, size_t& consumed);
+size_t utf16ToUtf8(Utf16Path path, const uint8_t* input, size_t units, bool bigEndian, bool last, char* out, size_t& consumed);
+
+#endif // UTF16_HPP
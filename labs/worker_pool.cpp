@@ -0,0 +1,70 @@
+#include "worker_pool.hpp"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned count) {
+    if (count == 0) {
+        count = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    }
+    // the calling thread is one of the workers
+    for (unsigned i = 1; i < count; i++) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::runTasks(Job& job) {
+    for (size_t i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+        (*job.task)(i);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeup.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        // woke up after the caller finished the job alone: nothing to join
+        Job* job = current;
+        if (!job) continue;
+        job->busyWorkers++;
+        lock.unlock();
+        runTasks(*job);
+        lock.lock();
+        if (--job->busyWorkers == 0) finished.notify_all();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    if (threads.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+    Job job;
+    job.task = &task;
+    job.count = count;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &job;
+        generation++;
+    }
+    wakeup.notify_all();
+    runTasks(job);
+    // no one joins from here on; wait for the ones that did
+    std::unique_lock<std::mutex> lock(mutex);
+    current = nullptr;
+    finished.wait(lock, [&] { return job.busyWorkers == 0; });
+}
@@ -0,0 +1,52 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads kept around for short fan-out jobs, so a job does not pay for
+// creating threads. The calling thread works too.
+class WorkerPool {
+public:
+    // 0 - one thread per core, at most 4 (the jobs are syscall-bound)
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Runs task(i) for every i in [0, count) and returns when all are done.
+    // One job at a time; concurrent callers wait for each other.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+    // threads working on a job, the caller included
+    unsigned threadCount() const { return (unsigned)threads.size() + 1; }
+
+private:
+    // One parallelFor call. Workers join it under the mutex while it is the
+    // current job, so one that wakes after the job is over never sees the
+    // next job's task with this job's counter.
+    struct Job {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        std::atomic<size_t> next{0};
+        size_t busyWorkers = 0;     // joined and not done yet
+    };
+
+    void workerLoop();
+    static void runTasks(Job& job);
+
+    std::vector<std::thread> threads;
+    std::mutex jobMutex;            // one parallelFor at a time
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    bool stopping = false;
+    uint64_t generation = 0;
+    Job* current = nullptr;
+};
+
+#endif // WORKER_POOL_HPP
@@ -6,6 +6,29 @@
 #include <algorithm>
 #include <cctype>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+#include "labs/stream_hub.hpp"
+#include "labs/battery_history.hpp"
+#include "labs/telemetry_file.hpp"
+#include "labs/battery_source.hpp"
+#include "labs/battery_replay.hpp"
+#include "labs/power_policy.hpp"
+#include "labs/pci_config.hpp"
+#include "labs/pci_topology.hpp"
+#include "labs/pci_index.hpp"
+#include "labs/generation_cache.hpp"
+#include "labs/pcie_links.hpp"
+#include "labs/storage_report.hpp"
+#include "labs/block_devices.hpp"
+#include "labs/disk_stats.hpp"
+#include "labs/storage_benchmark.hpp"
+#include "labs/disk_usage.hpp"
+#include "labs/file_follow.hpp"
+#include "labs/pci_codes.h"
 
 #include <filesystem>
 
@@ -27,11 +50,467 @@ std::string url_decode(const std::string& encoded) {
     return decoded;
 }
 
-int main()
+uint64_t unixTimeMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* acLineStatusName(AcLineStatus acLine) {
+    switch (acLine) {
+        case AcLineStatus::Online: return "online";
+        case AcLineStatus::Offline: return "offline";
+        default: return "unknown";
+    }
+}
+
+crow::json::wvalue powerStatusToJson(const PowerStatus& power) {
+    crow::json::wvalue json;
+    json["valid"] = power.valid;
+    json["charge"] = power.chargeKnown() ? (int)power.charge : -1;
+    json["acLine"] = acLineStatusName(power.acLine);
+    json["timeLeft"] = power.timeLeft;
+    json["eco"] = power.eco;
+    json["flags"]["known"] = power.flagsKnown();
+    json["flags"]["high"] = power.hasFlag(BatteryFlagHigh);
+    json["flags"]["low"] = power.hasFlag(BatteryFlagLow);
+    json["flags"]["critical"] = power.hasFlag(BatteryFlagCritical);
+    json["flags"]["charging"] = power.hasFlag(BatteryFlagCharging);
+    json["flags"]["noSystemBattery"] = power.hasFlag(BatteryFlagNoSystemBattery);
+    return json;
+}
+
+std::vector<crow::json::wvalue> batteryInfosToJson(const BatterySnapshot& snapshot) {
+    std::vector<crow::json::wvalue> batteries;
+    for (int i = 0; i < snapshot.batteryCount; i++) {
+        const BatteryInfo& battery = snapshot.batteries[i];
+        crow::json::wvalue batteryObj;
+        batteryObj["name"] = battery.name;
+        batteryObj["queried"] = battery.queried;
+        batteryObj["chemistry"] = battery.chemistry;
+        batteryObj["designedCapacity"] = battery.designedCapacity;
+        batteryObj["fullChargedCapacity"] = battery.fullChargedCapacity;
+        batteryObj["cycleCount"] = battery.cycleCount;
+        batteryObj["wearLevel"] = battery.wearLevel();
+        batteries.push_back(std::move(batteryObj));
+    }
+    return batteries;
+}
+
+crow::json::wvalue batteryFleetStatsToJson(const BatteryFleetStats& stats) {
+    crow::json::wvalue json;
+    json["batteries"] = stats.batteries;
+    json["designedCapacity"] = stats.designedCapacity;
+    json["fullChargedCapacity"] = stats.fullChargedCapacity;
+    json["wearLevel"] = stats.wearLevel;
+    json["meanCycleCount"] = stats.meanCycleCount;
+    return json;
+}
+
+// Straight from the typed sample, the client formats the text itself
+crow::json::wvalue batterySnapshotToJson(const BatterySnapshot& snapshot) {
+    crow::json::wvalue json;
+    json["sampledAt"] = snapshot.sampledAtMs;
+    json["power"] = powerStatusToJson(snapshot.power);
+    json["batteries"] = batteryInfosToJson(snapshot);
+    json["fleet"] = batteryFleetStatsToJson(snapshot.fleetStats());
+    return json;
+}
+
+crow::json::wvalue batteryHistoryBucketToJson(const BatteryHistoryBucket& bucket) {
+    crow::json::wvalue json;
+    json["t"] = bucket.startMs;
+    json["samples"] = bucket.samples;
+    json["chargeMin"] = bucket.chargeMin;
+    json["chargeMax"] = bucket.chargeMax;
+    json["chargeMean"] = bucket.chargeMean;
+    json["timeLeftMin"] = bucket.timeLeftMin;
+    json["timeLeftMax"] = bucket.timeLeftMax;
+    json["timeLeftMean"] = bucket.timeLeftMean;
+    json["acLineStatus"] = bucket.acLineStatus;
+    json["acTransitions"] = bucket.acTransitions;
+    return json;
+}
+
+// Only the parts that differ between two samples, timestamps don't count.
+// "power" is small enough to resend whole; "batteries" and "fleet" go together.
+// Returns false if nothing the dashboard shows has changed.
+bool batterySnapshotDelta(const BatterySnapshot& before, const BatterySnapshot& after, crow::json::wvalue& delta) {
+    bool changed = false;
+    if (!(before.power == after.power)) {
+        delta["power"] = powerStatusToJson(after.power);
+        changed = true;
+    }
+    bool batteriesChanged = before.batteryCount != after.batteryCount;
+    for (int i = 0; !batteriesChanged && i < after.batteryCount; i++) {
+        batteriesChanged = !(before.batteries[i] == after.batteries[i]);
+    }
+    if (batteriesChanged) {
+        delta["batteries"] = batteryInfosToJson(after);
+        delta["fleet"] = batteryFleetStatsToJson(after.fleetStats());
+        changed = true;
+    }
+    return changed;
+}
+
+// What the device list needs: address, IDs, class and the names the
+// lab page shows ("[VID] vendor" / "[DID] device")
+crow::json::wvalue pciDeviceSummaryToJson(const PciDeviceRecord& device) {
+    char hex[16];
+    crow::json::wvalue json;
+    json["address"] = device.address;
+    snprintf(hex, sizeof(hex), "%04X", device.vendorId);
+    json["vendorId"] = std::string(hex);
+    json["VenID"] = "[" + std::string(hex) + "] " + device.vendorName;
+    snprintf(hex, sizeof(hex), "%04X", device.deviceId);
+    json["deviceId"] = std::string(hex);
+    json["DevID"] = device.deviceName.empty() ? std::string(hex) : "[" + std::string(hex) + "] " + device.deviceName;
+    snprintf(hex, sizeof(hex), "%06X", device.classCode);
+    json["classCode"] = std::string(hex);
+    return json;
+}
+
+// The summary plus everything enumeration read
+crow::json::wvalue pciDeviceRecordToJson(const PciDeviceRecord& device) {
+    char hex[16];
+    crow::json::wvalue json = pciDeviceSummaryToJson(device);
+    json["driver"] = device.driver;
+    snprintf(hex, sizeof(hex), "%04X:%04X", device.subsystemVendorId, device.subsystemDeviceId);
+    json["subsystem"] = std::string(hex);
+    json["revision"] = device.revision;
+    if (device.linkWidth > 0) {
+        json["link"]["speed"] = device.linkSpeed;
+        json["link"]["width"] = device.linkWidth;
+        json["link"]["maxSpeed"] = device.maxLinkSpeed;
+        json["link"]["maxWidth"] = device.maxLinkWidth;
+    }
+    std::vector<crow::json::wvalue> resources;
+    for (const auto& resource : device.resources) {
+        crow::json::wvalue item;
+        item["index"] = resource.index;
+        item["start"] = resource.start;
+        item["size"] = resource.size;
+        item["flags"] = resource.flags;
+        resources.push_back(std::move(item));
+    }
+    json["resources"] = std::move(resources);
+    return json;
+}
+
+// Summary only; /pci/device/<address> has the rest
+crow::json::wvalue pciTopologyNodeToJson(const PciTopologyNode& node) {
+    crow::json::wvalue json = pciDeviceSummaryToJson(node.device);
+    json["parent"] = node.device.parent;
+    json["domain"] = node.domain;
+    json["bus"] = node.bus;
+    json["device"] = node.slot;
+    json["function"] = node.function;
+    json["generation"] = node.generation;
+    return json;
+}
+
+// A node with the functions behind it, recursively
+crow::json::wvalue pciTopologyTreeToJson(const std::map<std::string, const PciTopologyNode*>& nodes,
+                                         const PciTopologyNode& node) {
+    crow::json::wvalue json = pciTopologyNodeToJson(node);
+    std::vector<crow::json::wvalue> children;
+    for (const auto& child : node.children) {
+        auto it = nodes.find(child);
+        if (it != nodes.end()) children.push_back(pciTopologyTreeToJson(nodes, *it->second));
+    }
+    json["children"] = std::move(children);
+    return json;
+}
+
+crow::json::wvalue pciConfigToJson(const PciConfigSpace& config) {
+    char hex[16];
+    crow::json::wvalue json;
+    json["bytes"] = config.length;
+    snprintf(hex, sizeof(hex), "%04X", config.command);
+    json["command"]["value"] = std::string(hex);
+    std::vector<std::string> commandFlags;
+    for (size_t bit = 0; bit < PCI_COMMANDFLAGS_LEN; bit++) {
+        if (config.commandBit((int)bit)) commandFlags.push_back(PciCommandFlags[bit]);
+    }
+    json["command"]["flags"] = commandFlags;
+    snprintf(hex, sizeof(hex), "%04X", config.status);
+    json["status"]["value"] = std::string(hex);
+    // bits 9-10 are the DEVSEL timing, which has its own table
+    std::vector<std::string> statusFlags;
+    for (size_t bit = 0; bit < PCI_STATUSFLAGS_LEN; bit++) {
+        if (config.statusBit((int)bit) && PciStatusFlags[bit][0]) statusFlags.push_back(PciStatusFlags[bit]);
+    }
+    json["status"]["flags"] = statusFlags;
+    json["status"]["devsel"] = PciDevSelFlags[config.devselTiming()];
+    json["headerType"] = config.headerType;
+    json["multiFunction"] = config.multiFunction;
+    json["interruptPin"] = config.interruptPin;
+    json["interruptLine"] = config.interruptLine;
+    if (config.headerType != 0) {
+        json["buses"]["primary"] = config.primaryBus;
+        json["buses"]["secondary"] = config.secondaryBus;
+        json["buses"]["subordinate"] = config.subordinateBus;
+    }
+    std::vector<crow::json::wvalue> bars;
+    for (int i = 0; i < config.barCount; i++) {
+        const PciBar& bar = config.bars[i];
+        crow::json::wvalue item;
+        item["index"] = bar.index;
+        item["type"] = bar.io ? "io" : bar.is64 ? "mem64" : "mem32";
+        item["prefetchable"] = bar.prefetchable;
+        item["address"] = bar.address;
+        bars.push_back(std::move(item));
+    }
+    json["bars"] = std::move(bars);
+    std::vector<crow::json::wvalue> capabilities;
+    for (int i = 0; i < config.capabilityCount; i++) {
+        const PciCapability& capability = config.capabilities[i];
+        crow::json::wvalue item;
+        snprintf(hex, sizeof(hex), capability.extended ? "%03X" : "%02X", capability.offset);
+        item["offset"] = std::string(hex);
+        item["id"] = capability.id;
+        item["extended"] = capability.extended;
+        item["name"] = capability.extended ? pciExtendedCapabilityName(capability.id) : pciCapabilityName(capability.id);
+        if (capability.extended) item["version"] = capability.version;
+        capabilities.push_back(std::move(item));
+    }
+    json["capabilities"] = std::move(capabilities);
+    json["capabilitiesTruncated"] = config.capabilitiesTruncated;
+    if (config.express.present) {
+        const PciExpressInfo& express = config.express;
+        json["express"]["version"] = express.version;
+        json["express"]["portType"] = pciExpressPortTypeName(express.portType);
+        json["express"]["linkSpeed"] = pciLinkSpeedName(express.linkSpeed);
+        json["express"]["linkWidth"] = express.linkWidth;
+        json["express"]["maxLinkSpeed"] = pciLinkSpeedName(express.maxLinkSpeed);
+        json["express"]["maxLinkWidth"] = express.maxLinkWidth;
+    }
+    return json;
+}
+
+crow::json::wvalue blockMountsToJson(const std::vector<BlockMount>& mounts) {
+    std::vector<crow::json::wvalue> array;
+    for (const auto& mount : mounts) {
+        crow::json::wvalue json;
+        json["mountPoint"] = mount.mountPoint;
+        json["fsType"] = mount.fsType;
+        json["source"] = mount.source;
+        json["readOnly"] = mount.readOnly;
+        array.push_back(std::move(json));
+    }
+    crow::json::wvalue json;
+    json = std::move(array);
+    return json;
+}
+
+crow::json::wvalue blockDeviceToJson(const BlockDevice& device) {
+    crow::json::wvalue json;
+    json["name"] = device.name;
+    json["dev"] = std::to_string(device.major) + ":" + std::to_string(device.minor);
+    json["vendor"] = device.vendor;
+    json["model"] = device.model;
+    json["sizeBytes"] = device.sizeBytes;
+    json["logicalBlockSize"] = device.logicalBlockSize;
+    json["physicalBlockSize"] = device.physicalBlockSize;
+    json["rotational"] = device.rotational;
+    json["removable"] = device.removable;
+    json["readOnly"] = device.readOnly;
+    json["queueDepth"] = device.queueDepth;
+    json["requests"] = device.requests;
+    json["scheduler"] = device.scheduler;
+    json["schedulers"] = device.schedulers;
+    std::vector<crow::json::wvalue> partitions;
+    for (const auto& partition : device.partitions) {
+        crow::json::wvalue part;
+        part["name"] = partition.name;
+        part["dev"] = std::to_string(partition.major) + ":" + std::to_string(partition.minor);
+        part["number"] = partition.number;
+        part["startSector"] = partition.startSector;
+        part["sizeBytes"] = partition.sizeBytes;
+        part["mounts"] = blockMountsToJson(partition.mounts);
+        partitions.push_back(std::move(part));
+    }
+    json["partitions"] = std::move(partitions);
+    json["mounts"] = blockMountsToJson(device.mounts);
+    return json;
+}
+
+crow::json::wvalue diskIoSampleToJson(const DiskIoSample& sample) {
+    crow::json::wvalue json;
+    json["timestamp"] = sample.timestampMs;
+    json["intervalMs"] = sample.intervalMs;
+    json["readIops"] = sample.readIops;
+    json["writeIops"] = sample.writeIops;
+    json["readBytesPerSecond"] = sample.readBytesPerSecond;
+    json["writeBytesPerSecond"] = sample.writeBytesPerSecond;
+    json["readLatencyMs"] = sample.readLatencyMs;
+    json["writeLatencyMs"] = sample.writeLatencyMs;
+    json["queueDepth"] = sample.queueDepth;
+    json["utilization"] = sample.utilization;
+    json["inFlight"] = sample.inFlight;
+    return json;
+}
+
+crow::json::wvalue diskIoStatsToJson(const DiskIoStats& stats) {
+    crow::json::wvalue json;
+    json["name"] = stats.name;
+    json["dev"] = std::to_string(stats.major) + ":" + std::to_string(stats.minor);
+    json["partition"] = stats.partition;
+    json["reads"] = stats.reads;
+    json["writes"] = stats.writes;
+    json["bytesRead"] = stats.bytesRead;
+    json["bytesWritten"] = stats.bytesWritten;
+    json["last"] = diskIoSampleToJson(stats.last);
+    json["readIops"] = stats.readIops;
+    json["writeIops"] = stats.writeIops;
+    json["readBytesPerSecond"] = stats.readBytesPerSecond;
+    json["writeBytesPerSecond"] = stats.writeBytesPerSecond;
+    json["readLatencyMs"] = stats.readLatencyMs;
+    json["writeLatencyMs"] = stats.writeLatencyMs;
+    json["queueDepth"] = stats.queueDepth;
+    json["utilization"] = stats.utilization;
+    json["peakUtilization"] = stats.peakUtilization;
+    json["saturated"] = stats.saturated;
+    return json;
+}
+
+// an idle device repeats the same zeros every tick, that is no change
+bool diskIoSampleChanged(const DiskIoSample& a, const DiskIoSample& b) {
+    return a.readIops != b.readIops || a.writeIops != b.writeIops ||
+           a.readBytesPerSecond != b.readBytesPerSecond || a.writeBytesPerSecond != b.writeBytesPerSecond ||
+           a.readLatencyMs != b.readLatencyMs || a.writeLatencyMs != b.writeLatencyMs ||
+           a.queueDepth != b.queueDepth || a.utilization != b.utilization || a.inFlight != b.inFlight;
+}
+
+crow::json::wvalue benchJobToJson(const StorageBenchJob& job) {
+    crow::json::wvalue json;
+    json["id"] = job.id;
+    json["state"] = benchStateName(job.state);
+    json["progress"] = job.progress;
+    json["elapsedMs"] = job.elapsedMs;
+    json["operations"] = job.operations;
+    json["bytes"] = job.bytes;
+    json["config"]["path"] = job.config.directory;
+    json["config"]["pattern"] = benchPatternName(job.config.pattern);
+    json["config"]["blockSize"] = job.config.blockSize;
+    json["config"]["queueDepth"] = job.config.queueDepth;
+    json["config"]["durationMs"] = job.config.durationMs;
+    json["config"]["fileSize"] = job.config.fileSize;
+    json["config"]["direct"] = job.config.direct;
+    json["config"]["engine"] = benchEngineName(job.config.engine);
+    if (job.result.operations > 0) {
+        const StorageBenchResult& result = job.result;
+        json["result"]["engine"] = result.engine;
+        json["result"]["direct"] = result.direct;
+        json["result"]["operations"] = result.operations;
+        json["result"]["bytes"] = result.bytes;
+        json["result"]["seconds"] = result.seconds;
+        json["result"]["iops"] = result.iops;
+        json["result"]["bytesPerSecond"] = result.bytesPerSecond;
+        json["result"]["latencyUs"]["min"] = result.latencyMin;
+        json["result"]["latencyUs"]["mean"] = result.latencyMean;
+        json["result"]["latencyUs"]["p50"] = result.latencyP50;
+        json["result"]["latencyUs"]["p90"] = result.latencyP90;
+        json["result"]["latencyUs"]["p99"] = result.latencyP99;
+        json["result"]["latencyUs"]["p99.9"] = result.latencyP999;
+        json["result"]["latencyUs"]["max"] = result.latencyMax;
+    }
+    if (!job.error.empty()) json["error"] = job.error;
+    return json;
+}
+
+crow::json::wvalue followChunkToJson(const FollowChunk& chunk) {
+    crow::json::wvalue json;
+    json["text"] = chunk.text;
+    json["start"] = chunk.start;
+    json["next"] = chunk.next;
+    if (chunk.reset) json["reset"] = true;
+    json["more"] = chunk.more;
+    json["rotations"] = chunk.rotations;
+    json["status"] = 200;
+    return json;
+}
+
+// JSON string contents: quotes, backslashes and control characters escaped,
+// everything else (UTF-8 included) copied as is
+void appendJsonEscaped(std::string& out, const char* data, size_t size) {
+    size_t plain = 0;
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(data + plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        }
+    }
+    out.append(data + plain, size - plain);
+}
+
+int main(int argc, char* argv[])
 {
     crow::SimpleApp app;
 
-    batteryMonitor bMonitor;
+    // --battery-replay <trace> [--replay-speed <x>] [--replay-loop] plays a
+    // recorded trace instead of the machine's batteries; speed 0 is "as fast
+    // as possible", 60 is an hour per minute.
+    std::string replayPath;
+    double replaySpeed = 1.0;
+    bool replayLoop = false;
+    std::string sysfsRoot = "/sys";
+    std::string procRoot = "/proc";
+    long diskstatsPeriodMs = 1000;
+#ifdef _WIN32
+    std::string storageReportPath = "D:\\Study\\ИиУВМ\\WinXP\\shared\\SSD\\SSD\\output.txt";
+#else
+    std::string storageReportPath = "output.txt";
+#endif
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--battery-replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--replay-speed" && i + 1 < argc) {
+            replaySpeed = atof(argv[++i]);
+        } else if (arg == "--replay-loop") {
+            replayLoop = true;
+        } else if (arg == "--sysfs-root" && i + 1 < argc) {
+            // a fake /sys for the Linux enumerators
+            sysfsRoot = argv[++i];
+            SetPciSysfsRoot(sysfsRoot);
+        } else if (arg == "--proc-root" && i + 1 < argc) {
+            // a fake /proc (partitions, self/mountinfo) to go with it
+            procRoot = argv[++i];
+        } else if (arg == "--diskstats-period" && i + 1 < argc) {
+            // milliseconds between /proc/diskstats ticks
+            diskstatsPeriodMs = std::max(10L, atol(argv[++i]));
+        } else if (arg == "--storage-report" && i + 1 < argc) {
+            // the report the XP machine writes for lab 3
+            storageReportPath = argv[++i];
+        }
+    }
+    std::unique_ptr<BatterySource> batterySource;
+    ReplayBatterySource* replay = nullptr;
+    if (!replayPath.empty()) {
+        auto replaySource = std::make_unique<ReplayBatterySource>(replaySpeed, replayLoop);
+        if (!replaySource->load(replayPath)) {
+            std::cerr << replaySource->error() << std::endl;
+            return 1;
+        }
+        std::cout << "Replaying " << replaySource->traceLength() << " battery samples from " << replayPath << std::endl;
+        replay = replaySource.get();
+        batterySource = std::move(replaySource);
+    } else {
+        batterySource = std::make_unique<SystemBatterySource>();
+    }
+    batteryMonitor bMonitor(std::move(batterySource));
     CameraCapture camera;
     USBMonitor usbMonitor;
     
@@ -58,6 +537,167 @@ int main()
         return rendered;
     });
 
+    // Whole dashboard state in one request. Served from the sampler's last
+    // published snapshot, so it costs no OS query however many clients poll.
+    CROW_ROUTE(app, "/battery/snapshot")([&bMonitor, replay](){
+        BatterySnapshot snapshot = bMonitor.getSnapshot();
+        crow::json::wvalue response;
+        response["message"] = batterySnapshotToJson(snapshot);
+        response["sampler"]["periodMs"] = bMonitor.getSamplerPeriod().count();
+        response["sampler"]["ageMs"] = unixTimeMs() - snapshot.sampledAtMs;
+        response["sampler"]["sampleDurationUs"] = snapshot.sampleDurationUs;
+        response["sampler"]["source"] = bMonitor.getSourceName();
+        response["sampler"]["running"] = bMonitor.isSamplerRunning();
+        if (replay) {
+            response["sampler"]["replay"]["traceLength"] = replay->traceLength();
+            response["sampler"]["replay"]["samplesReplayed"] = replay->samplesReplayed();
+            response["sampler"]["replay"]["finished"] = replay->finished();
+        }
+        response["status"] = 200;
+        return response;
+    });
+
+    // Push stream: full snapshot on connect, afterwards only changed fields.
+    // Each change is serialized once no matter how many dashboards listen.
+    StreamHub<crow::websocket::connection> batteryStream;
+    BatterySnapshot lastStreamed = bMonitor.getSnapshot();
+    {
+        crow::json::wvalue full;
+        full["type"] = "snapshot";
+        full["message"] = batterySnapshotToJson(lastStreamed);
+        batteryStream.setState(full.dump());
+    }
+    bMonitor.addSampleListener([&batteryStream, &lastStreamed](const BatterySnapshot& snapshot){
+        crow::json::wvalue delta;
+        delta["type"] = "delta";
+        if (!batterySnapshotDelta(lastStreamed, snapshot, delta["message"])) {
+            return;
+        }
+        lastStreamed = snapshot;
+        crow::json::wvalue full;
+        full["type"] = "snapshot";
+        full["message"] = batterySnapshotToJson(snapshot);
+        batteryStream.publish(delta.dump(), full.dump());
+    });
+
+    CROW_WEBSOCKET_ROUTE(app, "/battery/stream")
+        .onopen([&batteryStream](crow::websocket::connection& conn){
+            batteryStream.subscribe(conn);
+        })
+        // the close handler signature differs between Crow versions (code argument)
+        .onclose([&batteryStream](crow::websocket::connection& conn, const std::string&, auto&&...){
+            batteryStream.unsubscribe(conn);
+        })
+        .onmessage([](crow::websocket::connection&, const std::string&, bool){
+            // nothing to receive, the stream is one-way
+        });
+
+    // History survives restarts: the tiers are rebuilt from the telemetry file,
+    // then every new sample goes to both. A replay gets a file of its own that
+    // starts empty, so simulated data never mixes with the real history.
+    BatteryHistory batteryHistory;
+    const std::string batteryTelemetryPath = replay ? "telemetry/battery-replay.tlm" : "telemetry/battery.tlm";
+    std::filesystem::create_directories("telemetry");
+    if (replay) {
+        std::filesystem::remove(batteryTelemetryPath);
+    } else {
+        TelemetryReader reader;
+        if (reader.open(batteryTelemetryPath) && reader.fieldCount() == kBatteryTelemetryFields) {
+            reader.scan(unixTimeMs() - 365 * 24 * BatteryHistory::kHourMs, unixTimeMs(),
+                        [&batteryHistory](const TelemetrySample& sample){
+                batteryHistory.add(telemetryToBatterySnapshot(sample));
+            });
+            std::cout << "Loaded " << reader.sampleCount() << " battery samples from " << batteryTelemetryPath << std::endl;
+        }
+    }
+    TelemetryWriter batteryTelemetry;
+    if (!batteryTelemetry.open(batteryTelemetryPath, kBatteryTelemetryFields)) {
+        std::cerr << "Failed to open " << batteryTelemetryPath << ", battery history will not be saved" << std::endl;
+    }
+    bMonitor.addSampleListener([&batteryHistory, &batteryTelemetry](const BatterySnapshot& snapshot){
+        batteryHistory.add(snapshot);
+        if (snapshot.power.valid) {
+            batteryTelemetry.append(batterySnapshotToTelemetry(snapshot));
+        }
+    });
+
+    // Energy policy: on battery or eco the server samples less often, throttles
+    // the camera preview, lets the OS batch its timers and holds back disk
+    // writes and background jobs until AC returns.
+    // before powerPolicy: a deferred full usage rescan may still be running
+    // on the policy's job thread when it is destroyed
+    DiskUsageScanner usageScanner;
+    PowerPolicyController powerPolicy;
+    powerPolicy.addListener([&bMonitor, &camera, &batteryTelemetry, &powerPolicy](const PowerPolicy& policy){
+        bMonitor.setSamplerPeriod(policy.samplerPeriod);
+        camera.setPreviewInterval(policy.previewInterval);
+        batteryTelemetry.setMaxBlockAge(policy.telemetryFlushInterval.count());
+        // the partial block is written when the deferred jobs are released
+        powerPolicy.runOrDefer("telemetry flush", [&batteryTelemetry](){
+            batteryTelemetry.flush();
+        });
+    });
+    // full rate until the first sample says otherwise
+    powerPolicy.apply(PowerPolicyMode::Performance, "startup");
+    bMonitor.addSampleListener([&powerPolicy](const BatterySnapshot& snapshot){
+        powerPolicy.update(snapshot.power);
+    });
+
+    CROW_ROUTE(app, "/power/policy")([&powerPolicy, &bMonitor, &camera](){
+        PowerPolicy policy = powerPolicy.current();
+        crow::json::wvalue response;
+        response["message"]["mode"] = powerPolicyModeToString(policy.mode);
+        response["message"]["reason"] = powerPolicy.reason();
+        response["message"]["since"] = powerPolicy.changedAtMs();
+        response["message"]["transitions"] = powerPolicy.transitions();
+        auto& effects = response["message"]["effects"];
+        effects["sampler"]["periodMs"] = bMonitor.getSamplerPeriod().count();
+        effects["cameraPreview"]["minIntervalMs"] = camera.getPreviewInterval().count();
+        effects["timers"]["slackMs"] = policy.timerSlack.count();
+        effects["telemetry"]["flushIntervalMs"] = policy.telemetryFlushInterval.count();
+        effects["pcieLinks"]["periodMs"] = policy.linkSamplerPeriod.count();
+        effects["diskStats"]["minPeriodMs"] = policy.diskStatsPeriod.count();
+        effects["blockDevices"]["rescanIntervalMs"] = policy.blockRescanInterval.count();
+        effects["backgroundJobs"]["deferred"] = policy.deferBackgroundJobs;
+        std::vector<crow::json::wvalue> pending;
+        for (const std::string& job : powerPolicy.deferredJobs()) {
+            pending.push_back(job);
+        }
+        effects["backgroundJobs"]["pending"] = std::move(pending);
+        response["status"] = 200;
+        return response;
+    });
+
+    // from/to are unix ms, resolution is ms per point (optional)
+    CROW_ROUTE(app, "/battery/history")([&batteryHistory](const crow::request& req){
+        crow::json::wvalue response;
+        uint64_t to = unixTimeMs();
+        uint64_t from = to - BatteryHistory::kHourMs;
+        uint64_t resolution = 0;
+        try {
+            if (req.url_params.get("to")) to = std::stoull(req.url_params.get("to"));
+            if (req.url_params.get("from")) from = std::stoull(req.url_params.get("from"));
+            if (req.url_params.get("resolution")) resolution = std::stoull(req.url_params.get("resolution"));
+        } catch (const std::exception&) {
+            response["message"] = "from, to and resolution must be unix milliseconds";
+            response["status"] = 400;
+            return response;
+        }
+
+        BatteryHistoryQuery result = batteryHistory.query(from, to, resolution);
+        std::vector<crow::json::wvalue> points;
+        points.reserve(result.points.size());
+        for (const auto& bucket : result.points) {
+            points.push_back(batteryHistoryBucketToJson(bucket));
+        }
+        response["message"]["tier"] = result.tier;
+        response["message"]["resolution"] = result.resolutionMs;
+        response["message"]["points"] = std::move(points);
+        response["message"]["memoryBytes"] = batteryHistory.memoryBytes();
+        response["status"] = 200;
+        return response;
+    });
+
     CROW_ROUTE(app, "/getCharge")([&bMonitor](){
         crow::json::wvalue response;
         response["message"] = bMonitor.getCharge();
@@ -120,20 +760,237 @@ int main()
         return rendered;
     });
 
-    // New endpoint: returns PCI devices info (VID/DID)
-    CROW_ROUTE(app, "/getPCIDevices")([](){
+    PciTopology pciTopology;
+
+    // rendered list and device details, rebuilt when their generation moves
+    GenerationCache pciResponses;
+
+    // link and AER sampling follows the enumerated devices
+    PcieLinkMonitor linkMonitor(sysfsRoot);
+    pciTopology.addListener([&linkMonitor](uint64_t, const std::vector<PciDeviceRecord>& devices) {
+        linkMonitor.setDevices(devices);
+    });
+    // every 5 s on AC, every 30 s in saver mode
+    powerPolicy.addListener([&linkMonitor](const PowerPolicy& policy){
+        linkMonitor.setPeriod(policy.linkSamplerPeriod);
+    });
+    pciTopology.refresh();
+
+    // class, vendor and name indexes of the list, rebuilt per generation
+    PciInventory pciInventory(pciTopology);
+
+    // New endpoint: returns PCI devices info (address, VID/DID, class, names).
+    // The body is rendered once per topology generation. Filters:
+    // ?class=storage,network (or hex class prefixes such as 0108),
+    // ?vendor=8086 (or a part of the name), ?name~=nvme; ids stay those of
+    // the full list.
+    CROW_ROUTE(app, "/getPCIDevices")([&pciTopology, &pciResponses, &pciInventory](const crow::request& req){
+        PciFilter filter;
+        if (req.url_params.get("class")) filter.classes = req.url_params.get("class");
+        if (req.url_params.get("vendor")) filter.vendors = req.url_params.get("vendor");
+        // "name~=x" reaches us as the key "name~"
+        if (req.url_params.get("name~")) filter.name = req.url_params.get("name~");
+        else if (req.url_params.get("name")) filter.name = req.url_params.get("name");
+        if (!filter.empty()) {
+            crow::json::wvalue response;
+            std::shared_ptr<const PciInventoryIndex> index = pciInventory.current();
+            std::vector<uint32_t> positions;
+            std::string error;
+            if (!index->filter(filter, positions, error)) {
+                response["message"] = error;
+                response["status"] = 400;
+                return crow::response(response);
+            }
+            std::vector<crow::json::wvalue> deviceArray;
+            deviceArray.reserve(positions.size());
+            for (uint32_t position : positions) {
+                crow::json::wvalue devObj = pciDeviceSummaryToJson(index->nodes()[position].device);
+                devObj["id"] = position + 1;
+                deviceArray.push_back(std::move(devObj));
+            }
+            response["devices"] = std::move(deviceArray);
+            response["total"] = (uint64_t)index->nodes().size();
+            response["generation"] = index->generation();
+            response["status"] = 200;
+            return crow::response(response);
+        }
+        uint64_t current = pciTopology.refresh();
+        GenerationCache::Body body = pciResponses.get("", current, [&pciTopology]() {
+            crow::json::wvalue response;
+            uint64_t generation;
+            std::vector<PciTopologyNode> nodes = pciTopology.nodes(generation);
+            std::vector<crow::json::wvalue> deviceArray;
+            int id = 1;
+            for (const auto& node : nodes) {
+                crow::json::wvalue devObj = pciDeviceSummaryToJson(node.device);
+                devObj["id"] = id++;
+                deviceArray.push_back(std::move(devObj));
+            }
+            response["devices"] = std::move(deviceArray);
+            response["generation"] = generation;
+            response["status"] = 200;
+            return response.dump();
+        });
+        crow::response response(*body);
+        response.set_header("Content-Type", "application/json");
+        return response;
+    });
+
+    // domain -> root bus functions -> bridges -> the functions behind them
+    CROW_ROUTE(app, "/pci/topology")([&pciTopology](){
         crow::json::wvalue response;
-        std::vector<std::pair<std::string, std::string>> devices = EnumeratePCIDevices();
-        std::vector<crow::json::wvalue> deviceArray;
-        int id = 1;
-        for (const auto& dev : devices) {
-            crow::json::wvalue devObj;
-            devObj["id"] = id++;
-            devObj["VenID"] = dev.first;
-            devObj["DevID"] = dev.second;
-            deviceArray.push_back(devObj);
+        pciTopology.refresh();
+        uint64_t generation;
+        std::vector<PciTopologyNode> nodes = pciTopology.nodes(generation);
+        std::map<std::string, const PciTopologyNode*> byAddress;
+        for (const auto& node : nodes) byAddress[node.device.address] = &node;
+        std::map<uint16_t, std::vector<crow::json::wvalue>> domains;
+        for (const auto& node : nodes) {
+            if (!byAddress.count(node.device.parent)) {
+                domains[node.domain].push_back(pciTopologyTreeToJson(byAddress, node));
+            }
         }
-        response["devices"] = std::move(deviceArray);
+        std::vector<crow::json::wvalue> domainArray;
+        for (auto& [domain, roots] : domains) {
+            crow::json::wvalue item;
+            char hex[8];
+            snprintf(hex, sizeof(hex), "%04x", domain);
+            item["domain"] = std::string(hex);
+            item["devices"] = std::move(roots);
+            domainArray.push_back(std::move(item));
+        }
+        response["domains"] = std::move(domainArray);
+        response["generation"] = generation;
+        response["status"] = 200;
+        return response;
+    });
+
+    // What changed after generation `since`. Unchanged answers carry only the
+    // generation; `reset` (unknown or too old since) means "added" is everything.
+    CROW_ROUTE(app, "/pci/changes")([&pciTopology](const crow::request& req){
+        crow::json::wvalue response;
+        uint64_t since = 0;
+        try {
+            if (req.url_params.get("since")) since = std::stoull(req.url_params.get("since"));
+        } catch (const std::exception&) {
+            response["message"] = "since must be a generation number";
+            response["status"] = 400;
+            return response;
+        }
+        pciTopology.refresh();
+        PciChanges changes = pciTopology.changesSince(since);
+        response["generation"] = changes.generation;
+        if (changes.reset) response["reset"] = true;
+        if (!changes.added.empty()) {
+            std::vector<crow::json::wvalue> added;
+            for (const auto& node : changes.added) added.push_back(pciTopologyNodeToJson(node));
+            response["added"] = std::move(added);
+        }
+        if (!changes.changed.empty()) {
+            std::vector<crow::json::wvalue> changed;
+            for (const auto& node : changes.changed) changed.push_back(pciTopologyNodeToJson(node));
+            response["changed"] = std::move(changed);
+        }
+        if (!changes.removed.empty()) response["removed"] = changes.removed;
+        response["status"] = 200;
+        return response;
+    });
+
+    // Everything known about one function, e.g. /pci/device/0000:00:1f.3:
+    // the record, driver, IOMMU group and decoded config space. Built on the
+    // first request and kept until the device's generation changes.
+    CROW_ROUTE(app, "/pci/device/<string>")([&pciTopology, &pciResponses](const std::string& address){
+        pciTopology.refresh();
+        PciTopologyNode node;
+        if (!pciTopology.find(address, node)) {
+            crow::json::wvalue response;
+            response["message"] = "No PCI device " + address;
+            response["status"] = 404;
+            return crow::response(response);
+        }
+        GenerationCache::Body body = pciResponses.get(address, node.generation, [&node]() {
+            crow::json::wvalue response = pciDeviceRecordToJson(node.device);
+            response["parent"] = node.device.parent;
+            response["generation"] = node.generation;
+            int group = ReadPCIIommuGroup(node.device.address);
+            if (group >= 0) response["iommuGroup"] = group;
+            uint8_t config[4096];
+            size_t length = ReadPCIConfigSpace(node.device.address, config, sizeof(config));
+            PciConfigSpace decoded;
+            if (decodePciConfig(config, length, decoded)) {
+                response["config"] = pciConfigToJson(decoded);
+            }
+            response["status"] = 200;
+            return response.dump();
+        });
+        crow::response response(*body);
+        response.set_header("Content-Type", "application/json");
+        return response;
+    });
+
+
+    // Link state and AER error rates of every PCIe function, rates over the
+    // last `window` seconds (60 by default).
+    CROW_ROUTE(app, "/pci/links")([&pciTopology, &linkMonitor](const crow::request& req){
+        crow::json::wvalue response;
+        uint64_t window = 60;
+        try {
+            if (req.url_params.get("window")) window = std::stoull(req.url_params.get("window"));
+        } catch (const std::exception&) {
+            response["message"] = "window must be a number of seconds";
+            response["status"] = 400;
+            return response;
+        }
+        pciTopology.refresh();
+        std::vector<crow::json::wvalue> links;
+        for (const auto& item : linkMonitor.health(window * 1000)) {
+            crow::json::wvalue link;
+            link["address"] = item.address;
+            link["linkSpeed"] = item.linkSpeed;
+            link["linkWidth"] = item.linkWidth;
+            link["maxLinkSpeed"] = item.maxLinkSpeed;
+            link["maxLinkWidth"] = item.maxLinkWidth;
+            link["widthDegraded"] = item.widthDegraded;
+            link["speedDegraded"] = item.speedDegraded;
+            link["downtrains"] = item.downtrains;
+            if (item.hasAer) {
+                link["correctable"] = item.correctable;
+                link["nonFatal"] = item.nonFatal;
+                link["fatal"] = item.fatal;
+                link["correctablePerMinute"] = item.correctablePerMinute;
+                link["nonFatalPerMinute"] = item.nonFatalPerMinute;
+                link["fatalPerMinute"] = item.fatalPerMinute;
+            }
+            links.push_back(std::move(link));
+        }
+        response["links"] = std::move(links);
+        response["window"] = window;
+        response["status"] = 200;
+        return response;
+    });
+
+    // the samples kept for one function, oldest first
+    CROW_ROUTE(app, "/pci/links/<string>")([&linkMonitor](const std::string& address){
+        crow::json::wvalue response;
+        std::vector<PcieLinkSample> samples;
+        if (!linkMonitor.history(address, samples)) {
+            response["message"] = "No PCIe link sampled for " + address;
+            response["status"] = 404;
+            return response;
+        }
+        std::vector<crow::json::wvalue> history;
+        for (const auto& sample : samples) {
+            crow::json::wvalue item;
+            item["timestamp"] = sample.timestampMs;
+            item["linkSpeed"] = sample.linkSpeed;
+            item["linkWidth"] = (int)sample.linkWidth;
+            item["correctable"] = sample.correctable;
+            item["nonFatal"] = sample.nonFatal;
+            item["fatal"] = sample.fatal;
+            history.push_back(std::move(item));
+        }
+        response["address"] = address;
+        response["history"] = std::move(history);
         response["status"] = 200;
         return response;
     });
@@ -145,9 +1002,424 @@ int main()
         return rendered;
     });
 
-    CROW_ROUTE(app, "/getStorageDevices")([](){
+    // disks, partitions and mounts from sysfs and procfs, enumerated again
+    // after block uevents and mount table changes
+    BlockInventory blockInventory(sysfsRoot, procRoot);
+    powerPolicy.addListener([&blockInventory](const PowerPolicy& policy){
+        blockInventory.setRescanInterval(policy.blockRescanInterval);
+    });
+    GenerationCache storageResponses;
+
+    // Where there is a native inventory (Linux): {"devices": [...]}, rendered
+    // once per inventory generation. Otherwise, or with ?source=report, the
+    // report as {"data": text}, transcoded from the mapped file chunk by
+    // chunk straight into the escaped body, which is the only full-size copy.
+    // ?source=inventory never reads the report: a client that follows it
+    // through /storage/report gets a 404 instead of the whole text.
+    CROW_ROUTE(app, "/getStorageDevices")([&storageReportPath, &blockInventory, &storageResponses](const crow::request& req){
+        std::string source = req.url_params.get("source") ? req.url_params.get("source") : "";
+        if (source == "inventory" && !BlockInventory::available()) {
+            crow::json::wvalue response;
+            response["message"] = "No native device inventory here, see /storage/report";
+            response["status"] = 404;
+            return crow::response(response);
+        }
+        if (BlockInventory::available() && source != "report") {
+            std::shared_ptr<const BlockInventorySnapshot> inventory = blockInventory.current();
+            GenerationCache::Body body = storageResponses.get("", inventory->generation, [&inventory]() {
+                crow::json::wvalue response;
+                std::vector<crow::json::wvalue> devices;
+                devices.reserve(inventory->devices.size());
+                for (const auto& device : inventory->devices) devices.push_back(blockDeviceToJson(device));
+                response["devices"] = std::move(devices);
+                response["generation"] = inventory->generation;
+                response["status"] = 200;
+                return response.dump();
+            });
+            crow::response response(*body);
+            response.set_header("Content-Type", "application/json");
+            return response;
+        }
+        StorageReport report;
+        if (!report.open(storageReportPath)) {
+            crow::json::wvalue response;
+            response["message"] = report.error();
+            response["status"] = 404;
+            return crow::response(response);
+        }
+        crow::response response;
+        response.set_header("Content-Type", "application/json");
+        // escapes add a little, most reports are plain text
+        response.body.reserve(report.maxTextSize() + report.maxTextSize() / 16 + 32);
+        response.body += "{\"data\":\"";
+        report.stream([&response](const char* data, size_t size) {
+            appendJsonEscaped(response.body, data, size);
+            return true;
+        });
+        response.body += "\",\"status\":200}";
+        return response;
+    });
+
+    // The report as it is being written: ?since=<next of the last answer>
+    // returns only what was appended since, decoded to UTF-8 like above. A
+    // `reset` answer starts over (the report was replaced); `more` means ask
+    // again right away.
+    FileFollower reportFollower(storageReportPath);
+    CROW_ROUTE(app, "/storage/report")([&reportFollower](const crow::request& req){
+        uint64_t since = 0;
+        size_t maxBytes = 1 << 20;
+        try {
+            if (req.url_params.get("since")) since = std::stoull(req.url_params.get("since"));
+            if (req.url_params.get("max")) maxBytes = std::stoull(req.url_params.get("max"));
+        } catch (const std::exception&) {
+            crow::json::wvalue response;
+            response["message"] = "since and max must be byte counts";
+            response["status"] = 400;
+            return response;
+        }
+        FollowChunk chunk;
+        if (!reportFollower.read(since, std::clamp<size_t>(maxBytes, 4096, 16 << 20), chunk)) {
+            crow::json::wvalue response;
+            response["message"] = reportFollower.error();
+            response["status"] = 404;
+            return response;
+        }
+        return followChunkToJson(chunk);
+    });
+
+    // Disk usage of the recordings folder and of removable drives. Only these
+    // roots can be scanned; each keeps its last tree, so asking again costs
+    // one statx per directory unless something changed. usageScanner is
+    // declared above powerPolicy.
+    auto usageRoots = [&usbMonitor, &blockInventory, &outputDir]() {
+        std::vector<std::pair<std::string, std::string>> roots{{"output", outputDir}};
+        for (char letter : usbMonitor.listRemovableDrives()) {
+            roots.push_back({std::string("drive:") + letter, std::string(1, letter) + ":\\"});
+        }
+        if (BlockInventory::available()) {
+            auto inventory = blockInventory.current();
+            for (const auto& device : inventory->devices) {
+                if (!device.removable) continue;
+                for (const auto& mount : device.mounts) roots.push_back({"device:" + device.name, mount.mountPoint});
+                for (const auto& part : device.partitions) {
+                    for (const auto& mount : part.mounts) roots.push_back({"device:" + part.name, mount.mountPoint});
+                }
+            }
+        }
+        return roots;
+    };
+
+    CROW_ROUTE(app, "/storage/usage/roots")([&usageRoots](){
+        crow::json::wvalue response;
+        std::vector<crow::json::wvalue> roots;
+        for (const auto& [id, path] : usageRoots()) {
+            crow::json::wvalue root;
+            root["id"] = id;
+            root["path"] = path;
+            roots.push_back(std::move(root));
+        }
+        response["roots"] = std::move(roots);
+        response["status"] = 200;
+        return response;
+    });
+
+    // /storage/usage?root=output&top=20&depth=1, full=1 to read everything again
+    CROW_ROUTE(app, "/storage/usage")([&usageRoots, &usageScanner, &powerPolicy](const crow::request& req){
+        crow::json::wvalue response;
+        std::string id = req.url_params.get("root") ? req.url_params.get("root") : "output";
+        std::string path;
+        for (const auto& [rootId, rootPath] : usageRoots()) {
+            if (rootId == id) {
+                path = rootPath;
+                break;
+            }
+        }
+        if (path.empty()) {
+            response["message"] = "Unknown root " + id + ", see /storage/usage/roots";
+            response["status"] = 404;
+            return response;
+        }
+        DiskUsageOptions options;
+        try {
+            if (req.url_params.get("top")) options.top = std::stoul(req.url_params.get("top"));
+            if (req.url_params.get("depth")) options.depth = std::stoi(req.url_params.get("depth"));
+        } catch (const std::exception&) {
+            response["message"] = "top and depth must be numbers";
+            response["status"] = 400;
+            return response;
+        }
+        options.full = req.url_params.get("full") && std::string(req.url_params.get("full")) != "0";
+        if (options.full && powerPolicy.current().deferBackgroundJobs) {
+            // reading every directory again waits for AC (it is the same
+            // scan for every request, so it runs once, on the policy's job
+            // thread, never on the battery sampler); the answer comes from
+            // a rescan of what changed
+            powerPolicy.runOrDefer("usage rescan " + id, [&usageScanner, path, options]() {
+                DiskUsageReport report;
+                std::string error;
+                usageScanner.scan(path, options, report, error);
+            });
+            options.full = false;
+            response["scan"]["fullDeferred"] = true;
+        }
+        DiskUsageReport report;
+        std::string error;
+        if (!usageScanner.scan(path, options, report, error)) {
+            response["message"] = error;
+            response["status"] = 500;
+            return response;
+        }
+        auto usageToJson = [](const DirectoryUsage& usage) {
+            crow::json::wvalue json;
+            json["path"] = usage.path;
+            json["bytes"] = usage.bytes;
+            json["allocatedBytes"] = usage.allocatedBytes;
+            json["files"] = usage.files;
+            json["directories"] = usage.directories;
+            return json;
+        };
+        std::vector<crow::json::wvalue> directories;
+        for (const auto& usage : report.directories) directories.push_back(usageToJson(usage));
+        std::vector<crow::json::wvalue> largest;
+        for (const auto& file : report.largest) {
+            crow::json::wvalue json;
+            json["path"] = file.path;
+            json["bytes"] = file.bytes;
+            json["modified"] = file.modifiedMs;
+            largest.push_back(std::move(json));
+        }
+        response["root"] = id;
+        response["path"] = report.root;
+        response["total"] = usageToJson(report.total);
+        response["directories"] = std::move(directories);
+        response["largest"] = std::move(largest);
+        response["errors"] = report.errors;
+        response["scan"]["us"] = report.scanUs;
+        response["scan"]["listed"] = report.listedDirectories;
+        response["scan"]["reused"] = report.reusedDirectories;
+        response["scan"]["statCalls"] = report.statCalls;
+        response["status"] = 200;
+        return response;
+    });
+
+    // Live disk I/O from /proc/diskstats, one tick per --diskstats-period
+    DiskStatsMonitor diskStats(procRoot, sysfsRoot);
+    auto diskStatsPeriod = [diskstatsPeriodMs](const PowerPolicy& policy) {
+        return std::max(std::chrono::milliseconds(diskstatsPeriodMs), policy.diskStatsPeriod);
+    };
+    // --diskstats-period on AC, at least every 5 s in saver mode
+    powerPolicy.addListener([&diskStats, diskStatsPeriod](const PowerPolicy& policy){
+        diskStats.setPeriod(diskStatsPeriod(policy));
+    });
+
+    // Every device with its last tick and the averages over the last
+    // `window` seconds (10 by default); saturated disks are flagged.
+    CROW_ROUTE(app, "/storage/io")([&diskStats](const crow::request& req){
+        crow::json::wvalue response;
+        uint64_t window = 10;
+        try {
+            if (req.url_params.get("window")) window = std::stoull(req.url_params.get("window"));
+        } catch (const std::exception&) {
+            response["message"] = "window must be a number of seconds";
+            response["status"] = 400;
+            return response;
+        }
+        std::vector<crow::json::wvalue> devices;
+        for (const auto& item : diskStats.stats(window * 1000)) devices.push_back(diskIoStatsToJson(item));
+        response["devices"] = std::move(devices);
+        response["window"] = window;
+        response["sampler"]["periodMs"] = diskStats.period().count();
+        response["sampler"]["tickUs"] = diskStats.lastTickUs();
+        response["sampler"]["running"] = diskStats.isRunning();
+        response["status"] = 200;
+        return response;
+    });
+
+    // the ticks kept for one device, oldest first
+    CROW_ROUTE(app, "/storage/io/<string>")([&diskStats](const std::string& name){
         crow::json::wvalue response;
-        response["data"] = RequestInfoStorage("D:\\Study\\ИиУВМ\\WinXP\\shared\\SSD\\SSD\\output.txt");
+        std::vector<DiskIoSample> samples;
+        if (!diskStats.history(name, samples)) {
+            response["message"] = "No I/O statistics for " + name;
+            response["status"] = 404;
+            return response;
+        }
+        std::vector<crow::json::wvalue> history;
+        history.reserve(samples.size());
+        for (const auto& sample : samples) history.push_back(diskIoSampleToJson(sample));
+        response["name"] = name;
+        response["history"] = std::move(history);
+        response["status"] = 200;
+        return response;
+    });
+
+    // Push stream like /battery/stream: every device on connect, afterwards
+    // the devices whose tick differs from the one last sent and the names
+    // of the ones that went away. Idle disks send nothing.
+    StreamHub<crow::websocket::connection> ioStream;
+    std::unordered_map<std::string, DiskIoSample> lastStreamedIo;
+    {
+        crow::json::wvalue full;
+        full["type"] = "snapshot";
+        full["message"]["devices"] = std::vector<crow::json::wvalue>();
+        ioStream.setState(full.dump());
+    }
+    diskStats.addListener([&diskStats, &ioStream, &lastStreamedIo](uint64_t){
+        std::vector<DiskIoStats> stats = diskStats.stats(0);
+        std::vector<crow::json::wvalue> changed;
+        std::vector<crow::json::wvalue> all;
+        all.reserve(stats.size());
+        std::unordered_set<std::string> present;
+        for (const auto& item : stats) {
+            present.insert(item.name);
+            auto it = lastStreamedIo.find(item.name);
+            if (it == lastStreamedIo.end() || diskIoSampleChanged(it->second, item.last)) {
+                changed.push_back(diskIoStatsToJson(item));
+                lastStreamedIo[item.name] = item.last;
+            }
+            all.push_back(diskIoStatsToJson(item));
+        }
+        std::vector<crow::json::wvalue> removed;
+        for (auto it = lastStreamedIo.begin(); it != lastStreamedIo.end(); ) {
+            if (present.count(it->first)) {
+                ++it;
+            } else {
+                removed.push_back(crow::json::wvalue(it->first));
+                it = lastStreamedIo.erase(it);
+            }
+        }
+        if (changed.empty() && removed.empty()) return;
+        crow::json::wvalue delta;
+        delta["type"] = "delta";
+        delta["message"]["devices"] = std::move(changed);
+        delta["message"]["removed"] = std::move(removed);
+        crow::json::wvalue full;
+        full["type"] = "snapshot";
+        full["message"]["devices"] = std::move(all);
+        ioStream.publish(delta.dump(), full.dump());
+    });
+
+    CROW_WEBSOCKET_ROUTE(app, "/storage/io/stream")
+        .onopen([&ioStream](crow::websocket::connection& conn){
+            ioStream.subscribe(conn);
+        })
+        // the close handler signature differs between Crow versions (code argument)
+        .onclose([&ioStream](crow::websocket::connection& conn, const std::string&, auto&&...){
+            ioStream.unsubscribe(conn);
+        })
+        .onmessage([](crow::websocket::connection&, const std::string&, bool){
+            // nothing to receive, the stream is one-way
+        });
+
+    // Storage benchmark jobs, run one at a time against a temp file in `path`:
+    // POST /storage/bench/start?path=/media/usb&pattern=randread&bs=4096&qd=32&duration=10&size=256&direct=1&engine=auto
+    // (duration in seconds, size in MiB; everything but path is optional).
+    // The job writes up to 1 TiB, so `path` must be a mount point from the
+    // block inventory or a disk usage root, or a directory below one.
+    StorageBenchQueue benchJobs;
+    auto benchDirectoryAllowed = [&usageRoots, &blockInventory](const std::string& path) {
+        std::error_code code;
+        std::filesystem::path directory = std::filesystem::canonical(path, code);
+        if (code || !std::filesystem::is_directory(directory, code)) return false;
+        std::vector<std::string> allowed;
+        for (const auto& root : usageRoots()) allowed.push_back(root.second);
+        if (BlockInventory::available()) {
+            auto inventory = blockInventory.current();
+            for (const auto& device : inventory->devices) {
+                for (const auto& mount : device.mounts) allowed.push_back(mount.mountPoint);
+                for (const auto& part : device.partitions) {
+                    for (const auto& mount : part.mounts) allowed.push_back(mount.mountPoint);
+                }
+            }
+        }
+        for (const auto& root : allowed) {
+            std::filesystem::path base = std::filesystem::canonical(root, code);
+            if (code) continue;
+            // whole components only: /media/usb does not allow /media/usb2
+            if (std::mismatch(base.begin(), base.end(), directory.begin(), directory.end()).first == base.end()) return true;
+        }
+        return false;
+    };
+    CROW_ROUTE(app, "/storage/bench/start")
+    .methods(crow::HTTPMethod::POST)
+    ([&benchJobs, &benchDirectoryAllowed](const crow::request& req){
+        crow::json::wvalue response;
+        auto query_params = crow::query_string(req.url);
+        StorageBenchConfig config;
+        std::string error;
+        // before narrowing, so 2^32 + 4096 is not taken for 4096
+        auto number = [](const char* text, uint64_t max) {
+            uint64_t value = std::stoull(text);
+            if (value > max) throw std::out_of_range(text);
+            return value;
+        };
+        try {
+            if (query_params.get("path")) config.directory = query_params.get("path");
+            if (query_params.get("pattern") && !parseBenchPattern(query_params.get("pattern"), config.pattern)) {
+                error = "pattern must be read, write, randread or randwrite";
+            }
+            if (query_params.get("engine") && !parseBenchEngine(query_params.get("engine"), config.engine)) {
+                error = "engine must be auto, io_uring or threads";
+            }
+            if (query_params.get("bs")) config.blockSize = (uint32_t)number(query_params.get("bs"), UINT32_MAX);
+            if (query_params.get("qd")) config.queueDepth = (uint32_t)number(query_params.get("qd"), UINT32_MAX);
+            if (query_params.get("duration")) {
+                double seconds = std::stod(query_params.get("duration"));
+                config.durationMs = seconds > 0 && seconds < 3600 ? (uint32_t)(seconds * 1000) : 0;
+            }
+            // in MiB, shifted only once it is known to fit
+            if (query_params.get("size")) config.fileSize = number(query_params.get("size"), UINT64_MAX >> 20) << 20;
+            if (query_params.get("direct")) config.direct = std::string(query_params.get("direct")) != "0";
+        } catch (const std::exception&) {
+            error = "bs, qd, duration and size must be numbers in range";
+        }
+        if (error.empty() && !config.directory.empty() && !benchDirectoryAllowed(config.directory)) {
+            error = "path must be a mounted disk or a disk usage root";
+        }
+        uint64_t id = error.empty() ? benchJobs.submit(config, error) : 0;
+        if (id == 0) {
+            response["message"] = error;
+            response["status"] = 400;
+            return response;
+        }
+        response["id"] = id;
+        response["status"] = 200;
+        return response;
+    });
+
+    CROW_ROUTE(app, "/storage/bench")([&benchJobs](){
+        crow::json::wvalue response;
+        std::vector<crow::json::wvalue> jobs;
+        for (const auto& job : benchJobs.jobs()) jobs.push_back(benchJobToJson(job));
+        response["jobs"] = std::move(jobs);
+        response["ioUring"] = StorageBenchmark::ioUringAvailable();
+        response["status"] = 200;
+        return response;
+    });
+
+    CROW_ROUTE(app, "/storage/bench/<uint>")([&benchJobs](uint64_t id){
+        StorageBenchJob job;
+        if (!benchJobs.job(id, job)) {
+            crow::json::wvalue response;
+            response["message"] = "No benchmark job " + std::to_string(id);
+            response["status"] = 404;
+            return response;
+        }
+        crow::json::wvalue response = benchJobToJson(job);
+        response["status"] = 200;
+        return response;
+    });
+
+    CROW_ROUTE(app, "/storage/bench/<uint>/cancel")
+    .methods(crow::HTTPMethod::POST, crow::HTTPMethod::GET)
+    ([&benchJobs](uint64_t id){
+        crow::json::wvalue response;
+        if (!benchJobs.cancel(id)) {
+            response["message"] = "No queued or running benchmark job " + std::to_string(id);
+            response["status"] = 404;
+            return response;
+        }
+        response["message"] = "Cancelling job " + std::to_string(id);
         response["status"] = 200;
         return response;
     });
@@ -400,6 +1672,29 @@ int main()
         return rendered;
     });
 
+    // usb_log.txt: the last 64 KiB without ?since, after that only the lines
+    // appended since `next` of the last answer
+    CROW_ROUTE(app, "/usb/log")([&usbMonitor](const crow::request& req){
+        FollowChunk chunk;
+        bool read;
+        try {
+            const char* since = req.url_params.get("since");
+            read = since ? usbMonitor.readLog(std::stoull(since), chunk) : usbMonitor.tailLog(chunk);
+        } catch (const std::exception&) {
+            crow::json::wvalue response;
+            response["message"] = "since must be a byte offset";
+            response["status"] = 400;
+            return response;
+        }
+        if (!read) {
+            crow::json::wvalue response;
+            response["message"] = "usb_log.txt cannot be read";
+            response["status"] = 404;
+            return response;
+        }
+        return followChunkToJson(chunk);
+    });
+
     // USB Drive Ejection endpoint (POST only)
     CROW_ROUTE(app, "/ejectUsbDrive")
         .methods(crow::HTTPMethod::POST)
@@ -642,5 +1937,14 @@ int main()
             return response;
         });
 
+    // only now, so that no sample (a fast replay in particular) misses a listener
+    bMonitor.startSampler(std::chrono::milliseconds(1000));
+    // the policy may have changed since the listeners were added
+    linkMonitor.start(powerPolicy.current().linkSamplerPeriod);
+    diskStats.start(diskStatsPeriod(powerPolicy.current()));
     app.port(8080).run();
+    // listeners reference locals of main(), stop calling them before those go away
+    bMonitor.stopSampler();
+    linkMonitor.stop();
+    diskStats.stop();
 }
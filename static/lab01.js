@@ -1,90 +1,110 @@
 
-function updateBatteryInfo() {
-    axios.get('/getCharge')
-        .then(function (response) {
-            document.getElementById('charge').innerText = 'Charge: ' + response.data.message + '%';
-        })
-        .catch(function (error) {
-            console.log(error);
-        });
-
-    axios.get('/getStatus')
-        .then(function (response) {
-            document.getElementById('status').innerText = 'Status: ' + response.data.message;
-        })
-        .catch(function (error) {
-            console.log(error);
-        });
-
-    axios.get('/getPowerMode')
-        .then(function (response) {
-            document.getElementById('power-mode').innerText = 'Power Mode: ' + response.data.message;
-            const gif = document.getElementById('power-gif');
-            const loader = document.getElementById('power-loader');
-            for (const sheet of document.styleSheets) {
-                try {
-                    for (const rule of sheet.cssRules) {
-                    if (rule.selectorText === '.loader::after') {
-                        // rule.style.content = '"New content"';
-                        rule.style.animation = 'none';
-                        break;
-                    }
-                    }
-                } catch(e) {
-                    // Ignore cross-origin stylesheet errors
-                }
+function renderPowerMode(powerMode) {
+    document.getElementById('power-mode').innerText = 'Power Mode: ' + powerMode;
+    const gif = document.getElementById('power-gif');
+    const loader = document.getElementById('power-loader');
+    for (const sheet of document.styleSheets) {
+        try {
+            for (const rule of sheet.cssRules) {
+            if (rule.selectorText === '.loader::after') {
+                // rule.style.content = '"New content"';
+                rule.style.animation = 'none';
+                break;
             }
-            
-            if (response.data.message === "Online") {
-                gif.style.display = 'block';
-                for (const sheet of document.styleSheets) {
-                try {
-                    for (const rule of sheet.cssRules) {
-                    if (rule.selectorText === '.loader::after') {
-                        rule.style.animation = 'full 5s ease-in-out infinite';
-                        break;
-                    }
-                    }
-                } catch(e) {
-                    // Ignore cross-origin stylesheet errors
-                }
             }
-                
-            } else {
-                gif.style.display = 'none';
-                loader.style.animation = "none";
+        } catch(e) {
+            // Ignore cross-origin stylesheet errors
+        }
+    }
+
+    if (powerMode === "Online") {
+        gif.style.display = 'block';
+        for (const sheet of document.styleSheets) {
+        try {
+            for (const rule of sheet.cssRules) {
+            if (rule.selectorText === '.loader::after') {
+                rule.style.animation = 'full 5s ease-in-out infinite';
+                break;
             }
-        })
-        .catch(function (error) {
-            console.log(error);
-        });
+            }
+        } catch(e) {
+            // Ignore cross-origin stylesheet errors
+        }
+    }
 
-    axios.get('/getInfo')
-        .then(function (response) {
-            document.getElementById('info').innerText = 'Info: ' + response.data.message;
-        })
-        .catch(function (error) {
-            console.log(error);
-        });
+    } else {
+        gif.style.display = 'none';
+        loader.style.animation = "none";
+    }
+}
 
-    axios.get('/getTimeLeft')
-        .then(function (response) {
-            let seconds = response.data.message;
-            if (seconds < 0) {
-                document.getElementById('time-left').innerText = 'Time Left: Unknown';
-            } else {
-                let hours = Math.floor(seconds / 3600);
-                let minutes = Math.floor((seconds % 3600) / 60);
-                document.getElementById('time-left').innerText = 'Time Left: ' + hours + 'h ' + minutes + 'm';
-            }
-        })
-        .catch(function (error) {
-            console.log(error);
-        });
+function renderTimeLeft(seconds) {
+    if (seconds < 0) {
+        document.getElementById('time-left').innerText = 'Time Left: Unknown';
+    } else {
+        let hours = Math.floor(seconds / 3600);
+        let minutes = Math.floor((seconds % 3600) / 60);
+        document.getElementById('time-left').innerText = 'Time Left: ' + hours + 'h ' + minutes + 'm';
+    }
+}
+
+// same text as /getStatus
+function formatBatteryFlags(power) {
+    if (!power.valid) return 'Error';
+    const flags = power.flags;
+    if (!flags.known) return 'Unknown status';
+    const parts = [];
+    if (flags.noSystemBattery) parts.push('No system battery');
+    if (flags.charging) parts.push('Charging');
+    if (flags.critical) parts.push('Critical (less than 5%)');
+    if (flags.low) parts.push('Low (less than 33%)');
+    if (flags.high) parts.push('High (more than 66%)');
+    return parts.length ? parts.join('; ') : 'Battery status normal';
+}
+
+function formatCapacity(value) {
+    return value < 0 ? 'Unknown' : value + ' mWh';
+}
+
+function formatBatteries(batteries, fleet) {
+    if (!batteries.length) return 'No batteries found or could not be queried.';
+    let text = '';
+    batteries.forEach(function (battery, i) {
+        text += 'Found Battery ' + i + ': ' + battery.name + '\n';
+        if (!battery.queried) {
+            text += '  Failed to query battery information.\n';
+            return;
+        }
+        text += '  Chemistry: ' + (battery.chemistry || 'Unknown') + '\n';
+        text += '  Designed Capacity: ' + formatCapacity(battery.designedCapacity) + '\n';
+        text += '  Full Charged Capacity: ' + formatCapacity(battery.fullChargedCapacity) + '\n';
+        text += '  Cycle Count: ' + (battery.cycleCount < 0 ? 'Unknown' : battery.cycleCount) + '\n';
+        text += '  Wear Level: ' + (battery.wearLevel < 0 ? 'Unknown' : (battery.wearLevel * 100).toFixed(1) + '%') + '\n';
+    });
+    if (batteries.length > 1 && fleet.wearLevel >= 0) {
+        text += 'All batteries: ' + formatCapacity(fleet.fullChargedCapacity) + ' of ' +
+                formatCapacity(fleet.designedCapacity) + ', wear ' + (fleet.wearLevel * 100).toFixed(1) + '%\n';
+    }
+    return text;
+}
 
-    axios.get('/isEco')
+function renderBatterySnapshot(snapshot) {
+    const power = snapshot.power;
+    document.getElementById('charge').innerText = 'Charge: ' + (power.charge < 0 ? 'Unknown' : power.charge + '%');
+    document.getElementById('status').innerText = 'Status: ' + formatBatteryFlags(power);
+    renderPowerMode(!power.valid ? 'Failed to get power status.' :
+                    power.acLine === 'online' ? 'Online' :
+                    power.acLine === 'offline' ? 'Offline' : 'Unknown');
+    document.getElementById('info').innerText = 'Info: ' + formatBatteries(snapshot.batteries, snapshot.fleet);
+    renderTimeLeft(power.timeLeft);
+    document.getElementById('eco-mode').innerText = 'Eco Mode: ' + (power.eco ? 'On' : 'Off');
+}
+
+// one request per tick instead of one per field
+function updateBatteryInfo() {
+    axios.get('/battery/snapshot')
         .then(function (response) {
-            document.getElementById('eco-mode').innerText = 'Eco Mode: ' + response.data.message;
+            renderBatterySnapshot(response.data.message);
         })
         .catch(function (error) {
             console.log(error);
@@ -111,5 +131,51 @@ function hibernate() {
         });
 }
 
-setInterval(updateBatteryInfo, 1000);
-updateBatteryInfo();
+// Push updates: the server sends the full snapshot once, then only the fields
+// that changed. Polling is only a fallback while the stream is down.
+let battery = {};
+let pollTimer = null;
+
+function startPolling() {
+    if (pollTimer === null) {
+        updateBatteryInfo();
+        pollTimer = setInterval(updateBatteryInfo, 1000);
+    }
+}
+
+function stopPolling() {
+    if (pollTimer !== null) {
+        clearInterval(pollTimer);
+        pollTimer = null;
+    }
+}
+
+function connectBatteryStream() {
+    if (!('WebSocket' in window)) {
+        startPolling();
+        return;
+    }
+    const protocol = location.protocol === 'https:' ? 'wss://' : 'ws://';
+    const socket = new WebSocket(protocol + location.host + '/battery/stream');
+
+    socket.onopen = function () {
+        stopPolling();
+    };
+
+    socket.onmessage = function (event) {
+        const data = JSON.parse(event.data);
+        if (data.type === 'snapshot') {
+            battery = data.message;
+        } else {
+            Object.assign(battery, data.message);
+        }
+        renderBatterySnapshot(battery);
+    };
+
+    socket.onclose = function () {
+        startPolling();
+        setTimeout(connectBatteryStream, 5000);
+    };
+}
+
+connectBatteryStream();
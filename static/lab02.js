@@ -47,6 +47,9 @@ window.addEventListener('mousemove', (event) => {
     coordsLabel.textContent = `Cursor Position: ${mouseX.toFixed(0)}, ${mouseY.toFixed(0)} | Distance: ${distance.toFixed(2)}px, Angle: ${angle}°  >>  ${normalized_distance}`;
 });
 
+// generation of the rendered list, 0 before the first load
+let pciGeneration = 0;
+
 // Function to fetch PCI devices and render table
 async function renderPCIDevicesTable() {
     try {
@@ -55,8 +58,11 @@ async function renderPCIDevicesTable() {
             throw new Error('Failed to fetch PCI devices');
         }
         const devices = response.data.devices;
+        pciGeneration = response.data.generation;
         const right = document.getElementById("card__right");
         const left = document.getElementById("card__left");
+        right.innerHTML = '';
+        left.innerHTML = '';
         devices.forEach(dev => {
             console.log(dev);
             const item_l = `
@@ -91,5 +97,21 @@ async function renderPCIDevicesTable() {
     }
 }
 
+// Polls for changes; an unchanged bus answers with the generation only
+async function pollPCIChanges() {
+    try {
+        const response = await axios.get(`/pci/changes?since=${pciGeneration}`);
+        const changes = response.data;
+        if (changes.status === 200 && changes.generation !== pciGeneration) {
+            await renderPCIDevicesTable();
+        }
+    } catch (err) {
+        console.error('Error polling PCI changes:', err);
+    }
+}
+
 // Call on page load
-window.addEventListener('DOMContentLoaded', renderPCIDevicesTable);
\ No newline at end of file
+window.addEventListener('DOMContentLoaded', () => {
+    renderPCIDevicesTable();
+    setInterval(pollPCIChanges, 5000);
+});
\ No newline at end of file
@@ -27,8 +27,48 @@ document.addEventListener('DOMContentLoaded', function() {
     // Load initial device lists
     listUsbDrives();
     listInputDevices();
+    followUsbLog();
+    setInterval(followUsbLog, 2000);
 });
 
+// The server's usb_log.txt: its tail first, then only the lines appended
+// since the last answer. A poll that comes while the last one is still
+// reading is skipped, so the same lines are never asked for twice.
+let usbLogNext = null;
+let usbLogReading = false;
+async function followUsbLog() {
+    if (usbLogReading) return;
+    usbLogReading = true;
+    try {
+        let chunk;
+        do {
+            const url = usbLogNext === null ? '/usb/log' : '/usb/log?since=' + usbLogNext;
+            chunk = await (await fetch(url)).json();
+            if (chunk.status !== 200) return;
+            for (const line of chunk.text.split('\n')) {
+                if (line) addServerLogLine(line);
+            }
+            usbLogNext = chunk.next;
+        } while (chunk.more);
+    } catch (error) {
+        console.error('Error reading the USB log:', error);
+    } finally {
+        usbLogReading = false;
+    }
+}
+
+function addServerLogLine(line) {
+    const logContainer = document.getElementById('log-entries');
+    if (!logContainer) return;
+    const logEntry = document.createElement('div');
+    logEntry.className = 'log-entry';
+    logEntry.textContent = line;
+    logContainer.prepend(logEntry);
+    if (logContainer.children.length > 50) {
+        logContainer.removeChild(logContainer.lastChild);
+    }
+}
+
 // Function to disable USB mouse
 async function disableUsbMouse() {
     try {